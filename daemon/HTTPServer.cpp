@@ -157,6 +157,14 @@ namespace http {
 			s << numKBytes / 1024 / 1024 << " GiB";
 	}
 
+	static void ShowDuplicatesFilter (std::stringstream& s, const char * name, const i2p::util::BloomFilterPtr& filter)
+	{
+		s << "<b>" << name << ":</b> dropped " << filter->GetNumHits () << " of " << filter->GetNumEntries ();
+		s << std::fixed << std::setprecision(4) << ", false positive " << filter->GetFalsePositiveRate () * 100 << "%, ";
+		ShowTraffic (s, filter->GetMemoryUsage ());
+		s << "<br>\r\n";
+	}
+
 	static void ShowTunnelDetails (std::stringstream& s, enum i2p::tunnel::TunnelState eState, bool explr, int bytes)
 	{
 		std::string state;
@@ -282,6 +290,14 @@ namespace http {
 		ShowTraffic (s, i2p::transport::transports.GetTotalTransitTransmittedBytes ());
 		s << " (" << (double) i2p::transport::transports.GetTransitBandwidth () / 1024 << " KiB/s)<br>\r\n";
 		s << "<b>Data path:</b> " << i2p::fs::GetDataDir() << "<br>\r\n";
+		for (const auto& it: i2p::util::GetMemoryPoolsStats ())
+		{
+			s << "<b>Memory pool " << it->GetBlockSize () << ":</b> hits " << it->GetNumHits () << ", misses " << it->GetNumMisses ();
+			s << ", blocks " << it->GetNumBlocks () << " (high-water " << it->GetHighWater () << ")<br>\r\n";
+		}
+		ShowDuplicatesFilter (s, "Duplicate messages", i2p::GetMessageIDsFilter ());
+		ShowDuplicatesFilter (s, "Replayed build records", i2p::GetBuildRecordsFilter ());
+		ShowDuplicatesFilter (s, "Replayed tunnel IVs", i2p::tunnel::GetTunnelIVsFilter ());
 		s << "<div class='slide'>";
 		if((outputFormat==OutputFormatEnum::forWebConsole)||!includeHiddenContent) {
 			s << "<label for=\"slide-info\">Hidden content. Press on text to see.</label>\r\n<input type=\"checkbox\" id=\"slide-info\" />\r\n<div class=\"slidecontent\">\r\n";
@@ -388,6 +404,7 @@ namespace http {
 	{
 		s << "<b>Base64:</b><br>\r\n<textarea readonly cols=\"80\" rows=\"11\" wrap=\"on\">";
 		s << dest->GetIdentity ()->ToBase64 () << "</textarea><br>\r\n<br>\r\n";
+		s << "<b>CPU time:</b> " << dest->GetCPUTime ()/1000 << " ms<br>\r\n<br>\r\n";
 		if (dest->IsEncryptedLeaseSet ())
 		{
 			i2p::data::BlindedPublicKey blinded (dest->GetIdentity (), dest->IsPerClientAuth ());
@@ -583,6 +600,9 @@ namespace http {
 	{
 		s << "<b>Tunnels:</b><br>\r\n<br>\r\n";
 		s << "<b>Queue size:</b> " << i2p::tunnel::tunnels.GetQueueSize () << "<br>\r\n";
+		for (const auto& it: i2p::tunnel::tunnels.GetDataShards ())
+			s << "&nbsp;&nbsp;Data thread " << it->GetIndex () << ": " << it->GetNumTunnels () << " tunnels, queue " << it->GetQueueSize () << "<br>\r\n";
+		s << "<b>Build requests queue:</b> " << i2p::GetNumQueuedBuildRequests () << "<br>\r\n";
 
 		auto ExplPool = i2p::tunnel::tunnels.GetExploratoryPool ();
 
@@ -714,6 +734,16 @@ namespace http {
 	void ShowTransports (std::stringstream& s)
 	{
 		s << "<b>Transports:</b><br>\r\n<br>\r\n";
+		const auto& shaper = i2p::transport::transports.GetTrafficShaper ();
+		s << "<table>\r\n<thead><th>Traffic class</th><th>Sent</th><th>Dropped</th><th>Expired</th></thead>\r\n<tbody>\r\n";
+		for (int i = 0; i < i2p::eNumI2NPTrafficClasses; i++)
+		{
+			auto cls = (i2p::I2NPTrafficClass)i;
+			s << "<tr><td>" << i2p::transport::TrafficShaper::GetTrafficClassName (cls) << "</td><td>";
+			ShowTraffic (s, shaper.GetNumSentBytes (cls));
+			s << "</td><td>" << shaper.GetNumDroppedMessages (cls) << "</td><td>" << shaper.GetNumExpiredMessages (cls) << "</td></tr>\r\n";
+		}
+		s << "</tbody></table>\r\n<br>\r\n";
 		auto ntcpServer = i2p::transport::transports.GetNTCPServer ();
 		if (ntcpServer)
 		{
@@ -724,6 +754,15 @@ namespace http {
 		auto ntcp2Server = i2p::transport::transports.GetNTCP2Server ();
 		if (ntcp2Server)
 		{
+			s << "<b>NTCP2 frames sent:</b> " << ntcp2Server->GetNumSentFrames () << ", send buffers allocated " << ntcp2Server->GetNumSendArenaAllocations () << "<br>\r\n";
+			for (const auto& it: ntcp2Server->GetWorkers ())
+			{
+				s << "<b>NTCP2 thread " << it->GetIndex () << ":</b> " << it->GetNumSessions () << " sessions, sent ";
+				ShowTraffic (s, it->GetNumSentBytes ());
+				s << ", received ";
+				ShowTraffic (s, it->GetNumReceivedBytes ());
+				s << "<br>\r\n";
+			}
 			auto sessions = ntcp2Server->GetNTCP2Sessions ();
 			if (!sessions.empty ())
 				ShowNTCPTransports (s, sessions, "NTCP2");
@@ -731,6 +770,8 @@ namespace http {
 		auto ssuServer = i2p::transport::transports.GetSSUServer ();
 		if (ssuServer)
 		{
+			s << std::fixed << std::setprecision(2) << "<b>SSU syscalls per packet:</b> received " << ssuServer->GetReceiveSyscallsPerPacket ();
+			s << ", sent " << ssuServer->GetSendSyscallsPerPacket () << "<br>\r\n";
 			auto sessions = ssuServer->GetSessions ();
 			if (!sessions.empty ())
 			{
@@ -9,69 +9,164 @@
 #include "BloomFilter.h"
 #include "I2PEndian.h"
 #include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
 #include <openssl/sha.h>
+#include <openssl/rand.h>
 
 namespace i2p
 {
 namespace util
 {
+	const int BLOOM_FILTER_MAX_NUM_HASHES = 16;
+	const double BLOOM_FILTER_LN2 = std::log(2.0);
 
-	/** @brief decaying bloom filter implementation */
+	/** @brief decaying bloom filter implementation, keeps current and previous intervals */
 	class DecayingBloomFilter : public IBloomFilter
 	{
 	public:
 
-		DecayingBloomFilter(const std::size_t size)
+		DecayingBloomFilter(std::size_t capacity, double falsePositiveRate, int decayInterval):
+			m_Current(0), m_NumEntries(0), m_NumHits(0), m_DecayInterval(decayInterval)
 		{
-			m_Size = size;
-			m_Data = new uint8_t[size];
-		}
-
-		/** @brief implements IBloomFilter::~IBloomFilter */
-		~DecayingBloomFilter()
-		{
-			delete [] m_Data;
+			if (!capacity) capacity = 1;
+			if (falsePositiveRate <= 0 || falsePositiveRate >= 1) falsePositiveRate = 0.001;
+			// m = -n*ln(p)/ln(2)^2, k = m/n*ln(2)
+			double numBits = -(double)capacity*std::log(falsePositiveRate)/(BLOOM_FILTER_LN2*BLOOM_FILTER_LN2);
+			m_NumWords = ((std::size_t)numBits + 63)/64;
+			m_NumBits = m_NumWords*64;
+			m_NumHashes = (int)std::lround((double)m_NumBits/capacity*BLOOM_FILTER_LN2);
+			if (m_NumHashes < 1) m_NumHashes = 1;
+			if (m_NumHashes > BLOOM_FILTER_MAX_NUM_HASHES) m_NumHashes = BLOOM_FILTER_MAX_NUM_HASHES;
+			for (auto& it: m_Data)
+			{
+				it.reset(new std::atomic<uint64_t>[m_NumWords]);
+				for (std::size_t i = 0; i < m_NumWords; i++) it[i].store(0, std::memory_order_relaxed);
+			}
+			m_WindowEntries[0] = 0; m_WindowEntries[1] = 0;
+			m_LastDecayTime = GetMonotonicSeconds();
+			// salted hash, so entries can't be chosen to collide
+			RAND_bytes(m_Salt, sizeof(m_Salt));
 		}
 
 		/** @brief implements IBloomFilter::Add */
 		bool Add(const uint8_t * data, std::size_t len)
 		{
-			std::size_t idx;
-			uint8_t mask;
-			Get(data, len, idx, mask);
-			if(m_Data[idx] & mask) return false; // filter hit
-			m_Data[idx] |= mask;
+			if (m_DecayInterval > 0)
+			{
+				auto ts = GetMonotonicSeconds();
+				auto lastDecayTime = m_LastDecayTime.load(std::memory_order_relaxed);
+				if (ts >= lastDecayTime + m_DecayInterval &&
+					m_LastDecayTime.compare_exchange_strong(lastDecayTime, ts))
+					Decay();
+			}
+			std::array<std::size_t, BLOOM_FILTER_MAX_NUM_HASHES> bits;
+			Get(data, len, bits);
+			int current = m_Current.load(std::memory_order_acquire);
+			m_NumEntries.fetch_add(1, std::memory_order_relaxed);
+			// seen in previous interval
+			auto previous = m_Data[1 - current].get();
+			bool found = true;
+			for (int i = 0; i < m_NumHashes; i++)
+				if (!(previous[bits[i]/64].load(std::memory_order_relaxed) & (1ULL << (bits[i] % 64))))
+				{
+					found = false;
+					break;
+				}
+			if (found)
+			{
+				m_NumHits.fetch_add(1, std::memory_order_relaxed);
+				return false; // filter hit
+			}
+			// set in current interval
+			auto data0 = m_Data[current].get();
+			found = true;
+			for (int i = 0; i < m_NumHashes; i++)
+			{
+				uint64_t mask = 1ULL << (bits[i] % 64);
+				if (!(data0[bits[i]/64].fetch_or(mask, std::memory_order_relaxed) & mask))
+					found = false;
+			}
+			if (found)
+			{
+				m_NumHits.fetch_add(1, std::memory_order_relaxed);
+				return false; // filter hit
+			}
+			m_WindowEntries[current].fetch_add(1, std::memory_order_relaxed);
 			return true;
 		}
 
 		/** @brief implements IBloomFilter::Decay */
 		void Decay()
 		{
-			// reset bloom filter buffer
-			memset(m_Data, 0, m_Size);
+			// previous interval becomes current one, concurrent Add might miss an entry but never gets false hit
+			int next = 1 - m_Current.load(std::memory_order_relaxed);
+			auto data = m_Data[next].get();
+			for (std::size_t i = 0; i < m_NumWords; i++)
+				data[i].store(0, std::memory_order_relaxed);
+			m_WindowEntries[next].store(0, std::memory_order_relaxed);
+			m_Current.store(next, std::memory_order_release);
+		}
+
+		/** @brief implements IBloomFilter::GetMemoryUsage */
+		std::size_t GetMemoryUsage() const
+		{
+			return 2*m_NumWords*sizeof(uint64_t);
 		}
 
+		/** @brief implements IBloomFilter::GetFalsePositiveRate */
+		double GetFalsePositiveRate() const
+		{
+			// p = (1 - e^(-k*n/m))^k for each of intervals
+			double rate = 0;
+			for (int i = 0; i < 2; i++)
+				rate += std::pow(1.0 - std::exp(-(double)m_NumHashes*m_WindowEntries[i].load(std::memory_order_relaxed)/m_NumBits), m_NumHashes);
+			return rate;
+		}
+
+		/** @brief implements IBloomFilter::GetNumHits */
+		uint64_t GetNumHits() const { return m_NumHits.load(std::memory_order_relaxed); }
+
+		/** @brief implements IBloomFilter::GetNumEntries */
+		uint64_t GetNumEntries() const { return m_NumEntries.load(std::memory_order_relaxed); }
+
 	private:
-		/** @brief get bit index for for data */
-		void Get(const uint8_t * data, std::size_t len, std::size_t & idx, uint8_t & bm)
+
+		/** @brief get bit indices for data, double hashing of salted digest */
+		void Get(const uint8_t * data, std::size_t len, std::array<std::size_t, BLOOM_FILTER_MAX_NUM_HASHES>& bits) const
 		{
-			bm = 1;
 			uint8_t digest[32];
 			// TODO: use blake2 because it's faster
-			SHA256(data, len, digest);
-			uint64_t i = buf64toh(digest);
-			idx = i % m_Size;
-			bm <<= (i % 8);
+			SHA256_CTX ctx;
+			SHA256_Init(&ctx);
+			SHA256_Update(&ctx, m_Salt, sizeof(m_Salt));
+			SHA256_Update(&ctx, data, len);
+			SHA256_Final(digest, &ctx);
+			uint64_t h1 = buf64toh(digest), h2 = buf64toh(digest + 8) | 1;
+			for (int i = 0; i < m_NumHashes; i++)
+				bits[i] = (h1 + i*h2) % m_NumBits;
+		}
+
+		static uint64_t GetMonotonicSeconds()
+		{
+			return std::chrono::duration_cast<std::chrono::seconds>(
+				std::chrono::steady_clock::now().time_since_epoch()).count();
 		}
 
-		uint8_t * m_Data;
-		std::size_t m_Size;
+		std::array<std::unique_ptr<std::atomic<uint64_t>[]>, 2> m_Data;
+		std::array<std::atomic<uint64_t>, 2> m_WindowEntries;
+		std::atomic<int> m_Current;
+		std::atomic<uint64_t> m_LastDecayTime, m_NumEntries, m_NumHits;
+		std::size_t m_NumWords, m_NumBits;
+		int m_NumHashes, m_DecayInterval;
+		uint8_t m_Salt[32];
 	};
 
 
-	BloomFilterPtr BloomFilter(std::size_t capacity)
+	BloomFilterPtr BloomFilter(std::size_t capacity, double falsePositiveRate, int decayInterval)
 	{
-		return std::make_shared<DecayingBloomFilter>(capacity);
+		return std::make_shared<DecayingBloomFilter>(capacity, falsePositiveRate, decayInterval);
 	}
 }
 }
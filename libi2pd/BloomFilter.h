@@ -26,12 +26,25 @@ namespace util
 		virtual bool Add(const uint8_t * data, std::size_t len) = 0;
 		/** @brief optionally decay old entries */
 		virtual void Decay() = 0;
+		/** @brief number of bytes allocated for filter data */
+		virtual std::size_t GetMemoryUsage() const = 0;
+		/** @brief estimated probability of false hit for current number of entries */
+		virtual double GetFalsePositiveRate() const = 0;
+		/** @brief total number of filter hits */
+		virtual uint64_t GetNumHits() const = 0;
+		/** @brief total number of added entries */
+		virtual uint64_t GetNumEntries() const = 0;
 	};
 
 	typedef std::shared_ptr<IBloomFilter> BloomFilterPtr;
 
-	/** @brief create bloom filter */
-	BloomFilterPtr BloomFilter(std::size_t capacity = 1024 * 8);
+	/**
+	 * @brief create decaying bloom filter, entries are remembered for one or two decay intervals
+	 * @param capacity expected number of entries per decay interval
+	 * @param falsePositiveRate desired probability of false hit with capacity entries
+	 * @param decayInterval in seconds, 0 means Decay must be called explicitly
+	 */
+	BloomFilterPtr BloomFilter(std::size_t capacity = 1024 * 8, double falsePositiveRate = 0.001, int decayInterval = 0);
 
 }
 }
@@ -60,6 +60,7 @@ namespace config {
 			("share", value<int>()->default_value(100),                       "Limit of transit traffic from max bandwidth in percents. (default: 100)")
 			("ntcp", value<bool>()->default_value(false),                     "Enable NTCP transport (default: disabled)")
 			("ssu", value<bool>()->default_value(true),                       "Enable SSU transport (default: enabled)")
+			("ssummsg", value<bool>()->default_value(false),                  "Use recvmmsg/sendmmsg for SSU, Linux only (default: disabled)")
 			("ntcpproxy", value<std::string>()->default_value(""),            "Proxy URL for NTCP transport")
 #ifdef _WIN32
 			("svcctl", value<std::string>()->default_value(""),               "Windows service management ('install' or 'remove')")
@@ -76,6 +77,9 @@ namespace config {
 			("limits.ntcpsoft", value<uint16_t>()->default_value(0),          "Threshold to start probabilistic backoff with ntcp sessions (default: use system limit)")
 			("limits.ntcphard", value<uint16_t>()->default_value(0),          "Maximum number of ntcp sessions (default: use system limit)")
 			("limits.ntcpthreads", value<uint16_t>()->default_value(1),       "Maximum number of threads used by NTCP DH worker (default: 1)")
+			("limits.tunneldatathreads", value<uint16_t>()->default_value(0), "Number of threads for transit and inbound tunnel data (default: 0 - use tunnels thread)")
+			("limits.tunnelbuildthreads", value<uint16_t>()->default_value(1), "Number of threads decrypting tunnel build requests (default: 1, 0 - use tunnels thread)")
+			("limits.destinationthreads", value<uint16_t>()->default_value(0), "Number of threads shared by local destinations (default: 0 - number of CPU cores)")
 		;
 
 		options_description httpserver("HTTP Server options");
@@ -244,6 +248,7 @@ namespace config {
 			("ntcp2.port", value<uint16_t>()->default_value(0),            "Port to listen for incoming NTCP2 connections (default: auto)")
 			("ntcp2.addressv6", value<std::string>()->default_value("::"), "Address to bind NTCP2 on")
 			("ntcp2.proxy", value<std::string>()->default_value(""),       "Proxy URL for NTCP2 transport")
+			("ntcp2.threads", value<uint16_t>()->default_value(1),         "Number of NTCP2 I/O threads (default: 1)")
 		;
 
 		options_description nettime("Time sync options");
@@ -262,6 +267,7 @@ namespace config {
 		persist.add_options()
 			("persist.profiles", value<bool>()->default_value(true),       "Persist peer profiles (default: true)")
 			("persist.addressbook", value<bool>()->default_value(true),    "Persist full addresses (default: true)")
+			("persist.netdbsnapshot", value<bool>()->default_value(false), "Keep netDb in single memory-mapped file instead of directory (default: false)")
 		;
 
 		m_OptionsDesc
@@ -0,0 +1,158 @@
+/*
+* Copyright (c) 2013-2020, The PurpleI2P Project
+*
+* This file is part of Purple i2pd project and licensed under BSD3
+*
+* See full license text in LICENSE file at top of project tree
+*/
+
+#include <stdlib.h>
+#include "Log.h"
+#include "CongestionControl.h"
+
+namespace i2p
+{
+namespace stream
+{
+	CongestionControl::CongestionControl ():
+		m_WindowSize (MIN_WINDOW_SIZE), m_SlowStartThreshold (WINDOW_SIZE),
+		m_SRTT (INITIAL_RTT), m_RTTVar (INITIAL_RTT/2), m_RTO (INITIAL_RTO), m_MinRTT (0), m_LastRTT (0),
+		m_NumAckedInWindow (0), m_HasRTTSample (false)
+	{
+	}
+
+	void CongestionControl::SetInitialRTT (int rtt)
+	{
+		if (m_HasRTTSample || rtt <= 0) return;
+		m_SRTT = rtt;
+		m_RTTVar = rtt/2;
+		m_RTO = rtt + 4*m_RTTVar;
+		if (m_RTO < MIN_RTO) m_RTO = MIN_RTO;
+		if (m_RTO > MAX_RTO) m_RTO = MAX_RTO;
+	}
+
+	void CongestionControl::UpdateRTT (int rtt)
+	{
+		if (rtt <= 0) rtt = 1;
+		if (!m_HasRTTSample)
+		{
+			m_SRTT = rtt;
+			m_RTTVar = rtt/2;
+			m_HasRTTSample = true;
+		}
+		else
+		{
+			m_RTTVar = (3*m_RTTVar + abs (m_SRTT - rtt))/4;
+			m_SRTT = (7*m_SRTT + rtt)/8;
+		}
+		if (!m_MinRTT || rtt < m_MinRTT) m_MinRTT = rtt;
+		m_LastRTT = rtt;
+		m_RTO = m_SRTT + 4*m_RTTVar;
+		if (m_RTO < MIN_RTO) m_RTO = MIN_RTO;
+		if (m_RTO > MAX_RTO) m_RTO = MAX_RTO;
+	}
+
+	void CongestionControl::BackoffRTO ()
+	{
+		m_RTO *= 2;
+		if (m_RTO > MAX_RTO) m_RTO = MAX_RTO;
+	}
+
+	void CongestionControl::OnTimeout ()
+	{
+		// whole window is lost, start over from one packet
+		m_SlowStartThreshold = m_WindowSize/2;
+		if (m_SlowStartThreshold < 2*MIN_WINDOW_SIZE) m_SlowStartThreshold = 2*MIN_WINDOW_SIZE;
+		SetWindowSize (MIN_WINDOW_SIZE);
+		BackoffRTO ();
+	}
+
+	void CongestionControl::OnPathChanged ()
+	{
+		m_HasRTTSample = false;
+		m_MinRTT = 0; m_LastRTT = 0;
+		m_RTO = INITIAL_RTO;
+	}
+
+	int CongestionControl::GetPacingInterval () const
+	{
+		if (!m_HasRTTSample) return 0; // initial window is small anyway
+		int gain = m_WindowSize < m_SlowStartThreshold ? PACING_GAIN_SLOW_START : PACING_GAIN;
+		int interval = (int64_t)m_SRTT*1000*100/((int64_t)m_WindowSize*gain);
+		return interval >= PACING_MIN_INTERVAL ? interval : 0;
+	}
+
+	void CongestionControl::IncreaseWindow (int numAcked)
+	{
+		if (m_WindowSize < m_SlowStartThreshold)
+			SetWindowSize (m_WindowSize + numAcked); // slow start
+		else
+		{
+			// congestion avoidance, one packet per window
+			m_NumAckedInWindow += numAcked;
+			if (m_NumAckedInWindow >= m_WindowSize)
+			{
+				m_NumAckedInWindow -= m_WindowSize;
+				SetWindowSize (m_WindowSize + 1);
+			}
+		}
+	}
+
+	void CongestionControl::SetWindowSize (int windowSize)
+	{
+		if (windowSize < MIN_WINDOW_SIZE) windowSize = MIN_WINDOW_SIZE;
+		if (windowSize > MAX_WINDOW_SIZE) windowSize = MAX_WINDOW_SIZE;
+		if (windowSize != m_WindowSize) m_NumAckedInWindow = 0;
+		m_WindowSize = windowSize;
+	}
+
+	void NewRenoCongestionControl::OnAck (int numAcked, uint64_t ts)
+	{
+		IncreaseWindow (numAcked);
+	}
+
+	void NewRenoCongestionControl::OnLoss ()
+	{
+		m_SlowStartThreshold = m_WindowSize/2;
+		if (m_SlowStartThreshold < 2*MIN_WINDOW_SIZE) m_SlowStartThreshold = 2*MIN_WINDOW_SIZE;
+		SetWindowSize (m_SlowStartThreshold);
+	}
+
+	void VegasCongestionControl::OnAck (int numAcked, uint64_t ts)
+	{
+		if (m_WindowSize < m_SlowStartThreshold)
+			IncreaseWindow (numAcked);
+		if (!m_HasRTTSample || ts < m_NextAdjustmentTime) return;
+		m_NextAdjustmentTime = ts + m_SRTT;
+		if (!m_MinRTT || !m_LastRTT) return;
+		// packets sitting in tunnel queues = window*(1 - base RTT/current RTT)
+		int queued = m_WindowSize*(m_LastRTT - m_MinRTT)/m_LastRTT;
+		if (m_WindowSize < m_SlowStartThreshold)
+		{
+			if (queued > DELAY_CONTROL_ALPHA)
+				m_SlowStartThreshold = m_WindowSize; // leave slow start
+		}
+		else if (queued < DELAY_CONTROL_ALPHA)
+			SetWindowSize (m_WindowSize + 1);
+		else if (queued > DELAY_CONTROL_BETA)
+			SetWindowSize (m_WindowSize - 1);
+	}
+
+	void VegasCongestionControl::OnLoss ()
+	{
+		// loss doesn't necessarily mean congestion, window is controlled by delay
+		m_SlowStartThreshold = m_WindowSize*3/4;
+		if (m_SlowStartThreshold < 2*MIN_WINDOW_SIZE) m_SlowStartThreshold = 2*MIN_WINDOW_SIZE;
+		SetWindowSize (m_SlowStartThreshold);
+	}
+
+	std::unique_ptr<CongestionControl> CreateCongestionControl (const std::string& name)
+	{
+		if (name == CONGESTION_CONTROL_VEGAS)
+			return std::unique_ptr<CongestionControl>(new VegasCongestionControl ());
+		if (!name.empty () && name != CONGESTION_CONTROL_NEWRENO)
+			LogPrint (eLogWarning, "Streaming: Unknown congestion control ", name, ", using ", CONGESTION_CONTROL_NEWRENO);
+		return std::unique_ptr<CongestionControl>(new NewRenoCongestionControl ());
+	}
+}
+}
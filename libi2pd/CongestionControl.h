@@ -0,0 +1,114 @@
+/*
+* Copyright (c) 2013-2020, The PurpleI2P Project
+*
+* This file is part of Purple i2pd project and licensed under BSD3
+*
+* See full license text in LICENSE file at top of project tree
+*/
+
+#ifndef CONGESTION_CONTROL_H__
+#define CONGESTION_CONTROL_H__
+
+#include <inttypes.h>
+#include <string>
+#include <memory>
+
+namespace i2p
+{
+namespace stream
+{
+	const int WINDOW_SIZE = 6; // in messages, initial slow start threshold
+	const int MIN_WINDOW_SIZE = 1;
+	const int MAX_WINDOW_SIZE = 128;
+	const int INITIAL_RTT = 8000; // in milliseconds
+	const int INITIAL_RTO = 9000; // in milliseconds
+	const int MIN_RTO = 100; // in milliseconds
+	const int MAX_RTO = 45000; // in milliseconds
+	const int FAST_RETRANSMIT_NACKS = 2; // packet is considered lost if NACKed that many times
+	const int DELAY_CONTROL_ALPHA = 2; // in packets queued in tunnels, grow window below it
+	const int DELAY_CONTROL_BETA = 4; // in packets queued in tunnels, shrink window above it
+	const int PACING_GAIN_SLOW_START = 200; // in percents of window per RTT, window doubles every RTT
+	const int PACING_GAIN = 125; // in percents of window per RTT, some room for RTT variation
+	const int PACING_MIN_INTERVAL = 200; // in microseconds, send without pacing if faster
+	const int PACING_MAX_BURST = 4; // in packets, sent at once after idle
+
+	const char CONGESTION_CONTROL_NEWRENO[] = "newreno";
+	const char CONGESTION_CONTROL_VEGAS[] = "vegas";
+
+	/**
+	 * @brief congestion window and retransmission timeout of a stream
+	 *
+	 * RTT estimation (RFC 6298) is common, window reaction to acks and losses is up to the algorithm.
+	 * Stream counts NACKs and calls OnLoss once per window for fast retransmit, OnTimeout when resend timer expires.
+	 */
+	class CongestionControl
+	{
+		public:
+
+			CongestionControl ();
+			virtual ~CongestionControl () {};
+
+			virtual const char * GetName () const = 0;
+			virtual void OnAck (int numAcked, uint64_t ts) = 0; // new packets acknowledged
+			virtual void OnLoss () = 0; // detected by NACKs, fast recovery starts
+			virtual void OnTimeout (); // resend timer expired
+			void OnPathChanged (); // new tunnels, previous RTT samples don't apply
+
+			void SetInitialRTT (int rtt); // from shared routing path, before any sample
+			void UpdateRTT (int rtt); // sample from packet not sent more than once
+			void BackoffRTO ();
+
+			int GetWindowSize () const { return m_WindowSize; };
+			int GetSlowStartThreshold () const { return m_SlowStartThreshold; };
+			int GetRTT () const { return m_SRTT; };
+			int GetRTTVar () const { return m_RTTVar; };
+			int GetRTO () const { return m_RTO; };
+			int GetPacingInterval () const; // between packets in microseconds, 0 if not paced
+
+		protected:
+
+			void IncreaseWindow (int numAcked); // slow start or one packet per window
+			void SetWindowSize (int windowSize);
+
+		protected:
+
+			int m_WindowSize, m_SlowStartThreshold;
+			int m_SRTT, m_RTTVar, m_RTO, m_MinRTT, m_LastRTT;
+			int m_NumAckedInWindow; // for linear growth
+			bool m_HasRTTSample;
+	};
+
+	/** loss based, halves window on loss */
+	class NewRenoCongestionControl: public CongestionControl
+	{
+		public:
+
+			const char * GetName () const { return CONGESTION_CONTROL_NEWRENO; };
+			void OnAck (int numAcked, uint64_t ts);
+			void OnLoss ();
+	};
+
+	/**
+	 * delay based, keeps number of packets queued in tunnels between alpha and beta
+	 * estimated from minimal and current RTT, adjusts window once per RTT. Doesn't need losses
+	 * to find link capacity, that takes many RTOs for long tunnels
+	 */
+	class VegasCongestionControl: public CongestionControl
+	{
+		public:
+
+			VegasCongestionControl (): m_NextAdjustmentTime (0) { m_SlowStartThreshold = MAX_WINDOW_SIZE; }; // delay decides when to leave slow start
+			const char * GetName () const { return CONGESTION_CONTROL_VEGAS; };
+			void OnAck (int numAcked, uint64_t ts);
+			void OnLoss ();
+
+		private:
+
+			uint64_t m_NextAdjustmentTime;
+	};
+
+	std::unique_ptr<CongestionControl> CreateCongestionControl (const std::string& name);
+}
+}
+
+#endif
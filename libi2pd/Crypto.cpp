@@ -1121,6 +1121,148 @@ namespace crypto
 		}
 	}
 
+#if defined(__AES__) && defined(__x86_64__)
+	// one round for 4 independent blocks in xmm0-xmm3, round keys are interleaved by 4
+	#define AESRoundx4(op, keys, round) \
+		#op " " #round "*64(%[" #keys "]), %%xmm0 \n" \
+		#op " " #round "*64+16(%[" #keys "]), %%xmm1 \n" \
+		#op " " #round "*64+32(%[" #keys "]), %%xmm2 \n" \
+		#op " " #round "*64+48(%[" #keys "]), %%xmm3 \n"
+
+	#define EncryptAES256x4(keys) \
+		AESRoundx4(pxor, keys, 0) \
+		AESRoundx4(aesenc, keys, 1) AESRoundx4(aesenc, keys, 2) AESRoundx4(aesenc, keys, 3) \
+		AESRoundx4(aesenc, keys, 4) AESRoundx4(aesenc, keys, 5) AESRoundx4(aesenc, keys, 6) \
+		AESRoundx4(aesenc, keys, 7) AESRoundx4(aesenc, keys, 8) AESRoundx4(aesenc, keys, 9) \
+		AESRoundx4(aesenc, keys, 10) AESRoundx4(aesenc, keys, 11) AESRoundx4(aesenc, keys, 12) \
+		AESRoundx4(aesenc, keys, 13) AESRoundx4(aesenclast, keys, 14)
+
+	#define DecryptAES256x4(keys) \
+		AESRoundx4(pxor, keys, 14) \
+		AESRoundx4(aesdec, keys, 13) AESRoundx4(aesdec, keys, 12) AESRoundx4(aesdec, keys, 11) \
+		AESRoundx4(aesdec, keys, 10) AESRoundx4(aesdec, keys, 9) AESRoundx4(aesdec, keys, 8) \
+		AESRoundx4(aesdec, keys, 7) AESRoundx4(aesdec, keys, 6) AESRoundx4(aesdec, keys, 5) \
+		AESRoundx4(aesdec, keys, 4) AESRoundx4(aesdec, keys, 3) AESRoundx4(aesdec, keys, 2) \
+		AESRoundx4(aesdec, keys, 1) AESRoundx4(aesdeclast, keys, 0)
+
+	#define ForEachChainx4(instr) instr(0, 4) instr(1, 5) instr(2, 6) instr(3, 7) // block and previous block registers
+	#define LoadBlock(j, p) "movups (%[b" #j "],%[offset]), %%xmm" #j " \n"
+	#define StoreBlock(j, p) "movups %%xmm" #j ", (%[b" #j "],%[offset]) \n"
+	#define SaveBlock(j, p) "movaps %%xmm" #j ", %%xmm" #p " \n"
+	#define RestoreBlock(j, p) "movaps %%xmm" #p ", %%xmm" #j " \n"
+	#define XorNextBlock(j, p) "movups (%[b" #j "],%[offset]), %%xmm8 \n" "pxor %%xmm8, %%xmm" #j " \n"
+	#define XorPrevBlockAndStore(j, p) "pxor %%xmm" #p ", %%xmm" #j " \n" \
+		"movups (%[b" #j "],%[offset]), %%xmm" #p " \n" StoreBlock(j, p)
+
+	static void InterleaveKeySchedules (const uint8_t * const * scheds, uint8_t * keys) // 4 schedules of 240 bytes
+	{
+		for (int round = 0; round < 15; round++)
+			for (int j = 0; j < 4; j++)
+				memcpy (keys + (round*4 + j)*16, scheds[j] + round*16, 16);
+	}
+
+	void TunnelEncryption::EncryptInterleaved (const BatchItem * items)
+	{
+		const uint8_t * ivScheds[4], * layerScheds[4];
+		for (int j = 0; j < 4; j++)
+		{
+			ivScheds[j] = items[j].layer->m_IVEncryption.GetKeySchedule ();
+			layerScheds[j] = items[j].layer->m_LayerEncryption.ECB ().GetKeySchedule ();
+			if (items[j].in != items[j].out) memcpy (items[j].out, items[j].in, 1024); // encrypt in place
+		}
+		AESAlignedBuffer<960> ivKeys, layerKeys;
+		InterleaveKeySchedules (ivScheds, ivKeys);
+		InterleaveKeySchedules (layerScheds, layerKeys);
+		size_t offset = 0;
+		__asm__ __volatile__
+			(
+				// encrypt IVs, encrypted IVs are saved in xmm4-xmm7 as previous blocks
+				ForEachChainx4(LoadBlock)
+				EncryptAES256x4(ivKeys)
+				ForEachChainx4(SaveBlock)
+				// double IV encryption
+				EncryptAES256x4(ivKeys)
+				ForEachChainx4(StoreBlock)
+				ForEachChainx4(RestoreBlock)
+				// encrypt data, chains are independent
+				"1: \n"
+				"add $16, %[offset] \n"
+				ForEachChainx4(XorNextBlock)
+				EncryptAES256x4(layerKeys)
+				ForEachChainx4(StoreBlock)
+				"cmp $1008, %[offset] \n" // last block
+				"jb 1b \n"
+				: [offset]"+r"(offset)
+				: [ivKeys]"r"((uint8_t *)ivKeys), [layerKeys]"r"((uint8_t *)layerKeys),
+					[b0]"r"(items[0].out), [b1]"r"(items[1].out), [b2]"r"(items[2].out), [b3]"r"(items[3].out)
+				: "%xmm0", "%xmm1", "%xmm2", "%xmm3", "%xmm4", "%xmm5", "%xmm6", "%xmm7", "%xmm8", "cc", "memory"
+			);
+	}
+
+	void TunnelDecryption::DecryptInterleaved (const BatchItem * items)
+	{
+		const uint8_t * ivScheds[4], * layerScheds[4];
+		for (int j = 0; j < 4; j++)
+		{
+			ivScheds[j] = items[j].layer->m_IVDecryption.GetKeySchedule ();
+			layerScheds[j] = items[j].layer->m_LayerDecryption.ECB ().GetKeySchedule ();
+			if (items[j].in != items[j].out) memcpy (items[j].out, items[j].in, 1024); // decrypt in place
+		}
+		AESAlignedBuffer<960> ivKeys, layerKeys;
+		InterleaveKeySchedules (ivScheds, ivKeys);
+		InterleaveKeySchedules (layerScheds, layerKeys);
+		size_t offset = 0;
+		__asm__ __volatile__
+			(
+				// decrypt IVs, decrypted IVs are saved in xmm4-xmm7 as previous blocks
+				ForEachChainx4(LoadBlock)
+				DecryptAES256x4(ivKeys)
+				ForEachChainx4(SaveBlock)
+				// double IV decryption
+				DecryptAES256x4(ivKeys)
+				ForEachChainx4(StoreBlock)
+				// decrypt data, xmm4-xmm7 get current encrypted blocks before they are overwritten
+				"1: \n"
+				"add $16, %[offset] \n"
+				ForEachChainx4(LoadBlock)
+				DecryptAES256x4(layerKeys)
+				ForEachChainx4(XorPrevBlockAndStore)
+				"cmp $1008, %[offset] \n" // last block
+				"jb 1b \n"
+				: [offset]"+r"(offset)
+				: [ivKeys]"r"((uint8_t *)ivKeys), [layerKeys]"r"((uint8_t *)layerKeys),
+					[b0]"r"(items[0].out), [b1]"r"(items[1].out), [b2]"r"(items[2].out), [b3]"r"(items[3].out)
+				: "%xmm0", "%xmm1", "%xmm2", "%xmm3", "%xmm4", "%xmm5", "%xmm6", "%xmm7", "cc", "memory"
+			);
+	}
+#endif
+
+	void TunnelEncryption::Encrypt (const BatchItem * items, size_t num)
+	{
+#if defined(__AES__) && defined(__x86_64__)
+		if(i2p::cpu::aesni)
+		{
+			for (; num >= TUNNEL_CRYPTO_MAX_INTERLEAVED; num -= TUNNEL_CRYPTO_MAX_INTERLEAVED, items += TUNNEL_CRYPTO_MAX_INTERLEAVED)
+				EncryptInterleaved (items);
+		}
+#endif
+		for (size_t i = 0; i < num; i++)
+			items[i].layer->Encrypt (items[i].in, items[i].out);
+	}
+
+	void TunnelDecryption::Decrypt (const BatchItem * items, size_t num)
+	{
+#if defined(__AES__) && defined(__x86_64__)
+		if(i2p::cpu::aesni)
+		{
+			for (; num >= TUNNEL_CRYPTO_MAX_INTERLEAVED; num -= TUNNEL_CRYPTO_MAX_INTERLEAVED, items += TUNNEL_CRYPTO_MAX_INTERLEAVED)
+				DecryptInterleaved (items);
+		}
+#endif
+		for (size_t i = 0; i < num; i++)
+			items[i].layer->Decrypt (items[i].in, items[i].out);
+	}
+
 // AEAD/ChaCha20/Poly1305
 
 	bool AEADChaCha20Poly1305 (const uint8_t * msg, size_t msgLen, const uint8_t * ad, size_t adLen, const uint8_t * key, const uint8_t * nonce, uint8_t * buf, size_t len, bool encrypt)
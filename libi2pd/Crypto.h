@@ -259,10 +259,22 @@ namespace crypto
 			ECBDecryption m_ECBDecryption;
 	};
 
+	const size_t TUNNEL_CRYPTO_MAX_INTERLEAVED = 4; // independent CBC chains processed at once
+
+	template<typename Layer>
+	struct TunnelCryptoBatchItem
+	{
+		Layer * layer;
+		const uint8_t * in;
+		uint8_t * out; // 1024 bytes, can be the same as in
+	};
+
 	class TunnelEncryption // with double IV encryption
 	{
 		public:
 
+			typedef TunnelCryptoBatchItem<TunnelEncryption> BatchItem;
+
 			void SetKeys (const AESKey& layerKey, const AESKey& ivKey)
 			{
 				m_LayerEncryption.SetKey (layerKey);
@@ -270,6 +282,13 @@ namespace crypto
 			}
 
 			void Encrypt (const uint8_t * in, uint8_t * out); // 1024 bytes (16 IV + 1008 data)
+			static void Encrypt (const BatchItem * items, size_t num); // messages of different tunnels are allowed
+
+		private:
+
+#if defined(__AES__) && defined(__x86_64__)
+			static void EncryptInterleaved (const BatchItem * items); // TUNNEL_CRYPTO_MAX_INTERLEAVED messages
+#endif
 
 		private:
 
@@ -281,6 +300,8 @@ namespace crypto
 	{
 		public:
 
+			typedef TunnelCryptoBatchItem<TunnelDecryption> BatchItem;
+
 			void SetKeys (const AESKey& layerKey, const AESKey& ivKey)
 			{
 				m_LayerDecryption.SetKey (layerKey);
@@ -288,6 +309,13 @@ namespace crypto
 			}
 
 			void Decrypt (const uint8_t * in, uint8_t * out); // 1024 bytes (16 IV + 1008 data)
+			static void Decrypt (const BatchItem * items, size_t num); // messages of different tunnels are allowed
+
+		private:
+
+#if defined(__AES__) && defined(__x86_64__)
+			static void DecryptInterleaved (const BatchItem * items); // TUNNEL_CRYPTO_MAX_INTERLEAVED messages
+#endif
 
 		private:
 
@@ -15,6 +15,9 @@
 #include <thread>
 #include <vector>
 #include <memory>
+#include <atomic>
+#include <functional>
+#include "Log.h"
 
 namespace i2p
 {
@@ -82,6 +85,95 @@ namespace worker
 		cond_t condition;
 		bool stop;
 	};
+
+	/** fixed number of workers with bounded backlog, every worker keeps own Context (like BN_CTX) for all its jobs */
+	template<typename Context>
+	class WorkerPool
+	{
+		public:
+
+			typedef std::function<void(Context&)> Job;
+
+			WorkerPool (): m_IsRunning (false), m_MaxBacklog (0) {};
+			~WorkerPool () { Stop (); };
+
+			void Start (int numWorkers, size_t maxBacklog)
+			{
+				if (m_IsRunning || numWorkers <= 0) return;
+				m_MaxBacklog = maxBacklog;
+				m_IsRunning = true;
+				for (int i = 0; i < numWorkers; i++)
+					m_Workers.emplace_back (std::bind (&WorkerPool<Context>::Run, this));
+			}
+
+			void Stop ()
+			{
+				{
+					std::unique_lock<std::mutex> l(m_JobsMutex);
+					if (!m_IsRunning) return;
+					m_IsRunning = false;
+					m_Jobs.clear ();
+				}
+				m_JobsCondition.notify_all ();
+				for (auto& it: m_Workers)
+					it.join ();
+				m_Workers.clear ();
+			}
+
+			bool IsRunning () const { return m_IsRunning; };
+			size_t GetMaxBacklogSize () const { return m_MaxBacklog; };
+			size_t GetBacklogSize ()
+			{
+				std::unique_lock<std::mutex> l(m_JobsMutex);
+				return m_Jobs.size ();
+			}
+
+			bool Offer (Job job) // false if stopped or backlog is full
+			{
+				{
+					std::unique_lock<std::mutex> l(m_JobsMutex);
+					if (!m_IsRunning || m_Jobs.size () >= m_MaxBacklog) return false;
+					m_Jobs.push_back (std::move (job));
+				}
+				m_JobsCondition.notify_one ();
+				return true;
+			}
+
+		private:
+
+			void Run ()
+			{
+				Context context;
+				for (;;)
+				{
+					Job job;
+					{
+						std::unique_lock<std::mutex> l(m_JobsMutex);
+						m_JobsCondition.wait (l, [this] { return !m_IsRunning || !m_Jobs.empty (); });
+						if (!m_IsRunning) return;
+						job = std::move (m_Jobs.front ());
+						m_Jobs.pop_front ();
+					}
+					try
+					{
+						job (context);
+					}
+					catch (std::exception& ex)
+					{
+						LogPrint (eLogError, "Worker: runtime exception: ", ex.what ());
+					}
+				}
+			}
+
+		private:
+
+			std::atomic<bool> m_IsRunning;
+			size_t m_MaxBacklog;
+			std::vector<std::thread> m_Workers;
+			std::deque<Job> m_Jobs;
+			std::mutex m_JobsMutex;
+			std::condition_variable m_JobsCondition;
+	};
 }
 }
 
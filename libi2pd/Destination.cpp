@@ -16,6 +16,7 @@
 #include "Log.h"
 #include "FS.h"
 #include "Timestamp.h"
+#include "Config.h"
 #include "NetDb.hpp"
 #include "Destination.h"
 
@@ -25,7 +26,7 @@ namespace client
 {
 	LeaseSetDestination::LeaseSetDestination (boost::asio::io_service& service,
 		bool isPublic, const std::map<std::string, std::string> * params):
-		m_Service (service), m_IsPublic (isPublic), m_PublishReplyToken (0),
+		m_Service (service), m_CPUTime (0), m_IsPublic (isPublic), m_PublishReplyToken (0),
 		m_LastSubmissionTime (0), m_PublishConfirmationTimer (m_Service),
 		m_PublishVerificationTimer (m_Service), m_PublishDelayTimer (m_Service), m_CleanupTimer (m_Service),
 		m_LeaseSetType (DEFAULT_LEASESET_TYPE), m_AuthType (i2p::data::ENCRYPTED_LEASESET_AUTH_TYPE_NONE)
@@ -320,13 +321,25 @@ namespace client
 
 	void LeaseSetDestination::ProcessGarlicMessage (std::shared_ptr<I2NPMessage> msg)
 	{
-		m_Service.post (std::bind (&LeaseSetDestination::HandleGarlicMessage, shared_from_this (), msg));
+		auto s = shared_from_this ();
+		m_Service.post ([s, msg](void)
+			{
+				auto start = i2p::util::GetThreadCPUTime ();
+				s->HandleGarlicMessage (msg);
+				s->m_CPUTime += i2p::util::GetThreadCPUTime () - start;
+			});
 	}
 
 	void LeaseSetDestination::ProcessDeliveryStatusMessage (std::shared_ptr<I2NPMessage> msg)
 	{
 		uint32_t msgID = bufbe32toh (msg->GetPayload () + DELIVERY_STATUS_MSGID_OFFSET);
-		m_Service.post (std::bind (&LeaseSetDestination::HandleDeliveryStatusMessage, shared_from_this (), msgID));
+		auto s = shared_from_this ();
+		m_Service.post ([s, msgID](void)
+			{
+				auto start = i2p::util::GetThreadCPUTime ();
+				s->HandleDeliveryStatusMessage (msgID);
+				s->m_CPUTime += i2p::util::GetThreadCPUTime () - start;
+			});
 	}
 
 	void LeaseSetDestination::HandleI2NPMessage (const uint8_t * buf, size_t len)
@@ -811,9 +824,11 @@ namespace client
 	{
 		if (ecode != boost::asio::error::operation_aborted)
 		{
+			auto start = i2p::util::GetThreadCPUTime ();
 			CleanupExpiredTags ();
 			CleanupRemoteLeaseSets ();
 			CleanupDestination ();
+			m_CPUTime += i2p::util::GetThreadCPUTime () - start;
 			m_CleanupTimer.expires_from_now (boost::posix_time::minutes (DESTINATION_CLEANUP_TIMEOUT));
 			m_CleanupTimer.async_wait (std::bind (&LeaseSetDestination::HandleCleanupTimer,
 				shared_from_this (), std::placeholders::_1));
@@ -847,6 +862,7 @@ namespace client
 		bool isPublic, const std::map<std::string, std::string> * params):
 		LeaseSetDestination (service, isPublic, params),
 		m_Keys (keys), m_StreamingAckDelay (DEFAULT_INITIAL_ACK_DELAY),
+		m_StreamingCongestionControl (DEFAULT_STREAMING_CONGESTION_CONTROL), m_IsStreamingPacing (DEFAULT_STREAMING_PACING),
 		m_DatagramDestination (nullptr), m_RefCounter (0),
 		m_ReadyChecker(service)
 	{
@@ -915,6 +931,12 @@ namespace client
 				auto it = params->find (I2CP_PARAM_STREAMING_INITIAL_ACK_DELAY);
 				if (it != params->end ())
 					m_StreamingAckDelay = std::stoi(it->second);
+				it = params->find (I2CP_PARAM_STREAMING_CONGESTION_CONTROL);
+				if (it != params->end ())
+					m_StreamingCongestionControl = it->second;
+				it = params->find (I2CP_PARAM_STREAMING_PACING);
+				if (it != params->end ())
+					m_IsStreamingPacing = it->second != "false";
 
 				if (GetLeaseSetType () == i2p::data::NETDB_STORE_TYPE_ENCRYPTED_LEASESET2)
 				{
@@ -1257,8 +1279,53 @@ namespace client
 		return false;
 	}
 
+	DestinationWorkers destinationWorkers;
+
+	void DestinationWorkers::Start ()
+	{
+		std::unique_lock<std::mutex> l(m_Mutex);
+		StartWorkers ();
+	}
+
+	void DestinationWorkers::StartWorkers ()
+	{
+		if (m_IsRunning) return;
+		if (m_Workers.empty ())
+		{
+			uint16_t numThreads; i2p::config::GetOption("limits.destinationthreads", numThreads);
+			if (!numThreads) numThreads = std::max (std::thread::hardware_concurrency (), 1u);
+			if (numThreads > DESTINATION_MAX_NUM_THREADS) numThreads = DESTINATION_MAX_NUM_THREADS;
+			for (int i = 0; i < numThreads; i++)
+				m_Workers.push_back (std::make_shared<DestinationWorker> (i));
+		}
+		for (auto& it: m_Workers)
+			it->Start ();
+		m_IsRunning = true;
+		LogPrint (eLogInfo, "Destination: ", m_Workers.size (), " threads started");
+	}
+
+	void DestinationWorkers::Stop ()
+	{
+		std::unique_lock<std::mutex> l(m_Mutex);
+		if (!m_IsRunning) return;
+		for (auto& it: m_Workers)
+			it->Stop ();
+		m_IsRunning = false;
+	}
+
+	std::shared_ptr<DestinationWorker> DestinationWorkers::Acquire ()
+	{
+		std::unique_lock<std::mutex> l(m_Mutex);
+		if (!m_IsRunning) StartWorkers (); // used without client context
+		std::shared_ptr<DestinationWorker> worker;
+		for (auto& it: m_Workers)
+			if (!worker || it->GetNumDestinations () < worker->GetNumDestinations ())
+				worker = it;
+		worker->DestinationAdded ();
+		return worker;
+	}
+
 	RunnableClientDestination::RunnableClientDestination (const i2p::data::PrivateKeys& keys, bool isPublic, const std::map<std::string, std::string> * params):
-		RunnableService ("Destination"),
 		ClientDestination (GetIOService (), keys, isPublic, params)
 	{
 	}
@@ -1274,7 +1341,7 @@ namespace client
 		if (!IsRunning ())
 		{
 			ClientDestination::Start ();
-			StartIOService ();
+			SetRunning (true);
 		}
 	}
 
@@ -1283,7 +1350,7 @@ namespace client
 		if (IsRunning ())
 		{
 			ClientDestination::Stop ();
-			StopIOService ();
+			SetRunning (false);
 		}
 	}
 
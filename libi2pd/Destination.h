@@ -11,6 +11,8 @@
 
 #include <string.h>
 #include <thread>
+#include <atomic>
+#include <vector>
 #include <mutex>
 #include <memory>
 #include <map>
@@ -78,6 +80,10 @@ namespace client
 	// streaming
 	const char I2CP_PARAM_STREAMING_INITIAL_ACK_DELAY[] = "i2p.streaming.initialAckDelay";
 	const int DEFAULT_INITIAL_ACK_DELAY = 200; // milliseconds
+	const char I2CP_PARAM_STREAMING_CONGESTION_CONTROL[] = "i2p.streaming.congestionControl";
+	const char DEFAULT_STREAMING_CONGESTION_CONTROL[] = "newreno"; // or vegas
+	const char I2CP_PARAM_STREAMING_PACING[] = "i2p.streaming.pacing";
+	const bool DEFAULT_STREAMING_PACING = true;
 
 	typedef std::function<void (std::shared_ptr<i2p::stream::Stream> stream)> StreamRequestComplete;
 
@@ -110,6 +116,7 @@ namespace client
 			~LeaseSetDestination ();
 			const std::string& GetNickname () const { return m_Nickname; };
 			boost::asio::io_service& GetService () { return m_Service; };
+			uint64_t GetCPUTime () const { return m_CPUTime; }; // in microseconds, spent on incoming messages and cleanup
 
 			virtual void Start ();
 			virtual void Stop ();
@@ -173,6 +180,7 @@ namespace client
 		private:
 
 			boost::asio::io_service& m_Service;
+			std::atomic<uint64_t> m_CPUTime;
 			mutable std::mutex m_RemoteLeaseSetsMutex;
 			std::map<i2p::data::IdentHash, std::shared_ptr<i2p::data::LeaseSet> > m_RemoteLeaseSets;
 			std::map<i2p::data::IdentHash, std::shared_ptr<LeaseSetRequest> > m_LeaseSetRequests;
@@ -242,6 +250,8 @@ namespace client
 			bool IsAcceptingStreams () const;
 			void AcceptOnce (const i2p::stream::StreamingDestination::Acceptor& acceptor);
 			int GetStreamingAckDelay () const { return m_StreamingAckDelay; }
+			const std::string& GetStreamingCongestionControl () const { return m_StreamingCongestionControl; }
+			bool IsStreamingPacing () const { return m_IsStreamingPacing; }
 
 			// datagram
 			i2p::datagram::DatagramDestination * GetDatagramDestination () const { return m_DatagramDestination; };
@@ -275,6 +285,8 @@ namespace client
 			std::unique_ptr<EncryptionKey> m_ECIESx25519EncryptionKey;
 
 			int m_StreamingAckDelay;
+			std::string m_StreamingCongestionControl;
+			bool m_IsStreamingPacing;
 			std::shared_ptr<i2p::stream::StreamingDestination> m_StreamingDestination; // default
 			std::map<uint16_t, std::shared_ptr<i2p::stream::StreamingDestination> > m_StreamingDestinationsByPorts;
 			i2p::datagram::DatagramDestination * m_DatagramDestination;
@@ -291,7 +303,75 @@ namespace client
 			bool DeleteStream (uint32_t recvStreamID);
 	};
 
-	class RunnableClientDestination: private i2p::util::RunnableService, public ClientDestination
+	const int DESTINATION_MAX_NUM_THREADS = 64;
+
+	class DestinationWorker: private i2p::util::RunnableServiceWithWork
+	{
+		public:
+
+			DestinationWorker (int index): RunnableServiceWithWork ("Destinations-" + std::to_string (index)),
+				m_NumDestinations (0) {};
+			~DestinationWorker () { Stop (); };
+
+			void Start () { if (!IsRunning ()) StartIOService (); };
+			void Stop () { StopIOService (); };
+			boost::asio::io_service& GetService () { return GetIOService (); };
+
+			void DestinationAdded () { m_NumDestinations++; };
+			void DestinationDeleted () { m_NumDestinations--; };
+			int GetNumDestinations () const { return m_NumDestinations; };
+
+		private:
+
+			std::atomic<int> m_NumDestinations;
+	};
+
+	/** @brief fixed number of threads shared by all runnable destinations */
+	class DestinationWorkers
+	{
+		public:
+
+			DestinationWorkers (): m_IsRunning (false) {};
+			~DestinationWorkers () { Stop (); };
+
+			void Start ();
+			void Stop ();
+			std::shared_ptr<DestinationWorker> Acquire (); // least loaded, starts threads if necessary
+
+			size_t GetNumThreads () const { return m_Workers.size (); };
+
+		private:
+
+			void StartWorkers ();
+
+		private:
+
+			std::mutex m_Mutex;
+			bool m_IsRunning;
+			std::vector<std::shared_ptr<DestinationWorker> > m_Workers;
+	};
+
+	extern DestinationWorkers destinationWorkers;
+
+	/** @brief replaces own thread of destination, all handlers still run in one thread */
+	class PooledDestinationService
+	{
+		protected:
+
+			PooledDestinationService (): m_Worker (destinationWorkers.Acquire ()), m_IsRunning (false) {};
+			~PooledDestinationService () { m_Worker->DestinationDeleted (); };
+
+			boost::asio::io_service& GetIOService () { return m_Worker->GetService (); };
+			bool IsRunning () const { return m_IsRunning; };
+			void SetRunning (bool isRunning) { m_IsRunning = isRunning; };
+
+		private:
+
+			std::shared_ptr<DestinationWorker> m_Worker; // keep it while we use its service
+			bool m_IsRunning;
+	};
+
+	class RunnableClientDestination: private PooledDestinationService, public ClientDestination
 	{
 		public:
 
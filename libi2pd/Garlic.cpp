@@ -447,16 +447,16 @@ namespace garlic
 	{
 		m_Sessions.clear ();
 		m_DeliveryStatusSessions.clear ();
-		m_Tags.clear ();
+		m_Tags.Clear ();
 		m_ECIESx25519Sessions.clear ();
-		m_ECIESx25519Tags.clear ();
+		m_ECIESx25519Tags.Clear ();
 	}
 	void GarlicDestination::AddSessionKey (const uint8_t * key, const uint8_t * tag)
 	{
 		if (key)
 		{
 			uint32_t ts = i2p::util::GetSecondsSinceEpoch ();
-			m_Tags[SessionTag(tag, ts)] = std::make_shared<AESDecryption>(key);
+			m_Tags.Insert (tag, std::make_shared<AESDecryption>(key), 0, ts);
 		}
 	}
 
@@ -477,13 +477,12 @@ namespace garlic
 		}
 		auto mod = length & 0x0f; // %16
 		buf += 4; // length
-		auto it = !mod ? m_Tags.find (SessionTag(buf)) : m_Tags.end (); // AES block is multiple of 16
+		int index;
+		auto decryption = !mod ? m_Tags.Take (buf, index) : nullptr; // AES block is multiple of 16, tag might be used only once
 		// AES tag might be used even if encryption type is not ElGamal/AES
-		if (it != m_Tags.end ())
+		if (decryption)
 		{
 			// tag found. Use AES
-			auto decryption = it->second;
-			m_Tags.erase (it); // tag might be used only once
 			if (length >= 32)
 			{
 				uint8_t iv[32]; // IV is first 16 bytes
@@ -503,14 +502,13 @@ namespace garlic
 				// try ECIESx25519 tag
 				uint64_t tag;
 				memcpy (&tag, buf, 8);
-				auto it1 = m_ECIESx25519Tags.find (tag);
-				if (it1 != m_ECIESx25519Tags.end ())
+				auto tagset = m_ECIESx25519Tags.Take (tag, index);
+				if (tagset)
 				{
 					found = true;
-					auto session = it1->second.tagset->GetSession ();
-					if (!session || !session->HandleNextMessage (buf, length, it1->second.tagset, it1->second.index))
+					auto session = tagset->GetSession ();
+					if (!session || !session->HandleNextMessage (buf, length, tagset, index))
 						LogPrint (eLogError, "Garlic: can't handle ECIES-X25519-AEAD-Ratchet message");
-					m_ECIESx25519Tags.erase (it1);
 				}
 			}
 
@@ -556,7 +554,7 @@ namespace garlic
 			}
 			uint32_t ts = i2p::util::GetSecondsSinceEpoch ();
 			for (int i = 0; i < tagCount; i++)
-				m_Tags[SessionTag(buf + i*32, ts)] = decryption;
+				m_Tags.Insert (buf + i*32, decryption, 0, ts);
 		}
 		buf += tagCount*32;
 		len -= tagCount*32;
@@ -760,17 +758,7 @@ namespace garlic
 	{
 		// incoming
 		uint32_t ts = i2p::util::GetSecondsSinceEpoch ();
-		int numExpiredTags = 0;
-		for (auto it = m_Tags.begin (); it != m_Tags.end ();)
-		{
-			if (ts > it->first.creationTime + INCOMING_TAGS_EXPIRATION_TIMEOUT)
-			{
-				numExpiredTags++;
-				it = m_Tags.erase (it);
-			}
-			else
-				++it;
-		}
+		auto numExpiredTags = m_Tags.CleanupExpired (ts, INCOMING_TAGS_EXPIRATION_TIMEOUT);
 		if (numExpiredTags > 0)
 			LogPrint (eLogDebug, "Garlic: ", numExpiredTags, " tags expired for ", GetIdentHash().ToBase64 ());
 
@@ -802,13 +790,8 @@ namespace garlic
 			}
 		}
 		// ECIESx25519
-		for (auto it = m_ECIESx25519Tags.begin (); it != m_ECIESx25519Tags.end ();)
-		{
-			if (it->second.tagset->IsExpired (ts) || ts > it->second.creationTime + ECIESX25519_INCOMING_TAGS_EXPIRATION_TIMEOUT)
-				it = m_ECIESx25519Tags.erase (it);
-			else
-				++it;
-		}
+		m_ECIESx25519Tags.InvalidateRecords ([ts](const RatchetTagSet& tagset) { return tagset.IsExpired (ts); });
+		m_ECIESx25519Tags.CleanupExpired (ts, ECIESX25519_INCOMING_TAGS_EXPIRATION_TIMEOUT);
 
 		for (auto it = m_ECIESx25519Sessions.begin (); it != m_ECIESx25519Sessions.end ();)
 		{
@@ -877,21 +860,21 @@ namespace garlic
 
 	void GarlicDestination::SaveTags ()
 	{
-		if (m_Tags.empty ()) return;
+		if (!m_Tags.GetSize ()) return;
 		std::string ident = GetIdentHash().ToBase32();
 		std::string path  = i2p::fs::DataDirPath("tags", (ident + ".tags"));
 		std::ofstream f (path, std::ofstream::binary | std::ofstream::out | std::ofstream::trunc);
 		uint32_t ts = i2p::util::GetSecondsSinceEpoch ();
 		// 4 bytes timestamp, 32 bytes tag, 32 bytes key
-		for (auto it: m_Tags)
-		{
-			if (ts < it.first.creationTime + INCOMING_TAGS_EXPIRATION_TIMEOUT)
+		m_Tags.ForEach ([&f, ts](const i2p::data::Tag<32>& tag, std::shared_ptr<AESDecryption> decryption, uint32_t creationTime)
 			{
-				f.write ((char *)&it.first.creationTime, 4);
-				f.write ((char *)it.first.data (), 32);
-				f.write ((char *)it.second->GetKey ().data (), 32);
-			}
-		}
+				if (ts < creationTime + INCOMING_TAGS_EXPIRATION_TIMEOUT)
+				{
+					f.write ((char *)&creationTime, 4);
+					f.write ((char *)tag.data (), 32);
+					f.write ((char *)decryption->GetKey ().data (), 32);
+				}
+			});
 	}
 
 	void GarlicDestination::LoadTags ()
@@ -918,7 +901,10 @@ namespace garlic
 						f.read ((char *)key, 32);
 					}
 					else
+					{
 						f.seekg (64, std::ios::cur); // skip
+						continue;
+					}
 					if (f.eof ()) break;
 
 					std::shared_ptr<AESDecryption> decryption;
@@ -926,11 +912,14 @@ namespace garlic
 					if (it != keys.end ())
 						decryption = it->second;
 					else
+					{
 						decryption = std::make_shared<AESDecryption>(key);
-					m_Tags.insert (std::make_pair (SessionTag (tag, ts), decryption));
+						keys[key] = decryption; // all tags of a session share one key record
+					}
+					m_Tags.Insert (tag, decryption, 0, ts);
 				}
-				if (!m_Tags.empty ())
-					LogPrint (eLogInfo, "Garlic: ", m_Tags.size (), " tags loaded for ", ident);
+				if (m_Tags.GetSize ())
+					LogPrint (eLogInfo, "Garlic: ", m_Tags.GetSize (), " tags loaded for ", ident);
 			}
 		}
 		i2p::fs::Remove (path);
@@ -1009,7 +998,7 @@ namespace garlic
 	{
 		auto index = tagset->GetNextIndex ();
 		uint64_t tag = tagset->GetNextSessionTag ();
-		m_ECIESx25519Tags.emplace (tag, ECIESX25519AEADRatchetIndexTagset{index, tagset, i2p::util::GetSecondsSinceEpoch ()});
+		m_ECIESx25519Tags.Insert (tag, tagset, index, i2p::util::GetSecondsSinceEpoch ());
 	}
 
 	void GarlicDestination::AddECIESx25519Session (const uint8_t * staticKey, ECIESX25519AEADRatchetSessionPtr session)
@@ -21,6 +21,7 @@
 #include "LeaseSet.h"
 #include "Queue.h"
 #include "Identity.h"
+#include "TagStore.h"
 
 namespace i2p
 {
@@ -215,12 +216,6 @@ namespace garlic
 	typedef std::shared_ptr<ECIESX25519AEADRatchetSession> ECIESX25519AEADRatchetSessionPtr;
 	class RatchetTagSet;
 	typedef std::shared_ptr<RatchetTagSet> RatchetTagSetPtr;
-	struct ECIESX25519AEADRatchetIndexTagset
-	{
-		int index;
-		RatchetTagSetPtr tagset;
-		uint64_t creationTime; // seconds since epoch
-	};
 
 	class GarlicDestination: public i2p::data::LocalDestination
 	{
@@ -281,8 +276,8 @@ namespace garlic
 			std::unordered_map<i2p::data::Tag<32>, ECIESX25519AEADRatchetSessionPtr> m_ECIESx25519Sessions; // static key -> session
 			// incoming
 			int m_NumRatchetInboundTags;
-			std::unordered_map<SessionTag, std::shared_ptr<AESDecryption>, std::hash<i2p::data::Tag<32> > > m_Tags;
-			std::unordered_map<uint64_t, ECIESX25519AEADRatchetIndexTagset> m_ECIESx25519Tags; // session tag -> session
+			TagStore<i2p::data::Tag<32>, AESDecryption> m_Tags;
+			TagStore<uint64_t, RatchetTagSet> m_ECIESx25519Tags; // session tag -> tagset and index
 			// DeliveryStatus
 			std::mutex m_DeliveryStatusSessionsMutex;
 			std::unordered_map<uint32_t, GarlicRoutingSessionPtr> m_DeliveryStatusSessions; // msgID -> session
@@ -290,8 +285,8 @@ namespace garlic
 		public:
 
 			// for HTTP only
-			size_t GetNumIncomingTags () const { return m_Tags.size (); }
-			size_t GetNumIncomingECIESx25519Tags () const { return m_ECIESx25519Tags.size (); }
+			size_t GetNumIncomingTags () const { return m_Tags.GetSize (); }
+			size_t GetNumIncomingECIESx25519Tags () const { return m_ECIESx25519Tags.GetSize (); }
 			const decltype(m_Sessions)& GetSessions () const { return m_Sessions; };
 			const decltype(m_ECIESx25519Sessions)& GetECIESx25519Sessions () const { return m_ECIESx25519Sessions; }
 	};
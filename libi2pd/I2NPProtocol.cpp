@@ -8,16 +8,21 @@
 
 #include <string.h>
 #include <atomic>
+#include <algorithm>
+#include <array>
+#include <vector>
 #include "Base.h"
 #include "Log.h"
 #include "Crypto.h"
 #include "I2PEndian.h"
 #include "Timestamp.h"
+#include "util.h"
 #include "RouterContext.h"
 #include "NetDb.hpp"
 #include "Tunnel.h"
 #include "Transports.h"
 #include "Garlic.h"
+#include "CryptoWorker.h"
 #include "I2NPProtocol.h"
 #include "version.h"
 
@@ -25,21 +30,29 @@ using namespace i2p::transport;
 
 namespace i2p
 {
+	template<size_t sz>
+	static std::shared_ptr<I2NPMessage> AllocateI2NPMessage ()
+	{
+		// message and shared_ptr's control block in one block from thread's pool
+		return std::allocate_shared<I2NPMessageBuffer<sz> >(
+			i2p::util::ThreadLocalPoolAllocator<I2NPMessageBuffer<sz>, I2NP_MESSAGES_POOL_THREAD_CACHE_SIZE>());
+	}
+
 	std::shared_ptr<I2NPMessage> NewI2NPMessage ()
 	{
-		return std::make_shared<I2NPMessageBuffer<I2NP_MAX_MESSAGE_SIZE> >();
+		return AllocateI2NPMessage<I2NP_MAX_MESSAGE_SIZE> ();
 	}
 
 	std::shared_ptr<I2NPMessage> NewI2NPShortMessage ()
 	{
-		return std::make_shared<I2NPMessageBuffer<I2NP_MAX_SHORT_MESSAGE_SIZE> >();
+		return AllocateI2NPMessage<I2NP_MAX_SHORT_MESSAGE_SIZE> ();
 	}
 
 	std::shared_ptr<I2NPMessage> NewI2NPTunnelMessage ()
 	{
-		auto msg = new I2NPMessageBuffer<i2p::tunnel::TUNNEL_DATA_MSG_SIZE + I2NP_HEADER_SIZE + 34>(); // reserved for alignment and NTCP 16 + 6 + 12
+		auto msg = AllocateI2NPMessage<i2p::tunnel::TUNNEL_DATA_MSG_SIZE + I2NP_HEADER_SIZE + 34> (); // reserved for alignment and NTCP 16 + 6 + 12
 		msg->Align (12);
-		return std::shared_ptr<I2NPMessage>(msg);
+		return msg;
 	}
 
 	std::shared_ptr<I2NPMessage> NewI2NPMessage (size_t len)
@@ -342,55 +355,164 @@ namespace i2p
 		return g_MaxNumTransitTunnels;
 	}
 
-	bool HandleBuildRequestRecords (int num, uint8_t * records, uint8_t * clearText)
+	struct BuildRequestsWorkerContext
+	{
+		BN_CTX * ctx;
+		BuildRequestsWorkerContext (): ctx (BN_CTX_new ()) {};
+		~BuildRequestsWorkerContext () { BN_CTX_free (ctx); };
+	};
+	static i2p::worker::WorkerPool<BuildRequestsWorkerContext> g_BuildRequestsWorkers;
+
+	void StartBuildRequestsWorkers (int numWorkers)
+	{
+		if (numWorkers > 0)
+		{
+			g_BuildRequestsWorkers.Start (numWorkers, MAX_NUM_QUEUED_BUILD_REQUESTS);
+			LogPrint (eLogInfo, "I2NP: ", numWorkers, " build requests workers started");
+		}
+	}
+
+	void StopBuildRequestsWorkers ()
+	{
+		g_BuildRequestsWorkers.Stop ();
+	}
+
+	size_t GetNumQueuedBuildRequests ()
+	{
+		return g_BuildRequestsWorkers.GetBacklogSize ();
+	}
+
+	static int FindBuildRequestRecord (int num, const uint8_t * records)
 	{
 		for (int i = 0; i < num; i++)
+			if (!memcmp (records + i*TUNNEL_BUILD_RECORD_SIZE + BUILD_REQUEST_RECORD_TO_PEER_OFFSET,
+				(const uint8_t *)i2p::context.GetRouterInfo ().GetIdentHash (), 16))
+				return i;
+		return -1;
+	}
+
+	const i2p::util::BloomFilterPtr& GetBuildRecordsFilter ()
+	{
+		// every accepted or rejected request lives for a tunnel lifetime at most
+		static auto filter = i2p::util::BloomFilter (std::max ((size_t)2*g_MaxNumTransitTunnels, (size_t)1024), 0.0001,
+			i2p::tunnel::TUNNEL_EXPIRATION_TIMEOUT);
+		return filter;
+	}
+
+	static bool IsReplayedBuildRecord (const uint8_t * record)
+	{
+		if (!GetBuildRecordsFilter ()->Add (record, TUNNEL_BUILD_RECORD_SIZE))
 		{
-			uint8_t * record = records + i*TUNNEL_BUILD_RECORD_SIZE;
-			if (!memcmp (record + BUILD_REQUEST_RECORD_TO_PEER_OFFSET, (const uint8_t *)i2p::context.GetRouterInfo ().GetIdentHash (), 16))
-			{
-				LogPrint (eLogDebug, "I2NP: Build request record ", i, " is ours");
-				BN_CTX * ctx = BN_CTX_new ();
-				i2p::context.DecryptTunnelBuildRecord (record + BUILD_REQUEST_RECORD_ENCRYPTED_OFFSET, clearText, ctx);
-				BN_CTX_free (ctx);
-				// replace record to reply
-				if (i2p::context.AcceptsTunnels () &&
-					i2p::tunnel::tunnels.GetTransitTunnels ().size () <= g_MaxNumTransitTunnels &&
-					!i2p::transport::transports.IsBandwidthExceeded () &&
-					!i2p::transport::transports.IsTransitBandwidthExceeded ())
-				{
-					auto transitTunnel = i2p::tunnel::CreateTransitTunnel (
-							bufbe32toh (clearText + BUILD_REQUEST_RECORD_RECEIVE_TUNNEL_OFFSET),
-							clearText + BUILD_REQUEST_RECORD_NEXT_IDENT_OFFSET,
-							bufbe32toh (clearText + BUILD_REQUEST_RECORD_NEXT_TUNNEL_OFFSET),
-							clearText + BUILD_REQUEST_RECORD_LAYER_KEY_OFFSET,
-							clearText + BUILD_REQUEST_RECORD_IV_KEY_OFFSET,
-							clearText[BUILD_REQUEST_RECORD_FLAG_OFFSET] & 0x80,
-							clearText[BUILD_REQUEST_RECORD_FLAG_OFFSET ] & 0x40);
-					i2p::tunnel::tunnels.AddTransitTunnel (transitTunnel);
-					record[BUILD_RESPONSE_RECORD_RET_OFFSET] = 0;
-				}
-				else
-					record[BUILD_RESPONSE_RECORD_RET_OFFSET] = 30; // always reject with bandwidth reason (30)
-
-				//TODO: fill filler
-				SHA256 (record + BUILD_RESPONSE_RECORD_PADDING_OFFSET, BUILD_RESPONSE_RECORD_PADDING_SIZE + 1, // + 1 byte of ret
-					record + BUILD_RESPONSE_RECORD_HASH_OFFSET);
-				// encrypt reply
-				i2p::crypto::CBCEncryption encryption;
-				for (int j = 0; j < num; j++)
-				{
-					encryption.SetKey (clearText + BUILD_REQUEST_RECORD_REPLY_KEY_OFFSET);
-					encryption.SetIV (clearText + BUILD_REQUEST_RECORD_REPLY_IV_OFFSET);
-					uint8_t * reply = records + j*TUNNEL_BUILD_RECORD_SIZE;
-					encryption.Encrypt(reply, TUNNEL_BUILD_RECORD_SIZE, reply);
-				}
-				return true;
-			}
+			LogPrint (eLogWarning, "I2NP: Replayed build request record dropped");
+			return true;
 		}
 		return false;
 	}
 
+	static void CreateBuildResponseRecords (int num, uint8_t * records, int ind, const uint8_t * clearText, bool reject)
+	{
+		uint8_t * record = records + ind*TUNNEL_BUILD_RECORD_SIZE;
+		// replace record to reply
+		if (!reject && i2p::context.AcceptsTunnels () &&
+			i2p::tunnel::tunnels.GetTransitTunnels ().size () <= g_MaxNumTransitTunnels &&
+			!i2p::transport::transports.IsBandwidthExceeded () &&
+			!i2p::transport::transports.IsTransitBandwidthExceeded ())
+		{
+			auto transitTunnel = i2p::tunnel::CreateTransitTunnel (
+					bufbe32toh (clearText + BUILD_REQUEST_RECORD_RECEIVE_TUNNEL_OFFSET),
+					clearText + BUILD_REQUEST_RECORD_NEXT_IDENT_OFFSET,
+					bufbe32toh (clearText + BUILD_REQUEST_RECORD_NEXT_TUNNEL_OFFSET),
+					clearText + BUILD_REQUEST_RECORD_LAYER_KEY_OFFSET,
+					clearText + BUILD_REQUEST_RECORD_IV_KEY_OFFSET,
+					clearText[BUILD_REQUEST_RECORD_FLAG_OFFSET] & 0x80,
+					clearText[BUILD_REQUEST_RECORD_FLAG_OFFSET ] & 0x40);
+			i2p::tunnel::tunnels.AddTransitTunnel (transitTunnel);
+			record[BUILD_RESPONSE_RECORD_RET_OFFSET] = 0;
+		}
+		else
+			record[BUILD_RESPONSE_RECORD_RET_OFFSET] = 30; // always reject with bandwidth reason (30)
+
+		//TODO: fill filler
+		SHA256 (record + BUILD_RESPONSE_RECORD_PADDING_OFFSET, BUILD_RESPONSE_RECORD_PADDING_SIZE + 1, // + 1 byte of ret
+			record + BUILD_RESPONSE_RECORD_HASH_OFFSET);
+		// encrypt reply
+		i2p::crypto::CBCEncryption encryption;
+		for (int j = 0; j < num; j++)
+		{
+			encryption.SetKey (clearText + BUILD_REQUEST_RECORD_REPLY_KEY_OFFSET);
+			encryption.SetIV (clearText + BUILD_REQUEST_RECORD_REPLY_IV_OFFSET);
+			uint8_t * reply = records + j*TUNNEL_BUILD_RECORD_SIZE;
+			encryption.Encrypt(reply, TUNNEL_BUILD_RECORD_SIZE, reply);
+		}
+	}
+
+	bool HandleBuildRequestRecords (int num, uint8_t * records, uint8_t * clearText)
+	{
+		int ind = FindBuildRequestRecord (num, records);
+		if (ind < 0) return false;
+		LogPrint (eLogDebug, "I2NP: Build request record ", ind, " is ours");
+		if (IsReplayedBuildRecord (records + ind*TUNNEL_BUILD_RECORD_SIZE)) return false;
+		BN_CTX * ctx = BN_CTX_new ();
+		i2p::context.DecryptTunnelBuildRecord (records + ind*TUNNEL_BUILD_RECORD_SIZE + BUILD_REQUEST_RECORD_ENCRYPTED_OFFSET, clearText, ctx);
+		BN_CTX_free (ctx);
+		CreateBuildResponseRecords (num, records, ind, clearText, false);
+		return true;
+	}
+
+	static void SendBuildRequestResponse (bool isVariable, uint8_t * buf, size_t len, const uint8_t * clearText)
+	{
+		std::shared_ptr<I2NPMessage> msg;
+		if (clearText[BUILD_REQUEST_RECORD_FLAG_OFFSET] & 0x40) // we are endpoint of outbound tunnel
+			// so we send it to reply tunnel
+			msg = CreateTunnelGatewayMsg (bufbe32toh (clearText + BUILD_REQUEST_RECORD_NEXT_TUNNEL_OFFSET),
+				isVariable ? eI2NPVariableTunnelBuildReply : eI2NPTunnelBuildReply, buf, len,
+				bufbe32toh (clearText + BUILD_REQUEST_RECORD_SEND_MSG_ID_OFFSET));
+		else
+			msg = CreateI2NPMessage (isVariable ? eI2NPVariableTunnelBuild : eI2NPTunnelBuild, buf, len,
+				bufbe32toh (clearText + BUILD_REQUEST_RECORD_SEND_MSG_ID_OFFSET));
+		msg->trafficClass = eI2NPTrafficClassTransit;
+		transports.SendMessage (clearText + BUILD_REQUEST_RECORD_NEXT_IDENT_OFFSET, msg);
+	}
+
+	static void HandleBuildRequest (bool isVariable, int num, uint8_t * buf, size_t len)
+	{
+		uint8_t * records = isVariable ? buf + 1 : buf;
+		if (!g_BuildRequestsWorkers.IsRunning ())
+		{
+			uint8_t clearText[BUILD_REQUEST_RECORD_CLEAR_TEXT_SIZE];
+			if (HandleBuildRequestRecords (num, records, clearText))
+				SendBuildRequestResponse (isVariable, buf, len, clearText);
+			return;
+		}
+
+		int ind = FindBuildRequestRecord (num, records);
+		if (ind < 0) return;
+		LogPrint (eLogDebug, "I2NP: Build request record ", ind, " is ours");
+		if (IsReplayedBuildRecord (records + ind*TUNNEL_BUILD_RECORD_SIZE)) return;
+		// decrypt by worker, the rest is done by tunnels thread again
+		auto request = std::make_shared<std::vector<uint8_t> >(buf, buf + len);
+		// reject if we are close to saturation, but still reply
+		bool reject = g_BuildRequestsWorkers.GetBacklogSize () >= g_BuildRequestsWorkers.GetMaxBacklogSize ()*3/4;
+		bool offered = g_BuildRequestsWorkers.Offer (
+			[request, isVariable, num, ind, reject](BuildRequestsWorkerContext& context)
+			{
+				auto buf = request->data ();
+				uint8_t * records = isVariable ? buf + 1 : buf;
+				auto clearText = std::make_shared<std::array<uint8_t, BUILD_REQUEST_RECORD_CLEAR_TEXT_SIZE> >();
+				i2p::context.DecryptTunnelBuildRecord (records + ind*TUNNEL_BUILD_RECORD_SIZE + BUILD_REQUEST_RECORD_ENCRYPTED_OFFSET,
+					clearText->data (), context.ctx);
+				i2p::tunnel::tunnels.PostTask (
+					[request, clearText, isVariable, num, ind, reject]()
+					{
+						auto buf = request->data ();
+						CreateBuildResponseRecords (num, isVariable ? buf + 1 : buf, ind, clearText->data (), reject);
+						SendBuildRequestResponse (isVariable, buf, request->size (), clearText->data ());
+					});
+			});
+		if (!offered)
+			LogPrint (eLogWarning, "I2NP: Build requests backlog is full, request dropped");
+	}
+
 	void HandleVariableTunnelBuildMsg (uint32_t replyMsgID, uint8_t * buf, size_t len)
 	{
 		int num = buf[0];
@@ -419,24 +541,7 @@ namespace i2p
 			}
 		}
 		else
-		{
-			uint8_t clearText[BUILD_REQUEST_RECORD_CLEAR_TEXT_SIZE];
-			if (HandleBuildRequestRecords (num, buf + 1, clearText))
-			{
-				if (clearText[BUILD_REQUEST_RECORD_FLAG_OFFSET] & 0x40) // we are endpoint of outboud tunnel
-				{
-					// so we send it to reply tunnel
-					transports.SendMessage (clearText + BUILD_REQUEST_RECORD_NEXT_IDENT_OFFSET,
-						CreateTunnelGatewayMsg (bufbe32toh (clearText + BUILD_REQUEST_RECORD_NEXT_TUNNEL_OFFSET),
-							eI2NPVariableTunnelBuildReply, buf, len,
-							bufbe32toh (clearText + BUILD_REQUEST_RECORD_SEND_MSG_ID_OFFSET)));
-				}
-				else
-					transports.SendMessage (clearText + BUILD_REQUEST_RECORD_NEXT_IDENT_OFFSET,
-						CreateI2NPMessage (eI2NPVariableTunnelBuild, buf, len,
-							bufbe32toh (clearText + BUILD_REQUEST_RECORD_SEND_MSG_ID_OFFSET)));
-			}
-		}
+			HandleBuildRequest (true, num, buf, len);
 	}
 
 	void HandleTunnelBuildMsg (uint8_t * buf, size_t len)
@@ -446,22 +551,7 @@ namespace i2p
 			LogPrint (eLogError, "TunnelBuild message is too short ", len);
 			return;
 		}
-		uint8_t clearText[BUILD_REQUEST_RECORD_CLEAR_TEXT_SIZE];
-		if (HandleBuildRequestRecords (NUM_TUNNEL_BUILD_RECORDS, buf, clearText))
-		{
-			if (clearText[BUILD_REQUEST_RECORD_FLAG_OFFSET] & 0x40) // we are endpoint of outbound tunnel
-			{
-				// so we send it to reply tunnel
-				transports.SendMessage (clearText + BUILD_REQUEST_RECORD_NEXT_IDENT_OFFSET,
-					CreateTunnelGatewayMsg (bufbe32toh (clearText + BUILD_REQUEST_RECORD_NEXT_TUNNEL_OFFSET),
-						eI2NPTunnelBuildReply, buf, len,
-						bufbe32toh (clearText + BUILD_REQUEST_RECORD_SEND_MSG_ID_OFFSET)));
-			}
-			else
-				transports.SendMessage (clearText + BUILD_REQUEST_RECORD_NEXT_IDENT_OFFSET,
-					CreateI2NPMessage (eI2NPTunnelBuild, buf, len,
-						bufbe32toh (clearText + BUILD_REQUEST_RECORD_SEND_MSG_ID_OFFSET)));
-		}
+		HandleBuildRequest (false, NUM_TUNNEL_BUILD_RECORDS, buf, len);
 	}
 
 	void HandleVariableTunnelBuildReplyMsg (uint32_t replyMsgID, uint8_t * buf, size_t len)
@@ -623,12 +713,27 @@ namespace i2p
 		}
 	}
 
+	const i2p::util::BloomFilterPtr& GetMessageIDsFilter ()
+	{
+		// tunnel data is not here, assume one message per 4K of traffic
+		static auto filter = i2p::util::BloomFilter (std::min (I2NP_MSGID_FILTER_MAX_CAPACITY,
+			std::max (I2NP_MSGID_FILTER_MIN_CAPACITY, (size_t)(i2p::context.GetBandwidthLimit ()/4)*I2NP_MSGID_FILTER_INTERVAL)),
+			I2NP_MSGID_FILTER_FALSE_POSITIVE_RATE, I2NP_MSGID_FILTER_INTERVAL);
+		return filter;
+	}
+
 	void HandleI2NPMessage (std::shared_ptr<I2NPMessage> msg)
 	{
 		if (msg)
 		{
 			uint8_t typeID = msg->GetTypeID ();
 			LogPrint (eLogDebug, "I2NP: Handling message with type ", (int)typeID);
+			if (typeID != eI2NPTunnelData && typeID != eI2NPTunnelGateway &&
+				!GetMessageIDsFilter ()->Add (msg->GetHeader () + I2NP_HEADER_MSGID_OFFSET, 12)) // msgID and expiration
+			{
+				LogPrint (eLogWarning, "I2NP: Duplicate message ", msg->GetMsgID (), " of type ", (int)typeID, " dropped");
+				return;
+			}
 			switch (typeID)
 			{
 				case eI2NPTunnelData:
@@ -14,6 +14,7 @@
 #include <set>
 #include <memory>
 #include "Crypto.h"
+#include "BloomFilter.h"
 #include "I2PEndian.h"
 #include "Identity.h"
 #include "RouterInfo.h"
@@ -98,6 +99,15 @@ namespace i2p
 		eI2NPVariableTunnelBuildReply = 24
 	};
 
+	enum I2NPTrafficClass // in order of priority for bandwidth
+	{
+		eI2NPTrafficClassLocal = 0, // our own tunnels and control messages
+		eI2NPTrafficClassNetDb,
+		eI2NPTrafficClassExploratory,
+		eI2NPTrafficClassTransit,
+		eNumI2NPTrafficClasses
+	};
+
 	const int NUM_TUNNEL_BUILD_RECORDS = 8;
 
 	// DatabaseLookup flags
@@ -118,17 +128,23 @@ namespace tunnel
 
 	const size_t I2NP_MAX_MESSAGE_SIZE = 62708;
 	const size_t I2NP_MAX_SHORT_MESSAGE_SIZE = 4096;
+	const size_t I2NP_MESSAGES_POOL_THREAD_CACHE_SIZE = 2*1024*1024; // per thread and message size, in bytes
 	const unsigned int I2NP_MESSAGE_EXPIRATION_TIMEOUT = 8000; // in milliseconds (as initial RTT)
 	const unsigned int I2NP_MESSAGE_CLOCK_SKEW = 60*1000; // 1 minute in milliseconds
+	const int I2NP_MSGID_FILTER_INTERVAL = 2*I2NP_MESSAGE_CLOCK_SKEW/1000; // in seconds
+	const size_t I2NP_MSGID_FILTER_MIN_CAPACITY = 16*1024; // entries per interval
+	const size_t I2NP_MSGID_FILTER_MAX_CAPACITY = 1024*1024;
+	const double I2NP_MSGID_FILTER_FALSE_POSITIVE_RATE = 0.0001;
 
 	struct I2NPMessage
 	{
 		uint8_t * buf;
 		size_t len, offset, maxLen;
 		std::shared_ptr<i2p::tunnel::InboundTunnel> from;
+		I2NPTrafficClass trafficClass;
 
 		I2NPMessage (): buf (nullptr),len (I2NP_HEADER_SIZE + 2),
-			offset(2), maxLen (0), from (nullptr) {};  // reserve 2 bytes for NTCP header
+			offset(2), maxLen (0), from (nullptr), trafficClass (eI2NPTrafficClassLocal) {};  // reserve 2 bytes for NTCP header
 
 		// header accessors
 		uint8_t * GetHeader () { return GetBuffer (); };
@@ -183,6 +199,7 @@ namespace tunnel
 			memcpy (buf + offset, other.buf + other.offset, other.GetLength ());
 			len = offset + other.GetLength ();
 			from = other.from;
+			trafficClass = other.trafficClass;
 			return *this;
 		}
 
@@ -260,7 +277,12 @@ namespace tunnel
 	std::shared_ptr<I2NPMessage> CreateDatabaseStoreMsg (std::shared_ptr<const i2p::data::LocalLeaseSet> leaseSet, uint32_t replyToken = 0, std::shared_ptr<const i2p::tunnel::InboundTunnel> replyTunnel = nullptr);
 	bool IsRouterInfoMsg (std::shared_ptr<I2NPMessage> msg);
 
+	const size_t MAX_NUM_QUEUED_BUILD_REQUESTS = 256; // new requests are dropped above, rejected above 3/4
+	void StartBuildRequestsWorkers (int numWorkers); // 0 - handle build requests by tunnels thread
+	void StopBuildRequestsWorkers ();
+	size_t GetNumQueuedBuildRequests ();
 	bool HandleBuildRequestRecords (int num, uint8_t * records, uint8_t * clearText);
+	const i2p::util::BloomFilterPtr& GetBuildRecordsFilter (); // replayed build request records
 	void HandleVariableTunnelBuildMsg (uint32_t replyMsgID, uint8_t * buf, size_t len);
 	void HandleVariableTunnelBuildReplyMsg (uint32_t replyMsgID, uint8_t * buf, size_t len);
 	void HandleTunnelBuildMsg (uint8_t * buf, size_t len);
@@ -277,6 +299,7 @@ namespace tunnel
 	size_t GetI2NPMessageLength (const uint8_t * msg, size_t len);
 	void HandleI2NPMessage (uint8_t * msg, size_t len);
 	void HandleI2NPMessage (std::shared_ptr<I2NPMessage> msg);
+	const i2p::util::BloomFilterPtr& GetMessageIDsFilter (); // duplicate msgID and expiration
 
 	class I2NPMessagesHandler
 	{
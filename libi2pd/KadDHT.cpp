@@ -0,0 +1,210 @@
+/*
+* Copyright (c) 2013-2020, The PurpleI2P Project
+*
+* This file is part of Purple i2pd project and licensed under BSD3
+*
+* See full license text in LICENSE file at top of project tree
+*/
+
+#include "KadDHT.h"
+
+namespace i2p
+{
+namespace data
+{
+	static inline bool GetBit (const IdentHash& h, int level)
+	{
+		return h[level >> 3] & (0x80 >> (level & 0x07)); // MSB first
+	}
+
+	DHTNode::~DHTNode ()
+	{
+		delete zero;
+		delete one;
+	}
+
+	void DHTNode::MoveRouterUp (bool fromOne)
+	{
+		DHTNode *& side = fromOne ? one : zero;
+		if (side)
+		{
+			router = side->router;
+			delete side;
+			side = nullptr;
+		}
+	}
+
+	DHTTable::DHTTable (): m_Size (0)
+	{
+		m_Root = new DHTNode;
+	}
+
+	DHTTable::~DHTTable ()
+	{
+		delete m_Root;
+	}
+
+	void DHTTable::Clear ()
+	{
+		m_Size = 0;
+		delete m_Root;
+		m_Root = new DHTNode;
+	}
+
+	void DHTTable::Insert (const std::shared_ptr<RouterInfo>& r)
+	{
+		if (!r) return;
+		return Insert (r, m_Root, 0);
+	}
+
+	void DHTTable::Insert (const std::shared_ptr<RouterInfo>& r, DHTNode * root, int level)
+	{
+		if (root->router)
+		{
+			if (root->router->GetIdentHash () == r->GetIdentHash ())
+			{
+				root->router = r; // replace
+				return;
+			}
+			// split leaf, push existing router one level down
+			auto r1 = root->router;
+			root->router = nullptr;
+			auto leaf = new DHTNode;
+			leaf->router = r1;
+			if (GetBit (r1->GetIdentHash (), level))
+				root->one = leaf;
+			else
+				root->zero = leaf;
+		}
+		else if (root->IsEmpty ()) // empty table
+		{
+			root->router = r;
+			m_Size++;
+			return;
+		}
+		DHTNode *& child = GetBit (r->GetIdentHash (), level) ? root->one : root->zero;
+		if (!child)
+		{
+			child = new DHTNode;
+			child->router = r;
+			m_Size++;
+		}
+		else
+			Insert (r, child, level + 1);
+	}
+
+	bool DHTTable::Remove (const IdentHash& h)
+	{
+		return Remove (h, m_Root, 0);
+	}
+
+	bool DHTTable::Remove (const IdentHash& h, DHTNode * root, int level)
+	{
+		if (root->router)
+		{
+			if (root->router->GetIdentHash () == h)
+			{
+				root->router = nullptr;
+				m_Size--;
+				return true;
+			}
+			return false;
+		}
+		DHTNode *& child = GetBit (h, level) ? root->one : root->zero;
+		if (!child || !Remove (h, child, level + 1)) return false;
+		if (child->IsEmpty ())
+		{
+			delete child;
+			child = nullptr;
+		}
+		// collapse single leaf
+		if (root->zero && !root->one && root->zero->router)
+			root->MoveRouterUp (false);
+		else if (root->one && !root->zero && root->one->router)
+			root->MoveRouterUp (true);
+		return true;
+	}
+
+	std::shared_ptr<RouterInfo> DHTTable::FindClosest (const IdentHash& h, const Filter& filter) const
+	{
+		return FindClosest (h, m_Root, 0, filter);
+	}
+
+	std::shared_ptr<RouterInfo> DHTTable::FindClosest (const IdentHash& h, DHTNode * root, int level, const Filter& filter) const
+	{
+		if (root->router)
+			return (!filter || filter (root->router)) ? root->router : nullptr;
+		// branch with same bit is always closer than another one
+		bool bit = GetBit (h, level);
+		DHTNode * first = bit ? root->one : root->zero, * second = bit ? root->zero : root->one;
+		if (first)
+		{
+			auto r = FindClosest (h, first, level + 1, filter);
+			if (r) return r;
+		}
+		if (second)
+			return FindClosest (h, second, level + 1, filter);
+		return nullptr;
+	}
+
+	std::vector<std::shared_ptr<RouterInfo> > DHTTable::FindClosest (const IdentHash& h, size_t num, const Filter& filter) const
+	{
+		std::vector<std::shared_ptr<RouterInfo> > routers;
+		if (num > 0)
+		{
+			routers.reserve (num);
+			FindClosest (h, num, m_Root, 0, filter, routers);
+		}
+		return routers;
+	}
+
+	void DHTTable::FindClosest (const IdentHash& h, size_t num, DHTNode * root, int level, const Filter& filter,
+		std::vector<std::shared_ptr<RouterInfo> >& routers) const
+	{
+		if (root->router)
+		{
+			if (!filter || filter (root->router))
+				routers.push_back (root->router);
+			return;
+		}
+		bool bit = GetBit (h, level);
+		DHTNode * first = bit ? root->one : root->zero, * second = bit ? root->zero : root->one;
+		if (first)
+			FindClosest (h, num, first, level + 1, filter, routers);
+		if (second && routers.size () < num)
+			FindClosest (h, num, second, level + 1, filter, routers);
+	}
+
+	void DHTTable::Cleanup (const Filter& filter)
+	{
+		if (filter) Cleanup (m_Root, filter);
+	}
+
+	void DHTTable::Cleanup (DHTNode * root, const Filter& filter)
+	{
+		if (root->router)
+		{
+			if (!filter (root->router))
+			{
+				root->router = nullptr;
+				m_Size--;
+			}
+			return;
+		}
+		for (auto child: { &root->zero, &root->one })
+		{
+			if (!*child) continue;
+			Cleanup (*child, filter);
+			if ((*child)->IsEmpty ())
+			{
+				delete *child;
+				*child = nullptr;
+			}
+		}
+		if (root->zero && !root->one && root->zero->router)
+			root->MoveRouterUp (false);
+		else if (root->one && !root->zero && root->one->router)
+			root->MoveRouterUp (true);
+	}
+}
+}
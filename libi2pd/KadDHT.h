@@ -0,0 +1,74 @@
+/*
+* Copyright (c) 2013-2020, The PurpleI2P Project
+*
+* This file is part of Purple i2pd project and licensed under BSD3
+*
+* See full license text in LICENSE file at top of project tree
+*/
+
+#ifndef KADDHT_H__
+#define KADDHT_H__
+
+#include <memory>
+#include <vector>
+#include <functional>
+#include "RouterInfo.h"
+
+// Kademlia DHT (XOR distance)
+
+namespace i2p
+{
+namespace data
+{
+	struct DHTNode
+	{
+		DHTNode * zero, * one;
+		std::shared_ptr<RouterInfo> router;
+
+		DHTNode (): zero (nullptr), one (nullptr) {};
+		~DHTNode ();
+
+		bool IsEmpty () const { return !zero && !one && !router; };
+		void MoveRouterUp (bool fromOne);
+	};
+
+	/** @brief binary trie of routers by ident hash, nearest-first traversal by XOR metric */
+	class DHTTable
+	{
+		public:
+
+			typedef std::function<bool (const std::shared_ptr<RouterInfo>&)> Filter;
+
+			DHTTable ();
+			~DHTTable ();
+
+			DHTTable (const DHTTable&) = delete;
+			DHTTable& operator= (const DHTTable&) = delete;
+
+			void Insert (const std::shared_ptr<RouterInfo>& r);
+			bool Remove (const IdentHash& h);
+			std::shared_ptr<RouterInfo> FindClosest (const IdentHash& h, const Filter& filter = nullptr) const;
+			std::vector<std::shared_ptr<RouterInfo> > FindClosest (const IdentHash& h, size_t num, const Filter& filter = nullptr) const;
+
+			void Cleanup (const Filter& filter); // remove routers filter returns false for
+			void Clear ();
+			size_t GetSize () const { return m_Size; };
+
+		private:
+
+			void Insert (const std::shared_ptr<RouterInfo>& r, DHTNode * root, int level); // recursive
+			bool Remove (const IdentHash& h, DHTNode * root, int level);
+			std::shared_ptr<RouterInfo> FindClosest (const IdentHash& h, DHTNode * root, int level, const Filter& filter) const;
+			void FindClosest (const IdentHash& h, size_t num, DHTNode * root, int level, const Filter& filter,
+				std::vector<std::shared_ptr<RouterInfo> >& hashes) const;
+			void Cleanup (DHTNode * root, const Filter& filter);
+
+		private:
+
+			DHTNode * m_Root;
+			size_t m_Size;
+	};
+}
+}
+
+#endif
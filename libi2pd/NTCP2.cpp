@@ -13,6 +13,7 @@
 #include <stdlib.h>
 #include <vector>
 #include "Log.h"
+#include "Config.h"
 #include "I2PEndian.h"
 #include "Crypto.h"
 #include "Siphash.h"
@@ -353,15 +354,16 @@ namespace transport
 
 	NTCP2Session::NTCP2Session (NTCP2Server& server, std::shared_ptr<const i2p::data::RouterInfo> in_RemoteRouter):
 		TransportSession (in_RemoteRouter, NTCP2_ESTABLISH_TIMEOUT),
-		m_Server (server), m_Socket (m_Server.GetService ()),
+		m_Server (server), m_Worker (server.GetWorker (in_RemoteRouter)),
+		m_Service (m_Worker ? m_Worker->GetService () : server.GetService ()), m_Socket (m_Service),
 		m_IsEstablished (false), m_IsTerminated (false),
 		m_Establisher (new NTCP2Establisher),
 		m_SendSipKey (nullptr), m_ReceiveSipKey (nullptr),
 #if OPENSSL_SIPHASH
 		m_SendMDCtx(nullptr), m_ReceiveMDCtx (nullptr),
 #endif
-		m_NextReceivedLen (0), m_NextReceivedBuffer (nullptr), m_NextSendBuffer (nullptr),
-		m_ReceiveSequenceNumber (0), m_SendSequenceNumber (0), m_IsSending (false)
+		m_NextReceivedLen (0), m_ReceiveBuffer (nullptr), m_ReceiveBufferOffset (0), m_ReceiveBufferLen (0), m_SendBufferSize (0),
+		m_ReceiveSequenceNumber (0), m_SendSequenceNumber (0), m_IsSending (false), m_IsSendingI2NPMsgs (false), m_IsRouterInfoPending (false)
 	{
 		if (in_RemoteRouter) // Alice
 		{
@@ -375,12 +377,13 @@ namespace transport
 			else
 				LogPrint (eLogWarning, "NTCP2: Missing NTCP2 parameters");
 		}
+		if (m_Worker) m_Worker->SessionCreated ();
 	}
 
 	NTCP2Session::~NTCP2Session ()
 	{
-		delete[] m_NextReceivedBuffer;
-		delete[] m_NextSendBuffer;
+		if (m_Worker) m_Worker->SessionDeleted ();
+		delete[] m_ReceiveBuffer;
 #if OPENSSL_SIPHASH
 		if (m_SendSipKey) EVP_PKEY_free (m_SendSipKey);
 		if (m_ReceiveSipKey) EVP_PKEY_free (m_ReceiveSipKey);
@@ -414,7 +417,7 @@ namespace transport
 
 	void NTCP2Session::Done ()
 	{
-		m_Server.GetService ().post (std::bind (&NTCP2Session::Terminate, shared_from_this ()));
+		m_Service.post (std::bind (&NTCP2Session::Terminate, shared_from_this ()));
 	}
 
 	void NTCP2Session::Established ()
@@ -425,6 +428,13 @@ namespace transport
 		transports.PeerConnected (shared_from_this ());
 	}
 
+	void NTCP2Session::SetTerminationTimeout (int terminationTimeout)
+	{
+		bool reduced = terminationTimeout < GetTerminationTimeout ();
+		TransportSession::SetTerminationTimeout (terminationTimeout);
+		if (reduced) m_Server.RescheduleTermination (shared_from_this ());
+	}
+
 	void NTCP2Session::CreateNonce (uint64_t seqn, uint8_t * nonce)
 	{
 		memset (nonce, 0, 4);
@@ -759,59 +769,24 @@ namespace transport
 
 	void NTCP2Session::ReceiveLength ()
 	{
-		if (IsTerminated ()) return;
-		boost::asio::async_read (m_Socket, boost::asio::buffer(&m_NextReceivedLen, 2), boost::asio::transfer_all (),
-			std::bind(&NTCP2Session::HandleReceivedLength, shared_from_this (), std::placeholders::_1, std::placeholders::_2));
-	}
-
-	void NTCP2Session::HandleReceivedLength (const boost::system::error_code& ecode, std::size_t bytes_transferred)
-	{
-		if (ecode)
-		{
-			if (ecode != boost::asio::error::operation_aborted)
-				LogPrint (eLogWarning, "NTCP2: receive length read error: ", ecode.message ());
-			Terminate ();
-		}
-		else
-		{
-#if OPENSSL_SIPHASH
-			EVP_DigestSignInit (m_ReceiveMDCtx, nullptr, nullptr, nullptr, nullptr);
-			EVP_DigestSignUpdate (m_ReceiveMDCtx, m_ReceiveIV.buf, 8);
-			size_t l = 8;
-			EVP_DigestSignFinal (m_ReceiveMDCtx, m_ReceiveIV.buf, &l);
-#else
-			i2p::crypto::Siphash<8> (m_ReceiveIV.buf, m_ReceiveIV.buf, 8, m_ReceiveSipKey);
-#endif
-			// m_NextReceivedLen comes from the network in BigEndian
-			m_NextReceivedLen = be16toh (m_NextReceivedLen) ^ le16toh (m_ReceiveIV.key);
-			LogPrint (eLogDebug, "NTCP2: received length ", m_NextReceivedLen);
-			if (m_NextReceivedLen >= 16)
-			{
-				if (m_NextReceivedBuffer) delete[] m_NextReceivedBuffer;
-				m_NextReceivedBuffer = new uint8_t[m_NextReceivedLen];
-				boost::system::error_code ec;
-				size_t moreBytes = m_Socket.available(ec);
-				if (!ec && moreBytes >= m_NextReceivedLen)
-				{
-					// read and process message immediately if available
-					moreBytes = boost::asio::read (m_Socket, boost::asio::buffer(m_NextReceivedBuffer, m_NextReceivedLen), boost::asio::transfer_all (), ec);
-					HandleReceived (ec, moreBytes);
-				}
-				else
-					Receive ();
-			}
-			else
-			{
-				LogPrint (eLogError, "NTCP2: received length ", m_NextReceivedLen, " is too short");
-				Terminate ();
-			}
-		}
+		// data phase starts
+		if (!m_ReceiveBuffer) m_ReceiveBuffer = new uint8_t[NTCP2_RECEIVE_BUFFER_SIZE];
+		m_ReceiveBufferOffset = 0; m_ReceiveBufferLen = 0; m_NextReceivedLen = 0;
+		Receive ();
 	}
 
 	void NTCP2Session::Receive ()
 	{
 		if (IsTerminated ()) return;
-		boost::asio::async_read (m_Socket, boost::asio::buffer(m_NextReceivedBuffer, m_NextReceivedLen), boost::asio::transfer_all (),
+		if (m_ReceiveBufferOffset > 0)
+		{
+			// move incomplete frame to the beginning
+			m_ReceiveBufferLen -= m_ReceiveBufferOffset;
+			if (m_ReceiveBufferLen > 0)
+				memmove (m_ReceiveBuffer, m_ReceiveBuffer + m_ReceiveBufferOffset, m_ReceiveBufferLen);
+			m_ReceiveBufferOffset = 0;
+		}
+		m_Socket.async_read_some (boost::asio::buffer(m_ReceiveBuffer + m_ReceiveBufferLen, NTCP2_RECEIVE_BUFFER_SIZE - m_ReceiveBufferLen),
 			std::bind(&NTCP2Session::HandleReceived, shared_from_this (), std::placeholders::_1, std::placeholders::_2));
 	}
 
@@ -822,27 +797,57 @@ namespace transport
 			if (ecode != boost::asio::error::operation_aborted)
 				LogPrint (eLogWarning, "NTCP2: receive read error: ", ecode.message ());
 			Terminate ();
+			return;
 		}
-		else
+		m_LastActivityTimestamp = i2p::util::GetSecondsSinceEpoch ();
+		m_NumReceivedBytes += bytes_transferred;
+		if (m_Worker) m_Worker->UpdateReceivedBytes (bytes_transferred);
+		i2p::transport::transports.UpdateReceivedBytes (bytes_transferred);
+		m_ReceiveBufferLen += bytes_transferred;
+		// process all complete frames
+		while (!IsTerminated ())
 		{
-			m_LastActivityTimestamp = i2p::util::GetSecondsSinceEpoch ();
-			m_NumReceivedBytes += bytes_transferred + 2; // + length
-			i2p::transport::transports.UpdateReceivedBytes (bytes_transferred);
+			if (!m_NextReceivedLen)
+			{
+				if (m_ReceiveBufferLen - m_ReceiveBufferOffset < 2) break;
+#if OPENSSL_SIPHASH
+				EVP_DigestSignInit (m_ReceiveMDCtx, nullptr, nullptr, nullptr, nullptr);
+				EVP_DigestSignUpdate (m_ReceiveMDCtx, m_ReceiveIV.buf, 8);
+				size_t l = 8;
+				EVP_DigestSignFinal (m_ReceiveMDCtx, m_ReceiveIV.buf, &l);
+#else
+				i2p::crypto::Siphash<8> (m_ReceiveIV.buf, m_ReceiveIV.buf, 8, m_ReceiveSipKey);
+#endif
+				// length comes from the network in BigEndian
+				m_NextReceivedLen = bufbe16toh (m_ReceiveBuffer + m_ReceiveBufferOffset) ^ le16toh (m_ReceiveIV.key);
+				m_ReceiveBufferOffset += 2;
+				LogPrint (eLogDebug, "NTCP2: received length ", m_NextReceivedLen);
+				if (m_NextReceivedLen < 16)
+				{
+					LogPrint (eLogError, "NTCP2: received length ", m_NextReceivedLen, " is too short");
+					Terminate ();
+					return;
+				}
+			}
+			if (m_ReceiveBufferLen - m_ReceiveBufferOffset < m_NextReceivedLen) break; // incomplete frame
+			uint8_t * frame = m_ReceiveBuffer + m_ReceiveBufferOffset;
 			uint8_t nonce[12];
 			CreateNonce (m_ReceiveSequenceNumber, nonce); m_ReceiveSequenceNumber++;
-			if (i2p::crypto::AEADChaCha20Poly1305 (m_NextReceivedBuffer, m_NextReceivedLen-16, nullptr, 0, m_ReceiveKey, nonce, m_NextReceivedBuffer, m_NextReceivedLen, false))
+			if (i2p::crypto::AEADChaCha20Poly1305 (frame, m_NextReceivedLen-16, nullptr, 0, m_ReceiveKey, nonce, frame, m_NextReceivedLen, false))
 			{
 				LogPrint (eLogDebug, "NTCP2: received message decrypted");
-				ProcessNextFrame (m_NextReceivedBuffer, m_NextReceivedLen-16);
-				delete[] m_NextReceivedBuffer; m_NextReceivedBuffer = nullptr; // we don't need received buffer anymore
-				ReceiveLength ();
+				ProcessNextFrame (frame, m_NextReceivedLen-16);
+				m_ReceiveBufferOffset += m_NextReceivedLen;
+				m_NextReceivedLen = 0;
 			}
 			else
 			{
 				LogPrint (eLogWarning, "NTCP2: Received AEAD verification failed ");
 				SendTerminationAndTerminate (eNTCP2DataPhaseAEADFailure);
+				return;
 			}
 		}
+		Receive ();
 	}
 
 	void NTCP2Session::ProcessNextFrame (const uint8_t * frame, size_t len)
@@ -925,13 +930,38 @@ namespace transport
 		LogPrint (eLogDebug, "NTCP2: sent length ", frameLen);
 	}
 
-	void NTCP2Session::SendI2NPMsgs (std::vector<std::shared_ptr<I2NPMessage> >& msgs)
+	template<typename T>
+	void NTCP2Session::ReserveSendArena (std::vector<T>& v, size_t num)
+	{
+		if (v.capacity () < num)
+		{
+			v.reserve (std::max (num, 2*v.capacity ()));
+			m_Server.SendArenaAllocated ();
+		}
+	}
+
+	uint8_t * NTCP2Session::GetSendBuffer (size_t len)
+	{
+		if (m_SendBufferSize < len)
+		{
+			m_SendBuffer.reset (new uint8_t[len]);
+			m_SendBufferSize = len;
+			m_Server.SendArenaAllocated ();
+		}
+		return m_SendBuffer.get ();
+	}
+
+	void NTCP2Session::SendI2NPMsgs ()
 	{
+		auto& msgs = m_SendMsgs;
 		if (msgs.empty () || IsTerminated ()) return;
 
 		size_t totalLen = 0;
-		std::vector<std::pair<uint8_t *, size_t> > encryptBufs;
-		std::vector<boost::asio::const_buffer> bufs;
+		auto& encryptBufs = m_SendEncryptBufs;
+		auto& bufs = m_SendBufs;
+		encryptBufs.clear (); bufs.clear ();
+		ReserveSendArena (encryptBufs, 2*msgs.size () + 1); // message blocks and up to two padding blocks
+		ReserveSendArena (bufs, msgs.size () + 1);
 		std::shared_ptr<I2NPMessage> first;
 		uint8_t * macBuf = nullptr;
 		for (auto& it: msgs)
@@ -973,15 +1003,13 @@ namespace transport
 
 		if (!macBuf) // last block was not enough for MAC
 		{
-			// allocate send buffer
-			m_NextSendBuffer = new uint8_t[287]; // can be any size > 16, we just allocate 287 frequently
-			// crate padding block
-			auto paddingLen = CreatePaddingBlock (totalLen, m_NextSendBuffer, 287 - 16);
+			// crate padding block in session's padding slab
+			auto paddingLen = CreatePaddingBlock (totalLen, m_SendPaddingBuffer, NTCP2_SEND_PADDING_BUFFER_SIZE - 16);
 			// and padding block to encrypt and send
 			if (paddingLen)
-				encryptBufs.push_back ( {m_NextSendBuffer, paddingLen} );
-			bufs.push_back (boost::asio::buffer (m_NextSendBuffer, paddingLen + 16));
-			macBuf = m_NextSendBuffer + paddingLen;
+				encryptBufs.push_back ( {m_SendPaddingBuffer, paddingLen} );
+			bufs.push_back (boost::asio::buffer (m_SendPaddingBuffer, paddingLen + 16));
+			macBuf = m_SendPaddingBuffer + paddingLen;
 			totalLen += paddingLen;
 		}
 		uint8_t nonce[12];
@@ -990,39 +1018,40 @@ namespace transport
 		SetNextSentFrameLength (totalLen + 16, first->GetNTCP2Header () - 5); // frame length right before first block
 
 		// send buffers
-		m_IsSending = true;
+		m_IsSending = true; m_IsSendingI2NPMsgs = true;
+		m_Server.FrameSent ();
 		boost::asio::async_write (m_Socket, bufs, boost::asio::transfer_all (),
-			std::bind(&NTCP2Session::HandleI2NPMsgsSent, shared_from_this (), std::placeholders::_1, std::placeholders::_2, msgs));
+			std::bind(&NTCP2Session::HandleI2NPMsgsSent, shared_from_this (), std::placeholders::_1, std::placeholders::_2));
 	}
 
-	void NTCP2Session::HandleI2NPMsgsSent (const boost::system::error_code& ecode, std::size_t bytes_transferred, std::vector<std::shared_ptr<I2NPMessage> > msgs)
+	void NTCP2Session::HandleI2NPMsgsSent (const boost::system::error_code& ecode, std::size_t bytes_transferred)
 	{
+		m_SendMsgs.clear (); // msgs get destroyed here
+		m_IsSendingI2NPMsgs = false;
 		HandleNextFrameSent (ecode, bytes_transferred);
-		// msgs get destroyed here
 	}
 
-	void NTCP2Session::EncryptAndSendNextBuffer (size_t payloadLen)
+	void NTCP2Session::EncryptAndSendNextBuffer (uint8_t * buf, size_t payloadLen)
 	{
-		if (IsTerminated ())
-		{
-			delete[] m_NextSendBuffer; m_NextSendBuffer = nullptr;
-			return;
-		}
+		if (IsTerminated ()) return;
 		// encrypt
 		uint8_t nonce[12];
 		CreateNonce (m_SendSequenceNumber, nonce); m_SendSequenceNumber++;
-		i2p::crypto::AEADChaCha20Poly1305Encrypt ({ {m_NextSendBuffer + 2, payloadLen} }, m_SendKey, nonce, m_NextSendBuffer + payloadLen + 2);
-		SetNextSentFrameLength (payloadLen + 16, m_NextSendBuffer);
+		m_SendEncryptBufs.clear ();
+		ReserveSendArena (m_SendEncryptBufs, 1);
+		m_SendEncryptBufs.push_back ({buf + 2, payloadLen});
+		i2p::crypto::AEADChaCha20Poly1305Encrypt (m_SendEncryptBufs, m_SendKey, nonce, buf + payloadLen + 2);
+		SetNextSentFrameLength (payloadLen + 16, buf);
 		// send
 		m_IsSending = true;
-		boost::asio::async_write (m_Socket, boost::asio::buffer (m_NextSendBuffer, payloadLen + 16 + 2), boost::asio::transfer_all (),
+		m_Server.FrameSent ();
+		boost::asio::async_write (m_Socket, boost::asio::buffer (buf, payloadLen + 16 + 2), boost::asio::transfer_all (),
 			std::bind(&NTCP2Session::HandleNextFrameSent, shared_from_this (), std::placeholders::_1, std::placeholders::_2));
 	}
 
 	void NTCP2Session::HandleNextFrameSent (const boost::system::error_code& ecode, std::size_t bytes_transferred)
 	{
-		m_IsSending = false;
-		delete[] m_NextSendBuffer; m_NextSendBuffer = nullptr;
+		m_IsSending = m_IsSendingI2NPMsgs; // RouterInfo or termination frame might complete while I2NP frame is still being sent
 
 		if (ecode)
 		{
@@ -1034,17 +1063,27 @@ namespace transport
 		{
 			m_LastActivityTimestamp = i2p::util::GetSecondsSinceEpoch ();
 			m_NumSentBytes += bytes_transferred;
+			if (m_Worker) m_Worker->UpdateSentBytes (bytes_transferred);
 			i2p::transport::transports.UpdateSentBytes (bytes_transferred);
 			LogPrint (eLogDebug, "NTCP2: Next frame sent ", bytes_transferred);
-			SendQueue ();
+			if (m_IsRouterInfoPending)
+			{
+				if (!m_IsSending) SendRouterInfo (); // otherwise after I2NP frame
+			}
+			else
+				SendQueue ();
 		}
 	}
 
 	void NTCP2Session::SendQueue ()
 	{
+		if (m_IsSendingI2NPMsgs) return; // called again when previous frame is sent
 		if (!m_SendQueue.empty ())
 		{
-			std::vector<std::shared_ptr<I2NPMessage> > msgs;
+			// pack queued messages into one frame
+			auto& msgs = m_SendMsgs;
+			msgs.clear ();
+			ReserveSendArena (msgs, m_SendQueue.size ());
 			size_t s = 0;
 			while (!m_SendQueue.empty ())
 			{
@@ -1064,7 +1103,7 @@ namespace transport
 				else
 					break;
 			}
-			SendI2NPMsgs (msgs);
+			SendI2NPMsgs ();
 		}
 	}
 
@@ -1086,69 +1125,80 @@ namespace transport
 	void NTCP2Session::SendRouterInfo ()
 	{
 		if (!IsEstablished ()) return;
+		if (m_IsSending)
+		{
+			// don't overwrite m_SendBuffer or interleave frames
+			m_IsRouterInfoPending = true;
+			return;
+		}
+		m_IsRouterInfoPending = false;
 		auto riLen = i2p::context.GetRouterInfo ().GetBufferLen ();
 		size_t payloadLen = riLen + 4; // 3 bytes block header + 1 byte RI flag
-		m_NextSendBuffer = new uint8_t[payloadLen + 16 + 2 + 64]; // up to 64 bytes padding
-		m_NextSendBuffer[2] = eNTCP2BlkRouterInfo;
-		htobe16buf (m_NextSendBuffer + 3, riLen + 1); // size
-		m_NextSendBuffer[5] = 0; // flag
-		memcpy (m_NextSendBuffer + 6, i2p::context.GetRouterInfo ().GetBuffer (), riLen);
+		auto buf = GetSendBuffer (payloadLen + 16 + 2 + 64); // up to 64 bytes padding
+		buf[2] = eNTCP2BlkRouterInfo;
+		htobe16buf (buf + 3, riLen + 1); // size
+		buf[5] = 0; // flag
+		memcpy (buf + 6, i2p::context.GetRouterInfo ().GetBuffer (), riLen);
 		// padding block
-		auto paddingSize = CreatePaddingBlock (payloadLen, m_NextSendBuffer + 2 + payloadLen, 64);
+		auto paddingSize = CreatePaddingBlock (payloadLen, buf + 2 + payloadLen, 64);
 		payloadLen += paddingSize;
 		// encrypt and send
-		EncryptAndSendNextBuffer (payloadLen);
+		EncryptAndSendNextBuffer (buf, payloadLen);
 	}
 
 	void NTCP2Session::SendTermination (NTCP2TerminationReason reason)
 	{
 		if (!m_SendKey || !m_SendSipKey) return;
-		m_NextSendBuffer = new uint8_t[49]; // 49 = 12 bytes message + 16 bytes MAC + 2 bytes size + up to 19 padding block
+		auto buf = m_TerminationBuffer; // 49 = 12 bytes message + 16 bytes MAC + 2 bytes size + up to 19 padding block
 		// termination block
-		m_NextSendBuffer[2] = eNTCP2BlkTermination;
-		m_NextSendBuffer[3] = 0; m_NextSendBuffer[4] = 9; // 9 bytes block size
-		htobe64buf (m_NextSendBuffer + 5, m_ReceiveSequenceNumber);
-		m_NextSendBuffer[13] = (uint8_t)reason;
+		buf[2] = eNTCP2BlkTermination;
+		buf[3] = 0; buf[4] = 9; // 9 bytes block size
+		htobe64buf (buf + 5, m_ReceiveSequenceNumber);
+		buf[13] = (uint8_t)reason;
 		// padding block
-		auto paddingSize = CreatePaddingBlock (12, m_NextSendBuffer + 14, 19);
+		auto paddingSize = CreatePaddingBlock (12, buf + 14, 19);
 		// encrypt and send
-		EncryptAndSendNextBuffer (paddingSize + 12);
+		EncryptAndSendNextBuffer (buf, paddingSize + 12);
 	}
 
 	void NTCP2Session::SendTerminationAndTerminate (NTCP2TerminationReason reason)
 	{
 		SendTermination (reason);
-		m_Server.GetService ().post (std::bind (&NTCP2Session::Terminate, shared_from_this ())); // let termination message go
+		m_Service.post (std::bind (&NTCP2Session::Terminate, shared_from_this ())); // let termination message go
 	}
 
-	void NTCP2Session::SendI2NPMessages (const std::vector<std::shared_ptr<I2NPMessage> >& msgs)
+	void NTCP2Session::ScheduleOutgoingQueue ()
 	{
-		m_Server.GetService ().post (std::bind (&NTCP2Session::PostI2NPMessages, shared_from_this (), msgs));
+		m_Service.post (std::bind (&NTCP2Session::PostI2NPMessages, shared_from_this ()));
 	}
 
-	void NTCP2Session::PostI2NPMessages (std::vector<std::shared_ptr<I2NPMessage> > msgs)
+	void NTCP2Session::PostI2NPMessages ()
 	{
+		auto msgs = GetOutgoingMessages ();
 		if (m_IsTerminated) return;
-		for (auto it: msgs)
-			m_SendQueue.push_back (it);
-		if (!m_IsSending)
-			SendQueue ();
-		else if (m_SendQueue.size () > NTCP2_MAX_OUTGOING_QUEUE_SIZE)
+		if (m_IsSending && m_SendQueue.size () + msgs.size () > NTCP2_MAX_OUTGOING_QUEUE_SIZE)
 		{
 			LogPrint (eLogWarning, "NTCP2: outgoing messages queue size to ", 
 			   	GetIdentHashBase64(), " exceeds ",  NTCP2_MAX_OUTGOING_QUEUE_SIZE);
 			Terminate ();
+			return;
 		}
+		transports.GetTrafficShaper ().Shape (msgs); // only messages that will be sent take tokens
+		for (auto it: msgs)
+			m_SendQueue.push_back (it);
+		if (!m_IsSending)
+			SendQueue ();
 	}
 
 	void NTCP2Session::SendLocalRouterInfo ()
 	{
 		if (!IsOutgoing ()) // we send it in SessionConfirmed
-			m_Server.GetService ().post (std::bind (&NTCP2Session::SendRouterInfo, shared_from_this ()));
+			m_Service.post (std::bind (&NTCP2Session::SendRouterInfo, shared_from_this ()));
 	}
 
 	NTCP2Server::NTCP2Server ():
-		RunnableServiceWithWork ("NTCP2"), m_TerminationTimer (GetService ()),
+		RunnableServiceWithWork ("NTCP2"), m_TerminationTimer (GetService ()), m_NextWorker (0),
+		m_NumSentFrames (0), m_NumSendArenaAllocations (0),
 		 m_ProxyType(eNoProxy), m_Resolver(GetService ())
 	{
 	}
@@ -1163,6 +1213,18 @@ namespace transport
 		if (!IsRunning ())
 		{
 			StartIOService ();
+			if (m_Workers.empty ())
+			{
+				uint16_t numThreads; i2p::config::GetOption("ntcp2.threads", numThreads);
+				if (numThreads > NTCP2_MAX_NUM_THREADS) numThreads = NTCP2_MAX_NUM_THREADS;
+				if (numThreads > 1)
+					for (int i = 0; i < numThreads; i++)
+						m_Workers.emplace_back (new NTCP2Worker (i));
+			}
+			for (auto& it: m_Workers)
+				it->Start ();
+			if (!m_Workers.empty ())
+				LogPrint (eLogInfo, "NTCP2: ", m_Workers.size (), " I/O threads started");
 			if(UsingProxy())
 			{
 				LogPrint(eLogInfo, "NTCP2: Using proxy to connect to peers");
@@ -1238,13 +1300,23 @@ namespace transport
 	{
 		{
 			// we have to copy it because Terminate changes m_NTCP2Sessions
-			auto ntcpSessions = m_NTCP2Sessions;
+			auto ntcpSessions = GetNTCP2Sessions ();
+			decltype(m_PendingIncomingSessions) pendingSessions;
+			{
+				std::unique_lock<std::mutex> l(m_NTCP2SessionsMutex);
+				pendingSessions = m_PendingIncomingSessions;
+			}
 			for (auto& it: ntcpSessions)
 				it.second->Terminate ();
-			for (auto& it: m_PendingIncomingSessions)
+			for (auto& it: pendingSessions)
 				it->Terminate ();
 		}
-		m_NTCP2Sessions.clear ();
+		{
+			std::unique_lock<std::mutex> l(m_NTCP2SessionsMutex);
+			m_NTCP2Sessions.clear ();
+			m_PendingIncomingSessions.clear ();
+			m_TerminationWheel.Clear ();
+		}
 
 		if (IsRunning ())
 		{
@@ -1252,51 +1324,82 @@ namespace transport
 			m_ProxyEndpoint = nullptr;
 		}
 		StopIOService ();
+		for (auto& it: m_Workers) // sessions might still refer to workers
+			it->Stop ();
 	}
 
 	bool NTCP2Server::AddNTCP2Session (std::shared_ptr<NTCP2Session> session, bool incoming)
 	{
 		if (!session) return false;
-		if (incoming)
-			m_PendingIncomingSessions.remove (session);
-		if (!session->GetRemoteIdentity ()) return false;
-		auto& ident = session->GetRemoteIdentity ()->GetIdentHash ();
-		auto it = m_NTCP2Sessions.find (ident);
-		if (it != m_NTCP2Sessions.end ())
+		std::shared_ptr<NTCP2Session> replaced;
 		{
-			LogPrint (eLogWarning, "NTCP2: session to ", ident.ToBase64 (), " already exists");
+			std::unique_lock<std::mutex> l(m_NTCP2SessionsMutex);
 			if (incoming)
-				// replace by new session
-				it->second->Terminate ();
+				m_PendingIncomingSessions.remove (session);
+			if (!session->GetRemoteIdentity ()) return false;
+			auto& ident = session->GetRemoteIdentity ()->GetIdentHash ();
+			auto it = m_NTCP2Sessions.find (ident);
+			if (it != m_NTCP2Sessions.end ())
+			{
+				LogPrint (eLogWarning, "NTCP2: session to ", ident.ToBase64 (), " already exists");
+				if (incoming)
+				{
+					// replace by new session
+					replaced = it->second;
+					it->second = session;
+				}
+				else
+					return false;
+			}
 			else
-				return false;
+				m_NTCP2Sessions.insert (std::make_pair (ident, session));
+			if (!incoming) // incoming is in the wheel since accepted
+				AddToTerminationWheel (session);
 		}
-		m_NTCP2Sessions.insert (std::make_pair (ident, session));
+		if (replaced)
+			replaced->GetService ().post (std::bind (&NTCP2Session::Terminate, replaced));
 		return true;
 	}
 
 	void NTCP2Server::RemoveNTCP2Session (std::shared_ptr<NTCP2Session> session)
 	{
 		if (session && session->GetRemoteIdentity ())
-			m_NTCP2Sessions.erase (session->GetRemoteIdentity ()->GetIdentHash ());
+		{
+			std::unique_lock<std::mutex> l(m_NTCP2SessionsMutex);
+			auto it = m_NTCP2Sessions.find (session->GetRemoteIdentity ()->GetIdentHash ());
+			if (it != m_NTCP2Sessions.end () && it->second == session) // might be replaced already
+				m_NTCP2Sessions.erase (it);
+		}
 	}
 
 	std::shared_ptr<NTCP2Session> NTCP2Server::FindNTCP2Session (const i2p::data::IdentHash& ident)
 	{
+		std::unique_lock<std::mutex> l(m_NTCP2SessionsMutex);
 		auto it = m_NTCP2Sessions.find (ident);
 		if (it != m_NTCP2Sessions.end ())
 			return it->second;
 		return nullptr;
 	}
 
+	NTCP2Worker * NTCP2Server::GetWorker (std::shared_ptr<const i2p::data::RouterInfo> remoteRouter)
+	{
+		if (m_Workers.empty ()) return nullptr;
+		size_t ind;
+		if (remoteRouter)
+			ind = remoteRouter->GetIdentHash ().GetLL ()[0] % m_Workers.size ();
+		else
+			ind = m_NextWorker++ % m_Workers.size ();
+		return m_Workers[ind].get ();
+	}
+
 	void NTCP2Server::Connect(const boost::asio::ip::address & address, uint16_t port, std::shared_ptr<NTCP2Session> conn)
 	{
 		LogPrint (eLogDebug, "NTCP2: Connecting to ", address ,":",  port);
-		GetService ().post([this, address, port, conn]()
+		conn->GetService ().post([this, address, port, conn]()
 			{
 				if (this->AddNTCP2Session (conn))
 				{
-					auto timer = std::make_shared<boost::asio::deadline_timer>(GetService ());
+					auto timer = std::make_shared<boost::asio::deadline_timer>(conn->GetService ());
 					auto timeout = NTCP2_CONNECT_TIMEOUT * 5;
 					conn->SetTerminationTimeout(timeout * 2);
 					timer->expires_from_now (boost::posix_time::seconds(timeout));
@@ -1342,8 +1445,10 @@ namespace transport
 				LogPrint (eLogDebug, "NTCP2: Connected from ", ep);
 				if (conn)
 				{
-					conn->ServerLogin ();
+					conn->GetService ().post (std::bind (&NTCP2Session::ServerLogin, conn));
+					std::unique_lock<std::mutex> l(m_NTCP2SessionsMutex);
 					m_PendingIncomingSessions.push_back (conn);
+					AddToTerminationWheel (conn);
 					conn = nullptr;
 				}
 			}
@@ -1375,8 +1480,10 @@ namespace transport
 				LogPrint (eLogDebug, "NTCP2: Connected from ", ep);
 				if (conn)
 				{
-					conn->ServerLogin ();
+					conn->GetService ().post (std::bind (&NTCP2Session::ServerLogin, conn));
+					std::unique_lock<std::mutex> l(m_NTCP2SessionsMutex);
 					m_PendingIncomingSessions.push_back (conn);
+					AddToTerminationWheel (conn);
 				}
 			}
 			else
@@ -1391,6 +1498,20 @@ namespace transport
 		}
 	}
 
+	void NTCP2Server::RescheduleTermination (std::shared_ptr<NTCP2Session> session)
+	{
+		std::unique_lock<std::mutex> l(m_NTCP2SessionsMutex);
+		// the wheel entry at previous termination time is skipped
+		if (session->GetTerminationTime () < session->GetTerminationCheckTime ())
+			AddToTerminationWheel (session);
+	}
+
+	void NTCP2Server::AddToTerminationWheel (std::shared_ptr<NTCP2Session> session)
+	{
+		session->SetTerminationCheckTime (session->GetTerminationTime ());
+		m_TerminationWheel.Add (session, session->GetTerminationCheckTime ());
+	}
+
 	void NTCP2Server::ScheduleTermination ()
 	{
 		m_TerminationTimer.expires_from_now (boost::posix_time::seconds(NTCP2_TERMINATION_CHECK_TIMEOUT));
@@ -1403,27 +1524,29 @@ namespace transport
 		if (ecode != boost::asio::error::operation_aborted)
 		{
 			auto ts = i2p::util::GetSecondsSinceEpoch ();
-			// established
-			for (auto& it: m_NTCP2Sessions)
-				if (it.second->IsTerminationTimeoutExpired (ts))
-				{
-					auto session = it.second;
-					LogPrint (eLogDebug, "NTCP2: No activity for ", session->GetTerminationTimeout (), " seconds");
-					session->TerminateByTimeout (); // it doesn't change m_NTCP2Session right a way
-				}
-			// pending
-			for (auto it = m_PendingIncomingSessions.begin (); it != m_PendingIncomingSessions.end ();)
-			{
-				if ((*it)->IsEstablished () || (*it)->IsTerminationTimeoutExpired (ts))
+			std::unique_lock<std::mutex> l(m_NTCP2SessionsMutex);
+			// only sessions due since previous check, active ones are checked again at their new termination time
+			m_TerminationWheel.Advance (ts, [this, ts](const std::weak_ptr<NTCP2Session>& s)
 				{
-					(*it)->Terminate ();
-					it = m_PendingIncomingSessions.erase (it); // established of expired
-				}
-				else if ((*it)->IsTerminated ())
-					it = m_PendingIncomingSessions.erase (it); // already terminated
-				else
-					it++;
-			}
+					auto session = s.lock ();
+					if (!session || session->GetTerminationCheckTime () > ts) return; // rescheduled, its entry is later
+					session->SetTerminationCheckTime (std::numeric_limits<uint64_t>::max ());
+					if (session->IsTerminated ())
+						m_PendingIncomingSessions.remove (session); // already terminated
+					else if (!session->IsTerminationTimeoutExpired (ts))
+						AddToTerminationWheel (session);
+					else if (session->IsEstablished ())
+					{
+						LogPrint (eLogDebug, "NTCP2: No activity for ", session->GetTerminationTimeout (), " seconds");
+						session->GetService ().post (std::bind (&NTCP2Session::TerminateByTimeout, session)); // it doesn't change m_NTCP2Session right a way
+					}
+					else
+					{
+						m_PendingIncomingSessions.remove (session);
+						session->GetService ().post (std::bind (&NTCP2Session::Terminate, session));
+					}
+				});
+			l.unlock ();
 
 			ScheduleTermination ();
 		}
@@ -1432,11 +1555,11 @@ namespace transport
 	void NTCP2Server::ConnectWithProxy (const std::string& host, uint16_t port, RemoteAddressType addrtype, std::shared_ptr<NTCP2Session> conn)
 	{
 		if(!m_ProxyEndpoint) return;
-		GetService().post([this, host, port, addrtype, conn]() {
+		conn->GetService ().post([this, host, port, addrtype, conn]() {
 			if (this->AddNTCP2Session (conn))
 			{
 
-				auto timer = std::make_shared<boost::asio::deadline_timer>(GetService());
+				auto timer = std::make_shared<boost::asio::deadline_timer>(conn->GetService ());
 				auto timeout = NTCP_CONNECT_TIMEOUT * 5;
 				conn->SetTerminationTimeout(timeout * 2);
 				timer->expires_from_now (boost::posix_time::seconds(timeout));
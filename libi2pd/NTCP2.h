@@ -12,9 +12,12 @@
 #include <inttypes.h>
 #include <memory>
 #include <thread>
+#include <mutex>
+#include <atomic>
 #include <list>
 #include <map>
 #include <array>
+#include <vector>
 #include <openssl/bn.h>
 #include <openssl/evp.h>
 #include <boost/asio.hpp>
@@ -29,6 +32,9 @@ namespace transport
 {
 
 	const size_t NTCP2_UNENCRYPTED_FRAME_MAX_SIZE = 65519;
+	const size_t NTCP2_RECEIVE_BUFFER_SIZE = 2 + 65535; // at least one frame with length
+	const size_t NTCP2_SEND_PADDING_BUFFER_SIZE = 287; // padding and MAC if last message doesn't have room for it
+	const size_t NTCP2_TERMINATION_BUFFER_SIZE = 49; // 12 bytes message + 16 bytes MAC + 2 bytes size + up to 19 padding block
 	const int NTCP2_MAX_PADDING_RATIO = 6; // in %
 
 	const int NTCP2_CONNECT_TIMEOUT = 5; // 5 seconds
@@ -38,6 +44,7 @@ namespace transport
 
 	const int NTCP2_CLOCK_SKEW = 60; // in seconds
 	const int NTCP2_MAX_OUTGOING_QUEUE_SIZE = 500; // how many messages we can queue up
+	const int NTCP2_MAX_NUM_THREADS = 64;
 
 	enum NTCP2BlockType
 	{
@@ -121,6 +128,35 @@ namespace transport
 
 	};
 
+	class NTCP2Worker: private i2p::util::RunnableServiceWithWork
+	{
+		public:
+
+			NTCP2Worker (int index): RunnableServiceWithWork ("NTCP2-" + std::to_string (index)),
+				m_Index (index), m_NumSessions (0), m_NumSentBytes (0), m_NumReceivedBytes (0) {};
+			~NTCP2Worker () { Stop (); };
+
+			void Start () { if (!IsRunning ()) StartIOService (); };
+			void Stop () { StopIOService (); };
+			boost::asio::io_service& GetService () { return GetIOService (); };
+
+			void SessionCreated () { m_NumSessions++; };
+			void SessionDeleted () { m_NumSessions--; };
+			void UpdateSentBytes (uint64_t numBytes) { m_NumSentBytes += numBytes; };
+			void UpdateReceivedBytes (uint64_t numBytes) { m_NumReceivedBytes += numBytes; };
+
+			int GetIndex () const { return m_Index; };
+			int GetNumSessions () const { return m_NumSessions; };
+			uint64_t GetNumSentBytes () const { return m_NumSentBytes; };
+			uint64_t GetNumReceivedBytes () const { return m_NumReceivedBytes; };
+
+		private:
+
+			int m_Index;
+			std::atomic<int> m_NumSessions;
+			std::atomic<uint64_t> m_NumSentBytes, m_NumReceivedBytes;
+	};
+
 	class NTCP2Server;
 	class NTCP2Session: public TransportSession, public std::enable_shared_from_this<NTCP2Session>
 	{
@@ -134,15 +170,16 @@ namespace transport
 			void Close () { m_Socket.close (); }; // for accept
 
 			boost::asio::ip::tcp::socket& GetSocket () { return m_Socket; };
+			boost::asio::io_service& GetService () { return m_Service; }; // all session's handlers are called here
 
 			bool IsEstablished () const { return m_IsEstablished; };
 			bool IsTerminated () const { return m_IsTerminated; };
+			void SetTerminationTimeout (int terminationTimeout);
 
 			void ClientLogin (); // Alice
 			void ServerLogin (); // Bob
 
 			void SendLocalRouterInfo (); // after handshake
-			void SendI2NPMessages (const std::vector<std::shared_ptr<I2NPMessage> >& msgs);
 
 		private:
 
@@ -167,27 +204,32 @@ namespace transport
 			void HandleSessionConfirmedReceived (const boost::system::error_code& ecode, std::size_t bytes_transferred);
 
 			// data
-			void ReceiveLength ();
-			void HandleReceivedLength (const boost::system::error_code& ecode, std::size_t bytes_transferred);
+			void ReceiveLength (); // start data phase
 			void Receive ();
 			void HandleReceived (const boost::system::error_code& ecode, std::size_t bytes_transferred);
 			void ProcessNextFrame (const uint8_t * frame, size_t len);
 
 			void SetNextSentFrameLength (size_t frameLen, uint8_t * lengthBuf);
-			void SendI2NPMsgs (std::vector<std::shared_ptr<I2NPMessage> >& msgs);
-			void HandleI2NPMsgsSent (const boost::system::error_code& ecode, std::size_t bytes_transferred, std::vector<std::shared_ptr<I2NPMessage> > msgs);
-			void EncryptAndSendNextBuffer (size_t payloadLen);
+			template<typename T>
+			void ReserveSendArena (std::vector<T>& v, size_t num);
+			uint8_t * GetSendBuffer (size_t len);
+			void SendI2NPMsgs (); // from m_SendMsgs
+			void HandleI2NPMsgsSent (const boost::system::error_code& ecode, std::size_t bytes_transferred);
+			void EncryptAndSendNextBuffer (uint8_t * buf, size_t payloadLen);
 			void HandleNextFrameSent (const boost::system::error_code& ecode, std::size_t bytes_transferred);
 			size_t CreatePaddingBlock (size_t msgLen, uint8_t * buf, size_t len);
 			void SendQueue ();
 			void SendRouterInfo ();
 			void SendTermination (NTCP2TerminationReason reason);
 			void SendTerminationAndTerminate (NTCP2TerminationReason reason);
-			void PostI2NPMessages (std::vector<std::shared_ptr<I2NPMessage> > msgs);
+			void ScheduleOutgoingQueue ();
+			void PostI2NPMessages ();
 
 		private:
 
 			NTCP2Server& m_Server;
+			NTCP2Worker * m_Worker; // nullptr if server's thread
+			boost::asio::io_service& m_Service;
 			boost::asio::ip::tcp::socket m_Socket;
 			bool m_IsEstablished, m_IsTerminated;
 
@@ -201,8 +243,16 @@ namespace transport
 #else
 			const uint8_t * m_SendSipKey, * m_ReceiveSipKey;
 #endif
-			uint16_t m_NextReceivedLen;
-			uint8_t * m_NextReceivedBuffer, * m_NextSendBuffer;
+			uint16_t m_NextReceivedLen; // 0 if length of next frame is not received yet
+			uint8_t * m_ReceiveBuffer; // frames are decrypted and processed in place
+			size_t m_ReceiveBufferOffset, m_ReceiveBufferLen;
+			// send arena, reused by frames
+			std::unique_ptr<uint8_t[]> m_SendBuffer; // RouterInfo, written only if no other frame is being sent
+			size_t m_SendBufferSize;
+			uint8_t m_SendPaddingBuffer[NTCP2_SEND_PADDING_BUFFER_SIZE], m_TerminationBuffer[NTCP2_TERMINATION_BUFFER_SIZE];
+			std::vector<std::shared_ptr<I2NPMessage> > m_SendMsgs; // being sent
+			std::vector<std::pair<uint8_t *, size_t> > m_SendEncryptBufs;
+			std::vector<boost::asio::const_buffer> m_SendBufs;
 			union
 			{
 				uint8_t buf[8];
@@ -212,7 +262,8 @@ namespace transport
 
 			i2p::I2NPMessagesHandler m_Handler;
 
-			bool m_IsSending;
+			bool m_IsSending, m_IsSendingI2NPMsgs; // m_SendMsgs and m_SendPaddingBuffer are in use by the latter
+			bool m_IsRouterInfoPending; // sent when current frame is sent
 			std::list<std::shared_ptr<I2NPMessage> > m_SendQueue;
 	};
 
@@ -243,7 +294,9 @@ namespace transport
 
 			bool AddNTCP2Session (std::shared_ptr<NTCP2Session> session, bool incoming = false);
 			void RemoveNTCP2Session (std::shared_ptr<NTCP2Session> session);
+			void RescheduleTermination (std::shared_ptr<NTCP2Session> session); // if termination time became earlier
 			std::shared_ptr<NTCP2Session> FindNTCP2Session (const i2p::data::IdentHash& ident);
+			NTCP2Worker * GetWorker (std::shared_ptr<const i2p::data::RouterInfo> remoteRouter); // by ident hash for outgoing, nullptr if single thread
 
 			void ConnectWithProxy (const std::string& addr, uint16_t port, RemoteAddressType addrtype, std::shared_ptr<NTCP2Session> conn);
 			void Connect(const boost::asio::ip::address & address, uint16_t port, std::shared_ptr<NTCP2Session> conn);
@@ -254,6 +307,11 @@ namespace transport
 			bool UsingProxy() const { return m_ProxyType != eNoProxy; };
 			void UseProxy(ProxyType proxy, const std::string & address, uint16_t port);
 
+			void FrameSent () { m_NumSentFrames++; };
+			void SendArenaAllocated () { m_NumSendArenaAllocations++; };
+			uint64_t GetNumSentFrames () const { return m_NumSentFrames; };
+			uint64_t GetNumSendArenaAllocations () const { return m_NumSendArenaAllocations; };
+
 		private:
 
 			void HandleAccept (std::shared_ptr<NTCP2Session> conn, const boost::system::error_code& error);
@@ -263,6 +321,7 @@ namespace transport
 			void HandleProxyConnect(const boost::system::error_code& ecode, std::shared_ptr<NTCP2Session> conn, std::shared_ptr<boost::asio::deadline_timer> timer, const std::string & host, uint16_t port, RemoteAddressType adddrtype);
 
 			// timer
+			void AddToTerminationWheel (std::shared_ptr<NTCP2Session> session); // m_NTCP2SessionsMutex is locked
 			void ScheduleTermination ();
 			void HandleTerminationTimer (const boost::system::error_code& ecode);
 
@@ -270,8 +329,13 @@ namespace transport
 
 			boost::asio::deadline_timer m_TerminationTimer;
 			std::unique_ptr<boost::asio::ip::tcp::acceptor> m_NTCP2Acceptor, m_NTCP2V6Acceptor;
+			mutable std::mutex m_NTCP2SessionsMutex; // sessions and pending sessions
 			std::map<i2p::data::IdentHash, std::shared_ptr<NTCP2Session> > m_NTCP2Sessions;
 			std::list<std::shared_ptr<NTCP2Session> > m_PendingIncomingSessions;
+			i2p::util::TimingWheel<std::weak_ptr<NTCP2Session> > m_TerminationWheel; // sessions and pending sessions, seconds
+			std::vector<std::unique_ptr<NTCP2Worker> > m_Workers; // empty if single thread
+			std::atomic<size_t> m_NextWorker; // round-robin for incoming
+			std::atomic<uint64_t> m_NumSentFrames, m_NumSendArenaAllocations;
 
 			ProxyType m_ProxyType;
 			std::string m_ProxyAddress;
@@ -282,7 +346,12 @@ namespace transport
 		public:
 
 			// for HTTP/I2PControl
-			const decltype(m_NTCP2Sessions)& GetNTCP2Sessions () const { return m_NTCP2Sessions; };
+			decltype(m_NTCP2Sessions) GetNTCP2Sessions () const
+			{
+				std::unique_lock<std::mutex> l(m_NTCP2SessionsMutex);
+				return m_NTCP2Sessions;
+			};
+			const decltype(m_Workers)& GetWorkers () const { return m_Workers; };
 	};
 }
 }
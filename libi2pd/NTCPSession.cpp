@@ -749,26 +749,27 @@ namespace transport
 		Send (nullptr);
 	}
 
-	void NTCPSession::SendI2NPMessages (const std::vector<std::shared_ptr<I2NPMessage> >& msgs)
+	void NTCPSession::ScheduleOutgoingQueue ()
 	{
-		m_Server.GetService ().post (std::bind (&NTCPSession::PostI2NPMessages, shared_from_this (), msgs));
+		m_Server.GetService ().post (std::bind (&NTCPSession::PostI2NPMessages, shared_from_this ()));
 	}
 
-	void NTCPSession::PostI2NPMessages (std::vector<std::shared_ptr<I2NPMessage> > msgs)
+	void NTCPSession::PostI2NPMessages ()
 	{
+		auto msgs = GetOutgoingMessages ();
 		if (m_IsTerminated) return;
+		if (m_IsSending && m_SendQueue.size () >= NTCP_MAX_OUTGOING_QUEUE_SIZE)
+		{
+			LogPrint (eLogWarning, "NTCP: outgoing messages queue size exceeds ", NTCP_MAX_OUTGOING_QUEUE_SIZE);
+			Terminate ();
+			return;
+		}
+		transports.GetTrafficShaper ().Shape (msgs); // only messages that will be sent take tokens
+		if (msgs.empty ()) return;
 		if (m_IsSending)
 		{
-			if (m_SendQueue.size () < NTCP_MAX_OUTGOING_QUEUE_SIZE)
-			{
-				for (const auto& it: msgs)
-					m_SendQueue.push_back (it);
-			}
-			else
-			{
-				LogPrint (eLogWarning, "NTCP: outgoing messages queue size exceeds ", NTCP_MAX_OUTGOING_QUEUE_SIZE);
-				Terminate ();
-			}
+			for (const auto& it: msgs)
+				m_SendQueue.push_back (it);
 		}
 		else
 			Send (msgs);
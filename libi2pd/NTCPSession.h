@@ -72,11 +72,11 @@ namespace transport
 
 			void ClientLogin ();
 			void ServerLogin ();
-			void SendI2NPMessages (const std::vector<std::shared_ptr<I2NPMessage> >& msgs);
 
 		private:
 
-			void PostI2NPMessages (std::vector<std::shared_ptr<I2NPMessage> > msgs);
+			void ScheduleOutgoingQueue ();
+			void PostI2NPMessages ();
 			void Connected ();
 			void SendTimeSyncMessage ();
 			void SetIsEstablished (bool isEstablished) { m_IsEstablished = isEstablished; }
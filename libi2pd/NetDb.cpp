@@ -9,6 +9,8 @@
 #include <string.h>
 #include <fstream>
 #include <vector>
+#include <atomic>
+#include <chrono>
 #include <boost/asio.hpp>
 #include <stdexcept>
 
@@ -33,9 +35,76 @@ namespace i2p
 {
 namespace data
 {
+	uint32_t RandomRoutersIndex::GetBuckets (const RouterInfo& r)
+	{
+		uint32_t buckets = 1 << eBucketAll;
+		if ((r.GetCaps () & RouterInfo::eHighBandwidth) && r.GetVersion () >= NETDB_MIN_HIGHBANDWIDTH_VERSION)
+			buckets |= 1 << eBucketHighBandwidth;
+		if (r.IsPeerTesting ())
+		{
+			if (r.IsSSU (true)) buckets |= 1 << eBucketPeerTestingV4;
+			if (r.IsSSU (false)) buckets |= 1 << eBucketPeerTesting;
+		}
+		if (r.IsSSUV6 ())
+			buckets |= 1 << eBucketSSUV6;
+		if (r.IsIntroducer ())
+			buckets |= 1 << eBucketIntroducer;
+		return buckets;
+	}
+
+	void RandomRoutersIndex::Insert (const std::shared_ptr<RouterInfo>& r)
+	{
+		auto& entry = m_Entries[r->GetIdentHash ()];
+		entry.buckets = GetBuckets (*r);
+		for (int i = 0; i < eNumBuckets; i++)
+			if (entry.buckets & (1 << i))
+			{
+				entry.positions[i] = m_Buckets[i].size ();
+				m_Buckets[i].push_back (r);
+			}
+	}
+
+	void RandomRoutersIndex::Erase (int bucket, size_t pos)
+	{
+		// move last router to the hole
+		auto& routers = m_Buckets[bucket];
+		if (pos + 1 < routers.size ())
+		{
+			routers[pos] = routers.back ();
+			m_Entries[routers[pos]->GetIdentHash ()].positions[bucket] = pos;
+		}
+		routers.pop_back ();
+	}
+
+	void RandomRoutersIndex::Remove (const IdentHash& ident)
+	{
+		auto it = m_Entries.find (ident);
+		if (it == m_Entries.end ()) return;
+		auto entry = it->second;
+		m_Entries.erase (it);
+		for (int i = 0; i < eNumBuckets; i++)
+			if (entry.buckets & (1 << i))
+				Erase (i, entry.positions[i]);
+	}
+
+	void RandomRoutersIndex::Update (const std::shared_ptr<RouterInfo>& r)
+	{
+		auto it = m_Entries.find (r->GetIdentHash ());
+		if (it != m_Entries.end () && it->second.buckets == GetBuckets (*r)) return; // nothing changed
+		Remove (r->GetIdentHash ());
+		Insert (r);
+	}
+
+	void RandomRoutersIndex::Clear ()
+	{
+		for (auto& it: m_Buckets)
+			it.clear ();
+		m_Entries.clear ();
+	}
+
 	NetDb netdb;
 
-	NetDb::NetDb (): m_IsRunning (false), m_Thread (nullptr), m_Reseeder (nullptr), m_Storage("netDb", "r", "routerInfo-", "dat"), m_PersistProfiles (true), m_HiddenMode(false)
+	NetDb::NetDb (): m_LeaseSetsExpiration (NETDB_LEASESETS_EXPIRATION_TICK), m_IsRunning (false), m_Thread (nullptr), m_Reseeder (nullptr), m_Storage("netDb", "r", "routerInfo-", "dat"), m_CompactionThread (nullptr), m_PersistProfiles (true), m_HiddenMode(false)
 	{
 	}
 
@@ -51,6 +120,9 @@ namespace data
 		m_Storage.Init(i2p::data::GetBase64SubstitutionTable(), 64);
 		InitProfilesStorage ();
 		m_Families.LoadCertificates ();
+		bool snapshot; i2p::config::GetOption("persist.netdbsnapshot", snapshot);
+		if (snapshot && m_Snapshot.Open (i2p::fs::DataDirPath (NETDB_SNAPSHOT_FILENAME)) && !m_Snapshot.GetNumRecords ())
+			ImportToSnapshot ();
 		Load ();
 
 		uint16_t threshold; i2p::config::GetOption("reseed.threshold", threshold);
@@ -67,12 +139,13 @@ namespace data
 	{
 		if (m_IsRunning)
 		{
-			if (m_PersistProfiles)
-				for (auto& it: m_RouterInfos)
-					it.second->SaveProfile ();
 			DeleteObsoleteProfiles ();
+			if (m_PersistProfiles)
+				SaveProfiles ();
 			m_RouterInfos.clear ();
-			m_Floodfills.clear ();
+			m_RouterInfosTable.Clear ();
+			m_RandomRouters.Clear ();
+			m_Floodfills.Clear ();
 			if (m_Thread)
 			{
 				m_IsRunning = false;
@@ -81,14 +154,22 @@ namespace data
 				delete m_Thread;
 				m_Thread = 0;
 			}
+			if (m_CompactionThread)
+			{
+				m_CompactionThread->join ();
+				delete m_CompactionThread;
+				m_CompactionThread = nullptr;
+			}
+			m_Snapshot.Close ();
 			m_LeaseSets.clear();
+			m_LeaseSetsExpiration.Clear ();
 			m_Requests.Stop ();
 		}
 	}
 
 	void NetDb::Run ()
 	{
-		uint32_t lastSave = 0, lastPublish = 0, lastExploratory = 0, lastManageRequest = 0, lastDestinationCleanup = 0;
+		uint32_t lastSave = 0, lastPublish = 0, lastExploratory = 0, lastManageRequest = 0, lastDestinationCleanup = 0, lastProfilesSave = 0;
 		while (m_IsRunning)
 		{
 			try
@@ -141,6 +222,15 @@ namespace data
 					}
 					lastSave = ts;
 				}
+				if (ts - lastProfilesSave >= PEER_PROFILES_SAVE_INTERVAL)
+				{
+					if (lastProfilesSave)
+					{
+						DeleteObsoleteProfiles ();
+						if (m_PersistProfiles) SaveProfiles ();
+					}
+					lastProfilesSave = ts;
+				}
 				if (ts - lastDestinationCleanup >= i2p::garlic::INCOMING_TAGS_EXPIRATION_TIMEOUT)
 				{
 					i2p::context.CleanupDestination ();
@@ -219,14 +309,18 @@ namespace data
 				bool wasFloodfill = r->IsFloodfill ();
 				r->Update (buf, len);
 				LogPrint (eLogInfo, "NetDb: RouterInfo updated: ", ident.ToBase64());
+				{
+					std::unique_lock<std::mutex> l(m_RouterInfosMutex);
+					m_RandomRouters.Update (r);
+				}
 				if (wasFloodfill != r->IsFloodfill ()) // if floodfill status updated
 				{
 					LogPrint (eLogDebug, "NetDb: RouterInfo floodfill status updated: ", ident.ToBase64());
 					std::unique_lock<std::mutex> l(m_FloodfillsMutex);
 					if (wasFloodfill)
-						m_Floodfills.remove (r);
-					else
-						m_Floodfills.push_back (r);
+						m_Floodfills.Remove (r->GetIdentHash ());
+					else if (r->IsReachable ())
+						m_Floodfills.Insert (r);
 				}
 			}
 			else
@@ -244,6 +338,11 @@ namespace data
 				{
 					std::unique_lock<std::mutex> l(m_RouterInfosMutex);
 					inserted = m_RouterInfos.insert ({r->GetIdentHash (), r}).second;
+					if (inserted)
+					{
+						m_RouterInfosTable.Insert (r);
+						m_RandomRouters.Insert (r);
+					}
 				}
 				if (inserted)
 				{
@@ -251,7 +350,7 @@ namespace data
 					if (r->IsFloodfill () && r->IsReachable ()) // floodfill must be reachable
 					{
 						std::unique_lock<std::mutex> l(m_FloodfillsMutex);
-						m_Floodfills.push_back (r);
+						m_Floodfills.Insert (r);
 					}
 				}
 				else
@@ -282,6 +381,7 @@ namespace data
 				if(it->second->GetExpirationTime() < expires)
 				{
 					it->second->Update (buf, len, false); // signature is verified already
+					ScheduleLeaseSetExpiration (ident, it->second);
 					LogPrint (eLogInfo, "NetDb: LeaseSet updated: ", ident.ToBase32());
 					updated = true;
 				}
@@ -298,6 +398,7 @@ namespace data
 			{
 				LogPrint (eLogInfo, "NetDb: LeaseSet added: ", ident.ToBase32());
 				m_LeaseSets[ident] = leaseSet;
+				ScheduleLeaseSetExpiration (ident, leaseSet);
 				updated = true;
 			}
 			else
@@ -321,6 +422,7 @@ namespace data
 					// TODO: implement actual update
 					LogPrint (eLogInfo, "NetDb: LeaseSet2 updated: ", ident.ToBase32());
 					m_LeaseSets[ident] = leaseSet;
+					ScheduleLeaseSetExpiration (ident, leaseSet);
 					return true;
 				}
 				else
@@ -430,24 +532,52 @@ namespace data
 		i2p::transport::transports.SendMessages(ih, requests);
 	}
 
-	bool NetDb::LoadRouterInfo (const std::string & path)
+	std::shared_ptr<RouterInfo> NetDb::LoadRouterInfo (const std::string & path) const
 	{
 		auto r = std::make_shared<RouterInfo>(path);
+		if (CheckLoadedRouterInfo (r)) return r;
+		LogPrint(eLogWarning, "NetDb: RI from ", path, " is invalid. Delete");
+		i2p::fs::Remove(path);
+		return nullptr;
+	}
+
+	std::shared_ptr<RouterInfo> NetDb::LoadRouterInfo (const uint8_t * buf, size_t len) const
+	{
+		auto r = std::make_shared<RouterInfo>(buf, len, false); // was verified before saving
+		r->SetUpdated (false);
+		return CheckLoadedRouterInfo (r) ? r : nullptr;
+	}
+
+	bool NetDb::CheckLoadedRouterInfo (std::shared_ptr<RouterInfo> r) const
+	{
 		if (r->GetRouterIdentity () && !r->IsUnreachable () &&
 				(!r->UsesIntroducer () || m_LastLoad < r->GetTimestamp () + NETDB_INTRODUCEE_EXPIRATION_TIMEOUT*1000LL)) // 1 hour
 		{
 			r->DeleteBuffer ();
 			r->ClearProperties (); // properties are not used for regular routers
-			m_RouterInfos[r->GetIdentHash ()] = r;
-			if (r->IsFloodfill () && r->IsReachable ()) // floodfill must be reachable
-				m_Floodfills.push_back (r);
+			return true;
 		}
-		else
+		return false;
+	}
+
+	void NetDb::ImportToSnapshot ()
+	{
+		std::vector<std::string> files;
+		m_Storage.Traverse(files);
+		if (files.empty ()) return;
+		int numImported = 0;
+		for (const auto& path: files)
 		{
-			LogPrint(eLogWarning, "NetDb: RI from ", path, " is invalid. Delete");
-			i2p::fs::Remove(path);
+			RouterInfo r (path);
+			if (r.GetRouterIdentity () && r.GetBuffer ())
+			{
+				m_Snapshot.Put (r.GetIdentHash (), r.GetBuffer (), r.GetBufferLen ());
+				numImported++;
+			}
 		}
-		return true;
+		m_Snapshot.Flush ();
+		LogPrint (eLogInfo, "NetDb: ", numImported, " of ", files.size (), " routers imported from ", m_Storage.GetRoot (),
+			" to snapshot. The directory is not used anymore");
 	}
 
 	void NetDb::VisitLeaseSets(LeaseSetVisitor v)
@@ -459,6 +589,16 @@ namespace data
 
 	void NetDb::VisitStoredRouterInfos(RouterInfoVisitor v)
 	{
+		if (m_Snapshot.IsOpen ())
+		{
+			m_Snapshot.Iterate ([v] (const IdentHash& ident, const uint8_t * buf, size_t len)
+			{
+				auto ri = std::make_shared<i2p::data::RouterInfo>(buf, len, false);
+				ri->SetUpdated (false);
+				v(ri);
+			});
+			return;
+		}
 		m_Storage.Iterate([v] (const std::string & filename)
 		{
 			auto ri = std::make_shared<i2p::data::RouterInfo>(filename);
@@ -523,15 +663,71 @@ namespace data
 	{
 		// make sure we cleanup netDb from previous attempts
 		m_RouterInfos.clear ();
-		m_Floodfills.clear ();
+		m_RouterInfosTable.Clear ();
+		m_RandomRouters.Clear ();
+		m_Floodfills.Clear ();
 
+		auto start = std::chrono::steady_clock::now ();
 		m_LastLoad = i2p::util::GetSecondsSinceEpoch();
 		std::vector<std::string> files;
-		m_Storage.Traverse(files);
-		for (const auto& path : files)
-			LoadRouterInfo(path);
+		struct SnapshotRecord { IdentHash ident; const uint8_t * buf; size_t len; };
+		std::vector<SnapshotRecord> records; // point to mapped snapshot, valid until next flush
+		if (m_Snapshot.IsOpen ())
+			m_Snapshot.Iterate ([&records](const IdentHash& ident, const uint8_t * buf, size_t len)
+				{
+					records.push_back ({ ident, buf, len });
+				});
+		else
+			m_Storage.Traverse(files);
+		size_t numFiles = m_Snapshot.IsOpen () ? records.size () : files.size ();
+		auto traversed = std::chrono::steady_clock::now ();
+
+		// read and parse files in parallel, each thread takes next file
+		size_t numThreads = std::max (std::thread::hardware_concurrency (), 1u);
+		numThreads = std::min (std::min (numThreads, NETDB_MAX_NUM_LOAD_THREADS), numFiles / NETDB_MIN_NUM_FILES_PER_LOAD_THREAD + 1);
+		std::atomic<size_t> nextFile (0);
+		std::vector<std::vector<std::shared_ptr<RouterInfo> > > loaded (numThreads);
+		auto load = [this, &files, &records, numFiles, &nextFile](std::vector<std::shared_ptr<RouterInfo> >& routers)
+		{
+			size_t i;
+			while ((i = nextFile++) < numFiles)
+			{
+				auto r = records.empty () ? LoadRouterInfo (files[i]) : LoadRouterInfo (records[i].buf, records[i].len);
+				if (r) routers.push_back (r);
+			}
+		};
+		std::vector<std::thread> threads;
+		for (size_t i = 1; i < numThreads; i++)
+			threads.emplace_back (load, std::ref (loaded[i]));
+		load (loaded[0]); // this thread is one of them
+		for (auto& it: threads)
+			it.join ();
+		auto parsed = std::chrono::steady_clock::now ();
+
+		// merge
+		for (const auto& routers: loaded)
+			for (const auto& r: routers)
+			{
+				m_RouterInfos[r->GetIdentHash ()] = r;
+				m_RouterInfosTable.Insert (r);
+				m_RandomRouters.Insert (r);
+				if (r->IsFloodfill () && r->IsReachable ()) // floodfill must be reachable
+					m_Floodfills.Insert (r);
+			}
+		if (m_RouterInfos.size () < records.size ())
+		{
+			LogPrint (eLogWarning, "NetDb: ", records.size () - m_RouterInfos.size (), " invalid RIs in snapshot. Delete");
+			for (const auto& it: records)
+				if (!m_RouterInfos.count (it.ident))
+					m_Snapshot.Remove (it.ident);
+			m_Snapshot.Flush ();
+		}
+		auto merged = std::chrono::steady_clock::now ();
 
-		LogPrint (eLogInfo, "NetDb: ", m_RouterInfos.size(), " routers loaded (", m_Floodfills.size (), " floodfils)");
+		auto ms = [](std::chrono::steady_clock::duration d) { return std::chrono::duration_cast<std::chrono::milliseconds>(d).count (); };
+		LogPrint (eLogInfo, "NetDb: ", m_RouterInfos.size(), " routers loaded (", m_Floodfills.GetSize (), " floodfils) in ",
+			ms (merged - start), " ms: traverse ", ms (traversed - start), " ms, parse ", ms (parsed - traversed),
+			" ms with ", numThreads, " threads, merge ", ms (merged - parsed), " ms");
 	}
 
 	void NetDb::SaveUpdated ()
@@ -550,10 +746,15 @@ namespace data
 		for (auto& it: m_RouterInfos)
 		{
 			std::string ident = it.second->GetIdentHashBase64();
-			std::string path  = m_Storage.Path(ident);
 			if (it.second->IsUpdated ())
 			{
-				it.second->SaveToFile (path);
+				if (m_Snapshot.IsOpen ())
+				{
+					if (it.second->GetBuffer ())
+						m_Snapshot.Put (it.first, it.second->GetBuffer (), it.second->GetBufferLen ());
+				}
+				else
+					it.second->SaveToFile (m_Storage.Path(ident));
 				it.second->SetUpdated (false);
 				it.second->SetUnreachable (false);
 				it.second->DeleteBuffer ();
@@ -573,12 +774,27 @@ namespace data
 			if (it.second->IsUnreachable ())
 			{
 				// delete RI file
-				m_Storage.Remove(ident);
+				if (m_Snapshot.IsOpen ())
+					m_Snapshot.Remove (it.first);
+				else
+					m_Storage.Remove(ident);
 				deletedCount++;
 				if (total - deletedCount < NETDB_MIN_ROUTERS) checkForExpiration = false;
 			}
 		} // m_RouterInfos iteration
 
+		if (m_Snapshot.IsOpen ())
+		{
+			m_Snapshot.Flush ();
+			if (m_CompactionThread)
+			{
+				m_CompactionThread->join (); // previous one, normally finished long ago
+				delete m_CompactionThread;
+				m_CompactionThread = nullptr;
+			}
+			if (m_Snapshot.NeedsCompaction ())
+				m_CompactionThread = new std::thread (std::bind (&RouterInfoSnapshot::Compact, &m_Snapshot));
+		}
 		if (updatedCount > 0)
 			LogPrint (eLogInfo, "NetDb: saved ", updatedCount, " new/updated routers");
 		if (deletedCount > 0)
@@ -591,7 +807,8 @@ namespace data
 				{
 					if (it->second->IsUnreachable ())
 					{
-						if (m_PersistProfiles) it->second->SaveProfile ();
+						m_RouterInfosTable.Remove (it->first);
+						m_RandomRouters.Remove (it->first);
 						it = m_RouterInfos.erase (it);
 						continue;
 					}
@@ -601,11 +818,10 @@ namespace data
 			// clean up expired floodfills or not floodfills anymore
 			{
 				std::unique_lock<std::mutex> l(m_FloodfillsMutex);
-				for (auto it = m_Floodfills.begin (); it != m_Floodfills.end ();)
-					if ((*it)->IsUnreachable () || !(*it)->IsFloodfill ())
-						it = m_Floodfills.erase (it);
-					else
-						++it;
+				m_Floodfills.Cleanup ([](const std::shared_ptr<RouterInfo>& r)->bool
+					{
+						return r && !r->IsUnreachable () && r->IsFloodfill ();
+					});
 			}
 		}
 	}
@@ -909,7 +1125,18 @@ namespace data
 				if (router)
 				{
 					LogPrint (eLogDebug, "NetDb: requested RouterInfo ", key, " found");
-					router->LoadBuffer ();
+					if (m_Snapshot.IsOpen ())
+					{
+						if (!router->GetBuffer ())
+						{
+							uint8_t buf[MAX_RI_BUFFER_SIZE];
+							size_t len = MAX_RI_BUFFER_SIZE;
+							if (m_Snapshot.Get (ident, buf, len))
+								router->SetBuffer (buf, len);
+						}
+					}
+					else
+						router->LoadBuffer ();
 					if (router->GetBuffer ())
 						replyMsg = CreateDatabaseStoreMsg (router);
 				}
@@ -1078,7 +1305,7 @@ namespace data
 
 	std::shared_ptr<const RouterInfo> NetDb::GetRandomRouter () const
 	{
-		return GetRandomRouter (
+		return GetRandomRouter (RandomRoutersIndex::eBucketAll,
 			[](std::shared_ptr<const RouterInfo> router)->bool
 			{
 				return !router->IsHidden ();
@@ -1087,7 +1314,7 @@ namespace data
 
 	std::shared_ptr<const RouterInfo> NetDb::GetRandomRouter (std::shared_ptr<const RouterInfo> compatibleWith) const
 	{
-		return GetRandomRouter (
+		return GetRandomRouter (RandomRoutersIndex::eBucketAll,
 			[compatibleWith](std::shared_ptr<const RouterInfo> router)->bool
 			{
 				return !router->IsHidden () && router != compatibleWith &&
@@ -1097,7 +1324,7 @@ namespace data
 
 	std::shared_ptr<const RouterInfo> NetDb::GetRandomPeerTestRouter (bool v4only) const
 	{
-		return GetRandomRouter (
+		return GetRandomRouter (v4only ? RandomRoutersIndex::eBucketPeerTestingV4 : RandomRoutersIndex::eBucketPeerTesting,
 			[v4only](std::shared_ptr<const RouterInfo> router)->bool
 			{
 				return !router->IsHidden () && router->IsPeerTesting () && router->IsSSU (v4only);
@@ -1106,7 +1333,7 @@ namespace data
 
 	std::shared_ptr<const RouterInfo> NetDb::GetRandomSSUV6Router () const
 	{
-		return GetRandomRouter (
+		return GetRandomRouter (RandomRoutersIndex::eBucketSSUV6,
 			[](std::shared_ptr<const RouterInfo> router)->bool
 			{
 				return !router->IsHidden () && router->IsSSUV6 ();
@@ -1115,7 +1342,7 @@ namespace data
 
 	std::shared_ptr<const RouterInfo> NetDb::GetRandomIntroducer () const
 	{
-		return GetRandomRouter (
+		return GetRandomRouter (RandomRoutersIndex::eBucketIntroducer,
 			[](std::shared_ptr<const RouterInfo> router)->bool
 			{
 				return !router->IsHidden () && router->IsIntroducer ();
@@ -1124,7 +1351,7 @@ namespace data
 
 	std::shared_ptr<const RouterInfo> NetDb::GetHighBandwidthRandomRouter (std::shared_ptr<const RouterInfo> compatibleWith) const
 	{
-		return GetRandomRouter (
+		return GetRandomRouter (RandomRoutersIndex::eBucketHighBandwidth,
 			[compatibleWith](std::shared_ptr<const RouterInfo> router)->bool
 			{
 				return !router->IsHidden () && router != compatibleWith &&
@@ -1135,29 +1362,10 @@ namespace data
 	}
 
 	template<typename Filter>
-	std::shared_ptr<const RouterInfo> NetDb::GetRandomRouter (Filter filter) const
+	std::shared_ptr<const RouterInfo> NetDb::GetRandomRouter (RandomRoutersIndex::Bucket bucket, Filter filter) const
 	{
-		if (m_RouterInfos.empty())
-			return 0;
-		uint32_t ind = rand () % m_RouterInfos.size ();
-		for (int j = 0; j < 2; j++)
-		{
-			uint32_t i = 0;
-			std::unique_lock<std::mutex> l(m_RouterInfosMutex);
-			for (const auto& it: m_RouterInfos)
-			{
-				if (i >= ind)
-				{
-					if (!it.second->IsUnreachable () && filter (it.second))
-						return it.second;
-				}
-				else
-					i++;
-			}
-			// we couldn't find anything, try second pass
-			ind = 0;
-		}
-		return nullptr; // seems we have too few routers
+		std::unique_lock<std::mutex> l(m_RouterInfosMutex);
+		return m_RandomRouters.GetRandom (bucket, filter);
 	}
 
 	void NetDb::PostI2NPMsg (std::shared_ptr<const I2NPMessage> msg)
@@ -1168,83 +1376,48 @@ namespace data
 	std::shared_ptr<const RouterInfo> NetDb::GetClosestFloodfill (const IdentHash& destination,
 		const std::set<IdentHash>& excluded, bool closeThanUsOnly) const
 	{
-		std::shared_ptr<const RouterInfo> r;
-		XORMetric minMetric;
 		IdentHash destKey = CreateRoutingKey (destination);
-		if (closeThanUsOnly)
-			minMetric = destKey ^ i2p::context.GetIdentHash ();
-		else
-			minMetric.SetMax ();
-		std::unique_lock<std::mutex> l(m_FloodfillsMutex);
-		for (const auto& it: m_Floodfills)
+		std::shared_ptr<const RouterInfo> r;
 		{
-			if (!it->IsUnreachable ())
-			{
-				XORMetric m = destKey ^ it->GetIdentHash ();
-				if (m < minMetric && !excluded.count (it->GetIdentHash ()))
+			std::unique_lock<std::mutex> l(m_FloodfillsMutex);
+			r = m_Floodfills.FindClosest (destKey, [&excluded](const std::shared_ptr<RouterInfo>& r)->bool
 				{
-					minMetric = m;
-					r = it;
-				}
-			}
+					return !r->IsUnreachable () && !excluded.count (r->GetIdentHash ());
+				});
 		}
+		// closest is found first, so if it's not closer than us nothing else is
+		if (r && closeThanUsOnly && !((destKey ^ r->GetIdentHash ()) < (destKey ^ i2p::context.GetIdentHash ())))
+			r = nullptr;
 		return r;
 	}
 
 	std::vector<IdentHash> NetDb::GetClosestFloodfills (const IdentHash& destination, size_t num,
 		std::set<IdentHash>& excluded, bool closeThanUsOnly) const
 	{
-		struct Sorted
-		{
-			std::shared_ptr<const RouterInfo> r;
-			XORMetric metric;
-			bool operator< (const Sorted& other) const { return metric < other.metric; };
-		};
-
-		std::set<Sorted> sorted;
 		IdentHash destKey = CreateRoutingKey (destination);
-		XORMetric ourMetric;
-		if (closeThanUsOnly) ourMetric = destKey ^ i2p::context.GetIdentHash ();
+		std::vector<std::shared_ptr<RouterInfo> > closest;
 		{
 			std::unique_lock<std::mutex> l(m_FloodfillsMutex);
-			for (const auto& it: m_Floodfills)
-			{
-				if (!it->IsUnreachable ())
+			closest = m_Floodfills.FindClosest (destKey, num, [&excluded](const std::shared_ptr<RouterInfo>& r)->bool
 				{
-					XORMetric m = destKey ^ it->GetIdentHash ();
-					if (closeThanUsOnly && ourMetric < m) continue;
-					if (sorted.size () < num)
-						sorted.insert ({it, m});
-					else if (m < sorted.rbegin ()->metric)
-					{
-						sorted.insert ({it, m});
-						sorted.erase (std::prev (sorted.end ()));
-					}
-				}
-			}
+					return !r->IsUnreachable () && !excluded.count (r->GetIdentHash ());
+				});
 		}
 
+		// routers are sorted by distance
 		std::vector<IdentHash> res;
-		size_t i = 0;
-		for (const auto& it: sorted)
+		XORMetric ourMetric;
+		if (closeThanUsOnly) ourMetric = destKey ^ i2p::context.GetIdentHash ();
+		for (const auto& it: closest)
 		{
-			if (i < num)
-			{
-				const auto& ident = it.r->GetIdentHash ();
-				if (!excluded.count (ident))
-				{
-					res.push_back (ident);
-					i++;
-				}
-			}
-			else
-				break;
+			if (closeThanUsOnly && ourMetric < (destKey ^ it->GetIdentHash ())) break;
+			res.push_back (it->GetIdentHash ());
 		}
 		return res;
 	}
 
 	std::shared_ptr<const RouterInfo> NetDb::GetRandomRouterInFamily(const std::string & fam) const {
-		return GetRandomRouter(
+		return GetRandomRouter(RandomRoutersIndex::eBucketAll,
 			[fam](std::shared_ptr<const RouterInfo> router)->bool
 		{
 			return router->IsFamily(fam);
@@ -1254,39 +1427,35 @@ namespace data
 	std::shared_ptr<const RouterInfo> NetDb::GetClosestNonFloodfill (const IdentHash& destination,
 		const std::set<IdentHash>& excluded) const
 	{
-		std::shared_ptr<const RouterInfo> r;
-		XORMetric minMetric;
 		IdentHash destKey = CreateRoutingKey (destination);
-		minMetric.SetMax ();
-		// must be called from NetDb thread only
-		for (const auto& it: m_RouterInfos)
-		{
-			if (!it.second->IsFloodfill ())
+		std::unique_lock<std::mutex> l(m_RouterInfosMutex);
+		return m_RouterInfosTable.FindClosest (destKey, [&excluded](const std::shared_ptr<RouterInfo>& r)->bool
 			{
-				XORMetric m = destKey ^ it.first;
-				if (m < minMetric && !excluded.count (it.first))
-				{
-					minMetric = m;
-					r = it.second;
-				}
-			}
-		}
-		return r;
+				return !r->IsFloodfill () && !excluded.count (r->GetIdentHash ());
+			});
 	}
 
 	void NetDb::ManageLeaseSets ()
 	{
 		auto ts = i2p::util::GetMillisecondsSinceEpoch ();
-		for (auto it = m_LeaseSets.begin (); it != m_LeaseSets.end ();)
-		{
-			if (!it->second->IsValid () || ts > it->second->GetExpirationTime () - LEASE_ENDDATE_THRESHOLD)
+		std::unique_lock<std::mutex> lock(m_LeaseSetsMutex);
+		m_LeaseSetsExpiration.Advance (ts, [this, ts](const IdentHash& ident)
 			{
-				LogPrint (eLogInfo, "NetDb: LeaseSet ", it->first.ToBase64 (), " expired or invalid");
-				it = m_LeaseSets.erase (it);
-			}
-			else
-				++it;
-		}
+				auto it = m_LeaseSets.find (ident);
+				// if updated, there is another entry for new expiration
+				if (it != m_LeaseSets.end () &&
+					(!it->second->IsValid () || ts > it->second->GetExpirationTime () - LEASE_ENDDATE_THRESHOLD))
+				{
+					LogPrint (eLogInfo, "NetDb: LeaseSet ", it->first.ToBase64 (), " expired or invalid");
+					m_LeaseSets.erase (it);
+				}
+			});
+	}
+
+	void NetDb::ScheduleLeaseSetExpiration (const IdentHash& ident, std::shared_ptr<const LeaseSet> leaseSet)
+	{
+		// invalid is removed at next check
+		m_LeaseSetsExpiration.Add (ident, leaseSet->IsValid () ? leaseSet->GetExpirationTime () - LEASE_ENDDATE_THRESHOLD + 1 : 0);
 	}
 }
 }
@@ -12,6 +12,7 @@
 #include <inttypes.h>
 #include <set>
 #include <map>
+#include <unordered_map>
 #include <list>
 #include <string>
 #include <thread>
@@ -21,6 +22,7 @@
 #include "Gzip.h"
 #include "FS.h"
 #include "Queue.h"
+#include "util.h"
 #include "I2NPProtocol.h"
 #include "RouterInfo.h"
 #include "LeaseSet.h"
@@ -29,6 +31,8 @@
 #include "Reseed.h"
 #include "NetDbRequests.h"
 #include "Family.h"
+#include "KadDHT.h"
+#include "NetDbSnapshot.h"
 #include "version.h"
 
 namespace i2p
@@ -42,6 +46,10 @@ namespace data
 	const int NETDB_MAX_EXPIRATION_TIMEOUT = 27 * 60 * 60; // 27 hours
 	const int NETDB_PUBLISH_INTERVAL = 60 * 40;
 	const int NETDB_MIN_HIGHBANDWIDTH_VERSION = MAKE_VERSION_NUMBER(0, 9, 36); // 0.9.36
+	const size_t NETDB_MAX_NUM_LOAD_THREADS = 8;
+	const size_t NETDB_MIN_NUM_FILES_PER_LOAD_THREAD = 256;
+	const int NETDB_MAX_RANDOM_ROUTER_ATTEMPTS = 16; // random picks before scan of the bucket
+	const uint64_t NETDB_LEASESETS_EXPIRATION_TICK = 1000; // in milliseconds, LeaseSets are checked once a minute anyway
 
 	/** function for visiting a leaseset stored in a floodfill */
 	typedef std::function<void(const IdentHash, std::shared_ptr<LeaseSet>)> LeaseSetVisitor;
@@ -52,6 +60,67 @@ namespace data
 	/** function for visiting a router info and determining if we want to use it */
 	typedef std::function<bool(std::shared_ptr<const i2p::data::RouterInfo>)> RouterInfoFilter;
 
+	/** @brief routers in vectors by properties peer selection filters use, for O(1) random pick */
+	class RandomRoutersIndex
+	{
+		public:
+
+			enum Bucket
+			{
+				eBucketAll = 0,
+				eBucketHighBandwidth, // of recent version
+				eBucketPeerTestingV4,
+				eBucketPeerTesting,
+				eBucketSSUV6,
+				eBucketIntroducer,
+				eNumBuckets
+			};
+
+			void Insert (const std::shared_ptr<RouterInfo>& r);
+			void Remove (const IdentHash& ident);
+			void Update (const std::shared_ptr<RouterInfo>& r); // caps or addresses might change
+			void Clear ();
+
+			template<typename Filter>
+			std::shared_ptr<const RouterInfo> GetRandom (Bucket bucket, Filter filter) const;
+
+		private:
+
+			static uint32_t GetBuckets (const RouterInfo& r); // mask
+			void Erase (int bucket, size_t pos);
+
+		private:
+
+			struct Entry
+			{
+				uint32_t buckets;
+				size_t positions[eNumBuckets];
+			};
+			std::vector<std::shared_ptr<RouterInfo> > m_Buckets[eNumBuckets];
+			std::unordered_map<IdentHash, Entry> m_Entries;
+	};
+
+	template<typename Filter>
+	std::shared_ptr<const RouterInfo> RandomRoutersIndex::GetRandom (Bucket bucket, Filter filter) const
+	{
+		const auto& routers = m_Buckets[bucket];
+		if (routers.empty ()) return nullptr;
+		// rejection sampling first
+		for (int i = 0; i < NETDB_MAX_RANDOM_ROUTER_ATTEMPTS; i++)
+		{
+			const auto& r = routers[rand () % routers.size ()];
+			if (!r->IsUnreachable () && filter (r)) return r;
+		}
+		// then scan from random position, might be few matching routers
+		size_t ind = rand () % routers.size ();
+		for (size_t i = 0; i < routers.size (); i++)
+		{
+			const auto& r = routers[(ind + i) % routers.size ()];
+			if (!r->IsUnreachable () && filter (r)) return r;
+		}
+		return nullptr;
+	}
+
 	class NetDb
 	{
 		public:
@@ -101,7 +170,7 @@ namespace data
 
 			// for web interface
 			int GetNumRouters () const { return m_RouterInfos.size (); };
-			int GetNumFloodfills () const { return m_Floodfills.size (); };
+			int GetNumFloodfills () const { return m_Floodfills.GetSize (); };
 			int GetNumLeaseSets () const { return m_LeaseSets.size (); };
 
 			/** visit all lease sets we currently store */
@@ -113,18 +182,22 @@ namespace data
 			/** visit N random router that match using filter, then visit them with a visitor, return number of RouterInfos that were visited */
 			size_t VisitRandomRouterInfos(RouterInfoFilter f, RouterInfoVisitor v, size_t n);
 
-			void ClearRouterInfos () { m_RouterInfos.clear (); };
+			void ClearRouterInfos () { m_RouterInfos.clear (); m_RouterInfosTable.Clear (); m_RandomRouters.Clear (); };
 
 		private:
 
 			void Load ();
-			bool LoadRouterInfo (const std::string & path);
+			std::shared_ptr<RouterInfo> LoadRouterInfo (const std::string & path) const; // can be called from any thread
+			std::shared_ptr<RouterInfo> LoadRouterInfo (const uint8_t * buf, size_t len) const; // from snapshot
+			bool CheckLoadedRouterInfo (std::shared_ptr<RouterInfo> r) const;
+			void ImportToSnapshot ();
 			void SaveUpdated ();
 			void Run (); // exploratory thread
 			void Explore (int numDestinations);
 			void Publish ();
 			void Flood (const IdentHash& ident, std::shared_ptr<I2NPMessage> floodMsg);
 			void ManageLeaseSets ();
+			void ScheduleLeaseSetExpiration (const IdentHash& ident, std::shared_ptr<const LeaseSet> leaseSet); // m_LeaseSetsMutex is locked
 			void ManageRequests ();
 
 			void ReseedFromFloodfill(const RouterInfo & ri, int numRouters = 40, int numFloodfills = 20);
@@ -133,26 +206,31 @@ namespace data
 			std::shared_ptr<const RouterInfo> AddRouterInfo (const IdentHash& ident, const uint8_t * buf, int len, bool& updated);
 
 			template<typename Filter>
-			std::shared_ptr<const RouterInfo> GetRandomRouter (Filter filter) const;
+			std::shared_ptr<const RouterInfo> GetRandomRouter (RandomRoutersIndex::Bucket bucket, Filter filter) const;
 
 		private:
 
 			mutable std::mutex m_LeaseSetsMutex;
 			std::map<IdentHash, std::shared_ptr<LeaseSet> > m_LeaseSets;
+			i2p::util::TimingWheel<IdentHash> m_LeaseSetsExpiration; // in milliseconds, checked at every stored expiration, guarded by m_LeaseSetsMutex
 			mutable std::mutex m_RouterInfosMutex;
 			std::map<IdentHash, std::shared_ptr<RouterInfo> > m_RouterInfos;
+			DHTTable m_RouterInfosTable; // all routers by XOR distance, guarded by m_RouterInfosMutex
+			RandomRoutersIndex m_RandomRouters; // guarded by m_RouterInfosMutex
 			mutable std::mutex m_FloodfillsMutex;
-			std::list<std::shared_ptr<RouterInfo> > m_Floodfills;
+			DHTTable m_Floodfills;
 
 			bool m_IsRunning;
 			uint64_t m_LastLoad;
 			std::thread * m_Thread;
-			i2p::util::Queue<std::shared_ptr<const I2NPMessage> > m_Queue; // of I2NPDatabaseStoreMsg
+			i2p::util::MPSCQueue<std::shared_ptr<const I2NPMessage> > m_Queue; // of I2NPDatabaseStoreMsg
 
 			GzipInflator m_Inflator;
 			Reseeder * m_Reseeder;
 			Families m_Families;
 			i2p::fs::HashedStorage m_Storage;
+			RouterInfoSnapshot m_Snapshot; // used instead of m_Storage if open
+			std::thread * m_CompactionThread;
 
 			friend class NetDbRequests;
 			NetDbRequests m_Requests;
@@ -0,0 +1,291 @@
+/*
+* Copyright (c) 2013-2020, The PurpleI2P Project
+*
+* This file is part of Purple i2pd project and licensed under BSD3
+*
+* See full license text in LICENSE file at top of project tree
+*/
+
+#include <string.h>
+#include <algorithm>
+#include <boost/filesystem.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include "I2PEndian.h"
+#include "Log.h"
+#include "NetDbSnapshot.h"
+
+namespace i2p
+{
+namespace data
+{
+	RouterInfoSnapshot::RouterInfoSnapshot ():
+		m_IsOpen (false), m_FileSize (0), m_LiveSize (0)
+	{
+	}
+
+	RouterInfoSnapshot::~RouterInfoSnapshot ()
+	{
+		Close ();
+	}
+
+	bool RouterInfoSnapshot::Open (const std::string& path)
+	{
+		std::unique_lock<std::mutex> l(m_Mutex);
+		m_Path = path;
+		boost::system::error_code ec;
+		if (!boost::filesystem::exists (path, ec) || boost::filesystem::file_size (path, ec) < NETDB_SNAPSHOT_SIGNATURE_SIZE)
+		{
+			std::ofstream f (path, std::ofstream::binary | std::ofstream::out | std::ofstream::trunc);
+			if (!f.is_open ())
+			{
+				LogPrint (eLogError, "NetDbSnapshot: Can't create ", path);
+				return false;
+			}
+			f.write (NETDB_SNAPSHOT_SIGNATURE, NETDB_SNAPSHOT_SIGNATURE_SIZE);
+		}
+		if (!Map ()) return false;
+		if (memcmp (m_Region->get_address (), NETDB_SNAPSHOT_SIGNATURE, NETDB_SNAPSHOT_SIGNATURE_SIZE))
+		{
+			LogPrint (eLogError, "NetDbSnapshot: ", path, " is not a netDb snapshot");
+			m_Region = nullptr;
+			return false;
+		}
+		m_FileSize = Scan ();
+		if (m_FileSize < m_Region->get_size ())
+		{
+			// last record was not written completely
+			LogPrint (eLogWarning, "NetDbSnapshot: ", m_Region->get_size () - m_FileSize, " trailing bytes of ", path, " truncated");
+			m_Region = nullptr;
+			boost::filesystem::resize_file (path, m_FileSize, ec);
+			if (ec || !Map ()) return false;
+		}
+		m_File.open (path, std::ofstream::binary | std::ofstream::out | std::ofstream::app);
+		if (!m_File.is_open ())
+		{
+			LogPrint (eLogError, "NetDbSnapshot: Can't open ", path, " for writing");
+			m_Region = nullptr;
+			return false;
+		}
+		m_IsOpen = true;
+		LogPrint (eLogInfo, "NetDbSnapshot: ", m_Index.size (), " records in ", path, ", ", m_FileSize, " bytes, ", m_LiveSize, " live");
+		return true;
+	}
+
+	void RouterInfoSnapshot::Close ()
+	{
+		std::unique_lock<std::mutex> l(m_Mutex);
+		if (m_IsOpen)
+		{
+			m_File.close ();
+			m_Region = nullptr;
+			m_Index.clear ();
+			m_FileSize = 0; m_LiveSize = 0;
+			m_IsOpen = false;
+		}
+	}
+
+	bool RouterInfoSnapshot::Map () const
+	{
+		m_Region = nullptr;
+		try
+		{
+			boost::interprocess::file_mapping mapping (m_Path.c_str (), boost::interprocess::read_only);
+			m_Region = std::make_shared<boost::interprocess::mapped_region> (mapping, boost::interprocess::read_only);
+		}
+		catch (std::exception& ex)
+		{
+			LogPrint (eLogError, "NetDbSnapshot: Can't map ", m_Path, ": ", ex.what ());
+			return false;
+		}
+		return true;
+	}
+
+	size_t RouterInfoSnapshot::Scan ()
+	{
+		m_Index.clear ();
+		m_LiveSize = NETDB_SNAPSHOT_SIGNATURE_SIZE;
+		auto buf = (const uint8_t *)m_Region->get_address ();
+		size_t size = m_Region->get_size (), offset = NETDB_SNAPSHOT_SIGNATURE_SIZE;
+		while (offset + NETDB_SNAPSHOT_RECORD_HEADER_SIZE <= size)
+		{
+			IdentHash ident (buf + offset);
+			uint16_t len = bufbe16toh (buf + offset + 32);
+			if (offset + NETDB_SNAPSHOT_RECORD_HEADER_SIZE + len > size) break; // incomplete
+			auto it = m_Index.find (ident);
+			if (it != m_Index.end ())
+			{
+				m_LiveSize -= NETDB_SNAPSHOT_RECORD_HEADER_SIZE + it->second.len;
+				if (!len) m_Index.erase (it);
+			}
+			if (len)
+			{
+				m_Index[ident] = { offset + NETDB_SNAPSHOT_RECORD_HEADER_SIZE, len };
+				m_LiveSize += NETDB_SNAPSHOT_RECORD_HEADER_SIZE + len;
+			}
+			offset += NETDB_SNAPSHOT_RECORD_HEADER_SIZE + len;
+		}
+		return offset;
+	}
+
+	size_t RouterInfoSnapshot::GetNumRecords () const
+	{
+		std::unique_lock<std::mutex> l(m_Mutex);
+		return m_Index.size ();
+	}
+
+	size_t RouterInfoSnapshot::GetFileSize () const
+	{
+		std::unique_lock<std::mutex> l(m_Mutex);
+		return m_FileSize;
+	}
+
+	void RouterInfoSnapshot::Put (const IdentHash& ident, const uint8_t * buf, size_t len)
+	{
+		if (!len || len > 0xFFFF) return;
+		std::unique_lock<std::mutex> l(m_Mutex);
+		if (!m_IsOpen) return;
+		uint8_t header[NETDB_SNAPSHOT_RECORD_HEADER_SIZE];
+		memcpy (header, ident, 32);
+		htobe16buf (header + 32, len);
+		m_File.write ((const char *)header, NETDB_SNAPSHOT_RECORD_HEADER_SIZE);
+		m_File.write ((const char *)buf, len);
+		auto it = m_Index.find (ident);
+		if (it != m_Index.end ())
+			m_LiveSize -= NETDB_SNAPSHOT_RECORD_HEADER_SIZE + it->second.len;
+		m_Index[ident] = { m_FileSize + NETDB_SNAPSHOT_RECORD_HEADER_SIZE, (uint16_t)len };
+		m_FileSize += NETDB_SNAPSHOT_RECORD_HEADER_SIZE + len;
+		m_LiveSize += NETDB_SNAPSHOT_RECORD_HEADER_SIZE + len;
+	}
+
+	void RouterInfoSnapshot::Remove (const IdentHash& ident)
+	{
+		std::unique_lock<std::mutex> l(m_Mutex);
+		if (!m_IsOpen) return;
+		auto it = m_Index.find (ident);
+		if (it == m_Index.end ()) return;
+		uint8_t header[NETDB_SNAPSHOT_RECORD_HEADER_SIZE];
+		memcpy (header, ident, 32);
+		htobe16buf (header + 32, 0);
+		m_File.write ((const char *)header, NETDB_SNAPSHOT_RECORD_HEADER_SIZE);
+		m_LiveSize -= NETDB_SNAPSHOT_RECORD_HEADER_SIZE + it->second.len;
+		m_FileSize += NETDB_SNAPSHOT_RECORD_HEADER_SIZE;
+		m_Index.erase (it);
+	}
+
+	void RouterInfoSnapshot::Flush ()
+	{
+		std::unique_lock<std::mutex> l(m_Mutex);
+		if (!m_IsOpen) return;
+		m_File.flush ();
+		if (!m_Region || m_Region->get_size () < m_FileSize)
+			Map ();
+	}
+
+	bool RouterInfoSnapshot::Get (const IdentHash& ident, uint8_t * buf, size_t& len) const
+	{
+		std::unique_lock<std::mutex> l(m_Mutex);
+		if (!m_IsOpen) return false;
+		auto it = m_Index.find (ident);
+		if (it == m_Index.end () || it->second.len > len) return false;
+		if (!m_Region || it->second.offset + it->second.len > m_Region->get_size ())
+		{
+			// not flushed yet
+			m_File.flush ();
+			if (!Map () || it->second.offset + it->second.len > m_Region->get_size ()) return false;
+		}
+		memcpy (buf, (const uint8_t *)m_Region->get_address () + it->second.offset, it->second.len);
+		len = it->second.len;
+		return true;
+	}
+
+	void RouterInfoSnapshot::Iterate (RecordVisitor v) const
+	{
+		std::unique_lock<std::mutex> l(m_Mutex);
+		if (!m_IsOpen || !m_Region) return;
+		std::vector<std::pair<IdentHash, Record> > records (m_Index.begin (), m_Index.end ());
+		std::sort (records.begin (), records.end (),
+			[](const std::pair<IdentHash, Record>& r1, const std::pair<IdentHash, Record>& r2)
+			{
+				return r1.second.offset < r2.second.offset;
+			});
+		auto buf = (const uint8_t *)m_Region->get_address ();
+		size_t size = m_Region->get_size ();
+		for (const auto& it: records)
+			if (it.second.offset + it.second.len <= size)
+				v (it.first, buf + it.second.offset, it.second.len);
+	}
+
+	bool RouterInfoSnapshot::NeedsCompaction () const
+	{
+		std::unique_lock<std::mutex> l(m_Mutex);
+		return m_IsOpen && m_FileSize > NETDB_SNAPSHOT_MIN_COMPACTION_SIZE &&
+			m_FileSize > m_LiveSize*NETDB_SNAPSHOT_COMPACTION_RATIO;
+	}
+
+	void RouterInfoSnapshot::Compact ()
+	{
+		std::shared_ptr<boost::interprocess::mapped_region> region;
+		std::vector<std::pair<IdentHash, Record> > records;
+		size_t fileSize = 0;
+		{
+			std::unique_lock<std::mutex> l(m_Mutex);
+			if (!m_IsOpen) return;
+			m_File.flush ();
+			if (!Map ()) return;
+			region = m_Region; // stays mapped while we are copying
+			records.assign (m_Index.begin (), m_Index.end ());
+			fileSize = m_FileSize;
+		}
+		std::sort (records.begin (), records.end (),
+			[](const std::pair<IdentHash, Record>& r1, const std::pair<IdentHash, Record>& r2)
+			{
+				return r1.second.offset < r2.second.offset;
+			});
+		// copy live records without lock
+		std::string tmpPath = m_Path + ".tmp";
+		std::ofstream f (tmpPath, std::ofstream::binary | std::ofstream::out | std::ofstream::trunc);
+		if (!f.is_open ())
+		{
+			LogPrint (eLogError, "NetDbSnapshot: Can't create ", tmpPath);
+			return;
+		}
+		f.write (NETDB_SNAPSHOT_SIGNATURE, NETDB_SNAPSHOT_SIGNATURE_SIZE);
+		auto buf = (const uint8_t *)region->get_address ();
+		for (const auto& it: records)
+			f.write ((const char *)buf + it.second.offset - NETDB_SNAPSHOT_RECORD_HEADER_SIZE,
+				NETDB_SNAPSHOT_RECORD_HEADER_SIZE + it.second.len);
+		region = nullptr;
+
+		std::unique_lock<std::mutex> l(m_Mutex);
+		if (!m_IsOpen) return;
+		// records appended while we were copying
+		m_File.flush ();
+		if (m_FileSize > fileSize && Map ())
+			f.write ((const char *)m_Region->get_address () + fileSize, m_FileSize - fileSize);
+		f.close ();
+		if (!f)
+		{
+			LogPrint (eLogError, "NetDbSnapshot: Can't write ", tmpPath);
+			return;
+		}
+		auto oldSize = m_FileSize;
+		m_File.close ();
+		m_Region = nullptr;
+		boost::system::error_code ec;
+		boost::filesystem::rename (tmpPath, m_Path, ec);
+		if (ec)
+			LogPrint (eLogError, "NetDbSnapshot: Can't replace ", m_Path, ": ", ec.message ());
+		// reopen
+		if (!Map ())
+		{
+			m_IsOpen = false;
+			return;
+		}
+		m_FileSize = Scan ();
+		m_File.open (m_Path, std::ofstream::binary | std::ofstream::out | std::ofstream::app);
+		m_IsOpen = m_File.is_open ();
+		LogPrint (eLogInfo, "NetDbSnapshot: compacted from ", oldSize, " to ", m_FileSize, " bytes");
+	}
+}
+}
@@ -0,0 +1,91 @@
+/*
+* Copyright (c) 2013-2020, The PurpleI2P Project
+*
+* This file is part of Purple i2pd project and licensed under BSD3
+*
+* See full license text in LICENSE file at top of project tree
+*/
+
+#ifndef NETDB_SNAPSHOT_H__
+#define NETDB_SNAPSHOT_H__
+
+#include <inttypes.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <fstream>
+#include <functional>
+#include "Identity.h"
+
+namespace boost { namespace interprocess { class mapped_region; } }
+
+namespace i2p
+{
+namespace data
+{
+	const char NETDB_SNAPSHOT_FILENAME[] = "netDb.snapshot";
+	const char NETDB_SNAPSHOT_SIGNATURE[] = "I2PDNDB1"; // 8 bytes, last is version
+	const size_t NETDB_SNAPSHOT_SIGNATURE_SIZE = 8;
+	const size_t NETDB_SNAPSHOT_RECORD_HEADER_SIZE = 34; // ident hash + 2 bytes length, zero length means removed
+	const size_t NETDB_SNAPSHOT_MIN_COMPACTION_SIZE = 1024*1024; // 1M
+	const int NETDB_SNAPSHOT_COMPACTION_RATIO = 2; // compact if file is twice larger than live records
+
+	/**
+	 * @brief append-only log of RouterInfo buffers in one file, mapped into memory
+	 *
+	 * Every update appends a new record, removal appends an empty record.
+	 * The index of live records is built by one sequential scan of the file at open.
+	 * Compaction rewrites live records into a new file and can run in a separate thread.
+	 */
+	class RouterInfoSnapshot
+	{
+		public:
+
+			typedef std::function<void (const IdentHash&, const uint8_t *, size_t)> RecordVisitor;
+
+			RouterInfoSnapshot ();
+			~RouterInfoSnapshot ();
+
+			bool Open (const std::string& path); // creates new file if doesn't exist
+			void Close ();
+			bool IsOpen () const { return m_IsOpen; };
+			size_t GetNumRecords () const;
+			size_t GetFileSize () const;
+
+			void Put (const IdentHash& ident, const uint8_t * buf, size_t len);
+			void Remove (const IdentHash& ident);
+			void Flush (); // written records become visible for Get and Iterate
+			bool Get (const IdentHash& ident, uint8_t * buf, size_t& len) const; // copy, len is buffer size on input
+			void Iterate (RecordVisitor v) const; // live records in file order, pointers are valid until next Flush
+
+			bool NeedsCompaction () const;
+			void Compact ();
+
+		private:
+
+			bool Map () const;
+			size_t Scan (); // returns length of valid part of the file
+
+		private:
+
+			struct Record
+			{
+				size_t offset; // of data
+				uint16_t len;
+			};
+
+			std::string m_Path;
+			std::atomic<bool> m_IsOpen; // read without lock
+			mutable std::mutex m_Mutex;
+			mutable std::ofstream m_File; // for appends
+			size_t m_FileSize, m_LiveSize;
+			mutable std::shared_ptr<boost::interprocess::mapped_region> m_Region;
+			std::unordered_map<IdentHash, Record> m_Index;
+	};
+}
+}
+
+#endif
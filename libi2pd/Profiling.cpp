@@ -6,9 +6,15 @@
 * See full license text in LICENSE file at top of project tree
 */
 
-#include <sys/stat.h>
+#include <string.h>
+#include <fstream>
+#include <unordered_map>
+#include <mutex>
+#include <zlib.h>
+#include <boost/filesystem.hpp>
 #include <boost/property_tree/ptree.hpp>
 #include <boost/property_tree/ini_parser.hpp>
+#include "I2PEndian.h"
 #include "Base.h"
 #include "FS.h"
 #include "Log.h"
@@ -18,7 +24,9 @@ namespace i2p
 {
 namespace data
 {
-	i2p::fs::HashedStorage m_ProfilesStorage("peerProfiles", "p", "profile-", "txt");
+	i2p::fs::HashedStorage m_ProfilesStorage("peerProfiles", "p", "profile-", "txt"); // old format, imported
+	static std::mutex m_ProfilesMutex;
+	static std::unordered_map<IdentHash, std::shared_ptr<RouterProfile> > m_Profiles;
 
 	RouterProfile::RouterProfile ():
 		m_LastUpdateTime (boost::posix_time::second_clock::local_time()),
@@ -37,46 +45,31 @@ namespace data
 		m_LastUpdateTime = GetTime ();
 	}
 
-	void RouterProfile::Save (const IdentHash& identHash)
+	void RouterProfile::Save (uint8_t * buf) const
 	{
-		// fill sections
-		boost::property_tree::ptree participation;
-		participation.put (PEER_PROFILE_PARTICIPATION_AGREED, m_NumTunnelsAgreed);
-		participation.put (PEER_PROFILE_PARTICIPATION_DECLINED, m_NumTunnelsDeclined);
-		participation.put (PEER_PROFILE_PARTICIPATION_NON_REPLIED, m_NumTunnelsNonReplied);
-		boost::property_tree::ptree usage;
-		usage.put (PEER_PROFILE_USAGE_TAKEN, m_NumTimesTaken);
-		usage.put (PEER_PROFILE_USAGE_REJECTED, m_NumTimesRejected);
-		// fill property tree
-		boost::property_tree::ptree pt;
-		pt.put (PEER_PROFILE_LAST_UPDATE_TIME, boost::posix_time::to_simple_string (m_LastUpdateTime));
-		pt.put_child (PEER_PROFILE_SECTION_PARTICIPATION, participation);
-		pt.put_child (PEER_PROFILE_SECTION_USAGE, usage);
-
-		// save to file
-		std::string ident = identHash.ToBase64 ();
-		std::string path = m_ProfilesStorage.Path(ident);
+		static const boost::posix_time::ptime epoch (boost::gregorian::date (1970, 1, 1));
+		htobe64buf (buf, (m_LastUpdateTime - epoch).total_seconds ());
+		htobe32buf (buf + 8, m_NumTunnelsAgreed);
+		htobe32buf (buf + 12, m_NumTunnelsDeclined);
+		htobe32buf (buf + 16, m_NumTunnelsNonReplied);
+		htobe32buf (buf + 20, m_NumTimesTaken);
+		htobe32buf (buf + 24, m_NumTimesRejected);
+	}
 
-		try {
-			boost::property_tree::write_ini (path, pt);
-		} catch (std::exception& ex) {
-			/* boost exception verbose enough */
-			LogPrint (eLogError, "Profiling: ", ex.what ());
-		}
+	void RouterProfile::Load (const uint8_t * buf)
+	{
+		static const boost::posix_time::ptime epoch (boost::gregorian::date (1970, 1, 1));
+		m_LastUpdateTime = epoch + boost::posix_time::seconds ((long)bufbe64toh (buf));
+		m_NumTunnelsAgreed = bufbe32toh (buf + 8);
+		m_NumTunnelsDeclined = bufbe32toh (buf + 12);
+		m_NumTunnelsNonReplied = bufbe32toh (buf + 16);
+		m_NumTimesTaken = bufbe32toh (buf + 20);
+		m_NumTimesRejected = bufbe32toh (buf + 24);
 	}
 
-	void RouterProfile::Load (const IdentHash& identHash)
+	bool RouterProfile::LoadFromFile (const std::string& path)
 	{
-		std::string ident = identHash.ToBase64 ();
-		std::string path = m_ProfilesStorage.Path(ident);
 		boost::property_tree::ptree pt;
-
-		if (!i2p::fs::Exists(path))
-		{
-			LogPrint(eLogWarning, "Profiling: no profile yet for ", ident);
-			return;
-		}
-
 		try
 		{
 			boost::property_tree::read_ini (path, pt);
@@ -84,7 +77,7 @@ namespace data
 		{
 			/* boost exception verbose enough */
 			LogPrint (eLogError, "Profiling: ", ex.what ());
-			return;
+			return false;
 		}
 
 		try
@@ -92,39 +85,37 @@ namespace data
 			auto t = pt.get (PEER_PROFILE_LAST_UPDATE_TIME, "");
 			if (t.length () > 0)
 				m_LastUpdateTime = boost::posix_time::time_from_string (t);
-			if ((GetTime () - m_LastUpdateTime).hours () < PEER_PROFILE_EXPIRATION_TIMEOUT)
+			if (IsExpired ()) return false;
+			try
 			{
-				try
-				{
-					// read participations
-					auto participations = pt.get_child (PEER_PROFILE_SECTION_PARTICIPATION);
-					m_NumTunnelsAgreed = participations.get (PEER_PROFILE_PARTICIPATION_AGREED, 0);
-					m_NumTunnelsDeclined = participations.get (PEER_PROFILE_PARTICIPATION_DECLINED, 0);
-					m_NumTunnelsNonReplied = participations.get (PEER_PROFILE_PARTICIPATION_NON_REPLIED, 0);
-				}
-				catch (boost::property_tree::ptree_bad_path& ex)
-				{
-					LogPrint (eLogWarning, "Profiling: Missing section ", PEER_PROFILE_SECTION_PARTICIPATION, " in profile for ", ident);
-				}
-				try
-				{
-					// read usage
-					auto usage = pt.get_child (PEER_PROFILE_SECTION_USAGE);
-					m_NumTimesTaken = usage.get (PEER_PROFILE_USAGE_TAKEN, 0);
-					m_NumTimesRejected = usage.get (PEER_PROFILE_USAGE_REJECTED, 0);
-				}
-				catch (boost::property_tree::ptree_bad_path& ex)
-				{
-					LogPrint (eLogWarning, "Missing section ", PEER_PROFILE_SECTION_USAGE, " in profile for ", ident);
-				}
+				// read participations
+				auto participations = pt.get_child (PEER_PROFILE_SECTION_PARTICIPATION);
+				m_NumTunnelsAgreed = participations.get (PEER_PROFILE_PARTICIPATION_AGREED, 0);
+				m_NumTunnelsDeclined = participations.get (PEER_PROFILE_PARTICIPATION_DECLINED, 0);
+				m_NumTunnelsNonReplied = participations.get (PEER_PROFILE_PARTICIPATION_NON_REPLIED, 0);
+			}
+			catch (boost::property_tree::ptree_bad_path& ex)
+			{
+				LogPrint (eLogWarning, "Profiling: Missing section ", PEER_PROFILE_SECTION_PARTICIPATION, " in profile ", path);
+			}
+			try
+			{
+				// read usage
+				auto usage = pt.get_child (PEER_PROFILE_SECTION_USAGE);
+				m_NumTimesTaken = usage.get (PEER_PROFILE_USAGE_TAKEN, 0);
+				m_NumTimesRejected = usage.get (PEER_PROFILE_USAGE_REJECTED, 0);
+			}
+			catch (boost::property_tree::ptree_bad_path& ex)
+			{
+				LogPrint (eLogWarning, "Missing section ", PEER_PROFILE_SECTION_USAGE, " in profile ", path);
 			}
-			else
-				*this = RouterProfile ();
 		}
 		catch (std::exception& ex)
 		{
-			LogPrint (eLogError, "Profiling: Can't read profile ", ident, " :", ex.what ());
+			LogPrint (eLogError, "Profiling: Can't read profile ", path, " :", ex.what ());
+			return false;
 		}
+		return true;
 	}
 
 	void RouterProfile::TunnelBuildResponse (uint8_t ret)
@@ -168,36 +159,121 @@ namespace data
 		return isBad;
 	}
 
+	bool RouterProfile::IsExpired () const
+	{
+		return (GetTime () - m_LastUpdateTime).hours () >= PEER_PROFILE_EXPIRATION_TIMEOUT;
+	}
+
 	std::shared_ptr<RouterProfile> GetRouterProfile (const IdentHash& identHash)
 	{
-		auto profile = std::make_shared<RouterProfile> ();
-		profile->Load (identHash); // if possible
+		std::unique_lock<std::mutex> l(m_ProfilesMutex);
+		auto& profile = m_Profiles[identHash];
+		if (!profile)
+			profile = std::make_shared<RouterProfile> ();
 		return profile;
 	}
 
+	static void ImportProfiles ()
+	{
+		// profiles from per-router files of previous versions
+		std::vector<std::string> files;
+		m_ProfilesStorage.Traverse(files);
+		if (files.empty ()) return;
+		const std::string prefix = "profile-";
+		int numImported = 0;
+		for (const auto& path: files)
+		{
+			auto name = path.substr (path.find_last_of (i2p::fs::dirSep) + 1);
+			if (name.compare (0, prefix.length (), prefix) || name.length () < prefix.length () + 44) continue;
+			IdentHash ident;
+			if (ident.FromBase64 (name.substr (prefix.length (), 44)) == 32)
+			{
+				auto profile = std::make_shared<RouterProfile> ();
+				if (profile->LoadFromFile (path))
+				{
+					m_Profiles[ident] = profile;
+					numImported++;
+				}
+			}
+			i2p::fs::Remove (path);
+		}
+		LogPrint (eLogInfo, "Profiling: ", numImported, " of ", files.size (), " profiles imported from ", m_ProfilesStorage.GetRoot ());
+	}
+
 	void InitProfilesStorage ()
 	{
 		m_ProfilesStorage.SetPlace(i2p::fs::GetDataDir());
 		m_ProfilesStorage.Init(i2p::data::GetBase64SubstitutionTable(), 64);
+
+		std::unique_lock<std::mutex> l(m_ProfilesMutex);
+		m_Profiles.clear ();
+		std::string path = i2p::fs::DataDirPath (PEER_PROFILES_FILENAME);
+		std::ifstream f (path, std::ifstream::binary);
+		if (f.is_open ())
+		{
+			std::vector<uint8_t> buf ((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+			size_t len = buf.size ();
+			if (len < PEER_PROFILES_SIGNATURE_SIZE + 4 || memcmp (buf.data (), PEER_PROFILES_SIGNATURE, PEER_PROFILES_SIGNATURE_SIZE) ||
+				(len - PEER_PROFILES_SIGNATURE_SIZE - 4) % PEER_PROFILE_RECORD_SIZE ||
+				crc32 (0, buf.data (), len - 4) != bufbe32toh (buf.data () + len - 4))
+				LogPrint (eLogError, "Profiling: ", path, " is malformed. Ignored");
+			else
+			{
+				for (size_t offset = PEER_PROFILES_SIGNATURE_SIZE; offset < len - 4; offset += PEER_PROFILE_RECORD_SIZE)
+				{
+					auto profile = std::make_shared<RouterProfile> ();
+					profile->Load (buf.data () + offset + 32);
+					if (!profile->IsExpired ())
+						m_Profiles[IdentHash (buf.data () + offset)] = profile;
+				}
+				LogPrint (eLogInfo, "Profiling: ", m_Profiles.size (), " profiles loaded");
+			}
+		}
+		ImportProfiles ();
 	}
 
-	void DeleteObsoleteProfiles ()
+	void SaveProfiles ()
 	{
-		struct stat st;
-		std::time_t now = std::time(nullptr);
-
-		std::vector<std::string> files;
-		m_ProfilesStorage.Traverse(files);
-		for (const auto& path: files) {
-			if (stat(path.c_str(), &st) != 0) {
-				LogPrint(eLogWarning, "Profiling: Can't stat(): ", path);
-				continue;
-			}
-			if (((now - st.st_mtime) / 3600) >= PEER_PROFILE_EXPIRATION_TIMEOUT) {
-				LogPrint(eLogDebug, "Profiling: removing expired peer profile: ", path);
-				i2p::fs::Remove(path);
+		std::vector<uint8_t> buf;
+		{
+			std::unique_lock<std::mutex> l(m_ProfilesMutex);
+			buf.resize (PEER_PROFILES_SIGNATURE_SIZE + m_Profiles.size ()*PEER_PROFILE_RECORD_SIZE + 4);
+			memcpy (buf.data (), PEER_PROFILES_SIGNATURE, PEER_PROFILES_SIGNATURE_SIZE);
+			size_t offset = PEER_PROFILES_SIGNATURE_SIZE;
+			for (const auto& it: m_Profiles)
+			{
+				memcpy (buf.data () + offset, it.first, 32);
+				it.second->Save (buf.data () + offset + 32);
+				offset += PEER_PROFILE_RECORD_SIZE;
 			}
 		}
+		size_t len = buf.size ();
+		htobe32buf (buf.data () + len - 4, crc32 (0, buf.data (), len - 4));
+		// write to temporary file first to keep previous one if failed
+		std::string path = i2p::fs::DataDirPath (PEER_PROFILES_FILENAME), tmpPath = path + ".tmp";
+		std::ofstream f (tmpPath, std::ofstream::binary | std::ofstream::out | std::ofstream::trunc);
+		f.write ((const char *)buf.data (), len);
+		f.close ();
+		boost::system::error_code ec;
+		if (f)
+			boost::filesystem::rename (tmpPath, path, ec);
+		if (!f || ec)
+			LogPrint (eLogError, "Profiling: Can't save profiles to ", path);
+		else
+			LogPrint (eLogDebug, "Profiling: ", (len - PEER_PROFILES_SIGNATURE_SIZE - 4)/PEER_PROFILE_RECORD_SIZE, " profiles saved");
+	}
+
+	void DeleteObsoleteProfiles ()
+	{
+		std::unique_lock<std::mutex> l(m_ProfilesMutex);
+		for (auto it = m_Profiles.begin (); it != m_Profiles.end ();)
+		{
+			// profile is still in use if referenced by RouterInfo
+			if (it->second.use_count () == 1 && it->second->IsExpired ())
+				it = m_Profiles.erase (it);
+			else
+				++it;
+		}
 	}
 }
 }
@@ -30,6 +30,13 @@ namespace data
 
 	const int PEER_PROFILE_EXPIRATION_TIMEOUT = 72; // in hours (3 days)
 
+	// binary storage
+	const char PEER_PROFILES_FILENAME[] = "profiles.dat";
+	const char PEER_PROFILES_SIGNATURE[] = "I2PDPRF1"; // 8 bytes, last is version
+	const size_t PEER_PROFILES_SIGNATURE_SIZE = 8;
+	const size_t PEER_PROFILE_RECORD_SIZE = 32 + 8 + 5*4; // ident, last update time, counters
+	const int PEER_PROFILES_SAVE_INTERVAL = 30*60; // in seconds
+
 	class RouterProfile
 	{
 		public:
@@ -37,10 +44,12 @@ namespace data
 			RouterProfile ();
 			RouterProfile& operator= (const RouterProfile& ) = default;
 
-			void Save (const IdentHash& identHash);
-			void Load (const IdentHash& identHash);
+			void Save (uint8_t * buf) const; // PEER_PROFILE_RECORD_SIZE - 32 bytes
+			void Load (const uint8_t * buf);
+			bool LoadFromFile (const std::string& path); // old per-router format
 
 			bool IsBad ();
+			bool IsExpired () const;
 
 			void TunnelBuildResponse (uint8_t ret);
 			void TunnelNonReplied ();
@@ -66,8 +75,9 @@ namespace data
 			uint32_t m_NumTimesRejected;
 	};
 
-	std::shared_ptr<RouterProfile> GetRouterProfile (const IdentHash& identHash);
-	void InitProfilesStorage ();
+	std::shared_ptr<RouterProfile> GetRouterProfile (const IdentHash& identHash); // creates if not found
+	void InitProfilesStorage (); // loads all profiles
+	void SaveProfiles ();
 	void DeleteObsoleteProfiles ();
 }
 }
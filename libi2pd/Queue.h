@@ -9,10 +9,14 @@
 #ifndef QUEUE_H__
 #define QUEUE_H__
 
+#include <inttypes.h>
 #include <queue>
 #include <vector>
+#include <iterator>
 #include <mutex>
+#include <atomic>
 #include <thread>
+#include <chrono>
 #include <condition_variable>
 #include <functional>
 #include <utility>
@@ -127,6 +131,280 @@ namespace util
 			std::mutex m_QueueMutex;
 			std::condition_variable m_NonEmpty;
 	};
+
+	const size_t MPSC_QUEUE_DEFAULT_CAPACITY = 4096; // rounded up to power of 2
+	const size_t MPSC_QUEUE_CACHE_LINE_SIZE = 64;
+	const int MPSC_QUEUE_SPIN_COUNT = 16; // yields before consumer parks
+
+	/**
+	 * Bounded lock-free multiple producers/single consumer ring with the same interface as Queue.
+	 * Producers reserve cells with one CAS per batch and publish them by cell sequence numbers,
+	 * consumer is woken up only if it's parked. If the ring is full, elements go to a locked
+	 * overflow list, and ring is not used until consumer drains it, to keep producers' order
+	 */
+	template<typename Element>
+	class MPSCQueue
+	{
+		struct Cell
+		{
+			std::atomic<size_t> seq;
+			Element data;
+		};
+
+		public:
+
+			MPSCQueue (size_t capacity = MPSC_QUEUE_DEFAULT_CAPACITY):
+				m_Tail (0), m_Head (0), m_IsOverflowed (false), m_NumOverflowed (0), m_IsWaiting (false), m_IsWokenUp (false)
+			{
+				size_t size = 2;
+				while (size < capacity) size <<= 1;
+				m_Mask = size - 1;
+				m_Cells = new Cell[size];
+				for (size_t i = 0; i < size; i++)
+					m_Cells[i].seq.store (i, std::memory_order_relaxed);
+			}
+
+			~MPSCQueue () { delete[] m_Cells; }
+
+			MPSCQueue (const MPSCQueue&) = delete;
+			MPSCQueue& operator= (const MPSCQueue&) = delete;
+
+			void Put (Element e)
+			{
+				if (m_IsOverflowed.load () || !TryPush (&e, 1))
+					PutOverflow (&e, 1);
+				NotifyConsumer ();
+			}
+
+			template<template<typename, typename...>class Container, typename... R>
+			void Put (const Container<Element, R...>& vec)
+			{
+				if (vec.empty ()) return;
+				auto it = vec.begin ();
+				size_t num = vec.size (), maxBatch = (m_Mask + 1)/2;
+				while (num > 0)
+				{
+					size_t batch = num < maxBatch ? num : maxBatch;
+					if (m_IsOverflowed.load () || !TryPush (it, batch))
+						break;
+					std::advance (it, batch);
+					num -= batch;
+				}
+				if (num > 0) PutOverflow (it, num);
+				NotifyConsumer ();
+			}
+
+			// consumer only
+			Element Get ()
+			{
+				Element el;
+				if (!m_Pending.empty ())
+				{
+					el = std::move (m_Pending.front ());
+					m_Pending.pop ();
+					m_NumOverflowed--;
+				}
+				else if (!TryPop (el) && m_IsOverflowed.load ())
+				{
+					std::unique_lock<std::mutex> l(m_OverflowMutex);
+					// ring must be drained before elements from overflow
+					if (!TryPop (el))
+					{
+						std::swap (m_Pending, m_Overflow);
+						m_IsOverflowed.store (false);
+						l.unlock ();
+						if (!m_Pending.empty ())
+						{
+							el = std::move (m_Pending.front ());
+							m_Pending.pop ();
+							m_NumOverflowed--;
+						}
+					}
+				}
+				return el;
+			}
+
+			// consumer only, returns number of elements added to msgs
+			size_t Get (std::vector<Element>& msgs, size_t maxNum)
+			{
+				size_t num = 0;
+				while (num < maxNum)
+				{
+					auto el = Get ();
+					if (!el) break;
+					msgs.push_back (std::move (el));
+					num++;
+				}
+				return num;
+			}
+
+			Element GetNext ()
+			{
+				auto el = GetWithSpin ();
+				if (!el)
+				{
+					WaitFor (std::chrono::milliseconds (0));
+					el = Get ();
+				}
+				return el;
+			}
+
+			Element GetNextWithTimeout (int usec)
+			{
+				auto el = GetWithSpin ();
+				if (!el)
+				{
+					WaitFor (std::chrono::milliseconds (usec));
+					el = Get ();
+				}
+				return el;
+			}
+
+			void Wait ()
+			{
+				WaitFor (std::chrono::milliseconds (0));
+			}
+
+			bool Wait (int sec, int usec)
+			{
+				return WaitFor (std::chrono::seconds (sec) + std::chrono::milliseconds (usec));
+			}
+
+			bool IsEmpty () { return !GetSize (); }
+
+			int GetSize ()
+			{
+				return m_Tail.load (std::memory_order_relaxed) - m_Head.load (std::memory_order_relaxed) + m_NumOverflowed.load ();
+			}
+
+			void WakeUp ()
+			{
+				m_IsWokenUp.store (true); // not lost if consumer is not parked yet
+				std::unique_lock<std::mutex> l(m_WaitMutex);
+				m_NonEmpty.notify_all ();
+			}
+
+		private:
+
+			template<typename It>
+			bool TryPush (It it, size_t num)
+			{
+				if (num > m_Mask + 1) return false;
+				size_t pos = m_Tail.load (std::memory_order_relaxed);
+				for (;;)
+				{
+					// consumer frees cells in order, so if the last one is free, all are
+					auto& last = m_Cells[(pos + num - 1) & m_Mask];
+					size_t seq = last.seq.load (std::memory_order_acquire);
+					intptr_t diff = (intptr_t)seq - (intptr_t)(pos + num - 1);
+					if (!diff)
+					{
+						if (m_Tail.compare_exchange_weak (pos, pos + num, std::memory_order_relaxed))
+							break;
+					}
+					else if (diff < 0)
+						return false; // full
+					else
+						pos = m_Tail.load (std::memory_order_relaxed);
+				}
+				for (size_t i = 0; i < num; i++, ++it)
+				{
+					auto& cell = m_Cells[(pos + i) & m_Mask];
+					cell.data = *it;
+					cell.seq.store (pos + i + 1, std::memory_order_release);
+				}
+				return true;
+			}
+
+			template<typename It>
+			void PutOverflow (It it, size_t num)
+			{
+				std::unique_lock<std::mutex> l(m_OverflowMutex);
+				if (!m_IsOverflowed.load () && TryPush (it, num)) return; // consumer has drained it meanwhile
+				for (size_t i = 0; i < num; i++, ++it)
+					m_Overflow.push (*it);
+				m_NumOverflowed += num;
+				m_IsOverflowed.store (true);
+			}
+
+			bool TryPop (Element& el)
+			{
+				size_t head = m_Head.load (std::memory_order_relaxed);
+				auto& cell = m_Cells[head & m_Mask];
+				if (cell.seq.load (std::memory_order_acquire) != head + 1) return false; // empty or not published yet
+				el = std::move (cell.data);
+				cell.data = Element ();
+				cell.seq.store (head + m_Mask + 1, std::memory_order_release);
+				m_Head.store (head + 1, std::memory_order_relaxed);
+				return true;
+			}
+
+			bool IsReadyForConsumer ()
+			{
+				size_t head = m_Head.load (std::memory_order_relaxed);
+				return !m_Pending.empty () || m_IsOverflowed.load () ||
+					m_Cells[head & m_Mask].seq.load (std::memory_order_acquire) == head + 1;
+			}
+
+			Element GetWithSpin ()
+			{
+				auto el = Get ();
+				for (int i = 0; !el && i < MPSC_QUEUE_SPIN_COUNT; i++)
+				{
+					std::this_thread::yield ();
+					el = Get ();
+				}
+				return el;
+			}
+
+			// zero timeout means no timeout, returns false if timeout expired
+			template<typename Duration>
+			bool WaitFor (Duration timeout)
+			{
+				std::unique_lock<std::mutex> l(m_WaitMutex);
+				m_IsWaiting.store (true);
+				std::atomic_thread_fence (std::memory_order_seq_cst);
+				bool ret = true;
+				if (!IsReadyForConsumer () && !m_IsWokenUp.exchange (false))
+				{
+					if (timeout.count () > 0)
+						ret = m_NonEmpty.wait_for (l, timeout) != std::cv_status::timeout;
+					else
+						m_NonEmpty.wait (l);
+					m_IsWokenUp.store (false);
+				}
+				m_IsWaiting.store (false);
+				return ret;
+			}
+
+			void NotifyConsumer ()
+			{
+				std::atomic_thread_fence (std::memory_order_seq_cst);
+				if (m_IsWaiting.load (std::memory_order_relaxed))
+				{
+					std::unique_lock<std::mutex> l(m_WaitMutex);
+					m_NonEmpty.notify_one ();
+				}
+			}
+
+		private:
+
+			Cell * m_Cells;
+			size_t m_Mask;
+			uint8_t m_Padding0[MPSC_QUEUE_CACHE_LINE_SIZE];
+			std::atomic<size_t> m_Tail; // producers
+			uint8_t m_Padding1[MPSC_QUEUE_CACHE_LINE_SIZE - sizeof (std::atomic<size_t>)];
+			std::atomic<size_t> m_Head; // consumer
+			std::queue<Element> m_Pending; // consumer, taken from m_Overflow
+			uint8_t m_Padding2[MPSC_QUEUE_CACHE_LINE_SIZE];
+			std::mutex m_OverflowMutex;
+			std::queue<Element> m_Overflow;
+			std::atomic<bool> m_IsOverflowed;
+			std::atomic<int> m_NumOverflowed; // in m_Overflow and m_Pending
+			std::mutex m_WaitMutex;
+			std::condition_variable m_NonEmpty;
+			std::atomic<bool> m_IsWaiting, m_IsWokenUp;
+	};
 }
 }
 
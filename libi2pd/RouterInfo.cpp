@@ -42,7 +42,7 @@ namespace data
 		ReadFromFile ();
 	}
 
-	RouterInfo::RouterInfo (const uint8_t * buf, int len):
+	RouterInfo::RouterInfo (const uint8_t * buf, int len, bool verifySignature):
 		m_IsUpdated (true), m_IsUnreachable (false), m_SupportedTransports (0),
 		m_Caps (0), m_Version (0)
 	{
@@ -52,7 +52,7 @@ namespace data
 			m_Buffer = new uint8_t[MAX_RI_BUFFER_SIZE];
 			memcpy (m_Buffer, buf, len);
 			m_BufferLen = len;
-			ReadFromBuffer (true);
+			ReadFromBuffer (verifySignature);
 		}
 		else
 		{
@@ -639,6 +639,14 @@ namespace data
 		return m_Buffer;
 	}
 
+	void RouterInfo::SetBuffer (const uint8_t * buf, size_t len)
+	{
+		if (len > MAX_RI_BUFFER_SIZE) return;
+		if (!m_Buffer) m_Buffer = new uint8_t[MAX_RI_BUFFER_SIZE];
+		memcpy (m_Buffer, buf, len);
+		m_BufferLen = len;
+	}
+
 	void RouterInfo::CreateBuffer (const PrivateKeys& privateKeys)
 	{
 		m_Timestamp = i2p::util::GetMillisecondsSinceEpoch (); // refresh timstamp
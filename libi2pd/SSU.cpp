@@ -7,8 +7,14 @@
 */
 
 #include <string.h>
+#include <algorithm>
 #include <boost/bind.hpp>
+#ifdef SSU_USE_MMSG
+#include <sys/socket.h>
+#include <errno.h>
+#endif
 #include "Log.h"
+#include "Config.h"
 #include "Timestamp.h"
 #include "RouterContext.h"
 #include "NetDb.hpp"
@@ -20,28 +26,33 @@ namespace transport
 {
 
 	SSUServer::SSUServer (const boost::asio::ip::address & addr, int port):
-		m_OnlyV6(true), m_IsRunning(false),
+		m_OnlyV6(true), m_IsRunning(false), m_IsBatchIO (false),
 		m_Thread (nullptr), m_ThreadV6 (nullptr), m_ReceiversThread (nullptr),
 		m_ReceiversThreadV6 (nullptr), m_Work (m_Service), m_WorkV6 (m_ServiceV6),
 		m_ReceiversWork (m_ReceiversService), m_ReceiversWorkV6 (m_ReceiversServiceV6),
 		m_EndpointV6 (addr, port), m_Socket (m_ReceiversService, m_Endpoint),
 		m_SocketV6 (m_ReceiversServiceV6), m_IntroducersUpdateTimer (m_Service),
 		m_PeerTestsCleanupTimer (m_Service), m_TerminationTimer (m_Service),
-		m_TerminationTimerV6 (m_ServiceV6)
+		m_TerminationTimerV6 (m_ServiceV6), m_IsSendBlocked (false), m_IsSendBlockedV6 (false),
+		m_NumReceivedPackets (0), m_NumReceiveSyscalls (0), m_NumSentPackets (0), m_NumSendSyscalls (0)
 	{
+		m_ReceivedPackets.fill (nullptr); m_ReceivedPacketsV6.fill (nullptr);
 		OpenSocketV6 ();
 	}
 
 	SSUServer::SSUServer (int port):
-		m_OnlyV6(false), m_IsRunning(false),
+		m_OnlyV6(false), m_IsRunning(false), m_IsBatchIO (false),
 		m_Thread (nullptr), m_ThreadV6 (nullptr), m_ReceiversThread (nullptr),
 		m_ReceiversThreadV6 (nullptr), 	m_Work (m_Service), m_WorkV6 (m_ServiceV6),
 		m_ReceiversWork (m_ReceiversService), m_ReceiversWorkV6 (m_ReceiversServiceV6),
 		m_Endpoint (boost::asio::ip::udp::v4 (), port), m_EndpointV6 (boost::asio::ip::udp::v6 (), port),
 		m_Socket (m_ReceiversService), m_SocketV6 (m_ReceiversServiceV6),
 		m_IntroducersUpdateTimer (m_Service), m_PeerTestsCleanupTimer (m_Service),
-		m_TerminationTimer (m_Service), m_TerminationTimerV6 (m_ServiceV6)
+		m_TerminationTimer (m_Service), m_TerminationTimerV6 (m_ServiceV6),
+		m_IsSendBlocked (false), m_IsSendBlockedV6 (false), m_NumReceivedPackets (0),
+		m_NumReceiveSyscalls (0), m_NumSentPackets (0), m_NumSendSyscalls (0)
 	{
+		m_ReceivedPackets.fill (nullptr); m_ReceivedPacketsV6.fill (nullptr);
 		OpenSocket ();
 		if (context.SupportsV6 ())
 			OpenSocketV6 ();
@@ -49,6 +60,12 @@ namespace transport
 
 	SSUServer::~SSUServer ()
 	{
+		for (auto& it: m_ReceivedPackets)
+			m_PacketsPool.ReleaseMt (it);
+		for (auto& it: m_ReceivedPacketsV6)
+			m_PacketsPool.ReleaseMt (it);
+		m_PacketsPool.ReleaseMt (m_SendQueue);
+		m_PacketsPool.ReleaseMt (m_SendQueueV6);
 	}
 
 	void SSUServer::OpenSocket ()
@@ -89,6 +106,11 @@ namespace transport
 	void SSUServer::Start ()
 	{
 		m_IsRunning = true;
+#ifdef SSU_USE_MMSG
+		i2p::config::GetOption ("ssummsg", m_IsBatchIO);
+		if (m_IsBatchIO)
+			LogPrint (eLogInfo, "SSU: Using recvmmsg/sendmmsg");
+#endif
 		if (!m_OnlyV6)
 		{
 			m_ReceiversThread = new std::thread (std::bind (&SSUServer::RunReceivers, this));
@@ -110,6 +132,13 @@ namespace transport
 	void SSUServer::Stop ()
 	{
 		DeleteAllSessions ();
+#ifdef SSU_USE_MMSG
+		if (m_IsBatchIO)
+		{
+			FlushSendQueue (false);
+			FlushSendQueue (true);
+		}
+#endif
 		m_IsRunning = false;
 		m_TerminationTimer.cancel ();
 		m_TerminationTimerV6.cancel ();
@@ -243,26 +272,189 @@ namespace transport
 
 	void SSUServer::Send (const uint8_t * buf, size_t len, const boost::asio::ip::udp::endpoint& to)
 	{
-		if (to.protocol () == boost::asio::ip::udp::v4())
+		bool v6 = to.protocol () != boost::asio::ip::udp::v4();
+#ifdef SSU_USE_MMSG
+		if (m_IsBatchIO)
+		{
+			// coalesce packets sent during current event loop turn
+			auto packet = m_PacketsPool.AcquireMt ();
+			memcpy (packet->buf, buf, len);
+			packet->len = len;
+			packet->from = to;
+			bool isFirst = false;
+			{
+				std::unique_lock<std::mutex> l(m_SendQueueMutex);
+				auto& queue = v6 ? m_SendQueueV6 : m_SendQueue;
+				isFirst = queue.empty ();
+				queue.push_back (packet);
+			}
+			// always flushed in service's thread, sendmmsg calls of two flushes might interleave otherwise
+			if (isFirst)
+				(v6 ? m_ServiceV6 : m_Service).post (std::bind (&SSUServer::FlushSendQueue, this, v6));
+			return;
+		}
+#endif
+		m_NumSendSyscalls++; m_NumSentPackets++;
+		if (!v6)
 			m_Socket.send_to (boost::asio::buffer (buf, len), to);
 		else
 			m_SocketV6.send_to (boost::asio::buffer (buf, len), to);
 	}
 
+#ifdef SSU_USE_MMSG
+	void SSUServer::FlushSendQueue (bool v6)
+	{
+		std::vector<SSUPacket *> packets;
+		{
+			std::unique_lock<std::mutex> l(m_SendQueueMutex);
+			if (v6 ? m_IsSendBlockedV6 : m_IsSendBlocked) return; // will be flushed by HandleReadyToSend
+			std::swap (packets, v6 ? m_SendQueueV6 : m_SendQueue);
+		}
+		if (packets.empty ()) return;
+		auto& socket = v6 ? m_SocketV6 : m_Socket;
+		mmsghdr msgs[SSU_MAX_NUM_SENT_PACKETS];
+		iovec iovs[SSU_MAX_NUM_SENT_PACKETS];
+		size_t offset = 0;
+		while (offset < packets.size ())
+		{
+			size_t num = std::min (packets.size () - offset, SSU_MAX_NUM_SENT_PACKETS);
+			memset (msgs, 0, num*sizeof (mmsghdr));
+			for (size_t i = 0; i < num; i++)
+			{
+				auto packet = packets[offset + i];
+				iovs[i].iov_base = packet->buf;
+				iovs[i].iov_len = packet->len;
+				msgs[i].msg_hdr.msg_name = packet->from.data ();
+				msgs[i].msg_hdr.msg_namelen = packet->from.size ();
+				msgs[i].msg_hdr.msg_iov = iovs + i;
+				msgs[i].msg_hdr.msg_iovlen = 1;
+			}
+			int sent = sendmmsg (socket.native_handle (), msgs, num, 0);
+			m_NumSendSyscalls++;
+			if (sent > 0)
+			{
+				m_NumSentPackets += sent;
+				offset += sent;
+			}
+			else if (errno == EAGAIN || errno == EWOULDBLOCK)
+			{
+				// socket buffer is full, put remaining packets back in front of the queue
+				{
+					std::unique_lock<std::mutex> l(m_SendQueueMutex);
+					auto& queue = v6 ? m_SendQueueV6 : m_SendQueue;
+					queue.insert (queue.begin (), packets.begin () + offset, packets.end ());
+					(v6 ? m_IsSendBlockedV6 : m_IsSendBlocked) = true;
+				}
+				packets.resize (offset);
+				socket.async_wait (boost::asio::ip::udp::socket::wait_write,
+					std::bind (&SSUServer::HandleReadyToSend, this, std::placeholders::_1, v6));
+				break;
+			}
+			else if (errno != EINTR)
+			{
+				LogPrint (eLogError, "SSU: sendmmsg error: ", strerror (errno));
+				offset++; // skip packet
+			}
+		}
+		m_PacketsPool.ReleaseMt (packets);
+	}
+
+	void SSUServer::HandleReadyToSend (const boost::system::error_code& ecode, bool v6)
+	{
+		{
+			std::unique_lock<std::mutex> l(m_SendQueueMutex);
+			(v6 ? m_IsSendBlockedV6 : m_IsSendBlocked) = false;
+		}
+		if (ecode != boost::asio::error::operation_aborted) // we are in receivers' thread
+			(v6 ? m_ServiceV6 : m_Service).post (std::bind (&SSUServer::FlushSendQueue, this, v6));
+	}
+#endif
+
 	void SSUServer::Receive ()
 	{
-		SSUPacket * packet = new SSUPacket ();
+#ifdef SSU_USE_MMSG
+		if (m_IsBatchIO)
+		{
+			m_Socket.async_wait (boost::asio::ip::udp::socket::wait_read,
+				std::bind (&SSUServer::HandleReadyToReceive, this, std::placeholders::_1, false));
+			return;
+		}
+#endif
+		SSUPacket * packet = m_PacketsPool.AcquireMt ();
 		m_Socket.async_receive_from (boost::asio::buffer (packet->buf, SSU_MTU_V4), packet->from,
 			std::bind (&SSUServer::HandleReceivedFrom, this, std::placeholders::_1, std::placeholders::_2, packet));
 	}
 
 	void SSUServer::ReceiveV6 ()
 	{
-		SSUPacket * packet = new SSUPacket ();
+#ifdef SSU_USE_MMSG
+		if (m_IsBatchIO)
+		{
+			m_SocketV6.async_wait (boost::asio::ip::udp::socket::wait_read,
+				std::bind (&SSUServer::HandleReadyToReceive, this, std::placeholders::_1, true));
+			return;
+		}
+#endif
+		SSUPacket * packet = m_PacketsPool.AcquireMt ();
 		m_SocketV6.async_receive_from (boost::asio::buffer (packet->buf, SSU_MTU_V6), packet->from,
 			std::bind (&SSUServer::HandleReceivedFromV6, this, std::placeholders::_1, std::placeholders::_2, packet));
 	}
 
+#ifdef SSU_USE_MMSG
+	void SSUServer::HandleReadyToReceive (const boost::system::error_code& ecode, bool v6)
+	{
+		auto& socket = v6 ? m_SocketV6 : m_Socket;
+		if (ecode)
+		{
+			if (ecode != boost::asio::error::operation_aborted)
+			{
+				LogPrint (eLogError, "SSU: receive error: ", ecode.message ());
+				socket.close ();
+				if (v6) { OpenSocketV6 (); ReceiveV6 (); }
+				else { OpenSocket (); Receive (); }
+			}
+			return;
+		}
+		// preallocated packets, the ones passed to handler are replaced
+		auto& ring = v6 ? m_ReceivedPacketsV6 : m_ReceivedPackets;
+		mmsghdr msgs[SSU_MAX_NUM_RECEIVED_PACKETS];
+		iovec iovs[SSU_MAX_NUM_RECEIVED_PACKETS];
+		memset (msgs, 0, sizeof (msgs));
+		for (size_t i = 0; i < SSU_MAX_NUM_RECEIVED_PACKETS; i++)
+		{
+			if (!ring[i]) ring[i] = m_PacketsPool.AcquireMt ();
+			iovs[i].iov_base = ring[i]->buf;
+			iovs[i].iov_len = v6 ? SSU_MTU_V6 : SSU_MTU_V4;
+			msgs[i].msg_hdr.msg_name = ring[i]->from.data ();
+			msgs[i].msg_hdr.msg_namelen = ring[i]->from.capacity ();
+			msgs[i].msg_hdr.msg_iov = iovs + i;
+			msgs[i].msg_hdr.msg_iovlen = 1;
+		}
+		int num = recvmmsg (socket.native_handle (), msgs, SSU_MAX_NUM_RECEIVED_PACKETS, MSG_DONTWAIT, nullptr);
+		m_NumReceiveSyscalls++;
+		if (num > 0)
+		{
+			std::vector<SSUPacket *> packets;
+			packets.reserve (num);
+			for (int i = 0; i < num; i++)
+			{
+				ring[i]->len = msgs[i].msg_len;
+				ring[i]->from.resize (msgs[i].msg_hdr.msg_namelen);
+				packets.push_back (ring[i]);
+				ring[i] = nullptr;
+			}
+			m_NumReceivedPackets += num;
+			if (v6)
+				m_ServiceV6.post (std::bind (&SSUServer::HandleReceivedPackets, this, packets, true));
+			else
+				m_Service.post (std::bind (&SSUServer::HandleReceivedPackets, this, packets, false));
+		}
+		else if (num < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+			LogPrint (eLogError, "SSU: recvmmsg error: ", strerror (errno));
+		if (v6) ReceiveV6 (); else Receive ();
+	}
+#endif
+
 	void SSUServer::HandleReceivedFrom (const boost::system::error_code& ecode, std::size_t bytes_transferred, SSUPacket * packet)
 	{
 		if (!ecode)
@@ -271,35 +463,38 @@ namespace transport
 			std::vector<SSUPacket *> packets;
 			packets.push_back (packet);
 
+			m_NumReceiveSyscalls += 2; m_NumReceivedPackets++; // receive and available
 			boost::system::error_code ec;
 			size_t moreBytes = m_Socket.available(ec);
 			if (!ec)
 			{
-				while (moreBytes && packets.size () < 25)
+				while (moreBytes && packets.size () < SSU_MAX_NUM_RECEIVED_PACKETS)
 				{
-					packet = new SSUPacket ();
+					m_NumReceiveSyscalls += 2;
+					packet = m_PacketsPool.AcquireMt ();
 					packet->len = m_Socket.receive_from (boost::asio::buffer (packet->buf, SSU_MTU_V4), packet->from, 0, ec);
 					if (!ec)
 					{
 						packets.push_back (packet);
+						m_NumReceivedPackets++;
 						moreBytes = m_Socket.available(ec);
 						if (ec) break;
 					}
 					else
 					{
 						LogPrint (eLogError, "SSU: receive_from error: ", ec.message ());
-						delete packet;
+						m_PacketsPool.ReleaseMt (packet);
 						break;
 					}
 				}
 			}
 
-			m_Service.post (std::bind (&SSUServer::HandleReceivedPackets, this, packets, &m_Sessions));
+			m_Service.post (std::bind (&SSUServer::HandleReceivedPackets, this, packets, false));
 			Receive ();
 		}
 		else
 		{
-			delete packet;
+			m_PacketsPool.ReleaseMt (packet);
 			if (ecode != boost::asio::error::operation_aborted)
 			{
 				LogPrint (eLogError, "SSU: receive error: ", ecode.message ());
@@ -318,35 +513,38 @@ namespace transport
 			std::vector<SSUPacket *> packets;
 			packets.push_back (packet);
 
+			m_NumReceiveSyscalls += 2; m_NumReceivedPackets++; // receive and available
 			boost::system::error_code ec;
 			size_t moreBytes = m_SocketV6.available (ec);
 			if (!ec)
 			{
-				while (moreBytes && packets.size () < 25)
+				while (moreBytes && packets.size () < SSU_MAX_NUM_RECEIVED_PACKETS)
 				{
-					packet = new SSUPacket ();
+					m_NumReceiveSyscalls += 2;
+					packet = m_PacketsPool.AcquireMt ();
 					packet->len = m_SocketV6.receive_from (boost::asio::buffer (packet->buf, SSU_MTU_V6), packet->from, 0, ec);
 					if (!ec)
 					{
 						packets.push_back (packet);
+						m_NumReceivedPackets++;
 						moreBytes = m_SocketV6.available(ec);
 						if (ec) break;
 					}
 					else
 					{
 						LogPrint (eLogError, "SSU: v6 receive_from error: ", ec.message ());
-						delete packet;
+						m_PacketsPool.ReleaseMt (packet);
 						break;
 					}
 				}
 			}
 
-			m_ServiceV6.post (std::bind (&SSUServer::HandleReceivedPackets, this, packets, &m_SessionsV6));
+			m_ServiceV6.post (std::bind (&SSUServer::HandleReceivedPackets, this, packets, true));
 			ReceiveV6 ();
 		}
 		else
 		{
-			delete packet;
+			m_PacketsPool.ReleaseMt (packet);
 			if (ecode != boost::asio::error::operation_aborted)
 			{
 				LogPrint (eLogError, "SSU: v6 receive error: ", ecode.message ());
@@ -357,10 +555,11 @@ namespace transport
 		}
 	}
 
-	void SSUServer::HandleReceivedPackets (std::vector<SSUPacket *> packets,
-		std::map<boost::asio::ip::udp::endpoint, std::shared_ptr<SSUSession> > * sessions)
+	void SSUServer::HandleReceivedPackets (std::vector<SSUPacket *> packets, bool v6)
 	{
-		std::shared_ptr<SSUSession> session;
+		auto& sessions = v6 ? m_SessionsV6 : m_Sessions;
+		auto& lastSession = v6 ? m_LastSessionV6 : m_LastSession;
+		auto session = lastSession; // peers usually send few packets in a row
 		for (auto& packet: packets)
 		{
 			try
@@ -372,14 +571,14 @@ namespace transport
 						session->FlushData ();
 						session = nullptr;
 					}
-					auto it = sessions->find (packet->from);
-					if (it != sessions->end ())
+					auto it = sessions.find (packet->from);
+					if (it != sessions.end ())
 						session = it->second;
 					if (!session)
 					{
 						session = std::make_shared<SSUSession> (*this, packet->from);
 						session->WaitForConnect ();
-						(*sessions)[packet->from] = session;
+						AddSession (session);
 						LogPrint (eLogDebug, "SSU: new session from ", packet->from.address ().to_string (), ":", packet->from.port (), " created");
 					}
 				}
@@ -391,9 +590,20 @@ namespace transport
 				if (session) session->FlushData ();
 				session = nullptr;
 			}
-			delete packet;
 		}
 		if (session) session->FlushData ();
+		lastSession = (session && session->GetState () != eSessionStateClosed) ? session : nullptr; // not deleted
+		m_PacketsPool.ReleaseMt (packets);
+	}
+
+	double SSUServer::GetReceiveSyscallsPerPacket () const
+	{
+		return m_NumReceivedPackets ? (double)m_NumReceiveSyscalls/m_NumReceivedPackets : 0;
+	}
+
+	double SSUServer::GetSendSyscallsPerPacket () const
+	{
+		return m_NumSentPackets ? (double)m_NumSendSyscalls/m_NumSentPackets : 0;
 	}
 
 	std::shared_ptr<SSUSession> SSUServer::FindSession (std::shared_ptr<const i2p::data::RouterInfo> router) const
@@ -459,7 +669,7 @@ namespace transport
 		{
 			// otherwise create new session
 			auto session = std::make_shared<SSUSession> (*this, remoteEndpoint, router, peerTest);
-			sessions[remoteEndpoint] = session;
+			AddSession (session);
 			// connect
 			LogPrint (eLogDebug, "SSU: Creating new session to [", i2p::data::GetIdentHashAbbreviation (router->GetIdentHash ()), "] ",
 				remoteEndpoint.address ().to_string (), ":", remoteEndpoint.port ());
@@ -521,7 +731,7 @@ namespace transport
 						LogPrint (eLogDebug, "SSU: Creating new session to introducer ", introducer->iHost);
 						boost::asio::ip::udp::endpoint introducerEndpoint (introducer->iHost, introducer->iPort);
 						introducerSession = std::make_shared<SSUSession> (*this, introducerEndpoint, router);
-						m_Sessions[introducerEndpoint] = introducerSession;
+						AddSession (introducerSession);
 					}
 #if BOOST_VERSION >= 104900
 					if (!address->host.is_unspecified () && address->port)
@@ -529,7 +739,7 @@ namespace transport
 					{
 						// create session
 						auto session = std::make_shared<SSUSession> (*this, remoteEndpoint, router, peerTest);
-						m_Sessions[remoteEndpoint] = session;
+						AddSession (session);
 
 						// introduce
 						LogPrint (eLogInfo, "SSU: Introduce new session to [", i2p::data::GetIdentHashAbbreviation (router->GetIdentHash ()),
@@ -551,6 +761,23 @@ namespace transport
 		}
 	}
 
+	void SSUServer::AddSession (std::shared_ptr<SSUSession> session)
+	{
+		auto& ep = session->GetRemoteEndpoint ();
+		if (ep.address ().is_v6 ())
+			m_SessionsV6[ep] = session;
+		else
+			m_Sessions[ep] = session;
+		AddToTerminationWheel (session);
+	}
+
+	void SSUServer::RescheduleTermination (std::shared_ptr<SSUSession> session)
+	{
+		// the wheel entry at previous termination time is skipped
+		if (session->GetTerminationTime () < session->GetTerminationCheckTime ())
+			AddToTerminationWheel (session);
+	}
+
 	void SSUServer::DeleteSession (std::shared_ptr<SSUSession> session)
 	{
 		if (session)
@@ -558,9 +785,15 @@ namespace transport
 			session->Close ();
 			auto& ep = session->GetRemoteEndpoint ();
 			if (ep.address ().is_v6 ())
+			{
 				m_SessionsV6.erase (ep);
+				if (m_LastSessionV6 == session) m_LastSessionV6 = nullptr;
+			}
 			else
+			{
 				m_Sessions.erase (ep);
+				if (m_LastSession == session) m_LastSession = nullptr;
+			}
 		}
 	}
 
@@ -569,56 +802,74 @@ namespace transport
 		for (auto& it: m_Sessions)
 			it.second->Close ();
 		m_Sessions.clear ();
+		m_LastSession = nullptr;
+		m_EstablishedSessions.clear ();
+		m_TerminationWheel.Clear ();
 
 		for (auto& it: m_SessionsV6)
 			it.second->Close ();
 		m_SessionsV6.clear ();
+		m_LastSessionV6 = nullptr;
+		m_EstablishedSessionsV6.clear ();
+		m_TerminationWheelV6.Clear ();
+	}
+
+	void SSUServer::AddEstablishedSession (std::shared_ptr<SSUSession> session)
+	{
+		if (session->GetRemoteEndpoint ().address ().is_v6 ())
+			m_EstablishedSessionsV6.push_back (session);
+		else
+			m_EstablishedSessions.push_back (session);
 	}
 
 	template<typename Filter>
-	std::shared_ptr<SSUSession> SSUServer::GetRandomV4Session (Filter filter) // v4 only
+	std::shared_ptr<SSUSession> SSUServer::GetRandomSession (std::vector<std::weak_ptr<SSUSession> >& sessions, Filter filter)
 	{
-		std::vector<std::shared_ptr<SSUSession> > filteredSessions;
-		for (const auto& s :m_Sessions)
-			if (filter (s.second)) filteredSessions.push_back (s.second);
-		if (filteredSessions.size () > 0)
+		// start from random position, take first matching, drop no longer established on the way
+		if (sessions.empty ()) return nullptr;
+		size_t ind = rand () % sessions.size ();
+		for (size_t i = 0; i < sessions.size () && !sessions.empty ();)
 		{
-			auto ind = rand () % filteredSessions.size ();
-			return filteredSessions[ind];
+			if (ind >= sessions.size ()) ind = 0;
+			auto session = sessions[ind].lock ();
+			if (!session || session->GetState () != eSessionStateEstablished)
+			{
+				sessions[ind] = sessions.back ();
+				sessions.pop_back ();
+				continue;
+			}
+			if (filter (session)) return session;
+			ind++; i++;
 		}
 		return nullptr;
 	}
 
+	void SSUServer::CleanupEstablishedSessions (std::vector<std::weak_ptr<SSUSession> >& sessions)
+	{
+		sessions.erase (std::remove_if (sessions.begin (), sessions.end (),
+			[](const std::weak_ptr<SSUSession>& s)
+			{
+				auto session = s.lock ();
+				return !session || session->GetState () != eSessionStateEstablished;
+			}), sessions.end ());
+	}
+
 	std::shared_ptr<SSUSession> SSUServer::GetRandomEstablishedV4Session (std::shared_ptr<const SSUSession> excluded) // v4 only
 	{
-		return GetRandomV4Session (
+		return GetRandomSession (m_EstablishedSessions,
 			[excluded](std::shared_ptr<SSUSession> session)->bool
 			{
-				return session->GetState () == eSessionStateEstablished && session != excluded;
+				return session != excluded;
 			}
 		);
 	}
 
-	template<typename Filter>
-	std::shared_ptr<SSUSession> SSUServer::GetRandomV6Session (Filter filter) // v6 only
-	{
-		std::vector<std::shared_ptr<SSUSession> > filteredSessions;
-		for (const auto& s :m_SessionsV6)
-			if (filter (s.second)) filteredSessions.push_back (s.second);
-		if (filteredSessions.size () > 0)
-		{
-			auto ind = rand () % filteredSessions.size ();
-			return filteredSessions[ind];
-		}
-		return nullptr;
-	}
-
 	std::shared_ptr<SSUSession> SSUServer::GetRandomEstablishedV6Session (std::shared_ptr<const SSUSession> excluded) // v6 only
 	{
-		return GetRandomV6Session (
+		return GetRandomSession (m_EstablishedSessionsV6,
 			[excluded](std::shared_ptr<SSUSession> session)->bool
 			{
-				return session->GetState () == eSessionStateEstablished && session != excluded;
+				return session != excluded;
 			}
 		);
 	}
@@ -629,11 +880,10 @@ namespace transport
 		std::set<SSUSession *> ret;
 		for (int i = 0; i < maxNumIntroducers; i++)
 		{
-			auto session = GetRandomV4Session (
+			auto session = GetRandomSession (m_EstablishedSessions,
 				[&ret, ts](std::shared_ptr<SSUSession> session)->bool
 				{
 					return session->GetRelayTag () && !ret.count (session.get ()) &&
-						session->GetState () == eSessionStateEstablished &&
 						ts < session->GetCreationTime () + SSU_TO_INTRODUCER_SESSION_DURATION;
 				}
 			);
@@ -777,6 +1027,13 @@ namespace transport
 		}
 	}
 
+	void SSUServer::AddToTerminationWheel (std::shared_ptr<SSUSession> session)
+	{
+		auto& wheel = session->IsV6 () ? m_TerminationWheelV6 : m_TerminationWheel;
+		session->SetTerminationCheckTime (session->GetTerminationTime ());
+		wheel.Add (session, session->GetTerminationCheckTime ());
+	}
+
 	void SSUServer::ScheduleTermination ()
 	{
 		m_TerminationTimer.expires_from_now (boost::posix_time::seconds(SSU_TERMINATION_CHECK_TIMEOUT));
@@ -788,19 +1045,8 @@ namespace transport
 	{
 		if (ecode != boost::asio::error::operation_aborted)
 		{
-			auto ts = i2p::util::GetSecondsSinceEpoch ();
-			for (auto& it: m_Sessions)
-				if (it.second->IsTerminationTimeoutExpired (ts))
-				{
-					auto session = it.second;
-					if (it.first != session->GetRemoteEndpoint ())
-						LogPrint (eLogWarning, "SSU: remote endpoint ", session->GetRemoteEndpoint (), " doesn't match key ", it.first, " adjusted");
-					m_Service.post ([session]
-						{
-							LogPrint (eLogWarning, "SSU: no activity with ", session->GetRemoteEndpoint (), " for ", session->GetTerminationTimeout (), " seconds");
-							session->Failed ();
-						});
-				}
+			CheckTermination (m_Sessions, m_TerminationWheel, m_Service);
+			CleanupEstablishedSessions (m_EstablishedSessions);
 			ScheduleTermination ();
 		}
 	}
@@ -816,21 +1062,33 @@ namespace transport
 	{
 		if (ecode != boost::asio::error::operation_aborted)
 		{
-			auto ts = i2p::util::GetSecondsSinceEpoch ();
-			for (auto& it: m_SessionsV6)
-				if (it.second->IsTerminationTimeoutExpired (ts))
-				{
-					auto session = it.second;
-					if (it.first != session->GetRemoteEndpoint ())
-						LogPrint (eLogWarning, "SSU: remote endpoint ", session->GetRemoteEndpoint (), " doesn't match key ", it.first);
-					m_ServiceV6.post ([session]
+			CheckTermination (m_SessionsV6, m_TerminationWheelV6, m_ServiceV6);
+			CleanupEstablishedSessions (m_EstablishedSessionsV6);
+			ScheduleTerminationV6 ();
+		}
+	}
+
+	void SSUServer::CheckTermination (SSUSessions& sessions, i2p::util::TimingWheel<std::weak_ptr<SSUSession> >& wheel,
+		boost::asio::io_service& service)
+	{
+		auto ts = i2p::util::GetSecondsSinceEpoch ();
+		// only sessions due since previous check, active ones are checked again at their new termination time
+		wheel.Advance (ts, [this, &sessions, &service, ts](const std::weak_ptr<SSUSession>& s)
+			{
+				auto session = s.lock ();
+				if (!session || session->GetTerminationCheckTime () > ts) return; // rescheduled, its entry is later
+				session->SetTerminationCheckTime (std::numeric_limits<uint64_t>::max ());
+				auto it = sessions.find (session->GetRemoteEndpoint ());
+				if (it == sessions.end () || it->second != session) return; // deleted or replaced
+				if (!session->IsTerminationTimeoutExpired (ts))
+					AddToTerminationWheel (session);
+				else
+					service.post ([session]
 						{
 							LogPrint (eLogWarning, "SSU: no activity with ", session->GetRemoteEndpoint (), " for ", session->GetTerminationTimeout (), " seconds");
 							session->Failed ();
 						});
-				}
-			ScheduleTerminationV6 ();
-		}
+			});
 	}
 }
 }
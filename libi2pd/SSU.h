@@ -12,10 +12,15 @@
 #include <inttypes.h>
 #include <string.h>
 #include <map>
+#include <unordered_map>
 #include <list>
 #include <set>
 #include <thread>
 #include <mutex>
+#include <atomic>
+#include <array>
+#include <vector>
+#include <boost/version.hpp>
 #include <boost/asio.hpp>
 #include "Crypto.h"
 #include "I2PEndian.h"
@@ -23,6 +28,11 @@
 #include "RouterInfo.h"
 #include "I2NPProtocol.h"
 #include "SSUSession.h"
+#include "util.h"
+
+#if defined(__linux__) && (BOOST_VERSION >= 106600)
+#define SSU_USE_MMSG 1 // recvmmsg/sendmmsg
+#endif
 
 namespace i2p
 {
@@ -35,6 +45,29 @@ namespace transport
 	const size_t SSU_MAX_NUM_INTRODUCERS = 3;
 	const size_t SSU_SOCKET_RECEIVE_BUFFER_SIZE = 0x1FFFF; // 128K
 	const size_t SSU_SOCKET_SEND_BUFFER_SIZE = 0x1FFFF; // 128K
+	const size_t SSU_MAX_NUM_RECEIVED_PACKETS = 25; // per receive
+	const size_t SSU_MAX_NUM_SENT_PACKETS = 32; // per sendmmsg
+
+	struct SSUEndpointHash
+	{
+		size_t operator() (const boost::asio::ip::udp::endpoint& ep) const
+		{
+			uint64_t h = ep.port ();
+			if (ep.address ().is_v4 ())
+				h |= (uint64_t)ep.address ().to_v4 ().to_ulong () << 16;
+			else
+			{
+				auto bytes = ep.address ().to_v6 ().to_bytes ();
+				for (size_t i = 0; i < bytes.size (); i += 8)
+				{
+					uint64_t b; memcpy (&b, bytes.data () + i, 8);
+					h = (h ^ b)*0x9E3779B97F4A7C15ULL;
+				}
+			}
+			return (h*0x9E3779B97F4A7C15ULL) >> 32; // mix port and address bits
+		}
+	};
+	typedef std::unordered_map<boost::asio::ip::udp::endpoint, std::shared_ptr<SSUSession>, SSUEndpointHash> SSUSessions;
 
 	struct SSUPacket
 	{
@@ -60,6 +93,9 @@ namespace transport
 			std::shared_ptr<SSUSession> FindSession (const boost::asio::ip::udp::endpoint& e) const;
 			std::shared_ptr<SSUSession> GetRandomEstablishedV4Session (std::shared_ptr<const SSUSession> excluded);
 			std::shared_ptr<SSUSession> GetRandomEstablishedV6Session (std::shared_ptr<const SSUSession> excluded);
+			void AddEstablishedSession (std::shared_ptr<SSUSession> session);
+			void AddSession (std::shared_ptr<SSUSession> session);
+			void RescheduleTermination (std::shared_ptr<SSUSession> session); // if termination time became earlier, session's thread
 			void DeleteSession (std::shared_ptr<SSUSession> session);
 			void DeleteAllSessions ();
 
@@ -77,6 +113,9 @@ namespace transport
 			void UpdatePeerTest (uint32_t nonce, PeerTestParticipant role);
 			void RemovePeerTest (uint32_t nonce);
 
+			double GetReceiveSyscallsPerPacket () const;
+			double GetSendSyscallsPerPacket () const;
+
 		private:
 
 			void OpenSocket ();
@@ -89,14 +128,17 @@ namespace transport
 			void ReceiveV6 ();
 			void HandleReceivedFrom (const boost::system::error_code& ecode, std::size_t bytes_transferred, SSUPacket * packet);
 			void HandleReceivedFromV6 (const boost::system::error_code& ecode, std::size_t bytes_transferred, SSUPacket * packet);
-			void HandleReceivedPackets (std::vector<SSUPacket *> packets,
-				std::map<boost::asio::ip::udp::endpoint, std::shared_ptr<SSUSession> >* sessions);
+			void HandleReceivedPackets (std::vector<SSUPacket *> packets, bool v6);
+#ifdef SSU_USE_MMSG
+			void HandleReadyToReceive (const boost::system::error_code& ecode, bool v6);
+			void FlushSendQueue (bool v6);
+			void HandleReadyToSend (const boost::system::error_code& ecode, bool v6);
+#endif
 
 			void CreateSessionThroughIntroducer (std::shared_ptr<const i2p::data::RouterInfo> router, bool peerTest = false);
 			template<typename Filter>
-			std::shared_ptr<SSUSession> GetRandomV4Session (Filter filter);
-			template<typename Filter>
-			std::shared_ptr<SSUSession> GetRandomV6Session (Filter filter);
+			std::shared_ptr<SSUSession> GetRandomSession (std::vector<std::weak_ptr<SSUSession> >& sessions, Filter filter);
+			void CleanupEstablishedSessions (std::vector<std::weak_ptr<SSUSession> >& sessions);
 
 			std::set<SSUSession *> FindIntroducers (int maxNumIntroducers);
 			void ScheduleIntroducersUpdateTimer ();
@@ -106,10 +148,13 @@ namespace transport
 			void HandlePeerTestsCleanupTimer (const boost::system::error_code& ecode);
 
 			// timer
+			void AddToTerminationWheel (std::shared_ptr<SSUSession> session);
 			void ScheduleTermination ();
 			void HandleTerminationTimer (const boost::system::error_code& ecode);
 			void ScheduleTerminationV6 ();
 			void HandleTerminationTimerV6 (const boost::system::error_code& ecode);
+			void CheckTermination (SSUSessions& sessions, i2p::util::TimingWheel<std::weak_ptr<SSUSession> >& wheel,
+				boost::asio::io_service& service);
 
 		private:
 
@@ -121,7 +166,7 @@ namespace transport
 			};
 
 			bool m_OnlyV6;
-			bool m_IsRunning;
+			bool m_IsRunning, m_IsBatchIO;
 			std::thread * m_Thread, * m_ThreadV6, * m_ReceiversThread, * m_ReceiversThreadV6;
 			boost::asio::io_service m_Service, m_ServiceV6, m_ReceiversService, m_ReceiversServiceV6;
 			boost::asio::io_service::work m_Work, m_WorkV6, m_ReceiversWork, m_ReceiversWorkV6;
@@ -130,9 +175,18 @@ namespace transport
 			boost::asio::deadline_timer m_IntroducersUpdateTimer, m_PeerTestsCleanupTimer,
 				m_TerminationTimer, m_TerminationTimerV6;
 			std::list<boost::asio::ip::udp::endpoint> m_Introducers; // introducers we are connected to
-			std::map<boost::asio::ip::udp::endpoint, std::shared_ptr<SSUSession> > m_Sessions, m_SessionsV6;
+			SSUSessions m_Sessions, m_SessionsV6;
+			std::shared_ptr<SSUSession> m_LastSession, m_LastSessionV6; // received previous packet
+			std::vector<std::weak_ptr<SSUSession> > m_EstablishedSessions, m_EstablishedSessionsV6; // for random pick, closed are removed lazily
+			i2p::util::TimingWheel<std::weak_ptr<SSUSession> > m_TerminationWheel, m_TerminationWheelV6; // in seconds
 			std::map<uint32_t, std::shared_ptr<SSUSession> > m_Relays; // we are introducer
 			std::map<uint32_t, PeerTest> m_PeerTests; // nonce -> creation time in milliseconds
+			i2p::util::MemoryPoolMt<SSUPacket> m_PacketsPool;
+			std::array<SSUPacket *, SSU_MAX_NUM_RECEIVED_PACKETS> m_ReceivedPackets, m_ReceivedPacketsV6; // for recvmmsg
+			std::vector<SSUPacket *> m_SendQueue, m_SendQueueV6; // for sendmmsg
+			bool m_IsSendBlocked, m_IsSendBlockedV6; // socket buffer is full, send queue is flushed when writable
+			std::mutex m_SendQueueMutex;
+			std::atomic<uint64_t> m_NumReceivedPackets, m_NumReceiveSyscalls, m_NumSentPackets, m_NumSendSyscalls;
 
 		public:
 			// for HTTP only
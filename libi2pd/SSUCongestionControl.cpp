@@ -0,0 +1,81 @@
+/*
+* Copyright (c) 2013-2020, The PurpleI2P Project
+*
+* This file is part of Purple i2pd project and licensed under BSD3
+*
+* See full license text in LICENSE file at top of project tree
+*/
+
+#include <stdlib.h>
+#include "SSUCongestionControl.h"
+
+namespace i2p
+{
+namespace transport
+{
+	SSUCongestionControl::SSUCongestionControl (size_t packetSize):
+		m_PacketSize (packetSize), m_Window (SSU_INITIAL_WINDOW*packetSize),
+		m_SlowStartThreshold (SSU_MAX_WINDOW*packetSize), m_NumAckedBytes (0),
+		m_SRTT (SSU_INITIAL_RTO), m_RTTVar (0), m_RTO (SSU_INITIAL_RTO), m_HasRTTSample (false),
+		m_RecoverySeqn (0)
+	{
+	}
+
+	void SSUCongestionControl::SetPacketSize (size_t packetSize)
+	{
+		if (!packetSize || packetSize == m_PacketSize) return;
+		// keep window in packets
+		m_Window = m_Window/m_PacketSize*packetSize;
+		m_SlowStartThreshold = m_SlowStartThreshold/m_PacketSize*packetSize;
+		m_PacketSize = packetSize;
+	}
+
+	void SSUCongestionControl::UpdateRTT (int rtt)
+	{
+		if (rtt <= 0) rtt = 1;
+		if (!m_HasRTTSample)
+		{
+			m_SRTT = rtt;
+			m_RTTVar = rtt/2;
+			m_HasRTTSample = true;
+		}
+		else
+		{
+			m_RTTVar = (3*m_RTTVar + abs (m_SRTT - rtt))/4;
+			m_SRTT = (7*m_SRTT + rtt)/8;
+		}
+		m_RTO = m_SRTT + 4*m_RTTVar;
+		if (m_RTO < SSU_MIN_RTO) m_RTO = SSU_MIN_RTO;
+		if (m_RTO > SSU_MAX_RTO) m_RTO = SSU_MAX_RTO;
+	}
+
+	void SSUCongestionControl::OnAck (size_t numBytes)
+	{
+		if (m_Window < m_SlowStartThreshold)
+			m_Window += numBytes; // slow start
+		else
+		{
+			// additive increase, one packet per window
+			m_NumAckedBytes += numBytes;
+			if (m_NumAckedBytes >= m_Window)
+			{
+				m_NumAckedBytes -= m_Window;
+				m_Window += m_PacketSize;
+			}
+		}
+		if (m_Window > SSU_MAX_WINDOW*m_PacketSize) m_Window = SSU_MAX_WINDOW*m_PacketSize;
+	}
+
+	bool SSUCongestionControl::OnCongestion (uint32_t seqn, uint32_t lastSentSeqn)
+	{
+		if ((int32_t)(seqn - m_RecoverySeqn) <= 0) return false; // sent before last reduction
+		// multiplicative decrease
+		m_RecoverySeqn = lastSentSeqn;
+		m_SlowStartThreshold = m_Window/2;
+		if (m_SlowStartThreshold < SSU_MIN_WINDOW*m_PacketSize) m_SlowStartThreshold = SSU_MIN_WINDOW*m_PacketSize;
+		m_Window = m_SlowStartThreshold;
+		m_NumAckedBytes = 0;
+		return true;
+	}
+}
+}
@@ -0,0 +1,60 @@
+/*
+* Copyright (c) 2013-2020, The PurpleI2P Project
+*
+* This file is part of Purple i2pd project and licensed under BSD3
+*
+* See full license text in LICENSE file at top of project tree
+*/
+
+#ifndef SSU_CONGESTION_CONTROL_H__
+#define SSU_CONGESTION_CONTROL_H__
+
+#include <inttypes.h>
+#include <stddef.h>
+
+namespace i2p
+{
+namespace transport
+{
+	const int SSU_INITIAL_RTO = 1000; // in milliseconds, until first RTT sample
+	const int SSU_MIN_RTO = 200; // in milliseconds
+	const int SSU_MAX_RTO = 10000; // in milliseconds
+	const int SSU_FAST_RETRANSMIT_NACKS = 2; // resend if acks for packets sent after came that many times
+	const int SSU_INITIAL_WINDOW = 32; // in packets
+	const int SSU_MIN_WINDOW = 4; // in packets
+	const int SSU_MAX_WINDOW = 512; // in packets
+
+	/**
+	 * @brief RTT estimation and congestion window in bytes of SSU session
+	 *
+	 * RTO is SRTT + 4*RTTVAR (RFC 6298). Window grows by acknowledged bytes in slow start
+	 * and by one packet per window after, halves on loss or ECN, once per window of packets.
+	 */
+	class SSUCongestionControl
+	{
+		public:
+
+			SSUCongestionControl (size_t packetSize);
+
+			void SetPacketSize (size_t packetSize);
+			void UpdateRTT (int rtt); // in milliseconds, from message sent once
+			void OnAck (size_t numBytes);
+			bool OnCongestion (uint32_t seqn, uint32_t lastSentSeqn); // seqn of lost or marked packet, returns true if window reduced
+
+			size_t GetWindow () const { return m_Window; };
+			size_t GetSlowStartThreshold () const { return m_SlowStartThreshold; };
+			int GetRTT () const { return m_SRTT; };
+			int GetRTTVar () const { return m_RTTVar; };
+			int GetRTO () const { return m_RTO; };
+
+		private:
+
+			size_t m_PacketSize, m_Window, m_SlowStartThreshold, m_NumAckedBytes;
+			int m_SRTT, m_RTTVar, m_RTO;
+			bool m_HasRTTSample;
+			uint32_t m_RecoverySeqn; // packets sent before last reduction don't reduce window again
+	};
+}
+}
+
+#endif
@@ -9,7 +9,6 @@
 #include <stdlib.h>
 #include <boost/bind.hpp>
 #include "Log.h"
-#include "Timestamp.h"
 #include "NetDb.hpp"
 #include "SSU.h"
 #include "SSUData.h"
@@ -32,11 +31,11 @@ namespace transport
 		nextFragmentNum++;
 	}
 
-	SSUData::SSUData (SSUSession& session):
-		m_Session (session), m_ResendTimer (session.GetService ()),
-		m_IncompleteMessagesCleanupTimer (session.GetService ()),
-		m_MaxPacketSize (session.IsV6 () ? SSU_V6_MAX_PACKET_SIZE : SSU_V4_MAX_PACKET_SIZE),
-		m_PacketSize (m_MaxPacketSize), m_LastMessageReceivedTime (0)
+	SSUData::SSUData (SSUDataSession& session):
+		m_Session (session), m_MaxPacketSize (session.IsV6 () ? SSU_V6_MAX_PACKET_SIZE : SSU_V4_MAX_PACKET_SIZE),
+		m_PacketSize (m_MaxPacketSize), m_LastMessageReceivedTime (0),
+		m_CongestionControl (m_PacketSize), m_NumBytesInFlight (0), m_NextSendSeqn (1), m_LastAckedSeqn (0),
+		m_NextResendTime (0)
 	{
 	}
 
@@ -46,16 +45,18 @@ namespace transport
 
 	void SSUData::Start ()
 	{
-		ScheduleIncompleteMessagesCleanup ();
+		m_Session.ScheduleIncompleteMessagesCleanup ();
 	}
 
 	void SSUData::Stop ()
 	{
-		m_ResendTimer.cancel ();
-		m_IncompleteMessagesCleanupTimer.cancel ();
+		// session cancels timers
 		m_IncompleteMessages.clear ();
 		m_SentMessages.clear ();
 		m_ReceivedMessages.clear ();
+		m_PendingMessages.clear ();
+		m_NumBytesInFlight = 0;
+		m_NextResendTime = 0;
 	}
 
 	void SSUData::AdjustPacketSize (std::shared_ptr<const i2p::data::RouterInfo> remoteRouter)
@@ -74,6 +75,7 @@ namespace transport
 				m_PacketSize >>= 4;
 				m_PacketSize <<= 4;
 				if (m_PacketSize > m_MaxPacketSize) m_PacketSize = m_MaxPacketSize;
+				m_CongestionControl.SetPacketSize (m_PacketSize);
 				LogPrint (eLogDebug, "SSU: MTU=", ssuAddress->ssu->mtu, " packet size=", m_PacketSize);
 			}
 			else
@@ -96,9 +98,16 @@ namespace transport
 		auto it = m_SentMessages.find (msgID);
 		if (it != m_SentMessages.end ())
 		{
+			auto& sentMessage = it->second;
+			if (!sentMessage->numResends) // can't tell which transmission is acknowledged otherwise
+				m_CongestionControl.UpdateRTT (m_Session.GetMillisecondsSinceEpoch () - sentMessage->sendTime);
+			auto numBytes = sentMessage->GetNumUnackedBytes ();
+			m_NumBytesInFlight = numBytes < m_NumBytesInFlight ? m_NumBytesInFlight - numBytes : 0;
+			m_CongestionControl.OnAck (numBytes);
+			if ((int32_t)(sentMessage->sendSeqn - m_LastAckedSeqn) > 0) m_LastAckedSeqn = sentMessage->sendSeqn;
 			m_SentMessages.erase (it);
 			if (m_SentMessages.empty ())
-				m_ResendTimer.cancel ();
+				m_NextResendTime = 0; // timer finds nothing to resend
 		}
 	}
 
@@ -126,6 +135,7 @@ namespace transport
 				// process individual Ack bitfields
 				bool isNonLast = false;
 				int fragment = 0;
+				int lastAckedFragment = -1;
 				do
 				{
 					uint8_t bitfield = *buf;
@@ -141,7 +151,16 @@ namespace transport
 							if (bitfield & mask)
 							{
 								if (fragment < numSentFragments)
-									it->second->fragments[fragment].reset (nullptr);
+								{
+									auto& f = it->second->fragments[fragment];
+									if (f)
+									{
+										m_NumBytesInFlight = f->len < m_NumBytesInFlight ? m_NumBytesInFlight - f->len : 0;
+										m_CongestionControl.OnAck (f->len);
+										f.reset (nullptr);
+									}
+								}
+								lastAckedFragment = fragment;
 							}
 							fragment++;
 							mask <<= 1;
@@ -150,8 +169,42 @@ namespace transport
 					buf++;
 				}
 				while (isNonLast);
+				if (lastAckedFragment > 0 && it != m_SentMessages.end ())
+				{
+					auto& sentMessage = it->second;
+					if ((int32_t)(sentMessage->sendSeqn - m_LastAckedSeqn) > 0) m_LastAckedSeqn = sentMessage->sendSeqn;
+					// fragments sent before acknowledged one are probably lost
+					int numSentFragments = sentMessage->fragments.size ();
+					for (int j = 0; j < lastAckedFragment && j < numSentFragments; j++)
+					{
+						auto& f = sentMessage->fragments[j];
+						if (f && ++f->numNACKs >= SSU_FAST_RETRANSMIT_NACKS)
+						{
+							m_CongestionControl.OnCongestion (sentMessage->sendSeqn, m_NextSendSeqn - 1);
+							f->numNACKs = 0;
+							try
+							{
+								m_Session.Send (f->buf, f->len); // resend
+							}
+							catch (boost::system::system_error& ec)
+							{
+								LogPrint (eLogWarning, "SSU: Can't resend message ", msgID, " data fragment: ", ec.what ());
+							}
+						}
+					}
+				}
 			}
 		}
+		if (m_LastAckedSeqn)
+		{
+			// messages sent before acknowledged ones are probably lost
+			std::vector<uint32_t> lost;
+			for (auto& it: m_SentMessages)
+				if ((int32_t)(it.second->sendSeqn - m_LastAckedSeqn) < 0 && ++it.second->numNACKs >= SSU_FAST_RETRANSMIT_NACKS)
+					lost.push_back (it.first);
+			if (!lost.empty ())
+				FastRetransmit (lost);
+		}
 	}
 
 	void SSUData::ProcessFragments (uint8_t * buf)
@@ -222,7 +275,7 @@ namespace transport
 					LogPrint (eLogWarning, "SSU: Missing fragments from ", (int)incompleteMessage->nextFragmentNum, " to ", fragmentNum - 1, " of message ", msgID);
 					auto savedFragment = new Fragment (fragmentNum, buf, fragmentSize, isLast);
 					if (incompleteMessage->savedFragments.insert (std::unique_ptr<Fragment>(savedFragment)).second)
-						incompleteMessage->lastFragmentInsertTime = i2p::util::GetSecondsSinceEpoch ();
+						incompleteMessage->lastFragmentInsertTime = m_Session.GetMillisecondsSinceEpoch ()/1000;
 					else
 						LogPrint (eLogWarning, "SSU: Fragment ", (int)fragmentNum, " of message ", msgID, " already saved");
 				}
@@ -238,12 +291,12 @@ namespace transport
 				// process message
 				SendMsgAck (msgID);
 				msg->FromSSU (msgID);
-				if (m_Session.GetState () == eSessionStateEstablished)
+				if (m_Session.IsEstablished ())
 				{
 					if (!m_ReceivedMessages.count (msgID))
 					{
 						m_ReceivedMessages.insert (msgID);
-						m_LastMessageReceivedTime = i2p::util::GetSecondsSinceEpoch ();
+						m_LastMessageReceivedTime = m_Session.GetMillisecondsSinceEpoch ()/1000;
 						if (!msg->IsExpired ())
 						{
 							m_Handler.PutNextMessage (msg);
@@ -283,9 +336,18 @@ namespace transport
 		uint8_t flag = *buf;
 		buf++;
 		LogPrint (eLogDebug, "SSU: Process data, flags=", (int)flag, ", len=", len);
+		if (flag & DATA_FLAG_EXPLICIT_CONGESTION_NOTIFICATION)
+		{
+			// peer is congested, same as loss but nothing to resend
+			if (m_CongestionControl.OnCongestion (m_LastAckedSeqn, m_NextSendSeqn - 1))
+				LogPrint (eLogDebug, "SSU: ECN received, window reduced to ", m_CongestionControl.GetWindow (), " bytes");
+		}
 		// process acks if presented
 		if (flag & (DATA_FLAG_ACK_BITFIELDS_INCLUDED | DATA_FLAG_EXPLICIT_ACKS_INCLUDED))
+		{
 			ProcessAcks (buf, flag);
+			SendPendingMessages ();
+		}
 		// extended data if presented
 		if (flag & DATA_FLAG_EXTENDED_DATA_INCLUDED)
 		{
@@ -299,6 +361,31 @@ namespace transport
 	}
 
 	void SSUData::Send (std::shared_ptr<i2p::I2NPMessage> msg)
+	{
+		if (!m_PendingMessages.empty () || m_NumBytesInFlight >= m_CongestionControl.GetWindow ())
+		{
+			// wait for acks
+			if (m_PendingMessages.size () < SSU_MAX_PENDING_MESSAGES)
+				m_PendingMessages.push_back (msg);
+			else
+				LogPrint (eLogWarning, "SSU: Too many messages waiting for congestion window, dropped");
+			return;
+		}
+		SendMessage (msg);
+	}
+
+	void SSUData::SendPendingMessages ()
+	{
+		while (!m_PendingMessages.empty () && m_NumBytesInFlight < m_CongestionControl.GetWindow ())
+		{
+			auto msg = m_PendingMessages.front ();
+			m_PendingMessages.pop_front ();
+			if (!msg->IsExpired ())
+				SendMessage (msg);
+		}
+	}
+
+	void SSUData::SendMessage (std::shared_ptr<i2p::I2NPMessage> msg)
 	{
 		uint32_t msgID = msg->ToSSU ();
 		if (m_SentMessages.count (msgID) > 0)
@@ -306,15 +393,16 @@ namespace transport
 			LogPrint (eLogWarning, "SSU: message ", msgID, " already sent");
 			return;
 		}
-		if (m_SentMessages.empty ()) // schedule resend at first message only
-			ScheduleResend ();
 
 		auto ret = m_SentMessages.insert (std::make_pair (msgID, std::unique_ptr<SentMessage>(new SentMessage)));
 		std::unique_ptr<SentMessage>& sentMessage = ret.first->second;
 		if (ret.second)
 		{
-			sentMessage->nextResendTime = i2p::util::GetSecondsSinceEpoch () + RESEND_INTERVAL;
+			sentMessage->sendTime = m_Session.GetMillisecondsSinceEpoch ();
+			sentMessage->nextResendTime = sentMessage->sendTime + m_CongestionControl.GetRTO ();
+			sentMessage->sendSeqn = m_NextSendSeqn++;
 			sentMessage->numResends = 0;
+			sentMessage->numNACKs = 0;
 		}
 		auto& fragments = sentMessage->fragments;
 		size_t payloadSize = m_PacketSize - sizeof (SSUHeader) - 9; // 9  =  flag + #frg(1) + messageID(4) + frag info (3)
@@ -351,6 +439,7 @@ namespace transport
 				size = ((size >> 4) + 1) << 4; // (/16 + 1)*16
 			fragment->len = size;
 			fragments.push_back (std::unique_ptr<Fragment> (fragment));
+			m_NumBytesInFlight += size;
 
 			// encrypt message with session key
 			m_Session.FillHeaderAndEncrypt (PAYLOAD_TYPE_DATA, buf, size);
@@ -371,6 +460,8 @@ namespace transport
 				len = 0;
 			fragmentNum++;
 		}
+		if (!m_NextResendTime || sentMessage->nextResendTime < m_NextResendTime)
+			ScheduleResend ();
 	}
 
 	void SSUData::SendMsgAck (uint32_t msgID)
@@ -419,96 +510,114 @@ namespace transport
 		m_Session.Send (buf, len);
 	}
 
-	void SSUData::ScheduleResend()
+	int SSUData::Resend (uint32_t msgID, SentMessage& sentMessage, uint64_t ts)
 	{
-		m_ResendTimer.cancel ();
-		m_ResendTimer.expires_from_now (boost::posix_time::seconds(RESEND_INTERVAL));
-		auto s = m_Session.shared_from_this();
-		m_ResendTimer.async_wait ([s](const boost::system::error_code& ecode)
-			{ s->m_Data.HandleResendTimer (ecode); });
-	}
-
-	void SSUData::HandleResendTimer (const boost::system::error_code& ecode)
-	{
-		if (ecode != boost::asio::error::operation_aborted)
-		{
-			uint32_t ts = i2p::util::GetSecondsSinceEpoch ();
-			int numResent = 0;
-			for (auto it = m_SentMessages.begin (); it != m_SentMessages.end ();)
+		int numResent = 0;
+		for (auto& f: sentMessage.fragments)
+			if (f)
 			{
-				if (ts >= it->second->nextResendTime)
+				try
 				{
-					if (it->second->numResends < MAX_NUM_RESENDS)
-					{
-						for (auto& f: it->second->fragments)
-							if (f)
-							{
-								try
-								{
-									m_Session.Send (f->buf, f->len); // resend
-									numResent++;
-								}
-								catch (boost::system::system_error& ec)
-								{
-									LogPrint (eLogWarning, "SSU: Can't resend message ", it->first, " data fragment: ", ec.what ());
-								}
-							}
-
-						it->second->numResends++;
-						it->second->nextResendTime += it->second->numResends*RESEND_INTERVAL;
-						++it;
-					}
-					else
-					{
-						LogPrint (eLogInfo, "SSU: message ", it->first, " has not been ACKed after ", MAX_NUM_RESENDS, " attempts, deleted");
-						it = m_SentMessages.erase (it);
-					}
+					m_Session.Send (f->buf, f->len); // resend
+					numResent++;
 				}
-				else
-					++it;
-			}
-			if (m_SentMessages.empty ()) return; // nothing to resend
-			if (numResent < MAX_OUTGOING_WINDOW_SIZE)
-				ScheduleResend ();
-			else
-			{
-				LogPrint (eLogError, "SSU: resend window exceeds max size. Session terminated");
-				m_Session.Close ();
+				catch (boost::system::system_error& ec)
+				{
+					LogPrint (eLogWarning, "SSU: Can't resend message ", msgID, " data fragment: ", ec.what ());
+				}
+				f->numNACKs = 0;
 			}
+		sentMessage.numResends++;
+		sentMessage.numNACKs = 0;
+		sentMessage.sendTime = ts;
+		sentMessage.sendSeqn = m_NextSendSeqn++;
+		int rto = m_CongestionControl.GetRTO () << sentMessage.numResends; // back off
+		if (rto > SSU_MAX_RTO) rto = SSU_MAX_RTO;
+		sentMessage.nextResendTime = ts + rto;
+		return numResent;
+	}
+
+	void SSUData::FastRetransmit (const std::vector<uint32_t>& msgIDs)
+	{
+		auto ts = m_Session.GetMillisecondsSinceEpoch ();
+		for (auto msgID: msgIDs)
+		{
+			auto it = m_SentMessages.find (msgID);
+			if (it == m_SentMessages.end () || it->second->numResends >= MAX_NUM_RESENDS) continue;
+			if (m_CongestionControl.OnCongestion (it->second->sendSeqn, m_NextSendSeqn - 1))
+				LogPrint (eLogDebug, "SSU: Fast retransmit, window reduced to ", m_CongestionControl.GetWindow (), " bytes");
+			Resend (msgID, *it->second, ts);
 		}
 	}
 
-	void SSUData::ScheduleIncompleteMessagesCleanup ()
+	void SSUData::ScheduleResend()
 	{
-		m_IncompleteMessagesCleanupTimer.cancel ();
-		m_IncompleteMessagesCleanupTimer.expires_from_now (boost::posix_time::seconds(INCOMPLETE_MESSAGES_CLEANUP_TIMEOUT));
-		auto s = m_Session.shared_from_this();
-		m_IncompleteMessagesCleanupTimer.async_wait ([s](const boost::system::error_code& ecode)
-			{ s->m_Data.HandleIncompleteMessagesCleanupTimer (ecode); });
+		uint64_t nextResendTime = 0;
+		for (const auto& it: m_SentMessages)
+			if (!nextResendTime || it.second->nextResendTime < nextResendTime)
+				nextResendTime = it.second->nextResendTime;
+		if (!nextResendTime) return;
+		m_NextResendTime = nextResendTime;
+		m_Session.ScheduleResend (nextResendTime);
 	}
 
-	void SSUData::HandleIncompleteMessagesCleanupTimer (const boost::system::error_code& ecode)
+	void SSUData::HandleResendTimer ()
 	{
-		if (ecode != boost::asio::error::operation_aborted)
+		m_NextResendTime = 0;
+		auto ts = m_Session.GetMillisecondsSinceEpoch ();
+		int numResent = 0;
+		for (auto it = m_SentMessages.begin (); it != m_SentMessages.end ();)
 		{
-			uint32_t ts = i2p::util::GetSecondsSinceEpoch ();
-			for (auto it = m_IncompleteMessages.begin (); it != m_IncompleteMessages.end ();)
+			if (ts >= it->second->nextResendTime)
 			{
-				if (ts > it->second->lastFragmentInsertTime + INCOMPLETE_MESSAGES_CLEANUP_TIMEOUT)
+				if (it->second->numResends < MAX_NUM_RESENDS)
 				{
-					LogPrint (eLogWarning, "SSU: message ", it->first, " was not completed in ", INCOMPLETE_MESSAGES_CLEANUP_TIMEOUT, " seconds, deleted");
-					it = m_IncompleteMessages.erase (it);
+					if (m_CongestionControl.OnCongestion (it->second->sendSeqn, m_NextSendSeqn - 1))
+						LogPrint (eLogDebug, "SSU: Resend timeout, window reduced to ", m_CongestionControl.GetWindow (), " bytes");
+					numResent += Resend (it->first, *it->second, ts);
+					++it;
 				}
 				else
-					++it;
+				{
+					LogPrint (eLogInfo, "SSU: message ", it->first, " has not been ACKed after ", MAX_NUM_RESENDS, " attempts, deleted");
+					auto numBytes = it->second->GetNumUnackedBytes ();
+					m_NumBytesInFlight = numBytes < m_NumBytesInFlight ? m_NumBytesInFlight - numBytes : 0;
+					it = m_SentMessages.erase (it);
+				}
 			}
-			// decay
-			if (m_ReceivedMessages.size () > MAX_NUM_RECEIVED_MESSAGES ||
-				i2p::util::GetSecondsSinceEpoch () > m_LastMessageReceivedTime + DECAY_INTERVAL)
-				m_ReceivedMessages.clear ();
+			else
+				++it;
+		}
+		SendPendingMessages ();
+		if (m_SentMessages.empty ()) return; // nothing to resend
+		if (numResent < MAX_OUTGOING_WINDOW_SIZE)
+			ScheduleResend ();
+		else
+		{
+			LogPrint (eLogError, "SSU: resend window exceeds max size. Session terminated");
+			m_Session.Close ();
+		}
+	}
 
-			ScheduleIncompleteMessagesCleanup ();
+	void SSUData::HandleIncompleteMessagesCleanupTimer ()
+	{
+		uint32_t ts = m_Session.GetMillisecondsSinceEpoch ()/1000;
+		for (auto it = m_IncompleteMessages.begin (); it != m_IncompleteMessages.end ();)
+		{
+			if (ts > it->second->lastFragmentInsertTime + INCOMPLETE_MESSAGES_CLEANUP_TIMEOUT)
+			{
+				LogPrint (eLogWarning, "SSU: message ", it->first, " was not completed in ", INCOMPLETE_MESSAGES_CLEANUP_TIMEOUT, " seconds, deleted");
+				it = m_IncompleteMessages.erase (it);
+			}
+			else
+				++it;
 		}
+		// decay
+		if (m_ReceivedMessages.size () > MAX_NUM_RECEIVED_MESSAGES ||
+			ts > m_LastMessageReceivedTime + DECAY_INTERVAL)
+			m_ReceivedMessages.clear ();
+
+		m_Session.ScheduleIncompleteMessagesCleanup ();
 	}
 }
 }
@@ -13,12 +13,14 @@
 #include <string.h>
 #include <map>
 #include <vector>
+#include <deque>
 #include <unordered_set>
 #include <memory>
 #include <boost/asio.hpp>
 #include "I2NPProtocol.h"
 #include "Identity.h"
 #include "RouterInfo.h"
+#include "SSUCongestionControl.h"
 
 namespace i2p
 {
@@ -36,7 +38,7 @@ namespace transport
 	const size_t UDP_HEADER_SIZE = 8;
 	const size_t SSU_V4_MAX_PACKET_SIZE = SSU_MTU_V4 - IPV4_HEADER_SIZE - UDP_HEADER_SIZE; // 1456
 	const size_t SSU_V6_MAX_PACKET_SIZE = SSU_MTU_V6 - IPV6_HEADER_SIZE - UDP_HEADER_SIZE; // 1440
-	const int RESEND_INTERVAL = 3; // in seconds
+	const size_t SSU_MAX_PENDING_MESSAGES = 1024; // waiting for congestion window
 	const int MAX_NUM_RESENDS = 5;
 	const int DECAY_INTERVAL = 20; // in seconds
 	const int INCOMPLETE_MESSAGES_CLEANUP_TIMEOUT = 30; // in seconds
@@ -55,6 +57,7 @@ namespace transport
 		int fragmentNum;
 		size_t len;
 		bool isLast;
+		int numNACKs = 0; // later fragments acknowledged
 		uint8_t buf[SSU_V4_MAX_PACKET_SIZE + 18]; // use biggest
 
 		Fragment () = default;
@@ -84,16 +87,47 @@ namespace transport
 	struct SentMessage
 	{
 		std::vector<std::unique_ptr<Fragment> > fragments;
-		uint32_t nextResendTime; // in seconds
-		int numResends;
+		uint64_t sendTime, nextResendTime; // in milliseconds
+		uint32_t sendSeqn; // order of last transmission
+		int numResends, numNACKs;
+
+		size_t GetNumUnackedBytes () const
+		{
+			size_t numBytes = 0;
+			for (const auto& it: fragments)
+				if (it) numBytes += it->len;
+			return numBytes;
+		}
+	};
+
+	/**
+	 * @brief session of SSUData, implemented by SSUSession
+	 *
+	 * SSUData sends packets, takes time and runs its timers through it only
+	 */
+	class SSUDataSession
+	{
+		public:
+
+			virtual ~SSUDataSession () {};
+
+			virtual bool IsV6 () const = 0;
+			virtual bool IsEstablished () const = 0;
+			virtual void Established () = 0; // DeliveryStatus received
+			virtual void Close () = 0;
+			virtual void FillHeaderAndEncrypt (uint8_t payloadType, uint8_t * buf, size_t len) = 0; // with session key
+			virtual void Send (const uint8_t * buf, size_t size) = 0;
+
+			virtual uint64_t GetMillisecondsSinceEpoch () const = 0;
+			virtual void ScheduleResend (uint64_t ts) = 0; // SSUData::HandleResendTimer at ts, replaces previous
+			virtual void ScheduleIncompleteMessagesCleanup () = 0; // SSUData::HandleIncompleteMessagesCleanupTimer in INCOMPLETE_MESSAGES_CLEANUP_TIMEOUT
 	};
 
-	class SSUSession;
 	class SSUData
 	{
 		public:
 
-			SSUData (SSUSession& session);
+			SSUData (SSUDataSession& session);
 			~SSUData ();
 
 			void Start ();
@@ -106,6 +140,9 @@ namespace transport
 			void AdjustPacketSize (std::shared_ptr<const i2p::data::RouterInfo> remoteRouter);
 			void UpdatePacketSize (const i2p::data::IdentHash& remoteIdent);
 
+			void HandleResendTimer ();
+			void HandleIncompleteMessagesCleanupTimer ();
+
 		private:
 
 			void SendMsgAck (uint32_t msgID);
@@ -113,24 +150,27 @@ namespace transport
 			void ProcessAcks (uint8_t *& buf, uint8_t flag);
 			void ProcessFragments (uint8_t * buf);
 			void ProcessSentMessageAck (uint32_t msgID);
+			void SendMessage (std::shared_ptr<i2p::I2NPMessage> msg);
+			void SendPendingMessages ();
+			int Resend (uint32_t msgID, SentMessage& sentMessage, uint64_t ts); // returns number of resent fragments
+			void FastRetransmit (const std::vector<uint32_t>& msgIDs);
 
 			void ScheduleResend ();
-			void HandleResendTimer (const boost::system::error_code& ecode);
-
-			void ScheduleIncompleteMessagesCleanup ();
-			void HandleIncompleteMessagesCleanupTimer (const boost::system::error_code& ecode);
-
 
 		private:
 
-			SSUSession& m_Session;
+			SSUDataSession& m_Session;
 			std::map<uint32_t, std::unique_ptr<IncompleteMessage> > m_IncompleteMessages;
 			std::map<uint32_t, std::unique_ptr<SentMessage> > m_SentMessages;
 			std::unordered_set<uint32_t> m_ReceivedMessages;
-			boost::asio::deadline_timer m_ResendTimer, m_IncompleteMessagesCleanupTimer;
 			int m_MaxPacketSize, m_PacketSize;
 			i2p::I2NPMessagesHandler m_Handler;
 			uint32_t m_LastMessageReceivedTime; // in second
+			SSUCongestionControl m_CongestionControl;
+			size_t m_NumBytesInFlight; // unacknowledged fragments
+			uint32_t m_NextSendSeqn, m_LastAckedSeqn;
+			uint64_t m_NextResendTime; // of timer in milliseconds, 0 if not scheduled
+			std::deque<std::shared_ptr<i2p::I2NPMessage> > m_PendingMessages; // window is full
 	};
 }
 }
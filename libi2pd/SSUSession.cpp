@@ -25,6 +25,7 @@ namespace transport
 		std::shared_ptr<const i2p::data::RouterInfo> router, bool peerTest ):
 		TransportSession (router, SSU_TERMINATION_TIMEOUT),
 		m_Server (server), m_RemoteEndpoint (remoteEndpoint), m_ConnectTimer (GetService ()),
+		m_ResendTimer (GetService ()), m_IncompleteMessagesCleanupTimer (GetService ()),
 		m_IsPeerTest (peerTest),m_State (eSessionStateUnknown), m_IsSessionKey (false),
 		m_RelayTag (0), m_SentRelayTag (0), m_Data (*this), m_IsDataReceived (false)
 	{
@@ -892,6 +893,8 @@ namespace transport
 		transports.PeerDisconnected (shared_from_this ());
 		m_Data.Stop ();
 		m_ConnectTimer.cancel ();
+		m_ResendTimer.cancel ();
+		m_IncompleteMessagesCleanupTimer.cancel ();
 		if (m_SentRelayTag)
 		{
 			m_Server.RemoveRelay (m_SentRelayTag); // relay tag is not valid anymore
@@ -907,9 +910,18 @@ namespace transport
 		GetService ().post (std::bind (&SSUSession::Failed, shared_from_this ()));
 	}
 
+	void SSUSession::SetTerminationTimeout (int terminationTimeout)
+	{
+		bool reduced = terminationTimeout < GetTerminationTimeout ();
+		TransportSession::SetTerminationTimeout (terminationTimeout);
+		if (reduced)
+			GetService ().post (std::bind (&SSUServer::RescheduleTermination, &m_Server, shared_from_this ()));
+	}
+
 	void SSUSession::Established ()
 	{
 		m_State = eSessionStateEstablished;
+		m_Server.AddEstablishedSession (shared_from_this ());
 		m_DHKeysPair = nullptr;
 		m_SignedData = nullptr;
 		m_Data.Start ();
@@ -921,6 +933,34 @@ namespace transport
 		m_LastActivityTimestamp = i2p::util::GetSecondsSinceEpoch ();
 	}
 
+	uint64_t SSUSession::GetMillisecondsSinceEpoch () const
+	{
+		return i2p::util::GetMillisecondsSinceEpoch ();
+	}
+
+	void SSUSession::ScheduleResend (uint64_t ts)
+	{
+		auto now = i2p::util::GetMillisecondsSinceEpoch ();
+		m_ResendTimer.expires_from_now (boost::posix_time::milliseconds(ts > now ? ts - now : 0));
+		auto s = shared_from_this ();
+		m_ResendTimer.async_wait ([s](const boost::system::error_code& ecode)
+			{
+				if (ecode != boost::asio::error::operation_aborted)
+					s->m_Data.HandleResendTimer ();
+			});
+	}
+
+	void SSUSession::ScheduleIncompleteMessagesCleanup ()
+	{
+		m_IncompleteMessagesCleanupTimer.expires_from_now (boost::posix_time::seconds(INCOMPLETE_MESSAGES_CLEANUP_TIMEOUT));
+		auto s = shared_from_this ();
+		m_IncompleteMessagesCleanupTimer.async_wait ([s](const boost::system::error_code& ecode)
+			{
+				if (ecode != boost::asio::error::operation_aborted)
+					s->m_Data.HandleIncompleteMessagesCleanupTimer ();
+			});
+	}
+
 	void SSUSession::Failed ()
 	{
 		if (m_State != eSessionStateFailed)
@@ -930,15 +970,17 @@ namespace transport
 		}
 	}
 
-	void SSUSession::SendI2NPMessages (const std::vector<std::shared_ptr<I2NPMessage> >& msgs)
+	void SSUSession::ScheduleOutgoingQueue ()
 	{
-		GetService ().post (std::bind (&SSUSession::PostI2NPMessages, shared_from_this (), msgs));
+		GetService ().post (std::bind (&SSUSession::PostI2NPMessages, shared_from_this ()));
 	}
 
-	void SSUSession::PostI2NPMessages (std::vector<std::shared_ptr<I2NPMessage> > msgs)
+	void SSUSession::PostI2NPMessages ()
 	{
+		auto msgs = GetOutgoingMessages ();
 		if (m_State == eSessionStateEstablished)
 		{
+			transports.GetTrafficShaper ().Shape (msgs);
 			for (const auto& it: msgs)
 				if (it)
 				{
@@ -71,7 +71,7 @@ namespace transport
 	};
 
 	class SSUServer;
-	class SSUSession: public TransportSession, public std::enable_shared_from_this<SSUSession>
+	class SSUSession: public TransportSession, public SSUDataSession, public std::enable_shared_from_this<SSUSession>
 	{
 		public:
 
@@ -91,10 +91,11 @@ namespace transport
 			const boost::asio::ip::udp::endpoint& GetRemoteEndpoint () { return m_RemoteEndpoint; };
 
 			bool IsV6 () const { return m_RemoteEndpoint.address ().is_v6 (); };
-			void SendI2NPMessages (const std::vector<std::shared_ptr<I2NPMessage> >& msgs);
 			void SendPeerTest (); // Alice
 
 			SessionState GetState () const { return m_State; };
+			bool IsEstablished () const { return m_State == eSessionStateEstablished; };
+			void SetTerminationTimeout (int terminationTimeout);
 			size_t GetNumSentBytes () const { return m_NumSentBytes; };
 			size_t GetNumReceivedBytes () const { return m_NumReceivedBytes; };
 
@@ -110,7 +111,8 @@ namespace transport
 			boost::asio::io_service& GetService ();
 			void CreateAESandMacKey (const uint8_t * pubKey);
 			size_t GetSSUHeaderSize (const uint8_t * buf) const;
-			void PostI2NPMessages (std::vector<std::shared_ptr<I2NPMessage> > msgs);
+			void ScheduleOutgoingQueue ();
+			void PostI2NPMessages ();
 			void ProcessMessage (uint8_t * buf, size_t len, const boost::asio::ip::udp::endpoint& senderEndpoint); // call for established session
 			void ProcessSessionRequest (const uint8_t * buf, size_t len);
 			void SendSessionRequest ();
@@ -144,12 +146,16 @@ namespace transport
 
 			void Reset ();
 
+			// timers of SSUData
+			uint64_t GetMillisecondsSinceEpoch () const;
+			void ScheduleResend (uint64_t ts);
+			void ScheduleIncompleteMessagesCleanup ();
+
 		private:
 
-			friend class SSUData; // TODO: change in later
 			SSUServer& m_Server;
 			const boost::asio::ip::udp::endpoint m_RemoteEndpoint;
-			boost::asio::deadline_timer m_ConnectTimer;
+			boost::asio::deadline_timer m_ConnectTimer, m_ResendTimer, m_IncompleteMessagesCleanupTimer;
 			bool m_IsPeerTest;
 			SessionState m_State;
 			bool m_IsSessionKey;
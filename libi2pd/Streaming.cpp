@@ -68,10 +68,11 @@ namespace stream
 		m_SendStreamID (0), m_SequenceNumber (0), m_LastReceivedSequenceNumber (-1),
 		m_Status (eStreamStatusNew), m_IsAckSendScheduled (false), m_LocalDestination (local),
 		m_RemoteLeaseSet (remote), m_ReceiveTimer (m_Service), m_ResendTimer (m_Service),
-		m_AckSendTimer (m_Service), m_NumSentBytes (0), m_NumReceivedBytes (0), m_Port (port),
-		m_WindowSize (MIN_WINDOW_SIZE), m_RTT (INITIAL_RTT), m_RTO (INITIAL_RTO),
+		m_AckSendTimer (m_Service), m_SendTimer (m_Service), m_NumSentBytes (0), m_NumReceivedBytes (0), m_Port (port),
+		m_CongestionControl (CreateCongestionControl (local.GetOwner ()->GetStreamingCongestionControl ())),
 		m_AckDelay (local.GetOwner ()->GetStreamingAckDelay ()),
-		m_LastWindowSizeIncreaseTime (0), m_NumResendAttempts (0), m_MTU (STREAMING_MTU)
+		m_RecoverySeqn (0), m_IsInRecovery (false), m_IsPacing (local.GetOwner ()->IsStreamingPacing ()),
+		m_IsSendScheduled (false), m_LastPacingTime (0), m_PacingCredit (0), m_NumResendAttempts (0), m_MTU (STREAMING_MTU)
 	{
 		RAND_bytes ((uint8_t *)&m_RecvStreamID, 4);
 		m_RemoteIdentity = remote->GetIdentity ();
@@ -80,10 +81,12 @@ namespace stream
 	Stream::Stream (boost::asio::io_service& service, StreamingDestination& local):
 		m_Service (service), m_SendStreamID (0), m_SequenceNumber (0), m_LastReceivedSequenceNumber (-1),
 		m_Status (eStreamStatusNew), m_IsAckSendScheduled (false), m_LocalDestination (local),
-		m_ReceiveTimer (m_Service), m_ResendTimer (m_Service), m_AckSendTimer (m_Service),
-		m_NumSentBytes (0), m_NumReceivedBytes (0), m_Port (0), m_WindowSize (MIN_WINDOW_SIZE),
-		m_RTT (INITIAL_RTT), m_RTO (INITIAL_RTO), m_AckDelay (local.GetOwner ()->GetStreamingAckDelay ()),
-		m_LastWindowSizeIncreaseTime (0), m_NumResendAttempts (0), m_MTU (STREAMING_MTU)
+		m_ReceiveTimer (m_Service), m_ResendTimer (m_Service), m_AckSendTimer (m_Service), m_SendTimer (m_Service),
+		m_NumSentBytes (0), m_NumReceivedBytes (0), m_Port (0),
+		m_CongestionControl (CreateCongestionControl (local.GetOwner ()->GetStreamingCongestionControl ())),
+		m_AckDelay (local.GetOwner ()->GetStreamingAckDelay ()),
+		m_RecoverySeqn (0), m_IsInRecovery (false), m_IsPacing (local.GetOwner ()->IsStreamingPacing ()),
+		m_IsSendScheduled (false), m_LastPacingTime (0), m_PacingCredit (0), m_NumResendAttempts (0), m_MTU (STREAMING_MTU)
 	{
 		RAND_bytes ((uint8_t *)&m_RecvStreamID, 4);
 	}
@@ -99,6 +102,7 @@ namespace stream
 		m_AckSendTimer.cancel ();
 		m_ReceiveTimer.cancel ();
 		m_ResendTimer.cancel ();
+		m_SendTimer.cancel ();
 		//CleanUp (); /* Need to recheck - broke working on windows */
 		if (deleteFromDestination)
 			m_LocalDestination.DeleteStream (shared_from_this ());
@@ -171,7 +175,7 @@ namespace stream
 				if (!m_IsAckSendScheduled)
 				{
 					m_IsAckSendScheduled = true;
-					auto ackTimeout = m_RTT/10;
+					auto ackTimeout = m_CongestionControl->GetRTT ()/10;
 					if (ackTimeout > m_AckDelay) ackTimeout = m_AckDelay;
 					m_AckSendTimer.expires_from_now (boost::posix_time::milliseconds(ackTimeout));
 					m_AckSendTimer.async_wait (std::bind (&Stream::HandleAckSendTimer,
@@ -361,7 +365,8 @@ namespace stream
 			LogPrint (eLogError, "Streaming: Unexpected ackThrough=", ackThrough, " > seqn=", m_SequenceNumber);
 			return;
 		}
-		int nackCount = packet->GetNACKCount ();
+		int nackCount = packet->GetNACKCount (), numAcked = 0;
+		std::vector<Packet *> lost;
 		for (auto it = m_SentPackets.begin (); it != m_SentPackets.end ();)
 		{
 			auto seqn = (*it)->GetSeqn ();
@@ -379,6 +384,14 @@ namespace stream
 					if (nacked)
 					{
 						LogPrint (eLogDebug, "Streaming: Packet ", seqn, " NACK");
+						auto nackedPacket = *it;
+						// NACKs for previous send don't count if resent less than RTT ago
+						if (!nackedPacket->numResends || ts >= nackedPacket->sendTime + m_CongestionControl->GetRTT ())
+						{
+							nackedPacket->numNACKs++;
+							if (nackedPacket->numNACKs >= FAST_RETRANSMIT_NACKS)
+								lost.push_back (nackedPacket);
+						}
 						++it;
 						continue;
 					}
@@ -390,28 +403,17 @@ namespace stream
 					LogPrint(eLogError, "Streaming: Packet ", seqn, "sent from the future, sendTime=", sentPacket->sendTime);
 					rtt = 1;
 				}
-				m_RTT = (m_RTT*seqn + rtt)/(seqn + 1);
-				m_RTO = m_RTT*1.5; // TODO: implement it better
+				if (!sentPacket->numResends) // can't tell which send is acknowledged otherwise
+					m_CongestionControl->UpdateRTT (rtt);
 				LogPrint (eLogDebug, "Streaming: Packet ", seqn, " acknowledged rtt=", rtt, " sentTime=", sentPacket->sendTime);
 				m_SentPackets.erase (it++);
 				m_LocalDestination.DeletePacket (sentPacket);
 				acknowledged = true;
-				if (m_WindowSize < WINDOW_SIZE)
-					m_WindowSize++; // slow start
-				else
-				{
-					// linear growth
-					if (ts > m_LastWindowSizeIncreaseTime + m_RTT)
-					{
-						m_WindowSize++;
-						if (m_WindowSize > MAX_WINDOW_SIZE) m_WindowSize = MAX_WINDOW_SIZE;
-						m_LastWindowSizeIncreaseTime = ts;
-					}
-				}
+				numAcked++;
 				if (!seqn && m_RoutingSession) // first message confirmed
 					m_RoutingSession->SetSharedRoutingPath (
 						std::make_shared<i2p::garlic::GarlicRoutingPath> (
-							i2p::garlic::GarlicRoutingPath{m_CurrentOutboundTunnel, m_CurrentRemoteLease, m_RTT, 0, 0}));
+							i2p::garlic::GarlicRoutingPath{m_CurrentOutboundTunnel, m_CurrentRemoteLease, m_CongestionControl->GetRTT (), 0, 0}));
 			}
 			else
 				break;
@@ -421,14 +423,41 @@ namespace stream
 		if (acknowledged)
 		{
 			m_NumResendAttempts = 0;
-			SendBuffer ();
+			if (m_IsInRecovery && ackThrough >= m_RecoverySeqn)
+				m_IsInRecovery = false; // everything sent before loss has been received
+			if (!m_IsInRecovery)
+				m_CongestionControl->OnAck (numAcked, ts);
 		}
+		if (!lost.empty ())
+			FastRetransmit (lost);
+		if (acknowledged)
+			SendBuffer ();
 		if (m_Status == eStreamStatusClosed)
 			Terminate ();
 		else if (m_Status == eStreamStatusClosing)
 			Close (); // check is all outgoing messages have been sent and we can send close
 	}
 
+	void Stream::FastRetransmit (const std::vector<Packet *>& packets)
+	{
+		if (!m_IsInRecovery)
+		{
+			// window is reduced once per loss event
+			m_IsInRecovery = true;
+			m_RecoverySeqn = m_SequenceNumber - 1; // last sent
+			m_CongestionControl->OnLoss ();
+		}
+		LogPrint (eLogDebug, "Streaming: Fast retransmit of ", packets.size (), " packets, window=", m_CongestionControl->GetWindowSize (), ", sSID=", m_SendStreamID);
+		auto ts = i2p::util::GetMillisecondsSinceEpoch ();
+		for (auto it: packets)
+		{
+			it->sendTime = ts;
+			it->numResends++;
+			it->numNACKs = 0;
+		}
+		SendPackets (packets);
+	}
+
 	size_t Stream::Send (const uint8_t * buf, size_t len)
 	{
 		AsyncSend (buf, len, nullptr);
@@ -449,8 +478,22 @@ namespace stream
 
 	void Stream::SendBuffer ()
 	{
-		int numMsgs = m_WindowSize - m_SentPackets.size ();
+		int numMsgs = m_CongestionControl->GetWindowSize () - m_SentPackets.size ();
 		if (numMsgs <= 0) return; // window is full
+		if (m_IsSendScheduled) return; // paced, will be sent by timer
+
+		// spread window over RTT rather than send it at once
+		int pacingInterval = (m_IsPacing && m_Status != eStreamStatusNew) ? m_CongestionControl->GetPacingInterval () : 0;
+		if (pacingInterval > 0)
+		{
+			auto ts = i2p::util::GetMonotonicMicroseconds ();
+			m_PacingCredit += ts - m_LastPacingTime;
+			m_LastPacingTime = ts;
+			int64_t maxCredit = (int64_t)pacingInterval*PACING_MAX_BURST;
+			if (m_PacingCredit > maxCredit) m_PacingCredit = maxCredit;
+			int numPaced = m_PacingCredit/pacingInterval;
+			if (numPaced < numMsgs) numMsgs = numPaced;
+		}
 
 		bool isNoAck = m_LastReceivedSequenceNumber < 0; // first packet
 		std::vector<Packet *> packets;
@@ -475,7 +518,7 @@ namespace stream
 				size += 4; // ack Through
 				packet[size] = 0;
 				size++; // NACK count
-				packet[size] = m_RTO/1000;
+				packet[size] = m_CongestionControl->GetRTO ()/1000;
 				size++; // resend delay
 				if (m_Status == eStreamStatusNew)
 				{
@@ -528,6 +571,13 @@ namespace stream
 				packets.push_back (p);
 				numMsgs--;
 			}
+			if (pacingInterval > 0)
+			{
+				m_PacingCredit -= (int64_t)packets.size ()*pacingInterval;
+				if (IsEstablished () && !m_SendBuffer.IsEmpty () &&
+					(int)(m_SentPackets.size () + packets.size ()) < m_CongestionControl->GetWindowSize ())
+					ScheduleSend (pacingInterval - m_PacingCredit); // next packet
+			}
 		}
 		if (packets.size () > 0)
 		{
@@ -742,8 +792,7 @@ namespace stream
 			{
 				m_CurrentOutboundTunnel = routingPath->outboundTunnel;
 				m_CurrentRemoteLease = routingPath->remoteLease;
-				m_RTT = routingPath->rtt;
-				m_RTO = m_RTT*1.5; // TODO: implement it better
+				m_CongestionControl->SetInitialRTT (routingPath->rtt);
 			}
 		}
 		if (!m_CurrentOutboundTunnel || !m_CurrentOutboundTunnel->IsEstablished ())
@@ -808,12 +857,25 @@ namespace stream
 		}
 	}
 
+	void Stream::ScheduleSend (int delay)
+	{
+		m_IsSendScheduled = true;
+		m_SendTimer.expires_from_now (boost::posix_time::microseconds(delay));
+		m_SendTimer.async_wait (std::bind (&Stream::HandleSendTimer,
+			shared_from_this (), std::placeholders::_1));
+	}
+
+	void Stream::HandleSendTimer (const boost::system::error_code& ecode)
+	{
+		m_IsSendScheduled = false;
+		if (ecode != boost::asio::error::operation_aborted)
+			SendBuffer ();
+	}
+
 	void Stream::ScheduleResend ()
 	{
 		m_ResendTimer.cancel ();
-		// check for invalid value
-		if (m_RTO <= 0) m_RTO = INITIAL_RTO;
-		m_ResendTimer.expires_from_now (boost::posix_time::milliseconds(m_RTO));
+		m_ResendTimer.expires_from_now (boost::posix_time::milliseconds(m_CongestionControl->GetRTO ()));
 		m_ResendTimer.async_wait (std::bind (&Stream::HandleResendTimer,
 			shared_from_this (), std::placeholders::_1));
 	}
@@ -836,9 +898,11 @@ namespace stream
 			std::vector<Packet *> packets;
 			for (auto it : m_SentPackets)
 			{
-				if (ts >= it->sendTime + m_RTO)
+				if (ts >= it->sendTime + m_CongestionControl->GetRTO ())
 				{
 					it->sendTime = ts;
+					it->numResends++;
+					it->numNACKs = 0;
 					packets.push_back (it);
 				}
 			}
@@ -847,15 +911,16 @@ namespace stream
 			if (packets.size () > 0)
 			{
 				m_NumResendAttempts++;
-				m_RTO *= 2;
+				m_IsInRecovery = false;
+				if (m_NumResendAttempts > 2)
+					m_CongestionControl->BackoffRTO ();
 				switch (m_NumResendAttempts)
 				{
 					case 1: // congesion avoidance
-						m_WindowSize >>= 1; // /2
-						if (m_WindowSize < MIN_WINDOW_SIZE) m_WindowSize = MIN_WINDOW_SIZE;
+						m_CongestionControl->OnTimeout ();
 					break;
 					case 2:
-						m_RTO = INITIAL_RTO; // drop RTO to initial upon tunnels pair change first time
+						m_CongestionControl->OnPathChanged (); // drop RTO to initial upon tunnels pair change first time
 #if (__cplusplus >= 201703L) // C++ 17 or higher
 						[[fallthrough]];
 #endif
@@ -25,6 +25,7 @@
 #include "I2NPProtocol.h"
 #include "Garlic.h"
 #include "Tunnel.h"
+#include "CongestionControl.h"
 #include "util.h" // MemoryPool
 
 namespace i2p
@@ -53,11 +54,6 @@ namespace stream
 	const size_t MAX_PACKET_SIZE = 4096;
 	const size_t COMPRESSION_THRESHOLD_SIZE = 66;
 	const int MAX_NUM_RESEND_ATTEMPTS = 6;
-	const int WINDOW_SIZE = 6; // in messages
-	const int MIN_WINDOW_SIZE = 1;
-	const int MAX_WINDOW_SIZE = 128;
-	const int INITIAL_RTT = 8000; // in milliseconds
-	const int INITIAL_RTO = 9000; // in milliseconds
 	const int SYN_TIMEOUT = 200; // how long we wait for SYN after follow-on, in milliseconds
 	const size_t MAX_PENDING_INCOMING_BACKLOG = 128;
 	const int PENDING_INCOMING_TIMEOUT = 10; // in seconds
@@ -68,8 +64,9 @@ namespace stream
 		size_t len, offset;
 		uint8_t buf[MAX_PACKET_SIZE];
 		uint64_t sendTime;
+		int numResends, numNACKs; // NACKs since last send
 
-		Packet (): len (0), offset (0), sendTime (0) {};
+		Packet (): len (0), offset (0), sendTime (0), numResends (0), numNACKs (0) {};
 		uint8_t * GetBuffer () { return buf + offset; };
 		size_t GetLength () const { return len - offset; };
 
@@ -172,7 +169,7 @@ namespace stream
 			void AsyncSend (const uint8_t * buf, size_t len, SendHandler handler);
 
 			template<typename Buffer, typename ReceiveHandler>
-			void AsyncReceive (const Buffer& buffer, ReceiveHandler handler, int timeout = 0);
+			void AsyncReceive (const Buffer& buffer, ReceiveHandler handler, int timeout = 0); // empty buffer to wait for data and read it with ReadSome
 			size_t ReadSome (uint8_t * buf, size_t len) { return ConcatenatePackets (buf, len); };
 
 			void AsyncClose() { m_Service.post(std::bind(&Stream::Close, shared_from_this())); };
@@ -186,8 +183,8 @@ namespace stream
 			size_t GetSendQueueSize () const { return m_SentPackets.size (); };
 			size_t GetReceiveQueueSize () const { return m_ReceiveQueue.size (); };
 			size_t GetSendBufferSize () const { return m_SendBuffer.GetSize (); };
-			int GetWindowSize () const { return m_WindowSize; };
-			int GetRTT () const { return m_RTT; };
+			int GetWindowSize () const { return m_CongestionControl->GetWindowSize (); };
+			int GetRTT () const { return m_CongestionControl->GetRTT (); };
 
 			void Terminate (bool deleteFromDestination = true);
 
@@ -206,6 +203,7 @@ namespace stream
 			void ProcessPacket (Packet * packet);
 			bool ProcessOptions (uint16_t flags, Packet * packet);
 			void ProcessAck (Packet * packet);
+			void FastRetransmit (const std::vector<Packet *>& packets);
 			size_t ConcatenatePackets (uint8_t * buf, size_t len);
 
 			void UpdateCurrentRemoteLease (bool expired = false);
@@ -213,6 +211,8 @@ namespace stream
 			template<typename Buffer, typename ReceiveHandler>
 			void HandleReceiveTimer (const boost::system::error_code& ecode, const Buffer& buffer, ReceiveHandler handler, int remainingTimeout);
 
+			void ScheduleSend (int delay); // in microseconds
+			void HandleSendTimer (const boost::system::error_code& ecode);
 			void ScheduleResend ();
 			void HandleResendTimer (const boost::system::error_code& ecode);
 			void HandleAckSendTimer (const boost::system::error_code& ecode);
@@ -234,14 +234,19 @@ namespace stream
 			std::queue<Packet *> m_ReceiveQueue;
 			std::set<Packet *, PacketCmp> m_SavedPackets;
 			std::set<Packet *, PacketCmp> m_SentPackets;
-			boost::asio::deadline_timer m_ReceiveTimer, m_ResendTimer, m_AckSendTimer;
+			boost::asio::deadline_timer m_ReceiveTimer, m_ResendTimer, m_AckSendTimer, m_SendTimer;
 			size_t m_NumSentBytes, m_NumReceivedBytes;
 			uint16_t m_Port;
 
 			std::mutex m_SendBufferMutex;
 			SendBufferQueue m_SendBuffer;
-			int m_WindowSize, m_RTT, m_RTO, m_AckDelay;
-			uint64_t m_LastWindowSizeIncreaseTime;
+			std::unique_ptr<CongestionControl> m_CongestionControl;
+			int m_AckDelay;
+			uint32_t m_RecoverySeqn; // fast recovery is over when acked
+			bool m_IsInRecovery;
+			bool m_IsPacing, m_IsSendScheduled;
+			uint64_t m_LastPacingTime; // in microseconds
+			int64_t m_PacingCredit; // in microseconds, time we can send without waiting
 			int m_NumResendAttempts;
 			size_t m_MTU;
 	};
@@ -337,8 +342,8 @@ namespace stream
 	void Stream::HandleReceiveTimer (const boost::system::error_code& ecode, const Buffer& buffer, ReceiveHandler handler, int remainingTimeout)
 	{
 		size_t received = ConcatenatePackets (boost::asio::buffer_cast<uint8_t *>(buffer), boost::asio::buffer_size(buffer));
-		if (received > 0)
-			handler (boost::system::error_code (), received);
+		if (received > 0 || (!boost::asio::buffer_size(buffer) && !m_ReceiveQueue.empty ()))
+			handler (boost::system::error_code (), received); // empty buffer means wait for data only
 		else if (ecode == boost::asio::error::operation_aborted)
 		{
 			// timeout not expired
@@ -0,0 +1,307 @@
+/*
+* Copyright (c) 2013-2020, The PurpleI2P Project
+*
+* This file is part of Purple i2pd project and licensed under BSD3
+*
+* See full license text in LICENSE file at top of project tree
+*/
+
+#ifndef TAG_STORE_H__
+#define TAG_STORE_H__
+
+#include <inttypes.h>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <memory>
+#include <random>
+#include "Tag.h"
+
+namespace i2p
+{
+namespace garlic
+{
+	const uint32_t TAG_STORE_BUCKET_DURATION = 60; // in seconds, expiration granularity
+	const size_t TAG_STORE_MIN_CAPACITY = 64; // power of 2
+
+	inline uint64_t GetTagStoreKey (uint64_t tag) { return tag; }
+	template<size_t sz>
+	inline uint64_t GetTagStoreKey (const i2p::data::Tag<sz>& tag) { return tag.GetLL ()[0]; }
+
+	/**
+	 * @brief incoming session tags, open addressing with linear probing
+	 *
+	 * Entry is tag, creation time and 4-bytes index of shared record (key or tagset) with reference counter,
+	 * so many tags of the same session don't carry own copy of the key and own heap node.
+	 * First 8 bytes of tags are also added to a bucket of their creation time, expired buckets are removed
+	 * from the front without scanning whole table, entries are found by them and checked by creation time.
+	 */
+	template<typename Tag, typename Record>
+	class TagStore
+	{
+		public:
+
+			typedef std::shared_ptr<Record> RecordPtr;
+
+			TagStore (): m_Size (0), m_Shift (64), m_NumLiveRecords (0), m_LastRecordIndex (INVALID_RECORD)
+			{
+				std::random_device rd;
+				m_Seed = ((uint64_t)rd () << 32) | rd ();
+			}
+
+			size_t GetSize () const { return m_Size; };
+			size_t GetNumRecords () const { return m_NumLiveRecords; };
+			size_t GetCapacity () const { return m_Entries.size (); };
+
+			void Insert (const Tag& tag, RecordPtr r, int index, uint32_t ts)
+			{
+				if ((m_Size + 1)*4 > m_Entries.size ()*3) Resize (m_Entries.empty () ? TAG_STORE_MIN_CAPACITY : m_Entries.size ()*2);
+				auto record = AddRecord (r);
+				m_Records[record].refCount++;
+				size_t mask = m_Entries.size () - 1, i = Hash (tag);
+				while (m_Entries[i].record != INVALID_RECORD)
+				{
+					if (m_Entries[i].tag == tag)
+					{
+						// replace
+						ReleaseRecord (m_Entries[i].record);
+						m_Entries[i].record = record; m_Entries[i].index = index; m_Entries[i].creationTime = ts;
+						AddToBucket (tag, ts);
+						return;
+					}
+					i = (i + 1) & mask;
+				}
+				m_Entries[i].tag = tag; m_Entries[i].record = record; m_Entries[i].index = index; m_Entries[i].creationTime = ts;
+				m_Size++;
+				AddToBucket (tag, ts);
+			}
+
+			RecordPtr Take (const Tag& tag, int& index) // tag might be used only once, nullptr if not found
+			{
+				size_t i;
+				if (!Find (tag, i)) return nullptr;
+				auto record = m_Records[m_Entries[i].record].record; // nullptr if invalidated
+				index = m_Entries[i].index;
+				Erase (i);
+				return record;
+			}
+
+			template<typename Predicate>
+			void InvalidateRecords (Predicate expired) // tags of invalidated records are not found and removed later
+			{
+				for (auto& it: m_Records)
+					if (it.record && expired (*it.record))
+					{
+						m_RecordIndexes.erase (it.record.get ());
+						it.record = nullptr;
+						m_NumLiveRecords--;
+					}
+				m_LastRecordIndex = INVALID_RECORD;
+			}
+
+			size_t CleanupExpired (uint32_t ts, int timeout) // returns number of removed tags
+			{
+				size_t num = 0;
+				while (!m_Buckets.empty () && ts >= m_Buckets.front ().startTime + TAG_STORE_BUCKET_DURATION + timeout)
+				{
+					auto& bucket = m_Buckets.front ();
+					for (auto key: bucket.keys)
+					{
+						size_t i;
+						// might be used or added again after
+						if (FindCreatedBefore (key, bucket.startTime + TAG_STORE_BUCKET_DURATION, i))
+						{
+							Erase (i);
+							num++;
+						}
+					}
+					m_Buckets.pop_front ();
+				}
+				if (m_Entries.size () > TAG_STORE_MIN_CAPACITY && m_Size*8 < m_Entries.size ())
+					Resize (m_Entries.size ()/2);
+				return num;
+			}
+
+			template<typename Visitor>
+			void ForEach (Visitor v) const // v (tag, record, creationTime)
+			{
+				for (const auto& it: m_Entries)
+					if (it.record != INVALID_RECORD && m_Records[it.record].record)
+						v (it.tag, m_Records[it.record].record, it.creationTime);
+			}
+
+			void Clear ()
+			{
+				m_Entries.clear (); m_Size = 0; m_Shift = 64;
+				m_Records.clear (); m_FreeRecords.clear (); m_RecordIndexes.clear ();
+				m_NumLiveRecords = 0; m_LastRecordIndex = INVALID_RECORD;
+				m_Buckets.clear ();
+			}
+
+		private:
+
+			static const uint32_t INVALID_RECORD = 0xFFFFFFFF;
+
+			size_t HashKey (uint64_t key) const // home slot
+			{
+				// tags are random, but might be chosen by remote peer, take high bits of product
+				return ((key ^ m_Seed)*0x9E3779B97F4A7C15ULL) >> m_Shift;
+			}
+
+			size_t Hash (const Tag& tag) const { return HashKey (GetTagStoreKey (tag)); };
+
+			uint32_t AddRecord (RecordPtr record) // returns existing index for the same record
+			{
+				if (m_LastRecordIndex != INVALID_RECORD && m_Records[m_LastRecordIndex].record == record)
+					return m_LastRecordIndex; // tags usually come in series for the same record
+				auto it = m_RecordIndexes.find (record.get ());
+				if (it != m_RecordIndexes.end ())
+				{
+					m_LastRecordIndex = it->second;
+					return it->second;
+				}
+				uint32_t ind;
+				if (!m_FreeRecords.empty ())
+				{
+					ind = m_FreeRecords.back ();
+					m_FreeRecords.pop_back ();
+				}
+				else
+				{
+					ind = m_Records.size ();
+					m_Records.emplace_back ();
+				}
+				m_Records[ind].record = record;
+				m_Records[ind].refCount = 0;
+				m_RecordIndexes[record.get ()] = ind;
+				m_NumLiveRecords++;
+				m_LastRecordIndex = ind;
+				return ind;
+			}
+
+			bool Find (const Tag& tag, size_t& i) const
+			{
+				if (!m_Size) return false;
+				size_t mask = m_Entries.size () - 1;
+				i = Hash (tag);
+				while (m_Entries[i].record != INVALID_RECORD)
+				{
+					if (m_Entries[i].tag == tag) return true;
+					i = (i + 1) & mask;
+				}
+				return false;
+			}
+
+			bool FindCreatedBefore (uint64_t key, uint32_t ts, size_t& i) const
+			{
+				if (!m_Size) return false;
+				size_t mask = m_Entries.size () - 1;
+				i = HashKey (key);
+				while (m_Entries[i].record != INVALID_RECORD)
+				{
+					if (GetTagStoreKey (m_Entries[i].tag) == key && m_Entries[i].creationTime < ts) return true;
+					i = (i + 1) & mask;
+				}
+				return false;
+			}
+
+			void Erase (size_t i)
+			{
+				ReleaseRecord (m_Entries[i].record);
+				m_Size--;
+				// shift following entries back to keep probe sequences without holes
+				size_t mask = m_Entries.size () - 1, j = i;
+				for (;;)
+				{
+					m_Entries[i].record = INVALID_RECORD;
+					for (;;)
+					{
+						j = (j + 1) & mask;
+						if (m_Entries[j].record == INVALID_RECORD) return;
+						size_t k = Hash (m_Entries[j].tag);
+						// move if home slot is not in (i, j]
+						if (i <= j ? (i >= k || k > j) : (i >= k && k > j)) break;
+					}
+					m_Entries[i] = m_Entries[j];
+					i = j;
+				}
+			}
+
+			void Resize (size_t capacity)
+			{
+				std::vector<Entry> entries (capacity);
+				size_t mask = capacity - 1;
+				m_Shift = 64;
+				for (size_t c = capacity; c > 1; c >>= 1) m_Shift--;
+				for (const auto& it: m_Entries)
+					if (it.record != INVALID_RECORD)
+					{
+						size_t i = Hash (it.tag);
+						while (entries[i].record != INVALID_RECORD) i = (i + 1) & mask;
+						entries[i] = it;
+					}
+				m_Entries.swap (entries);
+			}
+
+			void ReleaseRecord (uint32_t ind)
+			{
+				auto& r = m_Records[ind];
+				if (!--r.refCount)
+				{
+					if (r.record)
+					{
+						m_RecordIndexes.erase (r.record.get ());
+						r.record = nullptr;
+						m_NumLiveRecords--;
+					}
+					m_FreeRecords.push_back (ind);
+					if (m_LastRecordIndex == ind) m_LastRecordIndex = INVALID_RECORD;
+				}
+			}
+
+			void AddToBucket (const Tag& tag, uint32_t ts)
+			{
+				uint32_t startTime = ts - ts % TAG_STORE_BUCKET_DURATION;
+				// older tags go to the last bucket and expire a bit later
+				if (m_Buckets.empty () || startTime > m_Buckets.back ().startTime)
+					m_Buckets.push_back ({startTime, {}});
+				m_Buckets.back ().keys.push_back (GetTagStoreKey (tag));
+			}
+
+		private:
+
+			struct Entry
+			{
+				Tag tag;
+				uint32_t record = INVALID_RECORD; // index in m_Records, empty slot if invalid
+				int index; // in tagset
+				uint32_t creationTime; // seconds since epoch
+			};
+
+			struct RecordSlot
+			{
+				RecordPtr record; // nullptr if invalidated
+				uint32_t refCount;
+			};
+
+			struct Bucket
+			{
+				uint32_t startTime;
+				std::vector<uint64_t> keys; // of tags, full tags are in entries
+			};
+
+			std::vector<Entry> m_Entries; // size is power of 2
+			size_t m_Size;
+			int m_Shift; // 64 - log2 (capacity)
+			uint64_t m_Seed;
+			std::vector<RecordSlot> m_Records;
+			std::vector<uint32_t> m_FreeRecords;
+			std::unordered_map<const Record *, uint32_t> m_RecordIndexes;
+			size_t m_NumLiveRecords;
+			uint32_t m_LastRecordIndex;
+			std::deque<Bucket> m_Buckets;
+	};
+}
+}
+
+#endif
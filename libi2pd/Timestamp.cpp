@@ -183,6 +183,23 @@ namespace util
 		return GetLocalHoursSinceEpoch () + g_TimeOffset/3600;
 	}
 
+	uint64_t GetThreadCPUTime ()
+	{
+#if defined(CLOCK_THREAD_CPUTIME_ID)
+		struct timespec ts;
+		if (!clock_gettime (CLOCK_THREAD_CPUTIME_ID, &ts))
+			return (uint64_t)ts.tv_sec*1000000 + ts.tv_nsec/1000;
+#endif
+		return std::chrono::duration_cast<std::chrono::microseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count ();
+	}
+
+	uint64_t GetMonotonicMicroseconds ()
+	{
+		return std::chrono::duration_cast<std::chrono::microseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count ();
+	}
+
 	uint64_t GetSecondsSinceEpoch ()
 	{
 		return GetLocalSecondsSinceEpoch () + g_TimeOffset;
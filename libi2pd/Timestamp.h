@@ -22,6 +22,8 @@ namespace util
 	uint64_t GetMillisecondsSinceEpoch ();
 	uint32_t GetHoursSinceEpoch ();
 	uint64_t GetSecondsSinceEpoch ();
+	uint64_t GetThreadCPUTime (); // in microseconds, wall clock if not supported
+	uint64_t GetMonotonicMicroseconds (); // for intervals only, not affected by time sync
 
 	void GetCurrentDate (char * date); // returns date as YYYYMMDD string, 9 bytes
 	void GetDateString (uint64_t timestamp, char * date); // timestap is seconds since epoch, returns date as YYYYMMDD string, 9 bytes
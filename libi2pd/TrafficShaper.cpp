@@ -0,0 +1,138 @@
+/*
+* Copyright (c) 2013-2020, The PurpleI2P Project
+*
+* This file is part of Purple i2pd project and licensed under BSD3
+*
+* See full license text in LICENSE file at top of project tree
+*/
+
+#include <algorithm>
+#include <limits>
+#include "Timestamp.h"
+#include "RouterContext.h"
+#include "TrafficShaper.h"
+
+namespace i2p
+{
+namespace transport
+{
+	void TrafficShaper::TokenBucket::Refill (uint64_t rate, uint64_t interval)
+	{
+		int64_t b = std::max ((int64_t)(rate*TRAFFIC_SHAPER_BURST/1000), TRAFFIC_SHAPER_MIN_BURST);
+		burst = b;
+		int64_t num = rate*interval/1000;
+		auto t = tokens.load ();
+		while (!tokens.compare_exchange_weak (t, std::min (t + num, b)));
+	}
+
+	bool TrafficShaper::TokenBucket::Take (size_t len, int64_t min)
+	{
+		int64_t maxDebt = TRAFFIC_SHAPER_MAX_DEBT*burst;
+		auto t = tokens.load ();
+		do
+			if (t < min) return false;
+		while (!tokens.compare_exchange_weak (t, std::max (t - (int64_t)len, -maxDebt)));
+		return true;
+	}
+
+	TrafficShaper::TrafficShaper (): m_LastRefillTime (0)
+	{
+		for (int i = 0; i < eNumI2NPTrafficClasses; i++)
+		{
+			m_NumSentBytes[i] = 0;
+			m_NumDroppedMessages[i] = 0;
+			m_NumExpiredMessages[i] = 0;
+		}
+	}
+
+	void TrafficShaper::Shape (std::vector<std::shared_ptr<I2NPMessage> >& msgs)
+	{
+		if (msgs.empty ()) return;
+		auto ts = i2p::util::GetMillisecondsSinceEpoch ();
+		// limits might be changed at runtime
+		Refill (ts, i2p::context.GetBandwidthLimit ()*1024, i2p::context.GetTransitBandwidthLimit ()*1024);
+		// classes present, usually one
+		int classes = 0;
+		for (const auto& it: msgs)
+			classes |= 1 << GetTrafficClass (*it);
+		std::vector<std::shared_ptr<I2NPMessage> > shaped;
+		shaped.reserve (msgs.size ());
+		for (int i = 0; i < eNumI2NPTrafficClasses; i++)
+		{
+			if (!(classes & (1 << i))) continue;
+			auto cls = (I2NPTrafficClass)i;
+			for (auto& it: msgs)
+			{
+				if (GetTrafficClass (*it) != cls) continue;
+				if (ts > it->GetExpiration ())
+					m_NumExpiredMessages[cls]++; // too late anyway, don't waste bandwidth
+				else if (!Admit (cls, it->GetLength ()))
+					m_NumDroppedMessages[cls]++;
+				else
+				{
+					m_NumSentBytes[cls] += it->GetLength ();
+					shaped.push_back (it);
+				}
+			}
+		}
+		msgs.swap (shaped);
+	}
+
+	void TrafficShaper::Refill (uint64_t ts, uint64_t rate, uint64_t transitRate)
+	{
+		auto lastRefillTime = m_LastRefillTime.load ();
+		if (ts <= lastRefillTime || !m_LastRefillTime.compare_exchange_strong (lastRefillTime, ts))
+			return; // refilled already, possibly by other thread
+		auto interval = ts - lastRefillTime;
+		if (interval > TRAFFIC_SHAPER_BURST) interval = TRAFFIC_SHAPER_BURST;
+		m_Root.Refill (rate, interval);
+		m_Transit.Refill (transitRate, interval);
+	}
+
+	bool TrafficShaper::Admit (I2NPTrafficClass cls, size_t len)
+	{
+		switch (cls)
+		{
+			case eI2NPTrafficClassTransit:
+				// within share and what is left from other classes
+				if (!m_Transit.Take (len, len)) return false;
+				if (!m_Root.Take (len, len))
+				{
+					m_Transit.tokens += len; // give back
+					return false;
+				}
+				return true;
+			case eI2NPTrafficClassExploratory:
+				return m_Root.Take (len, -m_Root.burst);
+			default: // local and NetDb
+				return m_Root.Take (len, std::numeric_limits<int64_t>::min ());
+		}
+	}
+
+	I2NPTrafficClass TrafficShaper::GetTrafficClass (const I2NPMessage& msg)
+	{
+		if (msg.trafficClass != eI2NPTrafficClassLocal) return msg.trafficClass;
+		switch (msg.GetTypeID ())
+		{
+			case eI2NPDatabaseStore:
+			case eI2NPDatabaseLookup:
+			case eI2NPDatabaseSearchReply:
+				return eI2NPTrafficClassNetDb;
+			default:
+				return eI2NPTrafficClassLocal;
+		}
+	}
+
+	const char * TrafficShaper::GetTrafficClassName (I2NPTrafficClass cls)
+	{
+		switch (cls)
+		{
+			case eI2NPTrafficClassLocal: return "Local";
+			case eI2NPTrafficClassNetDb: return "NetDb";
+			case eI2NPTrafficClassExploratory: return "Exploratory";
+			case eI2NPTrafficClassTransit: return "Transit";
+			default: return "Unknown";
+		}
+	}
+}
+}
@@ -0,0 +1,74 @@
+/*
+* Copyright (c) 2013-2020, The PurpleI2P Project
+*
+* This file is part of Purple i2pd project and licensed under BSD3
+*
+* See full license text in LICENSE file at top of project tree
+*/
+
+#ifndef TRAFFIC_SHAPER_H__
+#define TRAFFIC_SHAPER_H__
+
+#include <inttypes.h>
+#include <vector>
+#include <array>
+#include <memory>
+#include <atomic>
+#include "I2NPProtocol.h"
+
+namespace i2p
+{
+namespace transport
+{
+	const uint64_t TRAFFIC_SHAPER_BURST = 1000; // in milliseconds of rate, depth of buckets
+	const int64_t TRAFFIC_SHAPER_MIN_BURST = 64*1024; // in bytes, to pass messages of any size at low rates
+	const int TRAFFIC_SHAPER_MAX_DEBT = 2; // in bursts, borrowed by priority classes from future refills
+
+	/**
+	 * @brief token buckets of outgoing traffic, root one for bandwidth limit and transit one under it for share
+	 *
+	 * Only these two rates are configured, so other classes have no buckets of their own, they differ by
+	 * how deep they may take the root bucket in debt instead. Local and NetDb traffic is never dropped,
+	 * it borrows tokens from the root bucket if needed, so it's transit that doesn't get them.
+	 * Exploratory is dropped only if the root is deep in debt.
+	 * Messages come higher classes first and expired ones are dropped before they take tokens.
+	 * Buckets are atomic, sessions of all threads take tokens without lock and one of them refills.
+	 */
+	class TrafficShaper
+	{
+		public:
+
+			TrafficShaper ();
+
+			void Shape (std::vector<std::shared_ptr<I2NPMessage> >& msgs); // leaves messages to send, higher classes first
+			void Refill (uint64_t ts, uint64_t rate, uint64_t transitRate); // milliseconds, bytes per second
+			bool Admit (I2NPTrafficClass cls, size_t len);
+
+			uint64_t GetNumSentBytes (I2NPTrafficClass cls) const { return m_NumSentBytes[cls]; };
+			uint64_t GetNumDroppedMessages (I2NPTrafficClass cls) const { return m_NumDroppedMessages[cls]; };
+			uint64_t GetNumExpiredMessages (I2NPTrafficClass cls) const { return m_NumExpiredMessages[cls]; };
+
+			static I2NPTrafficClass GetTrafficClass (const I2NPMessage& msg);
+			static const char * GetTrafficClassName (I2NPTrafficClass cls);
+
+		private:
+
+			struct TokenBucket
+			{
+				std::atomic<int64_t> tokens, burst; // in bytes
+
+				TokenBucket (): tokens (0), burst (TRAFFIC_SHAPER_MIN_BURST) {};
+				void Refill (uint64_t rate, uint64_t interval); // bytes per second, milliseconds
+				bool Take (size_t len, int64_t min); // if at least min tokens, debt is limited
+			};
+
+		private:
+
+			TokenBucket m_Root, m_Transit;
+			std::atomic<uint64_t> m_LastRefillTime;
+			std::array<std::atomic<uint64_t>, eNumI2NPTrafficClasses> m_NumSentBytes, m_NumDroppedMessages, m_NumExpiredMessages;
+	};
+}
+}
+
+#endif
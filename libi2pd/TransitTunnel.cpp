@@ -7,6 +7,7 @@
 */
 
 #include <string.h>
+#include <algorithm>
 #include "I2PEndian.h"
 #include "Log.h"
 #include "RouterContext.h"
@@ -19,6 +20,15 @@ namespace i2p
 {
 namespace tunnel
 {
+	const i2p::util::BloomFilterPtr& GetTunnelIVsFilter ()
+	{
+		// about one tunnel data message per kilobyte of transit traffic
+		static auto filter = i2p::util::BloomFilter (std::min (TUNNEL_IVS_FILTER_MAX_CAPACITY,
+			std::max (TUNNEL_IVS_FILTER_MIN_CAPACITY, (size_t)i2p::context.GetTransitBandwidthLimit ()*TUNNEL_EXPIRATION_TIMEOUT)),
+			TUNNEL_IVS_FILTER_FALSE_POSITIVE_RATE, TUNNEL_EXPIRATION_TIMEOUT);
+		return filter;
+	}
+
 	TransitTunnel::TransitTunnel (uint32_t receiveTunnelID,
 		const uint8_t * nextIdent, uint32_t nextTunnelID,
 		const uint8_t * layerKey,const uint8_t * ivKey):
@@ -27,29 +37,64 @@ namespace tunnel
 		m_Encryption.SetKeys (layerKey, ivKey);
 	}
 
+	bool TransitTunnel::IsReplayedTunnelMsg (std::shared_ptr<const I2NPMessage> tunnelMsg) const
+	{
+		// tunnelID followed by IV
+		if (!GetTunnelIVsFilter ()->Add (tunnelMsg->GetPayload (), 4 + 16))
+		{
+			LogPrint (eLogWarning, "TransitTunnel: Replayed tunnel message dropped for ", GetTunnelID ());
+			return true;
+		}
+		return false;
+	}
+
 	void TransitTunnel::EncryptTunnelMsg (std::shared_ptr<const I2NPMessage> in, std::shared_ptr<I2NPMessage> out)
 	{
 		m_Encryption.Encrypt (in->GetPayload () + 4, out->GetPayload () + 4);
 		i2p::transport::transports.UpdateTotalTransitTransmittedBytes (TUNNEL_DATA_MSG_SIZE);
 	}
 
+	void TransitTunnel::EncryptTunnelMsgs (const std::vector<std::shared_ptr<const I2NPMessage> >& in,
+		const std::vector<std::shared_ptr<I2NPMessage> >& out)
+	{
+		std::vector<i2p::crypto::TunnelEncryption::BatchItem> items;
+		items.reserve (in.size ());
+		for (size_t i = 0; i < in.size (); i++)
+			items.push_back ({ &m_Encryption, in[i]->GetPayload () + 4, out[i]->GetPayload () + 4 });
+		i2p::crypto::TunnelEncryption::Encrypt (items.data (), items.size ());
+		i2p::transport::transports.UpdateTotalTransitTransmittedBytes (TUNNEL_DATA_MSG_SIZE*in.size ());
+	}
+
 	TransitTunnelParticipant::~TransitTunnelParticipant ()
 	{
 	}
 
 	void TransitTunnelParticipant::HandleTunnelDataMsg (std::shared_ptr<const i2p::I2NPMessage> tunnelMsg)
 	{
-		auto newMsg = CreateEmptyTunnelDataMsg ();
-		EncryptTunnelMsg (tunnelMsg, newMsg);
-
+		if (IsReplayedTunnelMsg (tunnelMsg)) return;
 		m_NumTransmittedBytes += tunnelMsg->GetLength ();
-		htobe32buf (newMsg->GetPayload (), GetNextTunnelID ());
-		newMsg->FillI2NPMessageHeader (eI2NPTunnelData);
-		m_TunnelDataMsgs.push_back (newMsg);
+		m_ReceivedTunnelDataMsgs.push_back (tunnelMsg);
 	}
 
 	void TransitTunnelParticipant::FlushTunnelDataMsgs ()
 	{
+		if (!m_ReceivedTunnelDataMsgs.empty ())
+		{
+			// encrypt all messages received since last flush at once
+			std::vector<std::shared_ptr<i2p::I2NPMessage> > newMsgs;
+			newMsgs.reserve (m_ReceivedTunnelDataMsgs.size ());
+			for (size_t i = 0; i < m_ReceivedTunnelDataMsgs.size (); i++)
+				newMsgs.push_back (CreateEmptyTunnelDataMsg ());
+			EncryptTunnelMsgs (m_ReceivedTunnelDataMsgs, newMsgs);
+			m_ReceivedTunnelDataMsgs.clear ();
+			for (auto& it: newMsgs)
+			{
+				htobe32buf (it->GetPayload (), GetNextTunnelID ());
+				it->FillI2NPMessageHeader (eI2NPTunnelData);
+				it->trafficClass = eI2NPTrafficClassTransit;
+				m_TunnelDataMsgs.push_back (it);
+			}
+		}
 		if (!m_TunnelDataMsgs.empty ())
 		{
 			auto num = m_TunnelDataMsgs.size ();
@@ -87,6 +132,7 @@ namespace tunnel
 
 	void TransitTunnelEndpoint::HandleTunnelDataMsg (std::shared_ptr<const i2p::I2NPMessage> tunnelMsg)
 	{
+		if (IsReplayedTunnelMsg (tunnelMsg)) return;
 		auto newMsg = CreateEmptyTunnelDataMsg ();
 		EncryptTunnelMsg (tunnelMsg, newMsg);
 
@@ -14,6 +14,7 @@
 #include <mutex>
 #include <memory>
 #include "Crypto.h"
+#include "BloomFilter.h"
 #include "I2NPProtocol.h"
 #include "TunnelEndpoint.h"
 #include "TunnelGateway.h"
@@ -23,6 +24,11 @@ namespace i2p
 {
 namespace tunnel
 {
+	const size_t TUNNEL_IVS_FILTER_MIN_CAPACITY = 16*1024; // entries per interval
+	const size_t TUNNEL_IVS_FILTER_MAX_CAPACITY = 2*1024*1024;
+	const double TUNNEL_IVS_FILTER_FALSE_POSITIVE_RATE = 0.0001;
+	const i2p::util::BloomFilterPtr& GetTunnelIVsFilter (); // replayed transit tunnel data
+
 	class TransitTunnel: public TunnelBase
 	{
 		public:
@@ -32,11 +38,19 @@ namespace tunnel
 				const uint8_t * layerKey,const uint8_t * ivKey);
 
 			virtual size_t GetNumTransmittedBytes () const { return 0; };
+			I2NPTrafficClass GetTrafficClass () const { return eI2NPTrafficClassTransit; };
 
 			// implements TunnelBase
 			void SendTunnelDataMsg (std::shared_ptr<i2p::I2NPMessage> msg);
 			void HandleTunnelDataMsg (std::shared_ptr<const i2p::I2NPMessage> tunnelMsg);
 			void EncryptTunnelMsg (std::shared_ptr<const I2NPMessage> in, std::shared_ptr<I2NPMessage> out);
+			void EncryptTunnelMsgs (const std::vector<std::shared_ptr<const I2NPMessage> >& in,
+				const std::vector<std::shared_ptr<I2NPMessage> >& out);
+
+		protected:
+
+			bool IsReplayedTunnelMsg (std::shared_ptr<const I2NPMessage> tunnelMsg) const; // by tunnelID and IV
+
 		private:
 
 			i2p::crypto::TunnelEncryption m_Encryption;
@@ -60,6 +74,7 @@ namespace tunnel
 		private:
 
 			size_t m_NumTransmittedBytes;
+			std::vector<std::shared_ptr<const i2p::I2NPMessage> > m_ReceivedTunnelDataMsgs; // encrypted at flush
 			std::vector<std::shared_ptr<i2p::I2NPMessage> > m_TunnelDataMsgs;
 	};
 
@@ -94,6 +109,7 @@ namespace tunnel
 				m_Endpoint (false) {}; // transit endpoint is always outbound
 
 			void Cleanup () { m_Endpoint.Cleanup (); }
+			bool IsEndpoint () const { return true; };
 
 			void HandleTunnelDataMsg (std::shared_ptr<const i2p::I2NPMessage> tunnelMsg);
 			size_t GetNumTransmittedBytes () const { return m_Endpoint.GetNumReceivedBytes (); }
@@ -13,17 +13,23 @@
 #include <iostream>
 #include <memory>
 #include <vector>
+#include <algorithm>
 #include <mutex>
+#include <atomic>
+#include <limits>
 #include "Identity.h"
 #include "Crypto.h"
 #include "RouterInfo.h"
 #include "I2NPProtocol.h"
 #include "Timestamp.h"
+#include "Queue.h"
 
 namespace i2p
 {
 namespace transport
 {
+	const size_t TRANSPORT_SESSION_SEND_QUEUE_SIZE = 64; // in messages, more go to overflow list
+
 	class SignedData
 	{
 		public:
@@ -65,7 +71,8 @@ namespace transport
 
 			TransportSession (std::shared_ptr<const i2p::data::RouterInfo> router, int terminationTimeout):
 				m_DHKeysPair (nullptr), m_NumSentBytes (0), m_NumReceivedBytes (0), m_IsOutgoing (router), m_TerminationTimeout (terminationTimeout),
-				m_LastActivityTimestamp (i2p::util::GetSecondsSinceEpoch ())
+				m_LastActivityTimestamp (i2p::util::GetSecondsSinceEpoch ()), m_TerminationCheckTime (std::numeric_limits<uint64_t>::max ()),
+				m_OutgoingQueue (TRANSPORT_SESSION_SEND_QUEUE_SIZE), m_IsOutgoingQueueScheduled (false)
 			{
 				if (router)
 					m_RemoteIdentity = router->GetRouterIdentity ();
@@ -92,12 +99,37 @@ namespace transport
 			bool IsOutgoing () const { return m_IsOutgoing; };
 
 			int GetTerminationTimeout () const { return m_TerminationTimeout; };
-			void SetTerminationTimeout (int terminationTimeout) { m_TerminationTimeout = terminationTimeout; };
+			virtual void SetTerminationTimeout (int terminationTimeout) { m_TerminationTimeout = terminationTimeout; };
 			bool IsTerminationTimeoutExpired (uint64_t ts) const
 			{ return ts >= m_LastActivityTimestamp + GetTerminationTimeout (); };
+			uint64_t GetTerminationTime () const { return m_LastActivityTimestamp + GetTerminationTimeout (); }; // if no activity since
+			uint64_t GetTerminationCheckTime () const { return m_TerminationCheckTime; }; // server's termination wheel only
+			void SetTerminationCheckTime (uint64_t ts) { m_TerminationCheckTime = ts; };
 
 			virtual void SendLocalRouterInfo () { SendI2NPMessages ({ CreateDatabaseStoreMsg () }); };
-			virtual void SendI2NPMessages (const std::vector<std::shared_ptr<I2NPMessage> >& msgs) = 0;
+			void SendI2NPMessages (const std::vector<std::shared_ptr<I2NPMessage> >& msgs) // from any thread
+			{
+				if (std::find (msgs.begin (), msgs.end (), nullptr) == msgs.end ())
+					m_OutgoingQueue.Put (msgs);
+				else
+					for (const auto& it: msgs)
+						if (it) m_OutgoingQueue.Put (it); // nullptr means empty queue for consumer
+				// one drain for all messages added until session's thread gets to it
+				if (!m_IsOutgoingQueueScheduled.exchange (true))
+					ScheduleOutgoingQueue ();
+			}
+
+		protected:
+
+			virtual void ScheduleOutgoingQueue () = 0; // post GetOutgoingMessages to session's thread
+			std::vector<std::shared_ptr<I2NPMessage> > GetOutgoingMessages () // session's thread only
+			{
+				m_IsOutgoingQueueScheduled.store (false); // messages added after will be scheduled again
+				std::vector<std::shared_ptr<I2NPMessage> > msgs;
+				while (auto msg = m_OutgoingQueue.Get ())
+					msgs.push_back (msg);
+				return msgs;
+			}
 
 		protected:
 
@@ -108,6 +140,12 @@ namespace transport
 			bool m_IsOutgoing;
 			int m_TerminationTimeout;
 			uint64_t m_LastActivityTimestamp;
+			uint64_t m_TerminationCheckTime; // of its entry in server's termination wheel, max if not there
+
+		private:
+
+			i2p::util::MPSCQueue<std::shared_ptr<I2NPMessage> > m_OutgoingQueue;
+			std::atomic<bool> m_IsOutgoingQueueScheduled;
 	};
 }
 }
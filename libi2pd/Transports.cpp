@@ -291,6 +291,7 @@ namespace transport
 		if (m_PeerCleanupTimer) m_PeerCleanupTimer->cancel ();
 		if (m_PeerTestTimer) m_PeerTestTimer->cancel ();
 		m_Peers.clear ();
+		m_ConnectedPeers.Clear ();
 		if (m_SSUServer)
 		{
 			m_SSUServer->Stop ();
@@ -376,7 +377,11 @@ namespace transport
 
 	void Transports::SendMessages (const i2p::data::IdentHash& ident, const std::vector<std::shared_ptr<i2p::I2NPMessage> >& msgs)
 	{
-		m_Service->post (std::bind (&Transports::PostMessages, this, ident, msgs));
+		auto session = m_ConnectedPeers.Get (ident);
+		if (session)
+			session->SendI2NPMessages (msgs); // to session's queue directly
+		else
+			m_Service->post (std::bind (&Transports::PostMessages, this, ident, msgs)); // connect first
 	}
 
 	void Transports::PostMessages (i2p::data::IdentHash ident, std::vector<std::shared_ptr<i2p::I2NPMessage> > msgs)
@@ -652,6 +657,7 @@ namespace transport
 				else
 					session->SetTerminationTimeout (10); // most likely it's publishing, no follow-up messages expected, set timeout to 10 seconds
 				it->second.sessions.push_back (session);
+				m_ConnectedPeers.Set (ident, it->second.sessions.front ());
 				session->SendI2NPMessages (it->second.delayedMessages);
 				it->second.delayedMessages.clear ();
 			}
@@ -666,6 +672,7 @@ namespace transport
 				session->SendI2NPMessages ({ CreateDatabaseStoreMsg () }); // send DatabaseStore
 				std::unique_lock<std::mutex>	l(m_PeersMutex);
 				m_Peers.insert (std::make_pair (ident, Peer{ 0, nullptr, { session }, i2p::util::GetSecondsSinceEpoch (), {} }));
+				m_ConnectedPeers.Set (ident, session);
 			}
 		});
 	}
@@ -682,6 +689,7 @@ namespace transport
 			{
 				auto before = it->second.sessions.size ();
 				it->second.sessions.remove (session);
+				m_ConnectedPeers.Set (ident, it->second.sessions.empty () ? nullptr : it->second.sessions.front ());
 				if (it->second.sessions.empty ())
 				{
 					if (it->second.delayedMessages.size () > 0)
@@ -14,6 +14,8 @@
 #include <condition_variable>
 #include <functional>
 #include <map>
+#include <unordered_map>
+#include <array>
 #include <vector>
 #include <queue>
 #include <string>
@@ -24,6 +26,7 @@
 #include "NTCPSession.h"
 #include "SSU.h"
 #include "NTCP2.h"
+#include "TrafficShaper.h"
 #include "RouterInfo.h"
 #include "I2NPProtocol.h"
 #include "Identity.h"
@@ -74,6 +77,64 @@ namespace transport
 		}
 	};
 
+	const size_t NUM_CONNECTED_PEERS_SHARDS = 16;
+	/**
+	 * @brief first session of every connected peer, for senders from any thread
+	 *
+	 * Updated by transports thread when peer's sessions change. Split to shards with own lock,
+	 * so senders to different peers rarely wait for each other
+	 */
+	class ConnectedPeers
+	{
+		public:
+
+			std::shared_ptr<TransportSession> Get (const i2p::data::IdentHash& ident) const
+			{
+				auto& shard = GetShard (ident);
+				std::lock_guard<std::mutex> l(shard.mutex);
+				auto it = shard.sessions.find (ident);
+				return it != shard.sessions.end () ? it->second : nullptr;
+			}
+
+			void Set (const i2p::data::IdentHash& ident, std::shared_ptr<TransportSession> session) // nullptr if disconnected
+			{
+				auto& shard = GetShard (ident);
+				std::lock_guard<std::mutex> l(shard.mutex);
+				if (session)
+					shard.sessions[ident] = session;
+				else
+					shard.sessions.erase (ident);
+			}
+
+			void Clear ()
+			{
+				for (auto& it: m_Shards)
+				{
+					std::lock_guard<std::mutex> l(it.mutex);
+					it.sessions.clear ();
+				}
+			}
+
+		private:
+
+			struct IdentHashHash
+			{
+				size_t operator() (const i2p::data::IdentHash& ident) const { return ident.GetLL ()[1]; } // random already
+			};
+
+			struct Shard
+			{
+				std::mutex mutex;
+				std::unordered_map<i2p::data::IdentHash, std::shared_ptr<TransportSession>, IdentHashHash> sessions;
+			};
+
+			Shard& GetShard (const i2p::data::IdentHash& ident) const { return m_Shards[ident.GetLL ()[0] % NUM_CONNECTED_PEERS_SHARDS]; };
+
+		private:
+
+			mutable std::array<Shard, NUM_CONNECTED_PEERS_SHARDS> m_Shards;
+	};
+
 	const size_t SESSION_CREATION_TIMEOUT = 10; // in seconds
 	const int PEER_TEST_INTERVAL = 71; // in minutes
 	const int MAX_NUM_DELAYED_MESSAGES = 50;
@@ -117,6 +178,8 @@ namespace transport
 			bool IsBandwidthExceeded () const;
 			bool IsTransitBandwidthExceeded () const;
 			size_t GetNumPeers () const { return m_Peers.size (); };
+			TrafficShaper& GetTrafficShaper () { return m_TrafficShaper; };
+			const TrafficShaper& GetTrafficShaper () const { return m_TrafficShaper; };
 			std::shared_ptr<const i2p::data::RouterInfo> GetRandomPeer () const;
 
 			/** get a trusted first hop for restricted routes */
@@ -158,6 +221,8 @@ namespace transport
 			NTCP2Server * m_NTCP2Server;
 			mutable std::mutex m_PeersMutex;
 			std::map<i2p::data::IdentHash, Peer> m_Peers;
+			ConnectedPeers m_ConnectedPeers; // senders don't wait for transports thread
+			TrafficShaper m_TrafficShaper;
 
 			DHKeysPairSupplier m_DHKeysPairSupplier;
 
@@ -94,6 +94,7 @@ namespace tunnel
 			hop = hop->prev;
 		}
 		msg->FillI2NPMessageHeader (eI2NPVariableTunnelBuild);
+		msg->trafficClass = GetTrafficClass ();
 
 		// send message
 		if (outboundTunnel)
@@ -179,6 +180,26 @@ namespace tunnel
 		}
 	}
 
+	void Tunnel::EncryptTunnelMsgs (const std::vector<std::shared_ptr<const I2NPMessage> >& in,
+		const std::vector<std::shared_ptr<I2NPMessage> >& out)
+	{
+		// hops are sequential, messages of each hop are interleaved
+		std::vector<i2p::crypto::TunnelDecryption::BatchItem> items (in.size ());
+		for (size_t i = 0; i < in.size (); i++)
+		{
+			items[i].in = in[i]->GetPayload () + 4;
+			items[i].out = out[i]->GetPayload () + 4;
+		}
+		for (auto& it: m_Hops)
+		{
+			for (auto& item: items)
+				item.layer = &it->decryption;
+			i2p::crypto::TunnelDecryption::Decrypt (items.data (), items.size ());
+			for (auto& item: items)
+				item.in = item.out;
+		}
+	}
+
 	void Tunnel::SendTunnelDataMsg (std::shared_ptr<i2p::I2NPMessage> msg)
 	{
 		LogPrint (eLogWarning, "Tunnel: Can't send I2NP messages without delivery instructions");
@@ -200,6 +221,11 @@ namespace tunnel
 		return ret;
 	}
 
+	I2NPTrafficClass Tunnel::GetTrafficClass () const
+	{
+		return (m_Pool && m_Pool == tunnels.GetExploratoryPool ()) ? eI2NPTrafficClassExploratory : eI2NPTrafficClassLocal;
+	}
+
 	void Tunnel::SetState(TunnelState state)
 	{
 		m_State = state;
@@ -219,10 +245,24 @@ namespace tunnel
 	void InboundTunnel::HandleTunnelDataMsg (std::shared_ptr<const I2NPMessage> msg)
 	{
 		if (IsFailed ()) SetState (eTunnelStateEstablished); // incoming messages means a tunnel is alive
-		auto newMsg = CreateEmptyTunnelDataMsg ();
-		EncryptTunnelMsg (msg, newMsg);
-		newMsg->from = shared_from_this ();
-		m_Endpoint.HandleDecryptedTunnelDataMsg (newMsg);
+		m_ReceivedTunnelDataMsgs.push_back (msg);
+	}
+
+	void InboundTunnel::FlushTunnelDataMsgs ()
+	{
+		if (m_ReceivedTunnelDataMsgs.empty ()) return;
+		// decrypt all messages received since last flush at once
+		std::vector<std::shared_ptr<I2NPMessage> > newMsgs;
+		newMsgs.reserve (m_ReceivedTunnelDataMsgs.size ());
+		for (size_t i = 0; i < m_ReceivedTunnelDataMsgs.size (); i++)
+			newMsgs.push_back (CreateEmptyTunnelDataMsg ());
+		EncryptTunnelMsgs (m_ReceivedTunnelDataMsgs, newMsgs);
+		m_ReceivedTunnelDataMsgs.clear ();
+		for (auto& it: newMsgs)
+		{
+			it->from = shared_from_this ();
+			m_Endpoint.HandleDecryptedTunnelDataMsg (it);
+		}
 	}
 
 	void InboundTunnel::Print (std::stringstream& s) const
@@ -327,7 +367,132 @@ namespace tunnel
 
 	Tunnels tunnels;
 
-	Tunnels::Tunnels (): m_IsRunning (false), m_Thread (nullptr),
+	TunnelDataShard::TunnelDataShard (Tunnels& owner, int index):
+		m_Owner (owner), m_Index (index), m_IsRunning (false), m_Thread (nullptr)
+	{
+	}
+
+	TunnelDataShard::~TunnelDataShard ()
+	{
+		Stop ();
+	}
+
+	void TunnelDataShard::Start ()
+	{
+		m_IsRunning = true;
+		m_Thread = new std::thread (std::bind (&TunnelDataShard::Run, this));
+	}
+
+	void TunnelDataShard::Stop ()
+	{
+		m_IsRunning = false;
+		m_Queue.WakeUp ();
+		if (m_Thread)
+		{
+			m_Thread->join ();
+			delete m_Thread;
+			m_Thread = nullptr;
+		}
+	}
+
+	std::shared_ptr<TunnelBase> TunnelDataShard::GetTunnel (uint32_t tunnelID)
+	{
+		std::unique_lock<std::mutex> l(m_TunnelsMutex);
+		auto it = m_Tunnels.find (tunnelID);
+		if (it != m_Tunnels.end ())
+			return it->second;
+		return nullptr;
+	}
+
+	bool TunnelDataShard::AddTunnel (std::shared_ptr<TunnelBase> tunnel)
+	{
+		std::unique_lock<std::mutex> l(m_TunnelsMutex);
+		if (!m_Tunnels.emplace (tunnel->GetTunnelID (), tunnel).second) return false;
+		if (tunnel->IsEndpoint ()) m_Endpoints.push_back (tunnel);
+		return true;
+	}
+
+	void TunnelDataShard::RemoveTunnel (uint32_t tunnelID)
+	{
+		std::unique_lock<std::mutex> l(m_TunnelsMutex);
+		m_Tunnels.erase (tunnelID);
+	}
+
+	size_t TunnelDataShard::GetNumTunnels ()
+	{
+		std::unique_lock<std::mutex> l(m_TunnelsMutex);
+		return m_Tunnels.size ();
+	}
+
+	void TunnelDataShard::Run ()
+	{
+		uint64_t lastTs = i2p::util::GetSecondsSinceEpoch ();
+		while (m_IsRunning)
+		{
+			try
+			{
+				auto msg = m_Queue.GetNextWithTimeout (1000); // 1 sec
+				if (msg)
+				{
+					// messages of the same tunnel always come to the same shard, so order is preserved
+					HandleTunnelMsgs<TunnelBase> (msg, [this]() { return m_Queue.Get (); },
+						[this](uint32_t tunnelID) { return GetTunnel (tunnelID); },
+						[this](uint32_t tunnelID, std::shared_ptr<TunnelBase> tunnel, std::shared_ptr<I2NPMessage> msg)
+						{
+							if (tunnel)
+							{
+								if (msg->GetTypeID () == eI2NPTunnelData)
+									tunnel->HandleTunnelDataMsg (msg);
+								else // tunnel gateway assumed
+									m_Owner.HandleTunnelGatewayMsg (tunnel, msg);
+							}
+							else
+								LogPrint (eLogWarning, "Tunnel: tunnel not found, tunnelID=", tunnelID, " type=", (int)msg->GetTypeID ());
+						},
+						[](std::shared_ptr<I2NPMessage> msg)
+						{
+							LogPrint (eLogWarning, "Tunnel: unexpected message type ", (int)msg->GetTypeID (), " in data shard");
+						});
+				}
+
+				uint64_t ts = i2p::util::GetSecondsSinceEpoch ();
+				if (ts - lastTs >= TUNNEL_MANAGE_INTERVAL)
+				{
+					CleanupTunnels ();
+					lastTs = ts;
+				}
+			}
+			catch (std::exception& ex)
+			{
+				LogPrint (eLogError, "Tunnel: shard ", m_Index, " runtime exception: ", ex.what ());
+			}
+		}
+	}
+
+	void TunnelDataShard::CleanupTunnels ()
+	{
+		// endpoints' reassembly state belongs to this thread, expiration is handled by Tunnels
+		std::vector<std::shared_ptr<TunnelBase> > endpoints;
+		{
+			std::unique_lock<std::mutex> l(m_TunnelsMutex);
+			endpoints.reserve (m_Endpoints.size ());
+			for (auto it = m_Endpoints.begin (); it != m_Endpoints.end ();)
+			{
+				auto tunnel = it->lock ();
+				if (tunnel && m_Tunnels.count (tunnel->GetTunnelID ()))
+				{
+					endpoints.push_back (tunnel);
+					it++;
+				}
+				else
+					it = m_Endpoints.erase (it); // removed
+			}
+		}
+		for (auto& it: endpoints)
+			it->Cleanup ();
+	}
+
+	Tunnels::Tunnels (): m_IsRunning (false), m_Thread (nullptr), m_NumDataShards (0),
 		m_NumSuccesiveTunnelCreations (0), m_NumFailedTunnelCreations (0)
 	{
 	}
@@ -338,12 +503,30 @@ namespace tunnel
 
 	std::shared_ptr<TunnelBase> Tunnels::GetTunnel (uint32_t tunnelID)
 	{
+		auto shard = GetDataShard (tunnelID);
+		if (shard) return shard->GetTunnel (tunnelID);
 		auto it = m_Tunnels.find(tunnelID);
 		if (it != m_Tunnels.end ())
 			return it->second;
 		return nullptr;
 	}
 
+	bool Tunnels::AddTunnel (std::shared_ptr<TunnelBase> tunnel)
+	{
+		auto shard = GetDataShard (tunnel->GetTunnelID ());
+		if (shard) return shard->AddTunnel (tunnel);
+		return m_Tunnels.emplace (tunnel->GetTunnelID (), tunnel).second;
+	}
+
+	void Tunnels::RemoveTunnel (uint32_t tunnelID)
+	{
+		auto shard = GetDataShard (tunnelID);
+		if (shard)
+			shard->RemoveTunnel (tunnelID);
+		else
+			m_Tunnels.erase (tunnelID);
+	}
+
 	std::shared_ptr<InboundTunnel> Tunnels::GetPendingInboundTunnel (uint32_t replyMsgID)
 	{
 		return GetPendingTunnel (replyMsgID, m_PendingInboundTunnels);
@@ -431,20 +614,45 @@ namespace tunnel
 
 	void Tunnels::AddTransitTunnel (std::shared_ptr<TransitTunnel> tunnel)
 	{
-		if (m_Tunnels.emplace (tunnel->GetTunnelID (), tunnel).second)
+		if (AddTunnel (tunnel))
+		{
 			m_TransitTunnels.push_back (tunnel);
+			m_TransitTunnelsExpiration.Add (std::prev (m_TransitTunnels.end ()), tunnel->GetCreationTime () + TUNNEL_EXPIRATION_TIMEOUT + 1);
+			if (!m_NumDataShards && tunnel->IsEndpoint ()) // otherwise in shard's endpoints
+				m_TransitTunnelEndpoints.push_back (tunnel);
+		}
 		else
 			LogPrint (eLogError, "Tunnel: tunnel with id ", tunnel->GetTunnelID (), " already exists");
 	}
 
 	void Tunnels::Start ()
 	{
+		uint16_t numDataThreads; i2p::config::GetOption("limits.tunneldatathreads", numDataThreads);
+		if (numDataThreads > MAX_NUM_TUNNEL_DATA_THREADS) numDataThreads = MAX_NUM_TUNNEL_DATA_THREADS;
+		if (m_DataShards.size () != numDataThreads)
+		{
+			// m_NumDataShards is 0 here, so nobody indexes m_DataShards
+			decltype(m_DataShards) shards;
+			for (int i = 0; i < numDataThreads; i++)
+				shards.emplace_back (new TunnelDataShard (*this, i));
+			m_DataShards.swap (shards);
+		}
+		for (auto& it: m_DataShards)
+			it->Start ();
+		m_NumDataShards = numDataThreads; // from now on data messages go to shards
+		if (numDataThreads > 0)
+			LogPrint (eLogInfo, "Tunnel: data plane is sharded across ", numDataThreads, " threads");
+		uint16_t numBuildThreads; i2p::config::GetOption("limits.tunnelbuildthreads", numBuildThreads);
+		StartBuildRequestsWorkers (numBuildThreads);
+
 		m_IsRunning = true;
 		m_Thread = new std::thread (std::bind (&Tunnels::Run, this));
 	}
 
 	void Tunnels::Stop ()
 	{
+		m_NumDataShards = 0; // data messages go to m_Queue from now on
+		StopBuildRequestsWorkers ();
 		m_IsRunning = false;
 		m_Queue.WakeUp ();
 		if (m_Thread)
@@ -453,6 +661,10 @@ namespace tunnel
 			delete m_Thread;
 			m_Thread = 0;
 		}
+		// shards are kept until next start, because transports might still post to them
+		// if they have read m_NumDataShards before it was reset
+		for (auto& it: m_DataShards)
+			it->Stop ();
 	}
 
 	void Tunnels::Run ()
@@ -467,61 +679,50 @@ namespace tunnel
 				auto msg = m_Queue.GetNextWithTimeout (1000); // 1 sec
 				if (msg)
 				{
-					uint32_t prevTunnelID = 0, tunnelID = 0;
-					std::shared_ptr<TunnelBase> prevTunnel;
-					do
-					{
-						std::shared_ptr<TunnelBase> tunnel;
-						uint8_t typeID = msg->GetTypeID ();
-						switch (typeID)
+					HandleTunnelMsgs<TunnelBase> (msg, [this]() { return m_Queue.Get (); },
+						[this](uint32_t tunnelID) -> std::shared_ptr<TunnelBase>
 						{
-							case eI2NPTunnelData:
-							case eI2NPTunnelGateway:
+							if (GetDataShard (tunnelID)) return nullptr; // handled by shard's thread
+							return GetTunnel (tunnelID);
+						},
+						[this](uint32_t tunnelID, std::shared_ptr<TunnelBase> tunnel, std::shared_ptr<I2NPMessage> msg)
+						{
+							if (tunnel)
 							{
-								tunnelID = bufbe32toh (msg->GetPayload ());
-								if (tunnelID == prevTunnelID)
-									tunnel = prevTunnel;
-								else if (prevTunnel)
-									prevTunnel->FlushTunnelDataMsgs ();
-
-								if (!tunnel)
-									tunnel = GetTunnel (tunnelID);
-								if (tunnel)
-								{
-									if (typeID == eI2NPTunnelData)
-										tunnel->HandleTunnelDataMsg (msg);
-									else // tunnel gateway assumed
-										HandleTunnelGatewayMsg (tunnel, msg);
-								}
-								else
-									LogPrint (eLogWarning, "Tunnel: tunnel not found, tunnelID=", tunnelID, " previousTunnelID=", prevTunnelID, " type=", (int)typeID);
-
-								break;
+								if (msg->GetTypeID () == eI2NPTunnelData)
+									tunnel->HandleTunnelDataMsg (msg);
+								else // tunnel gateway assumed
+									HandleTunnelGatewayMsg (tunnel, msg);
+								return;
 							}
-							case eI2NPVariableTunnelBuild:
-							case eI2NPVariableTunnelBuildReply:
-							case eI2NPTunnelBuild:
-							case eI2NPTunnelBuildReply:
-								HandleI2NPMessage (msg->GetBuffer (), msg->GetLength ());
-							break;
-							default:
-								LogPrint (eLogWarning, "Tunnel: unexpected message type ", (int) typeID);
-						}
-
-						msg = m_Queue.Get ();
-						if (msg)
+							auto shard = GetDataShard (tunnelID);
+							if (shard)
+								shard->PostTunnelData (msg); // posted before shards were started
+							else
+								LogPrint (eLogWarning, "Tunnel: tunnel not found, tunnelID=", tunnelID, " type=", (int)msg->GetTypeID ());
+						},
+						[this](std::shared_ptr<I2NPMessage> msg)
 						{
-							prevTunnelID = tunnelID;
-							prevTunnel = tunnel;
-						}
-						else if (tunnel)
-							tunnel->FlushTunnelDataMsgs ();
-					}
-					while (msg);
+							switch (msg->GetTypeID ())
+							{
+								case eI2NPVariableTunnelBuild:
+								case eI2NPVariableTunnelBuildReply:
+								case eI2NPTunnelBuild:
+								case eI2NPTunnelBuildReply:
+									HandleI2NPMessage (msg->GetBuffer (), msg->GetLength ());
+								break;
+								default:
+									LogPrint (eLogWarning, "Tunnel: unexpected message type ", (int)msg->GetTypeID ());
+							}
+						});
 				}
 
+				std::function<void ()> task;
+				while ((task = m_Tasks.Get ()))
+					task ();
+
 				uint64_t ts = i2p::util::GetSecondsSinceEpoch ();
-				if (ts - lastTs >= 15) // manage tunnels every 15 seconds
+				if (ts - lastTs >= TUNNEL_MANAGE_INTERVAL)
 				{
 					ManageTunnels ();
 					lastTs = ts;
@@ -697,7 +898,7 @@ namespace tunnel
 					auto pool = tunnel->GetTunnelPool ();
 					if (pool)
 						pool->TunnelExpired (tunnel);
-					m_Tunnels.erase (tunnel->GetTunnelID ());
+					RemoveTunnel (tunnel->GetTunnelID ());
 					it = m_InboundTunnels.erase (it);
 				}
 				else
@@ -717,7 +918,7 @@ namespace tunnel
 
 						if (ts + TUNNEL_EXPIRATION_THRESHOLD > tunnel->GetCreationTime () + TUNNEL_EXPIRATION_TIMEOUT)
 							tunnel->SetState (eTunnelStateExpiring);
-						else // we don't need to cleanup expiring tunnels
+						else if (!m_NumDataShards) // we don't need to cleanup expiring tunnels, shards cleanup by themselves
 							tunnel->Cleanup ();
 					}
 					it++;
@@ -762,21 +963,25 @@ namespace tunnel
 	void Tunnels::ManageTransitTunnels ()
 	{
 		uint32_t ts = i2p::util::GetSecondsSinceEpoch ();
-		for (auto it = m_TransitTunnels.begin (); it != m_TransitTunnels.end ();)
-		{
-			auto tunnel = *it;
-			if (ts > tunnel->GetCreationTime () + TUNNEL_EXPIRATION_TIMEOUT)
+		// lifetime is fixed, each tunnel is removed at its expiration without looking at the rest
+		m_TransitTunnelsExpiration.Advance (ts, [this](std::list<std::shared_ptr<TransitTunnel> >::iterator it)
 			{
-				LogPrint (eLogDebug, "Tunnel: Transit tunnel with id ", tunnel->GetTunnelID (), " expired");
-				m_Tunnels.erase (tunnel->GetTunnelID ());
-				it = m_TransitTunnels.erase (it);
-			}
-			else
+				LogPrint (eLogDebug, "Tunnel: Transit tunnel with id ", (*it)->GetTunnelID (), " expired");
+				RemoveTunnel ((*it)->GetTunnelID ());
+				m_TransitTunnels.erase (it);
+			});
+		if (!m_NumDataShards) // otherwise done by shard's thread
+			for (auto it = m_TransitTunnelEndpoints.begin (); it != m_TransitTunnelEndpoints.end ();)
 			{
-				tunnel->Cleanup ();
-				it++;
+				auto tunnel = it->lock ();
+				if (tunnel && ts <= tunnel->GetCreationTime () + TUNNEL_EXPIRATION_TIMEOUT)
+				{
+					tunnel->Cleanup ();
+					it++;
+				}
+				else
+					it = m_TransitTunnelEndpoints.erase (it); // expired
 			}
-		}
 	}
 
 	void Tunnels::ManageTunnelPools ()
@@ -794,12 +999,50 @@ namespace tunnel
 
 	void Tunnels::PostTunnelData (std::shared_ptr<I2NPMessage> msg)
 	{
-		if (msg) m_Queue.Put (msg);
+		if (!msg) return;
+		auto typeID = msg->GetTypeID ();
+		if (typeID == eI2NPTunnelData || typeID == eI2NPTunnelGateway)
+		{
+			auto shard = GetDataShard (bufbe32toh (msg->GetPayload ())); // nullptr if not sharded
+			if (shard)
+			{
+				shard->PostTunnelData (msg);
+				return;
+			}
+		}
+		m_Queue.Put (msg);
 	}
 
 	void Tunnels::PostTunnelData (const std::vector<std::shared_ptr<I2NPMessage> >& msgs)
 	{
-		m_Queue.Put (msgs);
+		int numShards = m_NumDataShards;
+		if (numShards <= 0)
+		{
+			m_Queue.Put (msgs);
+			return;
+		}
+		// split by tunnelID, keeping order of messages for each tunnel
+		std::vector<std::vector<std::shared_ptr<I2NPMessage> > > shardMsgs (numShards);
+		for (const auto& msg: msgs)
+		{
+			auto typeID = msg->GetTypeID ();
+			if (typeID == eI2NPTunnelData || typeID == eI2NPTunnelGateway)
+				shardMsgs[bufbe32toh (msg->GetPayload ()) % numShards].push_back (msg);
+			else
+				m_Queue.Put (msg);
+		}
+		for (int i = 0; i < numShards; i++)
+			if (!shardMsgs[i].empty ())
+				m_DataShards[i]->PostTunnelData (shardMsgs[i]);
+	}
+
+	void Tunnels::PostTask (std::function<void ()> task)
+	{
+		if (task)
+		{
+			m_Tasks.Put (task);
+			m_Queue.WakeUp ();
+		}
 	}
 
 	template<class TTunnel>
@@ -852,7 +1095,7 @@ namespace tunnel
 
 	void Tunnels::AddInboundTunnel (std::shared_ptr<InboundTunnel> newTunnel)
 	{
-		if (m_Tunnels.emplace (newTunnel->GetTunnelID (), newTunnel).second)
+		if (AddTunnel (newTunnel))
 		{
 			m_InboundTunnels.push_back (newTunnel);
 			auto pool = newTunnel->GetTunnelPool ();
@@ -881,7 +1124,7 @@ namespace tunnel
 		auto inboundTunnel = std::make_shared<ZeroHopsInboundTunnel> ();
 		inboundTunnel->SetState (eTunnelStateEstablished);
 		m_InboundTunnels.push_back (inboundTunnel);
-		m_Tunnels[inboundTunnel->GetTunnelID ()] = inboundTunnel;
+		AddTunnel (inboundTunnel);
 		return inboundTunnel;
 	}
 
@@ -907,6 +1150,14 @@ namespace tunnel
 		return timeout;
 	}
 
+	int Tunnels::GetQueueSize ()
+	{
+		int size = m_Queue.GetSize ();
+		for (auto& it: m_DataShards)
+			size += it->GetQueueSize ();
+		return size;
+	}
+
 	size_t Tunnels::CountTransitTunnels() const
 	{
 		// TODO: locking
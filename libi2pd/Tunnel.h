@@ -18,7 +18,10 @@
 #include <thread>
 #include <mutex>
 #include <memory>
+#include <atomic>
+#include <functional>
 #include "Queue.h"
+#include "util.h"
 #include "Crypto.h"
 #include "TunnelConfig.h"
 #include "TunnelPool.h"
@@ -37,6 +40,8 @@ namespace tunnel
 	const int TUNNEL_RECREATION_THRESHOLD = 90; // 1.5 minutes
 	const int TUNNEL_CREATION_TIMEOUT = 30; // 30 seconds
 	const int STANDARD_NUM_RECORDS = 5; // in VariableTunnelBuild message
+	const int TUNNEL_MANAGE_INTERVAL = 15; // 15 seconds
+	const int MAX_NUM_TUNNEL_DATA_THREADS = 64;
 
 	enum TunnelState
 	{
@@ -79,6 +84,7 @@ namespace tunnel
 			virtual bool IsInbound() const = 0;
 
 			std::shared_ptr<TunnelPool> GetTunnelPool () const { return m_Pool; };
+			I2NPTrafficClass GetTrafficClass () const;
 			void SetTunnelPool (std::shared_ptr<TunnelPool> pool) { m_Pool = pool; };
 
 			bool HandleTunnelBuildResponse (uint8_t * msg, size_t len);
@@ -88,6 +94,8 @@ namespace tunnel
 			// implements TunnelBase
 			void SendTunnelDataMsg (std::shared_ptr<i2p::I2NPMessage> msg);
 			void EncryptTunnelMsg (std::shared_ptr<const I2NPMessage> in, std::shared_ptr<I2NPMessage> out);
+			void EncryptTunnelMsgs (const std::vector<std::shared_ptr<const I2NPMessage> >& in,
+				const std::vector<std::shared_ptr<I2NPMessage> >& out);
 
 			/** @brief add latency sample */
 			void AddLatencySample(const uint64_t ms) { m_Latency = (m_Latency + ms) >> 1; }
@@ -142,16 +150,19 @@ namespace tunnel
 
 			InboundTunnel (std::shared_ptr<const TunnelConfig> config): Tunnel (config), m_Endpoint (true) {};
 			void HandleTunnelDataMsg (std::shared_ptr<const I2NPMessage> msg);
+			void FlushTunnelDataMsgs ();
 			virtual size_t GetNumReceivedBytes () const { return m_Endpoint.GetNumReceivedBytes (); };
 			void Print (std::stringstream& s) const;
 			bool IsInbound() const { return true; }
 
 			// override TunnelBase
 			void Cleanup () { m_Endpoint.Cleanup (); };
+			bool IsEndpoint () const { return true; };
 
 		private:
 
 			TunnelEndpoint m_Endpoint;
+			std::vector<std::shared_ptr<const I2NPMessage> > m_ReceivedTunnelDataMsgs; // decrypted at flush
 	};
 
 	class ZeroHopsInboundTunnel: public InboundTunnel
@@ -182,6 +193,43 @@ namespace tunnel
 			size_t m_NumSentBytes;
 	};
 
+	class Tunnels;
+	class TunnelDataShard
+	{
+		public:
+
+			TunnelDataShard (Tunnels& owner, int index);
+			~TunnelDataShard ();
+			void Start ();
+			void Stop ();
+
+			std::shared_ptr<TunnelBase> GetTunnel (uint32_t tunnelID);
+			bool AddTunnel (std::shared_ptr<TunnelBase> tunnel);
+			void RemoveTunnel (uint32_t tunnelID);
+			void PostTunnelData (std::shared_ptr<I2NPMessage> msg) { m_Queue.Put (msg); };
+			void PostTunnelData (const std::vector<std::shared_ptr<I2NPMessage> >& msgs) { m_Queue.Put (msgs); };
+
+			int GetIndex () const { return m_Index; };
+			int GetQueueSize () { return m_Queue.GetSize (); };
+			size_t GetNumTunnels ();
+
+		private:
+
+			void Run ();
+			void CleanupTunnels ();
+
+		private:
+
+			Tunnels& m_Owner;
+			int m_Index;
+			bool m_IsRunning;
+			std::thread * m_Thread;
+			std::mutex m_TunnelsMutex;
+			std::unordered_map<uint32_t, std::shared_ptr<TunnelBase> > m_Tunnels; // tunnelID->tunnel, this shard's slice
+			std::list<std::weak_ptr<TunnelBase> > m_Endpoints; // of m_Tunnels, removed ones are dropped at cleanup
+			i2p::util::MPSCQueue<std::shared_ptr<I2NPMessage> > m_Queue;
+	};
+
 	class Tunnels
 	{
 		public:
@@ -205,6 +253,7 @@ namespace tunnel
 			std::shared_ptr<OutboundTunnel> CreateOutboundTunnel (std::shared_ptr<TunnelConfig> config);
 			void PostTunnelData (std::shared_ptr<I2NPMessage> msg);
 			void PostTunnelData (const std::vector<std::shared_ptr<I2NPMessage> >& msgs);
+			void PostTask (std::function<void ()> task); // to be executed by tunnels thread
 			void AddPendingTunnel (uint32_t replyMsgID, std::shared_ptr<InboundTunnel> tunnel);
 			void AddPendingTunnel (uint32_t replyMsgID, std::shared_ptr<OutboundTunnel> tunnel);
 			std::shared_ptr<TunnelPool> CreateTunnelPool (int numInboundHops,
@@ -214,6 +263,8 @@ namespace tunnel
 
 		private:
 
+			friend class TunnelDataShard;
+
 			template<class TTunnel>
 			std::shared_ptr<TTunnel> CreateTunnel (std::shared_ptr<TunnelConfig> config, std::shared_ptr<OutboundTunnel> outboundTunnel = nullptr);
 
@@ -221,6 +272,13 @@ namespace tunnel
 			std::shared_ptr<TTunnel> GetPendingTunnel (uint32_t replyMsgID, const std::map<uint32_t, std::shared_ptr<TTunnel> >& pendingTunnels);
 
 			void HandleTunnelGatewayMsg (std::shared_ptr<TunnelBase> tunnel, std::shared_ptr<I2NPMessage> msg);
+			bool AddTunnel (std::shared_ptr<TunnelBase> tunnel); // to m_Tunnels or to owning shard
+			void RemoveTunnel (uint32_t tunnelID);
+			TunnelDataShard * GetDataShard (uint32_t tunnelID) const
+			{
+				int numShards = m_NumDataShards;
+				return numShards > 0 ? m_DataShards[tunnelID % numShards].get () : nullptr;
+			}
 
 			void Run ();
 			void ManageTunnels ();
@@ -244,11 +302,16 @@ namespace tunnel
 			std::list<std::shared_ptr<InboundTunnel> > m_InboundTunnels;
 			std::list<std::shared_ptr<OutboundTunnel> > m_OutboundTunnels;
 			std::list<std::shared_ptr<TransitTunnel> > m_TransitTunnels;
-			std::unordered_map<uint32_t, std::shared_ptr<TunnelBase> > m_Tunnels; // tunnelID->tunnel known by this id
+			i2p::util::TimingWheel<std::list<std::shared_ptr<TransitTunnel> >::iterator> m_TransitTunnelsExpiration; // in seconds
+			std::list<std::weak_ptr<TransitTunnel> > m_TransitTunnelEndpoints; // to cleanup if not sharded, expired ones are dropped at cleanup
+			std::unordered_map<uint32_t, std::shared_ptr<TunnelBase> > m_Tunnels; // tunnelID->tunnel known by this id, if not sharded
+			std::vector<std::unique_ptr<TunnelDataShard> > m_DataShards; // data plane threads, empty if single-threaded
+			std::atomic<int> m_NumDataShards; // published after m_DataShards is filled
 			std::mutex m_PoolsMutex;
 			std::list<std::shared_ptr<TunnelPool>> m_Pools;
 			std::shared_ptr<TunnelPool> m_ExploratoryPool;
-			i2p::util::Queue<std::shared_ptr<I2NPMessage> > m_Queue;
+			i2p::util::MPSCQueue<std::shared_ptr<I2NPMessage> > m_Queue;
+			i2p::util::MPSCQueue<std::function<void ()> > m_Tasks;
 
 			// some stats
 			int m_NumSuccesiveTunnelCreations, m_NumFailedTunnelCreations;
@@ -264,7 +327,8 @@ namespace tunnel
 			size_t CountInboundTunnels() const;
 			size_t CountOutboundTunnels() const;
 
-			int GetQueueSize () { return m_Queue.GetSize (); };
+			int GetQueueSize ();
+			const decltype(m_DataShards)& GetDataShards () const { return m_DataShards; };
 			int GetTunnelCreationSuccessRate () const // in percents
 			{
 				int totalNum = m_NumSuccesiveTunnelCreations + m_NumFailedTunnelCreations;
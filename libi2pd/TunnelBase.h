@@ -11,6 +11,7 @@
 
 #include <inttypes.h>
 #include <memory>
+#include <vector>
 #include "Timestamp.h"
 #include "I2NPProtocol.h"
 #include "Identity.h"
@@ -46,14 +47,22 @@ namespace tunnel
 				m_CreationTime (i2p::util::GetSecondsSinceEpoch ()) {};
 			virtual ~TunnelBase () {};
 			virtual void Cleanup () {};
+			virtual bool IsEndpoint () const { return false; }; // only endpoints have something to Cleanup
 
 			virtual void HandleTunnelDataMsg (std::shared_ptr<const i2p::I2NPMessage> tunnelMsg) = 0;
 			virtual void SendTunnelDataMsg (std::shared_ptr<i2p::I2NPMessage> msg) = 0;
 			virtual void FlushTunnelDataMsgs () {};
 			virtual void EncryptTunnelMsg (std::shared_ptr<const I2NPMessage> in, std::shared_ptr<I2NPMessage> out) = 0;
+			virtual void EncryptTunnelMsgs (const std::vector<std::shared_ptr<const I2NPMessage> >& in,
+				const std::vector<std::shared_ptr<I2NPMessage> >& out) // same number of messages
+			{
+				for (size_t i = 0; i < in.size (); i++)
+					EncryptTunnelMsg (in[i], out[i]);
+			};
 			uint32_t GetNextTunnelID () const { return m_NextTunnelID; };
 			const i2p::data::IdentHash& GetNextIdentHash () const { return m_NextIdent; };
 			virtual uint32_t GetTunnelID () const { return m_TunnelID; }; // as known at our side
+			virtual I2NPTrafficClass GetTrafficClass () const { return eI2NPTrafficClassLocal; }; // of messages sent through
 
 			uint32_t GetCreationTime () const { return m_CreationTime; };
 			void SetCreationTime (uint32_t t) { m_CreationTime = t; };
@@ -65,6 +74,81 @@ namespace tunnel
 			uint32_t m_CreationTime; // seconds since epoch
 	};
 
+	/**
+	 * tunnel of previous data message in a row from queue, its buffered messages are flushed
+	 * when a message for other tunnel or of other type comes, or when the queue is empty
+	 */
+	template<typename Tunnel>
+	class TunnelMsgsBatch
+	{
+		public:
+
+			TunnelMsgsBatch (): m_TunnelID (0) {};
+
+			std::shared_ptr<Tunnel> Get (uint32_t tunnelID) const // nullptr if other tunnel
+			{
+				return tunnelID == m_TunnelID ? m_Tunnel : nullptr;
+			}
+
+			void Set (uint32_t tunnelID, std::shared_ptr<Tunnel> tunnel)
+			{
+				if (tunnel == m_Tunnel) return;
+				Flush ();
+				m_TunnelID = tunnelID; m_Tunnel = tunnel;
+			}
+
+			void Flush ()
+			{
+				if (m_Tunnel)
+				{
+					m_Tunnel->FlushTunnelDataMsgs ();
+					m_Tunnel = nullptr;
+				}
+				m_TunnelID = 0;
+			}
+
+		private:
+
+			uint32_t m_TunnelID;
+			std::shared_ptr<Tunnel> m_Tunnel;
+	};
+
+	/**
+	 * handles messages from queue in a row until next () returns nullptr, data and gateway messages
+	 * go to handleData with tunnel found by findTunnel (nullptr if not found), others go to handleOther
+	 */
+	template<typename Tunnel, typename Next, typename FindTunnel, typename HandleData, typename HandleOther>
+	void HandleTunnelMsgs (std::shared_ptr<I2NPMessage> msg, Next next, FindTunnel findTunnel,
+		HandleData handleData, HandleOther handleOther)
+	{
+		TunnelMsgsBatch<Tunnel> batch;
+		while (msg)
+		{
+			uint8_t typeID = msg->GetTypeID ();
+			if (typeID == eI2NPTunnelData || typeID == eI2NPTunnelGateway)
+			{
+				uint32_t tunnelID = bufbe32toh (msg->GetPayload ());
+				auto tunnel = batch.Get (tunnelID);
+				if (!tunnel)
+				{
+					tunnel = findTunnel (tunnelID);
+					if (tunnel)
+						batch.Set (tunnelID, tunnel);
+					else
+						batch.Flush ();
+				}
+				handleData (tunnelID, tunnel, msg);
+			}
+			else
+			{
+				batch.Flush ();
+				handleOther (msg);
+			}
+			msg = next ();
+		}
+		batch.Flush ();
+	}
+
 	struct TunnelCreationTimeCmp
 	{
 		template<typename T>
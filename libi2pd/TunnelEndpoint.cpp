@@ -126,7 +126,10 @@ namespace tunnel
 							m.receiveTime = i2p::util::GetMillisecondsSinceEpoch ();
 							auto ret = m_IncompleteMessages.insert (std::pair<uint32_t, TunnelMessageBlockEx>(msgID, m));
 							if (ret.second)
+							{
+								m_IncompleteMessagesExpiration.Add (msgID, m.receiveTime + i2p::I2NP_MESSAGE_EXPIRATION_TIMEOUT + 1);
 								HandleOutOfSequenceFragments (msgID, ret.first->second);
+							}
 							else
 								LogPrint (eLogError, "TunnelMessage: Incomplete message ", msgID, " already exists");
 						}
@@ -201,7 +204,10 @@ namespace tunnel
 
 	void TunnelEndpoint::AddOutOfSequenceFragment (uint32_t msgID, uint8_t fragmentNum, bool isLastFragment, std::shared_ptr<I2NPMessage> data)
 	{
-		if (!m_OutOfSequenceFragments.insert ({{msgID, fragmentNum}, {isLastFragment, data, i2p::util::GetMillisecondsSinceEpoch () }}).second)
+		auto ts = i2p::util::GetMillisecondsSinceEpoch ();
+		if (m_OutOfSequenceFragments.insert ({{msgID, fragmentNum}, {isLastFragment, data, ts}}).second)
+			m_OutOfSequenceFragmentsExpiration.Add ({msgID, fragmentNum}, ts + i2p::I2NP_MESSAGE_EXPIRATION_TIMEOUT + 1);
+		else
 			LogPrint (eLogInfo, "TunnelMessage: duplicate out-of-sequence fragment ", fragmentNum, " of message ", msgID);
 	}
 
@@ -266,13 +272,20 @@ namespace tunnel
 			break;
 			case eDeliveryTypeTunnel:
 				if (!m_IsInbound) // outbound transit tunnel
-					i2p::transport::transports.SendMessage (msg.hash, i2p::CreateTunnelGatewayMsg (msg.tunnelID, msg.data));
+				{
+					auto gatewayMsg = i2p::CreateTunnelGatewayMsg (msg.tunnelID, msg.data);
+					gatewayMsg->trafficClass = eI2NPTrafficClassTransit;
+					i2p::transport::transports.SendMessage (msg.hash, gatewayMsg);
+				}
 				else
 					LogPrint (eLogError, "TunnelMessage: Delivery type 'tunnel' arrived from an inbound tunnel, dropped");
 			break;
 			case eDeliveryTypeRouter:
 				if (!m_IsInbound) // outbound transit tunnel
+				{
+					msg.data->trafficClass = eI2NPTrafficClassTransit;
 					i2p::transport::transports.SendMessage (msg.hash, msg.data);
+				}
 				else // we shouldn't send this message. possible leakage
 					LogPrint (eLogError, "TunnelMessage: Delivery type 'router' arrived from an inbound tunnel, dropped");
 			break;
@@ -284,22 +297,19 @@ namespace tunnel
 	void TunnelEndpoint::Cleanup ()
 	{
 		auto ts = i2p::util::GetMillisecondsSinceEpoch ();
-		// out-of-sequence fragments
-		for (auto it = m_OutOfSequenceFragments.begin (); it != m_OutOfSequenceFragments.end ();)
-		{
-			if (ts > it->second.receiveTime + i2p::I2NP_MESSAGE_EXPIRATION_TIMEOUT)
-				it = m_OutOfSequenceFragments.erase (it);
-			else
-				++it;
-		}
-		// incomplete messages
-		for (auto it = m_IncompleteMessages.begin (); it != m_IncompleteMessages.end ();)
-		{
-			if (ts > it->second.receiveTime + i2p::I2NP_MESSAGE_EXPIRATION_TIMEOUT)
-				it = m_IncompleteMessages.erase (it);
-			else
-				++it;
-		}
+		// key might be used again by newer one, that has own entry
+		m_OutOfSequenceFragmentsExpiration.Advance (ts, [this, ts](const std::pair<uint32_t, uint8_t>& key)
+			{
+				auto it = m_OutOfSequenceFragments.find (key);
+				if (it != m_OutOfSequenceFragments.end () && ts > it->second.receiveTime + i2p::I2NP_MESSAGE_EXPIRATION_TIMEOUT)
+					m_OutOfSequenceFragments.erase (it);
+			});
+		m_IncompleteMessagesExpiration.Advance (ts, [this, ts](uint32_t msgID)
+			{
+				auto it = m_IncompleteMessages.find (msgID);
+				if (it != m_IncompleteMessages.end () && ts > it->second.receiveTime + i2p::I2NP_MESSAGE_EXPIRATION_TIMEOUT)
+					m_IncompleteMessages.erase (it);
+			});
 	}
 }
 }
@@ -12,6 +12,7 @@
 #include <inttypes.h>
 #include <map>
 #include <string>
+#include "util.h"
 #include "I2NPProtocol.h"
 #include "TunnelBase.h"
 
@@ -19,6 +20,8 @@ namespace i2p
 {
 namespace tunnel
 {
+	const uint64_t TUNNEL_ENDPOINT_EXPIRATION_TICK = 1000; // in milliseconds
+
 	class TunnelEndpoint
 	{
 		struct TunnelMessageBlockEx: public TunnelMessageBlock
@@ -36,7 +39,9 @@ namespace tunnel
 
 		public:
 
-			TunnelEndpoint (bool isInbound): m_IsInbound (isInbound), m_NumReceivedBytes (0) {};
+			TunnelEndpoint (bool isInbound): m_IsInbound (isInbound), m_NumReceivedBytes (0),
+				m_IncompleteMessagesExpiration (TUNNEL_ENDPOINT_EXPIRATION_TICK),
+				m_OutOfSequenceFragmentsExpiration (TUNNEL_ENDPOINT_EXPIRATION_TICK) {};
 			~TunnelEndpoint ();
 			size_t GetNumReceivedBytes () const { return m_NumReceivedBytes; };
 			void Cleanup ();
@@ -58,6 +63,9 @@ namespace tunnel
 			std::map<std::pair<uint32_t, uint8_t>, Fragment> m_OutOfSequenceFragments; // (msgID, fragment#)->fragment
 			bool m_IsInbound;
 			size_t m_NumReceivedBytes;
+			// 16 seconds span is enough for message expiration, completed are just not found
+			i2p::util::TimingWheel<uint32_t, 4, 1> m_IncompleteMessagesExpiration;
+			i2p::util::TimingWheel<std::pair<uint32_t, uint8_t>, 4, 1> m_OutOfSequenceFragmentsExpiration;
 	};
 }
 }
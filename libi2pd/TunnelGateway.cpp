@@ -213,13 +213,14 @@ namespace tunnel
 		m_Buffer.CompleteCurrentTunnelDataMessage ();
 		std::vector<std::shared_ptr<I2NPMessage> > newTunnelMsgs;
 		const auto& tunnelDataMsgs = m_Buffer.GetTunnelDataMsgs ();
-		for (auto& tunnelMsg : tunnelDataMsgs)
+		for (size_t i = 0; i < tunnelDataMsgs.size (); i++)
+			newTunnelMsgs.push_back (CreateEmptyTunnelDataMsg ());
+		m_Tunnel->EncryptTunnelMsgs (tunnelDataMsgs, newTunnelMsgs); // all at once
+		for (auto& newMsg : newTunnelMsgs)
 		{
-			auto newMsg = CreateEmptyTunnelDataMsg ();
-			m_Tunnel->EncryptTunnelMsg (tunnelMsg, newMsg);
 			htobe32buf (newMsg->GetPayload (), m_Tunnel->GetNextTunnelID ());
 			newMsg->FillI2NPMessageHeader (eI2NPTunnelData);
-			newTunnelMsgs.push_back (newMsg);
+			newMsg->trafficClass = m_Tunnel->GetTrafficClass ();
 			m_NumSentBytes += TUNNEL_DATA_MSG_SIZE;
 		}
 		m_Buffer.ClearTunnelDataMsgs ();
@@ -66,6 +66,65 @@ namespace i2p
 namespace util
 {
 
+	struct MemoryPoolsStatsList
+	{
+		std::mutex mutex;
+		std::vector<const MemoryPoolStats *> stats;
+	};
+
+	static MemoryPoolsStatsList& GetMemoryPoolsStatsList ()
+	{
+		static MemoryPoolsStatsList * list = new MemoryPoolsStatsList (); // pools can be created before or used after globals
+		return *list;
+	}
+
+	MemoryPoolStats::MemoryPoolStats (size_t blockSize):
+		m_BlockSize (blockSize), m_NumBlocks (0), m_HighWater (0)
+	{
+		auto& list = GetMemoryPoolsStatsList ();
+		std::unique_lock<std::mutex> l(list.mutex);
+		list.stats.push_back (this);
+	}
+
+	MemoryPoolStats::ThreadCounters * MemoryPoolStats::CreateThreadCounters ()
+	{
+		std::unique_lock<std::mutex> l(m_ThreadCountersMutex);
+		m_ThreadCounters.emplace_back ();
+		return &m_ThreadCounters.back ();
+	}
+
+	void MemoryPoolStats::BlockCreated ()
+	{
+		int numBlocks = ++m_NumBlocks;
+		int highWater = m_HighWater;
+		while (numBlocks > highWater && !m_HighWater.compare_exchange_weak (highWater, numBlocks));
+	}
+
+	uint64_t MemoryPoolStats::GetNumHits () const
+	{
+		uint64_t num = 0;
+		std::unique_lock<std::mutex> l(m_ThreadCountersMutex);
+		for (const auto& it: m_ThreadCounters)
+			num += it.numHits.load (std::memory_order_relaxed);
+		return num;
+	}
+
+	uint64_t MemoryPoolStats::GetNumMisses () const
+	{
+		uint64_t num = 0;
+		std::unique_lock<std::mutex> l(m_ThreadCountersMutex);
+		for (const auto& it: m_ThreadCounters)
+			num += it.numMisses.load (std::memory_order_relaxed);
+		return num;
+	}
+
+	std::vector<const MemoryPoolStats *> GetMemoryPoolsStats ()
+	{
+		auto& list = GetMemoryPoolsStatsList ();
+		std::unique_lock<std::mutex> l(list.mutex);
+		return list.stats;
+	}
+
 	void RunnableService::StartIOService ()
 	{
 		if (!m_IsRunning)
@@ -86,6 +145,7 @@ namespace util
 				m_Thread->join ();
 				m_Thread = nullptr;
 			}
+			m_Service.reset (); // might be started again
 		}
 	}
 
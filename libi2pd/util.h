@@ -9,10 +9,16 @@
 #ifndef UTIL_H
 #define UTIL_H
 
+#include <inttypes.h>
 #include <string>
 #include <functional>
 #include <memory>
 #include <mutex>
+#include <atomic>
+#include <list>
+#include <vector>
+#include <array>
+#include <cstddef>
 #include <thread>
 #include <utility>
 #include <boost/asio.hpp>
@@ -131,6 +137,347 @@ namespace util
 			std::mutex m_Mutex;
 	};
 
+	class MemoryPoolStats
+	{
+		public:
+
+			struct ThreadCounters
+			{
+				std::atomic<uint64_t> numHits, numMisses; // updated by owner thread only
+				ThreadCounters (): numHits (0), numMisses (0) {};
+			};
+
+			MemoryPoolStats (size_t blockSize);
+
+			ThreadCounters * CreateThreadCounters ();
+			void BlockCreated ();
+			void BlockDeleted () { m_NumBlocks--; };
+
+			size_t GetBlockSize () const { return m_BlockSize; };
+			uint64_t GetNumHits () const;
+			uint64_t GetNumMisses () const;
+			int GetNumBlocks () const { return m_NumBlocks; };
+			int GetHighWater () const { return m_HighWater; };
+
+		private:
+
+			size_t m_BlockSize;
+			mutable std::mutex m_ThreadCountersMutex;
+			std::list<ThreadCounters> m_ThreadCounters; // never shrinks
+			std::atomic<int> m_NumBlocks, m_HighWater; // allocated from heap
+	};
+
+	std::vector<const MemoryPoolStats *> GetMemoryPoolsStats ();
+
+	/**
+	 * Per-thread cache of fixed size blocks. Allocation and release from the owner thread don't need any locks,
+	 * blocks released by other threads are pushed to owner's lock-free list and picked up on its next allocation.
+	 * Thread pools are never deleted, since blocks can outlive a thread.
+	 */
+	template<size_t BlockSize, size_t MaxCached>
+	class ThreadLocalMemoryPool
+	{
+		struct Block
+		{
+			ThreadLocalMemoryPool * owner;
+			Block * next;
+		};
+		static const size_t BLOCK_HEADER_SIZE = (sizeof (Block) + alignof (std::max_align_t) - 1)/alignof (std::max_align_t)*alignof (std::max_align_t);
+
+		public:
+
+			static void * Allocate ()
+			{
+				auto pool = GetThreadPool ();
+				return pool ? pool->AllocateBlock () : NewBlock (nullptr);
+			}
+
+			static void Release (void * p)
+			{
+				if (!p) return;
+				auto block = reinterpret_cast<Block *>(static_cast<uint8_t *>(p) - BLOCK_HEADER_SIZE);
+				auto owner = block->owner;
+				if (!owner)
+					DeleteBlock (block);
+				else if (owner == t_Pool)
+					owner->ReleaseLocal (block);
+				else
+					owner->ReleaseRemote (block);
+			}
+
+			static MemoryPoolStats& GetStats ()
+			{
+				static MemoryPoolStats * stats = new MemoryPoolStats (BlockSize); // might be used at exit
+				return *stats;
+			}
+
+		private:
+
+			struct ThreadExitGuard
+			{
+				~ThreadExitGuard ()
+				{
+					if (t_Pool) t_Pool->Orphan ();
+					t_Pool = nullptr;
+					t_IsThreadExiting = true;
+				}
+			};
+
+			ThreadLocalMemoryPool (): m_Free (nullptr), m_NumFree (0), m_Remote (nullptr),
+				m_IsOrphaned (false), m_Counters (GetStats ().CreateThreadCounters ()) {};
+
+			void * AllocateBlock ()
+			{
+				if (!m_Free) TakeRemote ();
+				if (m_Free)
+				{
+					auto block = m_Free;
+					m_Free = block->next;
+					m_NumFree--;
+					m_Counters->numHits.store (m_Counters->numHits.load (std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+					return reinterpret_cast<uint8_t *>(block) + BLOCK_HEADER_SIZE;
+				}
+				m_Counters->numMisses.store (m_Counters->numMisses.load (std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+				return NewBlock (this);
+			}
+
+			void ReleaseLocal (Block * block)
+			{
+				if (m_NumFree < MaxCached)
+				{
+					block->next = m_Free;
+					m_Free = block;
+					m_NumFree++;
+				}
+				else
+					DeleteBlock (block);
+			}
+
+			void ReleaseRemote (Block * block)
+			{
+				auto head = m_Remote.load (std::memory_order_relaxed);
+				do
+					block->next = head;
+				while (!m_Remote.compare_exchange_weak (head, block));
+				if (m_IsOrphaned.load ()) // owner thread has gone
+					DeleteList (m_Remote.exchange (nullptr));
+			}
+
+			void TakeRemote ()
+			{
+				auto block = m_Remote.exchange (nullptr);
+				while (block)
+				{
+					auto next = block->next;
+					ReleaseLocal (block);
+					block = next;
+				}
+			}
+
+			void Orphan ()
+			{
+				m_IsOrphaned.store (true);
+				DeleteList (m_Free);
+				m_Free = nullptr; m_NumFree = 0;
+				DeleteList (m_Remote.exchange (nullptr));
+			}
+
+			static void * NewBlock (ThreadLocalMemoryPool * owner)
+			{
+				auto block = static_cast<Block *>(::operator new (BLOCK_HEADER_SIZE + BlockSize));
+				block->owner = owner;
+				GetStats ().BlockCreated ();
+				return reinterpret_cast<uint8_t *>(block) + BLOCK_HEADER_SIZE;
+			}
+
+			static void DeleteBlock (Block * block)
+			{
+				::operator delete ((void *)block);
+				GetStats ().BlockDeleted ();
+			}
+
+			static void DeleteList (Block * block)
+			{
+				while (block)
+				{
+					auto next = block->next;
+					DeleteBlock (block);
+					block = next;
+				}
+			}
+
+			static ThreadLocalMemoryPool * GetThreadPool ()
+			{
+				if (!t_Pool && !t_IsThreadExiting)
+				{
+					t_Pool = new ThreadLocalMemoryPool ();
+					static thread_local ThreadExitGuard guard;
+					(void)guard;
+				}
+				return t_Pool;
+			}
+
+		private:
+
+			Block * m_Free; // owner thread only
+			size_t m_NumFree;
+			std::atomic<Block *> m_Remote; // released by other threads
+			std::atomic<bool> m_IsOrphaned;
+			MemoryPoolStats::ThreadCounters * m_Counters;
+
+			static thread_local ThreadLocalMemoryPool * t_Pool;
+			static thread_local bool t_IsThreadExiting;
+	};
+
+	template<size_t BlockSize, size_t MaxCached>
+	thread_local ThreadLocalMemoryPool<BlockSize, MaxCached> * ThreadLocalMemoryPool<BlockSize, MaxCached>::t_Pool = nullptr;
+	template<size_t BlockSize, size_t MaxCached>
+	thread_local bool ThreadLocalMemoryPool<BlockSize, MaxCached>::t_IsThreadExiting = false;
+
+	/** allocator for std::allocate_shared, object and control block come from ThreadLocalMemoryPool in one block */
+	template<typename T, size_t MaxCachedBytes>
+	struct ThreadLocalPoolAllocator
+	{
+		typedef T value_type;
+		typedef ThreadLocalMemoryPool<sizeof (T), (MaxCachedBytes/sizeof (T) > 16) ? MaxCachedBytes/sizeof (T) : 16> Pool;
+		template<typename U> struct rebind { typedef ThreadLocalPoolAllocator<U, MaxCachedBytes> other; };
+
+		ThreadLocalPoolAllocator () {};
+		template<typename U> ThreadLocalPoolAllocator (const ThreadLocalPoolAllocator<U, MaxCachedBytes>&) {}
+
+		T * allocate (size_t n)
+		{
+			return static_cast<T *>(n == 1 ? Pool::Allocate () : ::operator new (n*sizeof (T)));
+		}
+
+		void deallocate (T * p, size_t n)
+		{
+			if (n == 1) Pool::Release (p);
+			else ::operator delete ((void *)p);
+		}
+
+		template<typename U> bool operator== (const ThreadLocalPoolAllocator<U, MaxCachedBytes>&) const { return true; }
+		template<typename U> bool operator!= (const ThreadLocalPoolAllocator<U, MaxCachedBytes>&) const { return false; }
+	};
+
+	/**
+	 * Hierarchical timing wheel, NumLevels wheels of 2^SlotBits slots, each slot of a level spans a whole turn of the level below.
+	 * Add and expiration cost O(1) amortized, since entry moves down at most NumLevels times, and Advance looks only at due slots.
+	 * Entries are not removed or moved if item's deadline changes, expired callback should check actual state of the item
+	 * and add it again if it's not expired yet. Entries beyond whole span are kept at the last slot and checked again
+	 */
+	template<typename T, int SlotBits = 6, int NumLevels = 4>
+	class TimingWheel
+	{
+		public:
+
+			TimingWheel (uint64_t tickDuration = 1): m_TickDuration (tickDuration), m_CurrentTick (0), m_Size (0) {};
+
+			size_t GetSize () const { return m_Size; };
+
+			void Add (const T& item, uint64_t expiration) // in the same units as ts of Advance
+			{
+				uint64_t tick = (expiration + m_TickDuration - 1)/m_TickDuration;
+				if (tick <= m_CurrentTick) tick = m_CurrentTick + 1; // current slot is processed already
+				Insert (Entry{item, tick});
+				m_Size++;
+			}
+
+			template<typename Expired>
+			void Advance (uint64_t ts, Expired expired) // calls expired (item) for every item with expiration <= ts
+			{
+				uint64_t target = ts/m_TickDuration;
+				if (target <= m_CurrentTick) return;
+				if (!m_Size)
+				{
+					m_CurrentTick = target;
+					return;
+				}
+				std::vector<Entry> entries;
+				if (target - m_CurrentTick >= SPAN)
+				{
+					// first call or long pause, sort out everything at once
+					for (auto& slot: m_Slots)
+					{
+						entries.insert (entries.end (), slot.begin (), slot.end ());
+						slot.clear ();
+					}
+					m_CurrentTick = target;
+					Expire (entries, expired);
+					return;
+				}
+				while (m_CurrentTick < target && m_Size)
+				{
+					auto t = ++m_CurrentTick;
+					// move entries from upper levels' slots starting at this tick
+					for (int level = 1; level < NumLevels && !(t & ((1ULL << (SlotBits*level)) - 1)); level++)
+					{
+						entries.clear ();
+						entries.swap (m_Slots[GetSlotIndex (level, t)]);
+						for (auto& it: entries)
+							Insert (std::move (it));
+					}
+					entries.clear ();
+					entries.swap (m_Slots[GetSlotIndex (0, t)]);
+					Expire (entries, expired);
+				}
+				m_CurrentTick = target;
+			}
+
+			void Clear ()
+			{
+				for (auto& slot: m_Slots) slot.clear ();
+				m_Size = 0;
+			}
+
+		private:
+
+			static const uint64_t NUM_SLOTS = 1ULL << SlotBits;
+			static const uint64_t SPAN = 1ULL << (SlotBits*NumLevels); // in ticks
+
+			struct Entry
+			{
+				T item;
+				uint64_t tick;
+			};
+
+			static size_t GetSlotIndex (int level, uint64_t tick)
+			{
+				return level*NUM_SLOTS + ((tick >> (SlotBits*level)) & (NUM_SLOTS - 1));
+			}
+
+			void Insert (Entry&& entry) // entry.tick >= m_CurrentTick
+			{
+				uint64_t delta = entry.tick - m_CurrentTick, tick = entry.tick;
+				if (delta >= SPAN) tick = m_CurrentTick + SPAN - 1;
+				int level = 0;
+				while (level < NumLevels - 1 && delta >= (1ULL << (SlotBits*(level + 1)))) level++;
+				m_Slots[GetSlotIndex (level, tick)].push_back (std::move (entry));
+			}
+
+			template<typename Expired>
+			void Expire (std::vector<Entry>& entries, Expired& expired)
+			{
+				for (auto& it: entries)
+				{
+					if (it.tick <= m_CurrentTick)
+					{
+						m_Size--;
+						expired (it.item); // might add again
+					}
+					else
+						Insert (std::move (it)); // beyond span
+				}
+				entries.clear ();
+			}
+
+		private:
+
+			uint64_t m_TickDuration, m_CurrentTick;
+			size_t m_Size;
+			std::array<std::vector<Entry>, NUM_SLOTS*NumLevels> m_Slots;
+	};
+
 	class RunnableService
 	{
 		protected:
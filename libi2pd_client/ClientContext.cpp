@@ -42,6 +42,8 @@ namespace client
 
 	void ClientContext::Start ()
 	{
+		destinationWorkers.Start ();
+
 		// shared local destination
 		if (!m_SharedLocalDestination)
 			CreateNewSharedLocalDestination ();
@@ -200,6 +202,7 @@ namespace client
 			it.second->Stop ();
 		m_Destinations.clear ();
 		m_SharedLocalDestination = nullptr;
+		destinationWorkers.Stop ();
 	}
 
 	void ClientContext::ReloadConfig ()
@@ -445,6 +448,10 @@ namespace client
 		options[I2CP_PARAM_MIN_TUNNEL_LATENCY] = GetI2CPOption(section, I2CP_PARAM_MIN_TUNNEL_LATENCY, DEFAULT_MIN_TUNNEL_LATENCY);
 		options[I2CP_PARAM_MAX_TUNNEL_LATENCY] = GetI2CPOption(section, I2CP_PARAM_MAX_TUNNEL_LATENCY, DEFAULT_MAX_TUNNEL_LATENCY);
 		options[I2CP_PARAM_STREAMING_INITIAL_ACK_DELAY] = GetI2CPOption(section, I2CP_PARAM_STREAMING_INITIAL_ACK_DELAY, DEFAULT_INITIAL_ACK_DELAY);
+		std::string congestionControl = GetI2CPStringOption(section, I2CP_PARAM_STREAMING_CONGESTION_CONTROL, "");
+		if (congestionControl.length () > 0) options[I2CP_PARAM_STREAMING_CONGESTION_CONTROL] = congestionControl;
+		std::string pacing = GetI2CPStringOption(section, I2CP_PARAM_STREAMING_PACING, "");
+		if (pacing.length () > 0) options[I2CP_PARAM_STREAMING_PACING] = pacing;
 		options[I2CP_PARAM_LEASESET_TYPE] = GetI2CPOption(section, I2CP_PARAM_LEASESET_TYPE, DEFAULT_LEASESET_TYPE);
 		std::string encType = GetI2CPStringOption(section, I2CP_PARAM_LEASESET_ENCRYPTION_TYPE, "");
 		if (encType.length () > 0) options[I2CP_PARAM_LEASESET_ENCRYPTION_TYPE] = encType;
@@ -89,7 +89,7 @@ namespace proxy {
 			void SocksProxySuccess();
 			void HandoverToUpstreamProxy();
 
-			uint8_t m_recv_chunk[8192];
+			i2p::client::RelayBuffer m_recv_chunk; // while reading only
 			std::string m_recv_buf; // from client
 			std::string m_send_buf; // to upstream
 			std::shared_ptr<boost::asio::ip::tcp::socket> m_sock;
@@ -109,7 +109,7 @@ namespace proxy {
 		public:
 
 			HTTPReqHandler(HTTPProxy * parent, std::shared_ptr<boost::asio::ip::tcp::socket> sock) :
-				I2PServiceHandler(parent), m_sock(sock),
+				I2PServiceHandler(parent), m_recv_chunk(8192), m_sock(sock),
 				m_proxysock(std::make_shared<boost::asio::ip::tcp::socket>(parent->GetService())),
 				m_proxy_resolver(parent->GetService()),
 				m_OutproxyUrl(parent->GetOutproxyURL()),
@@ -125,7 +125,7 @@ namespace proxy {
 			LogPrint(eLogError, "HTTPProxy: no socket for read");
 			return;
 		}
-		m_sock->async_read_some(boost::asio::buffer(m_recv_chunk, sizeof(m_recv_chunk)),
+		m_sock->async_read_some(boost::asio::null_buffers(),
 			std::bind(&HTTPReqHandler::HandleSockRecv, shared_from_this(),
 			std::placeholders::_1, std::placeholders::_2));
 	}
@@ -607,15 +607,24 @@ namespace proxy {
 	/* will be called after some data received from client */
 	void HTTPReqHandler::HandleSockRecv(const boost::system::error_code & ecode, std::size_t len)
 	{
+		boost::system::error_code ec = ecode;
+		if (!ec && m_sock)
+			len = m_recv_chunk.ReadSome (*m_sock, ec);
 		LogPrint(eLogDebug, "HTTPProxy: sock recv: ", len, " bytes, recv buf: ", m_recv_buf.length(), ", send buf: ", m_send_buf.length());
-		if(ecode)
+		if (ec == boost::asio::error::would_block)
 		{
-			LogPrint(eLogWarning, "HTTPProxy: sock recv got error: ", ecode);
+			AsyncSockRead();
+			return;
+		}
+		if(ec)
+		{
+			LogPrint(eLogWarning, "HTTPProxy: sock recv got error: ", ec);
 			Terminate();
 			return;
 		}
 
-		m_recv_buf.append(reinterpret_cast<const char *>(m_recv_chunk), len);
+		m_recv_buf.append(reinterpret_cast<const char *>(m_recv_chunk.GetBuffer ()), len);
+		m_recv_chunk.Release ();
 		if (HandleRequest()) {
 			m_recv_buf.clear();
 			return;
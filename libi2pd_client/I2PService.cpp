@@ -6,6 +6,8 @@
 * See full license text in LICENSE file at top of project tree
 */
 
+#include <algorithm>
+#include "util.h"
 #include "Destination.h"
 #include "Identity.h"
 #include "ClientContext.h"
@@ -148,6 +150,91 @@ namespace client
 		}
 	}
 
+	template<size_t Size>
+	using RelayBufferPool = i2p::util::ThreadLocalMemoryPool<Size, RELAY_BUFFER_MAX_CACHED_BYTES/Size>;
+
+	static uint8_t * AllocateRelayBuffer (int sizeClass)
+	{
+		switch (sizeClass)
+		{
+			case 0: return (uint8_t *)RelayBufferPool<RELAY_BUFFER_SIZES[0]>::Allocate ();
+			case 1: return (uint8_t *)RelayBufferPool<RELAY_BUFFER_SIZES[1]>::Allocate ();
+			case 2: return (uint8_t *)RelayBufferPool<RELAY_BUFFER_SIZES[2]>::Allocate ();
+			default: return (uint8_t *)RelayBufferPool<RELAY_BUFFER_SIZES[3]>::Allocate ();
+		}
+	}
+
+	static void ReleaseRelayBuffer (uint8_t * buf, int sizeClass)
+	{
+		switch (sizeClass)
+		{
+			case 0: RelayBufferPool<RELAY_BUFFER_SIZES[0]>::Release (buf); break;
+			case 1: RelayBufferPool<RELAY_BUFFER_SIZES[1]>::Release (buf); break;
+			case 2: RelayBufferPool<RELAY_BUFFER_SIZES[2]>::Release (buf); break;
+			default: RelayBufferPool<RELAY_BUFFER_SIZES[3]>::Release (buf);
+		}
+	}
+
+	RelayBuffer::RelayBuffer (size_t maxSize):
+		m_Buffer (nullptr), m_SizeClass (0), m_AcquiredClass (0), m_MaxSizeClass (0)
+	{
+		while (m_MaxSizeClass < RELAY_BUFFER_NUM_SIZES - 1 && RELAY_BUFFER_SIZES[m_MaxSizeClass] < maxSize)
+			m_MaxSizeClass++;
+	}
+
+	uint8_t * RelayBuffer::Acquire (size_t minSize)
+	{
+		int sizeClass = m_SizeClass;
+		while (sizeClass < m_MaxSizeClass && RELAY_BUFFER_SIZES[sizeClass] < minSize)
+			sizeClass++;
+		if (m_Buffer)
+		{
+			if (m_AcquiredClass >= sizeClass) return m_Buffer;
+			Release ();
+		}
+		m_Buffer = AllocateRelayBuffer (sizeClass);
+		m_AcquiredClass = sizeClass;
+		return m_Buffer;
+	}
+
+	void RelayBuffer::Release ()
+	{
+		if (m_Buffer)
+		{
+			ReleaseRelayBuffer (m_Buffer, m_AcquiredClass);
+			m_Buffer = nullptr;
+		}
+	}
+
+	void RelayBuffer::Update (size_t len)
+	{
+		if (!m_Buffer) return;
+		if (len >= RELAY_BUFFER_SIZES[m_AcquiredClass]) // filled up, bulk transfer
+			m_SizeClass = std::min (m_AcquiredClass + 1, m_MaxSizeClass);
+		else if (m_AcquiredClass > 0 && len < RELAY_BUFFER_SIZES[m_AcquiredClass]/4)
+			m_SizeClass = m_AcquiredClass - 1;
+		else
+			m_SizeClass = m_AcquiredClass;
+	}
+
+	size_t RelayBuffer::ReadSome (boost::asio::ip::tcp::socket& socket, boost::system::error_code& ecode)
+	{
+		if (!socket.non_blocking ())
+		{
+			socket.non_blocking (true, ecode); // would_block rather than wait if nothing to read
+			if (ecode) return 0;
+		}
+		size_t available = socket.available (ecode);
+		if (ecode) return 0;
+		auto buf = Acquire (available);
+		size_t len = socket.read_some (boost::asio::buffer (buf, GetSize ()), ecode);
+		if (len > 0)
+			Update (len);
+		else
+			Release ();
+		return len;
+	}
+
 	TCPIPPipe::TCPIPPipe(I2PService * owner, std::shared_ptr<boost::asio::ip::tcp::socket> upstream, std::shared_ptr<boost::asio::ip::tcp::socket> downstream) : I2PServiceHandler(owner), m_up(upstream), m_down(downstream)
 	{
 		boost::asio::socket_base::receive_buffer_size option(TCP_IP_PIPE_BUFFER_SIZE);
@@ -188,7 +275,8 @@ namespace client
 	{
 		if (m_up)
 		{
-			m_up->async_read_some(boost::asio::buffer(m_upstream_to_down_buf, TCP_IP_PIPE_BUFFER_SIZE),
+			// wait for data without holding a buffer
+			m_up->async_read_some(boost::asio::null_buffers (),
 				std::bind(&TCPIPPipe::HandleUpstreamReceived, shared_from_this(),
 					std::placeholders::_1, std::placeholders::_2));
 		}
@@ -199,7 +287,7 @@ namespace client
 	void TCPIPPipe::AsyncReceiveDownstream()
 	{
 		if (m_down) {
-			m_down->async_read_some(boost::asio::buffer(m_downstream_to_up_buf, TCP_IP_PIPE_BUFFER_SIZE),
+			m_down->async_read_some(boost::asio::null_buffers (),
 				std::bind(&TCPIPPipe::HandleDownstreamReceived, shared_from_this(),
 					std::placeholders::_1, std::placeholders::_2));
 		}
@@ -212,7 +300,7 @@ namespace client
 		if (m_up)
 		{
 			LogPrint(eLogDebug, "TCPIPPipe: upstream: ", (int) len, " bytes written");
-			boost::asio::async_write(*m_up, boost::asio::buffer(m_upstream_buf, len),
+			boost::asio::async_write(*m_up, boost::asio::buffer(m_downstream_to_up_buf.GetBuffer (), len),
 				boost::asio::transfer_all(),
 				std::bind(&TCPIPPipe::HandleUpstreamWrite,
 					shared_from_this(),
@@ -227,7 +315,7 @@ namespace client
 		if (m_down)
 		{
 			LogPrint(eLogDebug, "TCPIPPipe: downstream: ", (int) len, " bytes written");
-			boost::asio::async_write(*m_down, boost::asio::buffer(m_downstream_buf, len),
+			boost::asio::async_write(*m_down, boost::asio::buffer(m_upstream_to_down_buf.GetBuffer (), len),
 				boost::asio::transfer_all(),
 				std::bind(&TCPIPPipe::HandleDownstreamWrite,
 					shared_from_this(),
@@ -240,20 +328,23 @@ namespace client
 
 	void TCPIPPipe::HandleDownstreamReceived(const boost::system::error_code & ecode, std::size_t bytes_transfered)
 	{
+		boost::system::error_code ec = ecode;
+		if (!ec && m_down)
+			bytes_transfered = m_downstream_to_up_buf.ReadSome (*m_down, ec);
 		LogPrint(eLogDebug, "TCPIPPipe: downstream: ", (int) bytes_transfered, " bytes received");
-		if (ecode)
+		if (ec == boost::asio::error::would_block)
+			AsyncReceiveDownstream();
+		else if (ec)
 		{
-			LogPrint(eLogError, "TCPIPPipe: downstream read error:" , ecode.message());
-			if (ecode != boost::asio::error::operation_aborted)
+			LogPrint(eLogError, "TCPIPPipe: downstream read error:" , ec.message());
+			if (ec != boost::asio::error::operation_aborted)
 				Terminate();
-		} else {
-			if (bytes_transfered > 0 )
-				memcpy(m_upstream_buf, m_downstream_to_up_buf, bytes_transfered);
+		} else
 			UpstreamWrite(bytes_transfered);
-		}
 	}
 
 	void TCPIPPipe::HandleDownstreamWrite(const boost::system::error_code & ecode) {
+		m_upstream_to_down_buf.Release ();
 		if (ecode)
 		{
 			LogPrint(eLogError, "TCPIPPipe: downstream write error:" , ecode.message());
@@ -265,6 +356,7 @@ namespace client
 	}
 
 	void TCPIPPipe::HandleUpstreamWrite(const boost::system::error_code & ecode) {
+		m_downstream_to_up_buf.Release ();
 		if (ecode)
 		{
 			LogPrint(eLogError, "TCPIPPipe: upstream write error:" , ecode.message());
@@ -277,17 +369,19 @@ namespace client
 
 	void TCPIPPipe::HandleUpstreamReceived(const boost::system::error_code & ecode, std::size_t bytes_transfered)
 	{
+		boost::system::error_code ec = ecode;
+		if (!ec && m_up)
+			bytes_transfered = m_upstream_to_down_buf.ReadSome (*m_up, ec);
 		LogPrint(eLogDebug, "TCPIPPipe: upstream ", (int)bytes_transfered, " bytes received");
-		if (ecode)
+		if (ec == boost::asio::error::would_block)
+			AsyncReceiveUpstream();
+		else if (ec)
 		{
-			LogPrint(eLogError, "TCPIPPipe: upstream read error:" , ecode.message());
-			if (ecode != boost::asio::error::operation_aborted)
+			LogPrint(eLogError, "TCPIPPipe: upstream read error:" , ec.message());
+			if (ec != boost::asio::error::operation_aborted)
 				Terminate();
-		} else {
-			if (bytes_transfered > 0 )
-				memcpy(m_downstream_buf, m_upstream_to_down_buf, bytes_transfered);
+		} else
 			DownstreamWrite(bytes_transfered);
-		}
 	}
 
 	void TCPIPAcceptor::Start ()
@@ -119,6 +119,39 @@ namespace client
 			std::atomic<bool> m_Dead; //To avoid cleaning up multiple times
 	};
 
+	constexpr size_t RELAY_BUFFER_SIZES[] = { 2048, 8192, 32768, 65536 }; // size classes
+	const int RELAY_BUFFER_NUM_SIZES = sizeof (RELAY_BUFFER_SIZES)/sizeof (RELAY_BUFFER_SIZES[0]);
+	const size_t RELAY_BUFFER_MAX_SIZE = 65536;
+	const size_t RELAY_BUFFER_MAX_CACHED_BYTES = 256*1024; // per size class and thread
+
+	/**
+	 * Buffer for relayed data, borrowed from per-thread pools only while data is in flight.
+	 * Size class grows when reads fill the buffer and shrinks back when they use a small part of it.
+	 */
+	class RelayBuffer
+	{
+		public:
+
+			RelayBuffer (size_t maxSize = RELAY_BUFFER_MAX_SIZE);
+			~RelayBuffer () { Release (); };
+
+			RelayBuffer (const RelayBuffer&) = delete;
+			RelayBuffer& operator= (const RelayBuffer&) = delete;
+
+			uint8_t * Acquire (size_t minSize = 0); // keeps current buffer if it's large enough
+			void Release ();
+			void Update (size_t len); // adjust size class to the last read
+			size_t ReadSome (boost::asio::ip::tcp::socket& socket, boost::system::error_code& ecode); // socket is ready for read
+
+			uint8_t * GetBuffer () const { return m_Buffer; };
+			size_t GetSize () const { return m_Buffer ? RELAY_BUFFER_SIZES[m_AcquiredClass] : 0; };
+
+		private:
+
+			uint8_t * m_Buffer;
+			int m_SizeClass, m_AcquiredClass, m_MaxSizeClass;
+	};
+
 	const size_t TCP_IP_PIPE_BUFFER_SIZE = 8192 * 8;
 
 	// bidirectional pipe for 2 tcp/ip sockets
@@ -144,8 +177,7 @@ namespace client
 
 		private:
 
-			uint8_t m_upstream_to_down_buf[TCP_IP_PIPE_BUFFER_SIZE], m_downstream_to_up_buf[TCP_IP_PIPE_BUFFER_SIZE];
-			uint8_t m_upstream_buf[TCP_IP_PIPE_BUFFER_SIZE], m_downstream_buf[TCP_IP_PIPE_BUFFER_SIZE];
+			RelayBuffer m_upstream_to_down_buf, m_downstream_to_up_buf; // held from read until written
 			std::shared_ptr<boost::asio::ip::tcp::socket> m_up, m_down;
 	};
 
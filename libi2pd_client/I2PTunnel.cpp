@@ -61,7 +61,7 @@ namespace client
 			if (msg)
 				m_Stream->Send (msg, len); // connect and send
 			else
-				m_Stream->Send (m_Buffer, 0); // connect
+				m_Stream->Send (nullptr, 0); // connect
 		}
 		StreamReceive ();
 		Receive ();
@@ -123,18 +123,24 @@ namespace client
 
 	void I2PTunnelConnection::Receive ()
 	{
-		m_Socket->async_read_some (boost::asio::buffer(m_Buffer, I2P_TUNNEL_CONNECTION_BUFFER_SIZE),
+		// wait for data without holding a buffer
+		m_Socket->async_read_some (boost::asio::null_buffers (),
 			std::bind(&I2PTunnelConnection::HandleReceived, shared_from_this (),
 			std::placeholders::_1, std::placeholders::_2));
 	}
 
 	void I2PTunnelConnection::HandleReceived (const boost::system::error_code& ecode, std::size_t bytes_transferred)
 	{
-		if (ecode)
+		boost::system::error_code ec = ecode;
+		if (!ec)
+			bytes_transferred = m_Buffer.ReadSome (*m_Socket, ec);
+		if (ec == boost::asio::error::would_block)
+			Receive ();
+		else if (ec)
 		{
-			if (ecode != boost::asio::error::operation_aborted)
+			if (ec != boost::asio::error::operation_aborted)
 			{
-				LogPrint (eLogError, "I2PTunnel: read error: ", ecode.message ());
+				LogPrint (eLogError, "I2PTunnel: read error: ", ec.message ());
 				Terminate ();
 			}
 		}
@@ -143,7 +149,7 @@ namespace client
 			if (m_Stream)
 			{
 				auto s = shared_from_this ();
-				m_Stream->AsyncSend (m_Buffer, bytes_transferred,
+				m_Stream->AsyncSend (m_Buffer.GetBuffer (), bytes_transferred,
 					[s](const boost::system::error_code& ecode)
 					{
 						if (!ecode)
@@ -152,11 +158,13 @@ namespace client
 							s->Terminate ();
 					});
 			}
+			m_Buffer.Release (); // copied by stream
 		}
 	}
 
 	void I2PTunnelConnection::HandleWrite (const boost::system::error_code& ecode)
 	{
+		m_StreamBuffer.Release ();
 		if (ecode)
 		{
 			LogPrint (eLogError, "I2PTunnel: write error: ", ecode.message ());
@@ -174,7 +182,8 @@ namespace client
 			if (m_Stream->GetStatus () == i2p::stream::eStreamStatusNew ||
 				m_Stream->GetStatus () == i2p::stream::eStreamStatusOpen) // regular
 			{
-				m_Stream->AsyncReceive (boost::asio::buffer (m_StreamBuffer, I2P_TUNNEL_CONNECTION_BUFFER_SIZE),
+				// wait for data without holding a buffer
+				m_Stream->AsyncReceive (boost::asio::mutable_buffers_1 (nullptr, 0),
 					std::bind (&I2PTunnelConnection::HandleStreamReceive, shared_from_this (),
 					std::placeholders::_1, std::placeholders::_2),
 					I2P_TUNNEL_CONNECTION_MAX_IDLE);
@@ -182,10 +191,7 @@ namespace client
 			else // closed by peer
 			{
 				// get remaning data
-				auto len = m_Stream->ReadSome (m_StreamBuffer, I2P_TUNNEL_CONNECTION_BUFFER_SIZE);
-				if (len > 0) // still some data
-					Write (m_StreamBuffer, len);
-				else // no more data
+				if (!StreamRead ()) // no more data
 					Terminate ();
 			}
 		}
@@ -198,9 +204,7 @@ namespace client
 			if (ecode != boost::asio::error::operation_aborted)
 			{
 				LogPrint (eLogError, "I2PTunnel: stream read error: ", ecode.message ());
-				if (bytes_transferred > 0)
-					Write (m_StreamBuffer, bytes_transferred); // postpone termination
-				else if (ecode == boost::asio::error::timed_out && m_Stream && m_Stream->IsOpen ())
+				if (ecode == boost::asio::error::timed_out && m_Stream && m_Stream->IsOpen ())
 					StreamReceive ();
 				else
 					Terminate ();
@@ -208,8 +212,22 @@ namespace client
 			else
 				Terminate ();
 		}
-		else
-			Write (m_StreamBuffer, bytes_transferred);
+		else if (!StreamRead ())
+			StreamReceive ();
+	}
+
+	bool I2PTunnelConnection::StreamRead ()
+	{
+		auto buf = m_StreamBuffer.Acquire ();
+		auto len = m_Stream ? m_Stream->ReadSome (buf, m_StreamBuffer.GetSize ()) : 0;
+		if (!len)
+		{
+			m_StreamBuffer.Release ();
+			return false;
+		}
+		m_StreamBuffer.Update (len);
+		Write (buf, len);
+		return true;
 	}
 
 	void I2PTunnelConnection::Write (const uint8_t * buf, size_t len)
@@ -235,10 +253,9 @@ namespace client
 				// send destination first like received from I2P
 				std::string dest = m_Stream->GetRemoteIdentity ()->ToBase64 ();
 				dest += "\n";
-				if(sizeof(m_StreamBuffer) >= dest.size()) {
-					memcpy (m_StreamBuffer, dest.c_str (), dest.size ());
-				}
-				HandleStreamReceive (boost::system::error_code (), dest.size ());
+				auto buf = m_StreamBuffer.Acquire (dest.size ());
+				memcpy (buf, dest.c_str (), dest.size ());
+				Write (buf, dest.size ());
 			}
 			Receive ();
 		}
@@ -693,39 +710,48 @@ namespace client
 		RemotePort(theirPort)
 	{
 		IPSocket.set_option (boost::asio::socket_base::receive_buffer_size (I2P_UDP_MAX_MTU ));
+		IPSocket.non_blocking (true); // don't wait if woken up for nothing
 		memcpy(Identity, to->data(), 32);
 		Receive();
 	}
 
 	void UDPSession::Receive() {
 		LogPrint(eLogDebug, "UDPSession: Receive");
-		IPSocket.async_receive_from(boost::asio::buffer(m_Buffer, I2P_UDP_MAX_MTU),
-			FromEndpoint, std::bind(&UDPSession::HandleReceived, this, std::placeholders::_1, std::placeholders::_2));
+		// wait for datagrams without holding a buffer
+		IPSocket.async_receive(boost::asio::null_buffers(),
+			std::bind(&UDPSession::HandleReceived, this, std::placeholders::_1, std::placeholders::_2));
 	}
 
 	void UDPSession::HandleReceived(const boost::system::error_code & ecode, std::size_t len)
 	{
 		if(!ecode)
 		{
-			LogPrint(eLogDebug, "UDPSession: forward ", len, "B from ", FromEndpoint);
-			LastActivity = i2p::util::GetMillisecondsSinceEpoch();
+			RelayBuffer buffer (I2P_UDP_MAX_MTU); // datagrams are copied when sent
 			auto session = m_Destination->GetSession (Identity);
-			m_Destination->SendDatagram(session, m_Buffer, len, LocalPort, RemotePort);
 			size_t numPackets = 0;
 			while (numPackets < i2p::datagram::DATAGRAM_SEND_QUEUE_MAX_SIZE)
-			{	
+			{
 				boost::system::error_code ec;
 				size_t moreBytes = IPSocket.available(ec);
-				if (ec || !moreBytes) break;
-				len = IPSocket.receive_from (boost::asio::buffer (m_Buffer, I2P_UDP_MAX_MTU), FromEndpoint, 0, ec);
-				m_Destination->SendRawDatagram (session, m_Buffer, len, LocalPort, RemotePort);			
+				if (ec || (numPackets > 0 && !moreBytes)) break;
+				auto buf = buffer.Acquire (moreBytes);
+				len = IPSocket.receive_from (boost::asio::buffer (buf, buffer.GetSize ()), FromEndpoint, 0, ec);
+				if (ec) break;
+				if (!numPackets)
+				{
+					LogPrint(eLogDebug, "UDPSession: forward ", len, "B from ", FromEndpoint);
+					LastActivity = i2p::util::GetMillisecondsSinceEpoch();
+					m_Destination->SendDatagram(session, buf, len, LocalPort, RemotePort);
+				}
+				else
+					m_Destination->SendRawDatagram (session, buf, len, LocalPort, RemotePort);
 				numPackets++;
-			}	
-			if (numPackets > 0)
-				LogPrint(eLogDebug, "UDPSession: forward more ", numPackets, "packets B from ", FromEndpoint);
+			}
+			if (numPackets > 1)
+				LogPrint(eLogDebug, "UDPSession: forward more ", numPackets - 1, "packets B from ", FromEndpoint);
 			m_Destination->FlushSendQueue (session);
 			Receive();
-		} 
+		}
 		else
 			LogPrint(eLogError, "UDPSession: ", ecode.message());
 	}
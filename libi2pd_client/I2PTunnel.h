@@ -60,13 +60,14 @@ namespace client
 
 			void StreamReceive ();
 			void HandleStreamReceive (const boost::system::error_code& ecode, std::size_t bytes_transferred);
+			bool StreamRead (); // false if no data
 			void HandleConnect (const boost::system::error_code& ecode);
 
 			std::shared_ptr<const boost::asio::ip::tcp::socket> GetSocket () const { return m_Socket; };
 
 		private:
 
-			uint8_t m_Buffer[I2P_TUNNEL_CONNECTION_BUFFER_SIZE], m_StreamBuffer[I2P_TUNNEL_CONNECTION_BUFFER_SIZE];
+			RelayBuffer m_Buffer, m_StreamBuffer; // from socket until sent to stream, from stream until written to socket
 			std::shared_ptr<boost::asio::ip::tcp::socket> m_Socket;
 			std::shared_ptr<i2p::stream::Stream> m_Stream;
 			boost::asio::ip::tcp::endpoint m_RemoteEndpoint;
@@ -181,8 +182,6 @@ namespace client
 		uint16_t LocalPort;
 		uint16_t RemotePort;
 
-		uint8_t m_Buffer[I2P_UDP_MAX_MTU];
-
 		UDPSession(boost::asio::ip::udp::endpoint localEndpoint,
 			const std::shared_ptr<i2p::client::ClientDestination> & localDestination,
 			boost::asio::ip::udp::endpoint remote, const i2p::data::IdentHash * ident,
@@ -25,7 +25,7 @@ namespace client
 {
 	SAMSocket::SAMSocket (SAMBridge& owner):
 		m_Owner (owner), m_Socket(owner.GetService()), m_Timer (m_Owner.GetService ()),
-		m_BufferOffset (0),
+		m_BufferOffset (0), m_StreamBuffer (SAM_SOCKET_BUFFER_SIZE),
 		m_SocketType (eSAMSocketTypeUnknown), m_IsSilent (false),
 		m_IsAccepting (false), m_Stream (nullptr)
 	{
@@ -771,7 +771,8 @@ namespace client
 			if (m_Stream->GetStatus () == i2p::stream::eStreamStatusNew ||
 				m_Stream->GetStatus () == i2p::stream::eStreamStatusOpen) // regular
 			{
-				m_Stream->AsyncReceive (boost::asio::buffer (m_StreamBuffer, SAM_SOCKET_BUFFER_SIZE),
+				// wait for data without holding a buffer
+				m_Stream->AsyncReceive (boost::asio::mutable_buffers_1 (nullptr, 0),
 						std::bind (&SAMSocket::HandleI2PReceive, shared_from_this(),
 						std::placeholders::_1, std::placeholders::_2),
 							SAM_SOCKET_CONNECTION_MAX_IDLE);
@@ -808,11 +809,48 @@ namespace client
 		delete [] buff;
 	}
 
+	void SAMSocket::WriteI2PDatagram(std::shared_ptr<std::vector<uint8_t> > buf)
+	{
+		// called from destination's thread, m_DatagramsQueue is accessed in SAM's thread only
+		auto s = shared_from_this ();
+		m_Owner.GetService ().post ([s, buf]
+			{
+				s->m_DatagramsQueue.push_back (buf);
+				if (s->m_DatagramsQueue.size () == 1) // otherwise previous one is being written
+					s->WriteNextI2PDatagram ();
+			});
+	}
+
+	void SAMSocket::WriteNextI2PDatagram()
+	{
+		auto buf = m_DatagramsQueue.front ();
+		boost::asio::async_write (
+			m_Socket,
+			boost::asio::buffer (buf->data (), buf->size ()),
+			boost::asio::transfer_all(),
+			std::bind(&SAMSocket::HandleWriteI2PDatagram, shared_from_this(), std::placeholders::_1));
+	}
+
+	void SAMSocket::HandleWriteI2PDatagram(const boost::system::error_code & ec)
+	{
+		if (ec)
+		{
+			m_DatagramsQueue.clear ();
+			LogPrint (eLogError, "SAM: socket write error: ", ec.message ());
+			if (ec != boost::asio::error::operation_aborted)
+				Terminate ("socket write error at HandleWriteI2PDatagram");
+			return;
+		}
+		if (!m_DatagramsQueue.empty ()) m_DatagramsQueue.pop_front ();
+		if (!m_DatagramsQueue.empty ())
+			WriteNextI2PDatagram ();
+	}
+
 	void SAMSocket::WriteI2PData(size_t sz)
 	{
 		boost::asio::async_write (
 			m_Socket,
-			boost::asio::buffer (m_StreamBuffer, sz),
+			boost::asio::buffer (m_StreamBuffer.GetBuffer (), sz),
 			boost::asio::transfer_all(),
 			std::bind(&SAMSocket::HandleWriteI2PData, shared_from_this(), std::placeholders::_1, std::placeholders::_2));
 	}
@@ -844,18 +882,28 @@ namespace client
 		{
 			if (m_SocketType != eSAMSocketTypeTerminated)
 			{
+				if (!bytes_transferred && m_Stream) // data is available
+				{
+					auto buf = m_StreamBuffer.Acquire ();
+					bytes_transferred = m_Stream->ReadSome (buf, m_StreamBuffer.GetSize ());
+					m_StreamBuffer.Update (bytes_transferred);
+				}
 				if (bytes_transferred > 0)
 				{
 					WriteI2PData(bytes_transferred);
 				}
 				else
+				{
+					m_StreamBuffer.Release ();
 					I2PReceive();
+				}
 			}
 		}
 	}
 
 	void SAMSocket::HandleWriteI2PData (const boost::system::error_code& ecode, size_t bytes_transferred)
 	{
+		m_StreamBuffer.Release ();
 		if (ecode)
 		{
 			LogPrint (eLogError, "SAM: socket write error: ", ecode.message ());
@@ -898,9 +946,10 @@ namespace client
 
 				// send remote peer address as base64
 				const size_t l = ident_ptr->ToBuffer (ident, ident_len);
-				const size_t l1 = i2p::data::ByteStreamToBase64 (ident, l, (char *)m_StreamBuffer, SAM_SOCKET_BUFFER_SIZE);
+				auto buf = m_StreamBuffer.Acquire (SAM_SOCKET_BUFFER_SIZE);
+				const size_t l1 = i2p::data::ByteStreamToBase64 (ident, l, (char *)buf, m_StreamBuffer.GetSize ());
 				delete[] ident;
-				m_StreamBuffer[l1] = '\n';
+				buf[l1] = '\n';
 				HandleI2PReceive (boost::system::error_code (), l1 +1); // we send identity like it has been received from stream
 			}
 			else
@@ -937,15 +986,17 @@ namespace client
 			}
 			else
 			{
+				auto data = std::make_shared<std::vector<uint8_t> > (SAM_SOCKET_BUFFER_SIZE);
 #ifdef _MSC_VER
-				size_t l = sprintf_s ((char *)m_StreamBuffer, SAM_SOCKET_BUFFER_SIZE, SAM_DATAGRAM_RECEIVED, base64.c_str (), (long unsigned int)len);
+				size_t l = sprintf_s ((char *)data->data (), data->size (), SAM_DATAGRAM_RECEIVED, base64.c_str (), (long unsigned int)len);
 #else
-				size_t l = snprintf ((char *)m_StreamBuffer, SAM_SOCKET_BUFFER_SIZE, SAM_DATAGRAM_RECEIVED, base64.c_str (), (long unsigned int)len);
+				size_t l = snprintf ((char *)data->data (), data->size (), SAM_DATAGRAM_RECEIVED, base64.c_str (), (long unsigned int)len);
 #endif
-				if (len < SAM_SOCKET_BUFFER_SIZE - l)
+				if (len < data->size () - l)
 				{
-					memcpy (m_StreamBuffer + l, buf, len);
-					WriteI2PData(len + l);
+					memcpy (data->data () + l, buf, len);
+					data->resize (len + l);
+					WriteI2PDatagram (data);
 				}
 				else
 					LogPrint (eLogWarning, "SAM: received datagram size ", len," exceeds buffer");
@@ -965,15 +1016,17 @@ namespace client
 				m_Owner.SendTo(buf, len, ep);
 			else
 			{
+				auto data = std::make_shared<std::vector<uint8_t> > (SAM_SOCKET_BUFFER_SIZE);
 #ifdef _MSC_VER
-				size_t l = sprintf_s ((char *)m_StreamBuffer, SAM_SOCKET_BUFFER_SIZE, SAM_RAW_RECEIVED, (long unsigned int)len);
+				size_t l = sprintf_s ((char *)data->data (), data->size (), SAM_RAW_RECEIVED, (long unsigned int)len);
 #else
-				size_t l = snprintf ((char *)m_StreamBuffer, SAM_SOCKET_BUFFER_SIZE, SAM_RAW_RECEIVED, (long unsigned int)len);
+				size_t l = snprintf ((char *)data->data (), data->size (), SAM_RAW_RECEIVED, (long unsigned int)len);
 #endif
-				if (len < SAM_SOCKET_BUFFER_SIZE - l)
+				if (len < data->size () - l)
 				{
-					memcpy (m_StreamBuffer + l, buf, len);
-					WriteI2PData(len + l);
+					memcpy (data->data () + l, buf, len);
+					data->resize (len + l);
+					WriteI2PDatagram (data);
 				}
 				else
 					LogPrint (eLogWarning, "SAM: received raw datagram size ", len," exceeds buffer");
@@ -13,6 +13,7 @@
 #include <string>
 #include <map>
 #include <list>
+#include <vector>
 #include <thread>
 #include <mutex>
 #include <memory>
@@ -22,6 +23,7 @@
 #include "LeaseSet.h"
 #include "Streaming.h"
 #include "Destination.h"
+#include "I2PService.h"
 
 namespace i2p
 {
@@ -143,8 +145,11 @@ namespace client
 
 			void WriteI2PData(size_t sz);
 			void WriteI2PDataImmediate(uint8_t * ptr, size_t sz);
+			void WriteI2PDatagram(std::shared_ptr<std::vector<uint8_t> > buf); // every datagram has own buffer
+			void WriteNextI2PDatagram();
 
 			void HandleWriteI2PDataImmediate(const boost::system::error_code & ec, uint8_t * buff);
+			void HandleWriteI2PDatagram(const boost::system::error_code & ec);
 			void HandleStreamSend(const boost::system::error_code & ec);
 
 		private:
@@ -154,7 +159,8 @@ namespace client
 			boost::asio::deadline_timer m_Timer;
 			char m_Buffer[SAM_SOCKET_BUFFER_SIZE + 1];
 			size_t m_BufferOffset;
-			uint8_t m_StreamBuffer[SAM_SOCKET_BUFFER_SIZE];
+			RelayBuffer m_StreamBuffer; // from stream until written to socket
+			std::list<std::shared_ptr<std::vector<uint8_t> > > m_DatagramsQueue; // front is being written to socket
 			SAMSocketType m_SocketType;
 			std::string m_ID; // nickname
 			bool m_IsSilent;
@@ -149,7 +149,7 @@ namespace proxy
 				boost::asio::ip::tcp::resolver::iterator itr);
 
 			boost::asio::ip::tcp::resolver m_proxy_resolver;
-			uint8_t m_sock_buff[socks_buffer_size];
+			i2p::client::RelayBuffer m_sock_buff; // held while request is parsed, remaining data points to it
 			std::shared_ptr<boost::asio::ip::tcp::socket> m_sock, m_upstreamSock;
 			std::shared_ptr<i2p::stream::Stream> m_stream;
 			uint8_t *m_remaining_data; //Data left to be sent
@@ -178,7 +178,7 @@ namespace proxy
 			SOCKSHandler(SOCKSServer * parent, std::shared_ptr<boost::asio::ip::tcp::socket> sock, const std::string & upstreamAddr, const uint16_t upstreamPort, const bool useUpstream) :
 				I2PServiceHandler(parent),
 				m_proxy_resolver(parent->GetService()),
-				m_sock(sock), m_stream(nullptr),
+				m_sock_buff(socks_buffer_size), m_sock(sock), m_stream(nullptr),
 				m_authchosen(AUTH_UNACCEPTABLE), m_addrtype(ADDR_IPV4),
 				m_UseUpstreamProxy(useUpstream),
 				m_UpstreamProxyAddress(upstreamAddr),
@@ -193,7 +193,7 @@ namespace proxy
 	{
 		LogPrint(eLogDebug, "SOCKS: async sock read");
 		if (m_sock) {
-			m_sock->async_receive(boost::asio::buffer(m_sock_buff, socks_buffer_size),
+			m_sock->async_receive(boost::asio::null_buffers(),
 				std::bind(&SOCKSHandler::HandleSockRecv, shared_from_this(),
 				std::placeholders::_1, std::placeholders::_2));
 		} else {
@@ -576,15 +576,23 @@ namespace proxy
 
 	void SOCKSHandler::HandleSockRecv(const boost::system::error_code & ecode, std::size_t len)
 	{
+		boost::system::error_code ec = ecode;
+		if (!ec && m_sock)
+			len = m_sock_buff.ReadSome (*m_sock, ec);
 		LogPrint(eLogDebug, "SOCKS: received ", len, " bytes");
-		if(ecode)
+		if (ec == boost::asio::error::would_block)
 		{
-			LogPrint(eLogWarning, "SOCKS: recv got error: ", ecode);
+			AsyncSockRead();
+			return;
+		}
+		if(ec)
+		{
+			LogPrint(eLogWarning, "SOCKS: recv got error: ", ec);
 			Terminate();
 			return;
 		}
 
-		if (HandleData(m_sock_buff, len))
+		if (HandleData(m_sock_buff.GetBuffer (), len))
 		{
 			if (m_state == READY)
 			{
@@ -605,7 +613,10 @@ namespace proxy
 				}
 			}
 			else
+			{
+				m_sock_buff.Release (); // parsed
 				AsyncSockRead();
+			}
 		}
 	}
 
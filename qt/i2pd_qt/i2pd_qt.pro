@@ -22,6 +22,7 @@ SOURCES += DaemonQT.cpp mainwindow.cpp \
     ../../libi2pd/BloomFilter.cpp \
     ../../libi2pd/ChaCha20.cpp \
     ../../libi2pd/Config.cpp \
+    ../../libi2pd/CongestionControl.cpp \
     ../../libi2pd/CPU.cpp \
     ../../libi2pd/Crypto.cpp \
     ../../libi2pd/CryptoKey.cpp \
@@ -37,10 +38,12 @@ SOURCES += DaemonQT.cpp mainwindow.cpp \
     ../../libi2pd/I2NPProtocol.cpp \
     ../../libi2pd/I2PEndian.cpp \
     ../../libi2pd/Identity.cpp \
+    ../../libi2pd/KadDHT.cpp \
     ../../libi2pd/LeaseSet.cpp \
     ../../libi2pd/Log.cpp \
     ../../libi2pd/NetDb.cpp \
     ../../libi2pd/NetDbRequests.cpp \
+    ../../libi2pd/NetDbSnapshot.cpp \
     ../../libi2pd/NTCP2.cpp \
     ../../libi2pd/NTCPSession.cpp \
     ../../libi2pd/Poly1305.cpp \
@@ -50,10 +53,12 @@ SOURCES += DaemonQT.cpp mainwindow.cpp \
     ../../libi2pd/RouterInfo.cpp \
     ../../libi2pd/Signature.cpp \
     ../../libi2pd/SSU.cpp \
+    ../../libi2pd/SSUCongestionControl.cpp \
     ../../libi2pd/SSUData.cpp \
     ../../libi2pd/SSUSession.cpp \
     ../../libi2pd/Streaming.cpp \
     ../../libi2pd/Timestamp.cpp \
+    ../../libi2pd/TrafficShaper.cpp \
     ../../libi2pd/TransitTunnel.cpp \
     ../../libi2pd/Transports.cpp \
     ../../libi2pd/Tunnel.cpp \
@@ -101,6 +106,7 @@ HEADERS  += DaemonQT.h mainwindow.h \
     ../../libi2pd/BloomFilter.h \
     ../../libi2pd/ChaCha20.h \
     ../../libi2pd/Config.h \
+    ../../libi2pd/CongestionControl.h \
     ../../libi2pd/CPU.h \
     ../../libi2pd/Crypto.h \
     ../../libi2pd/CryptoKey.h \
@@ -117,11 +123,13 @@ HEADERS  += DaemonQT.h mainwindow.h \
     ../../libi2pd/I2NPProtocol.h \
     ../../libi2pd/I2PEndian.h \
     ../../libi2pd/Identity.h \
+    ../../libi2pd/KadDHT.h \
     ../../libi2pd/LeaseSet.h \
     ../../libi2pd/LittleBigEndian.h \
     ../../libi2pd/Log.h \
     ../../libi2pd/NetDb.hpp \
     ../../libi2pd/NetDbRequests.h \
+    ../../libi2pd/NetDbSnapshot.h \
     ../../libi2pd/NTCP2.h \
     ../../libi2pd/NTCPSession.h \
     ../../libi2pd/Poly1305.h \
@@ -133,11 +141,14 @@ HEADERS  += DaemonQT.h mainwindow.h \
     ../../libi2pd/Signature.h \
     ../../libi2pd/Siphash.h \
     ../../libi2pd/SSU.h \
+    ../../libi2pd/SSUCongestionControl.h \
     ../../libi2pd/SSUData.h \
     ../../libi2pd/SSUSession.h \
     ../../libi2pd/Streaming.h \
     ../../libi2pd/Tag.h \
+    ../../libi2pd/TagStore.h \
     ../../libi2pd/Timestamp.h \
+    ../../libi2pd/TrafficShaper.h \
     ../../libi2pd/TransitTunnel.h \
     ../../libi2pd/Transports.h \
     ../../libi2pd/TransportSession.h \
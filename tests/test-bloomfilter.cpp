@@ -0,0 +1,36 @@
+#include <cassert>
+#include <inttypes.h>
+
+#include "BloomFilter.h"
+
+using namespace i2p::util;
+
+int main() {
+  const uint32_t num = 10000;
+  auto filter = BloomFilter(num, 0.001);
+  assert(filter->GetMemoryUsage() > 0);
+  assert(filter->GetFalsePositiveRate() == 0);
+
+  /* new entries pass except for false positives close to requested rate */
+  uint32_t falsePositives = 0;
+  for (uint32_t i = 0; i < num; i++)
+    if (!filter->Add((const uint8_t *)&i, sizeof(i))) falsePositives++;
+  assert(falsePositives < num/100);
+  assert(filter->GetFalsePositiveRate() > 0 && filter->GetFalsePositiveRate() < 0.002);
+
+  /* duplicates are always hits */
+  for (uint32_t i = 0; i < num; i++)
+    assert(!filter->Add((const uint8_t *)&i, sizeof(i)));
+  assert(filter->GetNumHits() == num + falsePositives);
+  assert(filter->GetNumEntries() == 2*num);
+
+  /* entries are remembered for one more interval */
+  filter->Decay();
+  uint32_t i = 0;
+  assert(!filter->Add((const uint8_t *)&i, sizeof(i)));
+  filter->Decay();
+  filter->Decay();
+  assert(filter->Add((const uint8_t *)&i, sizeof(i)));
+
+  return 0;
+}
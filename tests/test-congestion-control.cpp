@@ -0,0 +1,145 @@
+#include <cassert>
+#include <cstring>
+
+#include "Log.h"
+#include "CongestionControl.h"
+
+using namespace i2p::stream;
+
+void TestRTO()
+{
+  NewRenoCongestionControl cc;
+  assert(cc.GetRTO() == INITIAL_RTO);
+  assert(cc.GetPacingInterval() == 0); // no samples yet
+
+  // shared routing path before first sample, RTO = RTT + 4*RTT/2
+  cc.SetInitialRTT(500);
+  assert(cc.GetRTT() == 500 && cc.GetRTO() == 1500);
+
+  // RFC 6298, first sample replaces initial values, then SRTT += (R - SRTT)/8, RTTVAR += (|SRTT - R| - RTTVAR)/4
+  cc.UpdateRTT(1000);
+  assert(cc.GetRTT() == 1000 && cc.GetRTTVar() == 500 && cc.GetRTO() == 3000);
+  cc.SetInitialRTT(500); // ignored after sample
+  assert(cc.GetRTT() == 1000);
+  cc.UpdateRTT(2000);
+  assert(cc.GetRTTVar() == 625 && cc.GetRTT() == 1125 && cc.GetRTO() == 3625);
+
+  // resend timer expired, Stream backs off RTO once per attempt starting from the third one
+  cc.OnTimeout();
+  assert(cc.GetRTO() == 2*3625);
+  for (int i = 0; i < 10; i++) cc.BackoffRTO();
+  assert(cc.GetRTO() == MAX_RTO);
+  // Karn, acknowledgement of resent packet gives no sample and RTO stays backed off,
+  // first packet sent once brings it back from SRTT and RTTVAR
+  cc.UpdateRTT(1125);
+  assert(cc.GetRTT() == 1125 && cc.GetRTTVar() == 468 && cc.GetRTO() == 1125 + 4*468);
+
+  // new tunnels, next sample is first again
+  cc.OnPathChanged();
+  assert(cc.GetRTO() == INITIAL_RTO);
+  cc.UpdateRTT(400);
+  assert(cc.GetRTT() == 400 && cc.GetRTTVar() == 200 && cc.GetRTO() == 1200);
+
+  // bounds
+  cc.OnPathChanged();
+  cc.UpdateRTT(10);
+  assert(cc.GetRTO() == MIN_RTO);
+  cc.OnPathChanged();
+  cc.UpdateRTT(40000);
+  assert(cc.GetRTO() == MAX_RTO);
+}
+
+void TestNewReno()
+{
+  NewRenoCongestionControl cc;
+  assert(cc.GetWindowSize() == MIN_WINDOW_SIZE && cc.GetSlowStartThreshold() == WINDOW_SIZE);
+
+  // slow start, window grows by number of acknowledged packets
+  cc.OnAck(1, 0); assert(cc.GetWindowSize() == 2);
+  cc.OnAck(2, 0); assert(cc.GetWindowSize() == 4);
+  cc.OnAck(4, 0); assert(cc.GetWindowSize() == 8);
+  // congestion avoidance, one packet per window
+  cc.OnAck(7, 0); assert(cc.GetWindowSize() == 8);
+  cc.OnAck(1, 0); assert(cc.GetWindowSize() == 9);
+  for (int i = 0; i < 8; i++) cc.OnAck(1, 0);
+  assert(cc.GetWindowSize() == 9);
+  cc.OnAck(1, 0); assert(cc.GetWindowSize() == 10);
+
+  // fast retransmit halves window and keeps growing linearly from there
+  cc.OnLoss();
+  assert(cc.GetWindowSize() == 5 && cc.GetSlowStartThreshold() == 5);
+  cc.OnAck(4, 0); assert(cc.GetWindowSize() == 5);
+  cc.OnAck(1, 0); assert(cc.GetWindowSize() == 6);
+  cc.UpdateRTT(1000);
+  assert(cc.GetPacingInterval() == 1000*1000*100/(6*PACING_GAIN));
+
+  // timeout starts over from one packet with slow start up to half of window
+  cc.OnTimeout();
+  assert(cc.GetWindowSize() == MIN_WINDOW_SIZE && cc.GetSlowStartThreshold() == 3);
+  cc.OnAck(1, 0); cc.OnAck(1, 0);
+  assert(cc.GetWindowSize() == 3);
+  cc.OnAck(2, 0); assert(cc.GetWindowSize() == 3);
+  cc.OnAck(1, 0); assert(cc.GetWindowSize() == 4);
+
+  // limits
+  for (int i = 0; i < 10; i++) cc.OnLoss();
+  assert(cc.GetWindowSize() == 2*MIN_WINDOW_SIZE);
+  for (int i = 0; i < 100000; i++) cc.OnAck(1, 0);
+  assert(cc.GetWindowSize() == MAX_WINDOW_SIZE);
+}
+
+void TestVegas()
+{
+  VegasCongestionControl cc;
+  assert(cc.GetSlowStartThreshold() == MAX_WINDOW_SIZE);
+
+  // slow start while tunnels don't queue
+  cc.UpdateRTT(1000);
+  for (int i = 0; i < 15; i++) cc.OnAck(1, i);
+  assert(cc.GetWindowSize() == 16 && cc.GetSlowStartThreshold() == MAX_WINDOW_SIZE);
+
+  // RTT doubled, half of window is queued, above alpha
+  cc.UpdateRTT(2000);
+  cc.OnAck(1, 1000);
+  assert(cc.GetWindowSize() == 17 && cc.GetSlowStartThreshold() == 17);
+  // window is adjusted once per RTT, shrinks while above beta
+  cc.OnAck(1, 1100);
+  assert(cc.GetWindowSize() == 17);
+  cc.OnAck(1, 1000 + cc.GetRTT());
+  assert(cc.GetWindowSize() == 16);
+  // grows while below alpha, up to threshold at once
+  uint64_t ts = 10000;
+  cc.UpdateRTT(1000);
+  cc.OnAck(1, ts);
+  assert(cc.GetWindowSize() == 18);
+  cc.OnAck(1, ts + 1);
+  assert(cc.GetWindowSize() == 18);
+  ts += cc.GetRTT();
+  cc.OnAck(1, ts);
+  assert(cc.GetWindowSize() == 19);
+  // stays between alpha and beta, 19*(1 - 1000/1200) = 3
+  cc.UpdateRTT(1200);
+  ts += cc.GetRTT();
+  cc.OnAck(1, ts);
+  assert(cc.GetWindowSize() == 19);
+
+  // fast retransmit reduces window less than NewReno
+  cc.OnLoss();
+  assert(cc.GetWindowSize() == 14 && cc.GetSlowStartThreshold() == 14);
+  cc.OnTimeout();
+  assert(cc.GetWindowSize() == MIN_WINDOW_SIZE && cc.GetSlowStartThreshold() == 7);
+}
+
+int main() {
+  i2p::log::Logger().SetLogLevel("none");
+
+  TestRTO();
+  TestNewReno();
+  TestVegas();
+
+  assert(!strcmp(CreateCongestionControl(CONGESTION_CONTROL_VEGAS)->GetName(), CONGESTION_CONTROL_VEGAS));
+  assert(!strcmp(CreateCongestionControl("")->GetName(), CONGESTION_CONTROL_NEWRENO));
+  assert(!strcmp(CreateCongestionControl("cubic")->GetName(), CONGESTION_CONTROL_NEWRENO));
+
+  return 0;
+}
@@ -0,0 +1,81 @@
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "Queue.h"
+
+using namespace i2p::util;
+
+struct Msg
+{
+	int producer, seq;
+};
+
+int main() {
+  const int numProducers = 4, numMsgs = 20000;
+  // small ring to exercise overflow path
+  MPSCQueue<std::shared_ptr<Msg> > queue (16);
+
+  assert(queue.IsEmpty());
+  assert(!queue.Get());
+  queue.Put(std::make_shared<Msg>(Msg{0, 0}));
+  assert(queue.GetSize() == 1);
+  assert(queue.Get()->seq == 0);
+  assert(!queue.GetNextWithTimeout(10));
+
+  std::vector<std::thread> producers;
+  for (int p = 0; p < numProducers; p++)
+    producers.emplace_back([&queue, p]() {
+      for (int i = 0; i < numMsgs; i += 4)
+      {
+        if (i % 8)
+          queue.Put(std::make_shared<Msg>(Msg{p, i}));
+        else
+        {
+          std::vector<std::shared_ptr<Msg> > batch;
+          for (int j = 0; j < 4; j++) batch.push_back(std::make_shared<Msg>(Msg{p, i + j}));
+          queue.Put(batch);
+          continue;
+        }
+        for (int j = 1; j < 4; j++) queue.Put(std::make_shared<Msg>(Msg{p, i + j}));
+      }
+    });
+
+  // order of each producer must be preserved
+  std::vector<int> next(numProducers, 0);
+  int received = 0;
+  while (received < numProducers*numMsgs)
+  {
+    auto msg = queue.GetNextWithTimeout(1000);
+    assert(msg);
+    assert(msg->seq == next[msg->producer]);
+    next[msg->producer]++;
+    received++;
+  }
+  for (auto& it: producers) it.join();
+  assert(queue.IsEmpty());
+
+  // wake up before consumer is parked is not lost
+  auto start = std::chrono::steady_clock::now();
+  queue.WakeUp();
+  assert(!queue.GetNextWithTimeout(5000));
+  assert(std::chrono::steady_clock::now() - start < std::chrono::seconds(1));
+
+  // stop of consumer's loop, as threads of tunnels and NetDb do
+  for (int i = 0; i < 100; i++)
+  {
+    std::atomic<bool> isRunning(true);
+    std::thread consumer([&queue, &isRunning]() {
+      while (isRunning) queue.GetNextWithTimeout(5000);
+    });
+    start = std::chrono::steady_clock::now();
+    isRunning = false;
+    queue.WakeUp();
+    consumer.join();
+    assert(std::chrono::steady_clock::now() - start < std::chrono::seconds(1));
+  }
+  return 0;
+}
@@ -0,0 +1,138 @@
+#include <cassert>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include "I2PEndian.h"
+#include "Log.h"
+#include "NetDbSnapshot.h"
+
+using namespace i2p::data;
+
+const char PATH[] = "test-netdb-snapshot.tmp";
+
+IdentHash Ident(int n)
+{
+  uint8_t buf[32] = {};
+  buf[0] = n; buf[31] = n >> 8;
+  return IdentHash(buf);
+}
+
+int Number(const IdentHash& ident)
+{
+  return ident[0] | (ident[31] << 8);
+}
+
+std::vector<uint8_t> Data(int n, int version, size_t len)
+{
+  std::vector<uint8_t> data(len);
+  for (size_t i = 0; i < len; i++) data[i] = n + version + i;
+  return data;
+}
+
+// every expected record is in snapshot with its data and there are no others
+void Check(const RouterInfoSnapshot& snapshot, const std::map<int, std::vector<uint8_t> >& expected)
+{
+  assert(snapshot.GetNumRecords() == expected.size());
+  for (auto& it: expected)
+  {
+    uint8_t buf[0xFFFF];
+    size_t len = sizeof(buf);
+    assert(snapshot.Get(Ident(it.first), buf, len));
+    assert(std::vector<uint8_t>(buf, buf + len) == it.second);
+  }
+  size_t num = 0;
+  snapshot.Iterate([&expected, &num](const IdentHash& ident, const uint8_t * buf, size_t len)
+    {
+      auto it = expected.find(Number(ident));
+      assert(it != expected.end());
+      assert(std::vector<uint8_t>(buf, buf + len) == it->second);
+      num++;
+    });
+  assert(num == expected.size());
+}
+
+int main() {
+  i2p::log::Logger().SetLogLevel("none");
+  boost::filesystem::remove(PATH);
+  std::map<int, std::vector<uint8_t> > expected;
+
+  RouterInfoSnapshot snapshot;
+  assert(!snapshot.IsOpen());
+  assert(snapshot.Open(PATH));
+  assert(snapshot.IsOpen());
+  assert(snapshot.GetFileSize() == NETDB_SNAPSHOT_SIGNATURE_SIZE);
+  for (int n = 0; n < 100; n++)
+  {
+    expected[n] = Data(n, 0, 500 + n);
+    snapshot.Put(Ident(n), expected[n].data(), expected[n].size());
+  }
+  for (int n = 0; n < 100; n += 3)
+  {
+    snapshot.Remove(Ident(n));
+    expected.erase(n);
+  }
+  snapshot.Flush();
+  Check(snapshot, expected);
+  size_t fileSize = snapshot.GetFileSize();
+  snapshot.Close();
+  assert(!snapshot.IsOpen());
+  assert(boost::filesystem::file_size(PATH) == fileSize);
+
+  /* torn tail, last record was written partially */
+  {
+    std::ofstream f(PATH, std::ofstream::binary | std::ofstream::out | std::ofstream::app);
+    auto ident = Ident(1000);
+    uint8_t header[NETDB_SNAPSHOT_RECORD_HEADER_SIZE];
+    memcpy(header, ident, 32);
+    htobe16buf(header + 32, 1000);
+    f.write((const char *)header, NETDB_SNAPSHOT_RECORD_HEADER_SIZE);
+    auto data = Data(1000, 0, 300);
+    f.write((const char *)data.data(), data.size());
+  }
+  assert(boost::filesystem::file_size(PATH) > fileSize);
+  assert(snapshot.Open(PATH));
+  assert(snapshot.GetFileSize() == fileSize);
+  assert(boost::filesystem::file_size(PATH) == fileSize);
+  Check(snapshot, expected);
+  // appended after valid part
+  expected[1] = Data(1, 1, 700);
+  snapshot.Put(Ident(1), expected[1].data(), expected[1].size());
+  snapshot.Close();
+  assert(snapshot.Open(PATH));
+  Check(snapshot, expected);
+
+  /* compaction of updated records */
+  assert(!snapshot.NeedsCompaction());
+  for (int version = 2; snapshot.GetFileSize() <= NETDB_SNAPSHOT_MIN_COMPACTION_SIZE; version++)
+    for (int n = 0; n < 10; n++)
+    {
+      expected[n] = Data(n, version, 1000 + version);
+      snapshot.Put(Ident(n), expected[n].data(), expected[n].size());
+    }
+  snapshot.Flush();
+  assert(snapshot.NeedsCompaction());
+  fileSize = snapshot.GetFileSize();
+  snapshot.Compact();
+  assert(snapshot.IsOpen());
+  assert(!snapshot.NeedsCompaction());
+  assert(snapshot.GetFileSize() < fileSize/10);
+  assert(boost::filesystem::file_size(PATH) == snapshot.GetFileSize());
+  assert(!boost::filesystem::exists(std::string(PATH) + ".tmp"));
+  Check(snapshot, expected);
+  // still appendable
+  expected[1000] = Data(1000, 0, 300);
+  snapshot.Put(Ident(1000), expected[1000].data(), expected[1000].size());
+  snapshot.Remove(Ident(2));
+  expected.erase(2);
+  snapshot.Close();
+  assert(snapshot.Open(PATH));
+  Check(snapshot, expected);
+  snapshot.Close();
+
+  boost::filesystem::remove(PATH);
+  return 0;
+}
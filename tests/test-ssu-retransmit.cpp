@@ -0,0 +1,286 @@
+#include <cassert>
+#include <cstdio>
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "Log.h"
+#include "I2NPProtocol.h"
+#include "SSUSession.h"
+
+/* real SSUData of two sessions exchanging I2NP messages over a simulated lossy link,
+   clock is virtual, events run in order of their time without waiting */
+
+using namespace i2p::transport;
+
+const int OLD_RESEND_INTERVAL = 3000; // in milliseconds, former fixed resend
+
+uint64_t now = 0; // in milliseconds
+std::multimap<uint64_t, std::function<void ()> > events;
+
+void Schedule(uint64_t ts, std::function<void ()> event)
+{
+  events.emplace(std::max(ts, now), event);
+}
+
+void RunEvents()
+{
+  while (!events.empty() && now < 600000)
+  {
+    auto it = events.begin();
+    now = it->first;
+    auto event = it->second;
+    events.erase(it);
+    event();
+  }
+  assert(events.empty());
+}
+
+struct Peer
+{
+  virtual ~Peer() {}
+  virtual void Receive(std::vector<uint8_t>& packet) = 0;
+};
+
+struct Link
+{
+  Peer * to;
+  uint64_t delay;
+  unsigned int lossPercent;
+  std::mt19937 rng;
+  int numDroppedFragments = 0, numDroppedAcks = 0;
+  std::map<std::pair<uint32_t, int>, int> numTransmissions; // (msgID, fragmentNum) -> times sent
+
+  Link(Peer * t, uint64_t d, unsigned int loss, int seed): to(t), delay(d), lossPercent(loss), rng(seed) {}
+
+  void Send(const uint8_t * buf, size_t size)
+  {
+    // parse data packet as SSUData::ProcessMessage does
+    const uint8_t * payload = buf + sizeof(SSUHeader);
+    uint8_t flag = *payload++;
+    if (flag & DATA_FLAG_EXPLICIT_ACKS_INCLUDED)
+      payload += 1 + 4*(*payload);
+    if (flag & DATA_FLAG_ACK_BITFIELDS_INCLUDED)
+    {
+      int numBitfields = *payload++;
+      for (int i = 0; i < numBitfields; i++)
+      {
+        payload += 4;
+        while (*payload++ & 0x80);
+      }
+    }
+    if (flag & DATA_FLAG_EXTENDED_DATA_INCLUDED)
+      payload += 1 + *payload;
+    std::vector<std::pair<uint32_t, int> > fragments;
+    int numFragments = *payload++;
+    for (int i = 0; i < numFragments; i++)
+    {
+      uint32_t msgID = bufbe32toh(payload);
+      uint32_t fragmentInfo = (payload[4] << 16) | (payload[5] << 8) | payload[6];
+      fragments.push_back({msgID, (int)(fragmentInfo >> 17)});
+      payload += 7 + (fragmentInfo & 0x3FFF);
+    }
+    for (auto& it: fragments)
+      numTransmissions[it]++;
+
+    if (rng() % 100 < lossPercent)
+    {
+      if (fragments.empty()) numDroppedAcks++; else numDroppedFragments++;
+      return;
+    }
+    auto peer = to;
+    auto packet = std::make_shared<std::vector<uint8_t> >(buf, buf + size);
+    Schedule(now + delay, [peer, packet]() { peer->Receive(*packet); });
+  }
+
+  int GetNumRetransmits() const
+  {
+    int num = 0;
+    for (auto& it: numTransmissions) num += it.second - 1;
+    return num;
+  }
+};
+
+// established session, packets go as is
+class Session: public Peer, public SSUDataSession
+{
+  public:
+
+    Session(): data(*this), resendGeneration(0) {}
+
+    bool IsV6() const { return false; }
+    bool IsEstablished() const { return true; }
+    void Established() {}
+    void Close() { assert(false); }
+    void FillHeaderAndEncrypt(uint8_t, uint8_t *, size_t) {}
+    void Send(const uint8_t * buf, size_t size)
+    {
+      // explicit ack is sent once message is complete
+      const uint8_t * payload = buf + sizeof(SSUHeader);
+      if (payload[0] & DATA_FLAG_EXPLICIT_ACKS_INCLUDED)
+        for (int i = 0; i < payload[1]; i++)
+          completed.emplace(bufbe32toh(payload + 2 + 4*i), now);
+      link->Send(buf, size);
+    }
+
+    uint64_t GetMillisecondsSinceEpoch() const { return now; }
+    void ScheduleResend(uint64_t ts)
+    {
+      auto generation = ++resendGeneration;
+      Schedule(ts, [this, generation]() { if (generation == resendGeneration) data.HandleResendTimer(); });
+    }
+    void ScheduleIncompleteMessagesCleanup() {} // messages complete in less than cleanup timeout
+
+    void Receive(std::vector<uint8_t>& packet)
+    {
+      data.ProcessMessage(packet.data() + sizeof(SSUHeader), packet.size() - sizeof(SSUHeader));
+      data.FlushReceivedMessage();
+    }
+
+    Link * link;
+    SSUData data;
+    std::map<uint32_t, uint64_t> completed; // msgID -> time of receiving last fragment
+
+  private:
+
+    int resendGeneration;
+};
+
+// former SSUData resend, message in one packet again in OLD_RESEND_INTERVAL, then in 2x, 3x..
+class OldSender: public Peer
+{
+  public:
+
+    void Send(std::shared_ptr<i2p::I2NPMessage> msg)
+    {
+      uint32_t msgID = msg->ToSSU();
+      size_t size = (sizeof(SSUHeader) + 9 + msg->GetLength() + 15) & ~(size_t)0x0F; // 16 bytes boundary
+      std::vector<uint8_t> buf(size, 0);
+      uint8_t * payload = buf.data() + sizeof(SSUHeader);
+      payload[0] = DATA_FLAG_WANT_REPLY;
+      payload[1] = 1; // one fragment
+      htobe32buf(payload + 2, msgID);
+      uint32_t fragmentInfo = 0x010000 | msg->GetLength(); // last
+      payload[6] = fragmentInfo >> 16; payload[7] = fragmentInfo >> 8; payload[8] = fragmentInfo;
+      memcpy(payload + 9, msg->GetSSUHeader(), msg->GetLength());
+      packets[msgID] = buf;
+      Transmit(msgID, 0);
+    }
+
+    void Receive(std::vector<uint8_t>& packet)
+    {
+      const uint8_t * payload = packet.data() + sizeof(SSUHeader);
+      if (payload[0] & DATA_FLAG_EXPLICIT_ACKS_INCLUDED)
+        for (int i = 0; i < payload[1]; i++)
+          packets.erase(bufbe32toh(payload + 2 + 4*i));
+    }
+
+    Link * link;
+
+  private:
+
+    void Transmit(uint32_t msgID, int numResends)
+    {
+      auto it = packets.find(msgID);
+      if (it == packets.end()) return; // acknowledged
+      link->Send(it->second.data(), it->second.size());
+      if (numResends < MAX_NUM_RESENDS)
+        Schedule(now + (numResends + 1)*OLD_RESEND_INTERVAL, [this, msgID, numResends]() { Transmit(msgID, numResends + 1); });
+    }
+
+    std::map<uint32_t, std::vector<uint8_t> > packets;
+};
+
+std::shared_ptr<i2p::I2NPMessage> CreateMessage(int n, size_t size)
+{
+  std::vector<uint8_t> payload(size);
+  for (size_t i = 0; i < payload.size(); i++) payload[i] = n + i;
+  auto msg = i2p::NewI2NPMessage();
+  msg->Concat(payload.data(), payload.size());
+  msg->SetTypeID(i2p::eI2NPData);
+  msg->SetMsgID(n + 1);
+  msg->SetExpiration(i2p::util::GetMillisecondsSinceEpoch() + i2p::I2NP_MESSAGE_EXPIRATION_TIMEOUT); // checked by real clock
+  msg->UpdateSize();
+  return msg;
+}
+
+void CheckCompleted(const Session& receiver, int numMessages)
+{
+  assert((int)receiver.completed.size() == numMessages);
+  for (int n = 0; n < numMessages; n++)
+    assert(receiver.completed.count(n + 1));
+}
+
+/* all messages at once, faster than window allows, returns link from sender */
+Link Bulk(int numMessages, unsigned int lossPercent)
+{
+  now = 0;
+  Session a, b;
+  Link ab(&b, 10, lossPercent, 1), ba(&a, 10, lossPercent, 2);
+  a.link = &ab; b.link = &ba;
+  for (int n = 0; n < numMessages; n++)
+    a.data.Send(CreateMessage(n, 100 + (n*577) % 3000)); // up to 3 fragments
+  RunEvents();
+  CheckCompleted(b, numMessages);
+  ab.numDroppedAcks += ba.numDroppedAcks;
+  return ab;
+}
+
+/* one message in one packet every 10 milliseconds, returns delivery latency of every message */
+std::vector<uint64_t> Latencies(bool old)
+{
+  const int numMessages = 2000;
+  const uint64_t interval = 10, delay = 20;
+  const unsigned int lossPercent = 2; // data and acks
+  now = 0;
+  Session a, b;
+  OldSender oldSender;
+  Peer * sender = old ? (Peer *)&oldSender : (Peer *)&a;
+  Link ab(&b, delay, lossPercent, 1), ba(sender, delay, lossPercent, 2);
+  a.link = &ab; oldSender.link = &ab; b.link = &ba;
+  for (int n = 0; n < numMessages; n++)
+    Schedule(n*interval, [old, n, &a, &oldSender]()
+      {
+        auto msg = CreateMessage(n, 500);
+        if (old) oldSender.Send(msg); else a.data.Send(msg);
+      });
+  RunEvents();
+  CheckCompleted(b, numMessages);
+  std::vector<uint64_t> latencies;
+  for (auto& it: b.completed)
+    latencies.push_back(it.second - (it.first - 1)*interval);
+  return latencies;
+}
+
+uint64_t Percentile(std::vector<uint64_t> latencies, int percent)
+{
+  std::sort(latencies.begin(), latencies.end());
+  return latencies[latencies.size()*percent/100];
+}
+
+int main() {
+  i2p::log::Logger().SetLogLevel("none");
+
+  auto lossless = Bulk(300, 0);
+  assert(lossless.GetNumRetransmits() == 0);
+
+  auto lossy = Bulk(300, 5);
+  int dropped = lossy.numDroppedFragments + lossy.numDroppedAcks;
+  assert(lossy.numDroppedFragments > 0);
+  assert(lossy.GetNumRetransmits() >= lossy.numDroppedFragments); // every lost fragment is resent
+  assert(lossy.GetNumRetransmits() <= 3*dropped); // and not much more
+
+  /* tail latency under loss */
+  auto before = Latencies(true), after = Latencies(false);
+  uint64_t p99Before = Percentile(before, 99), p99After = Percentile(after, 99);
+  printf("SSU delivery latency with 2%% loss, p50/p99/max in ms: fixed resend %lu/%lu/%lu, RTO and fast retransmit %lu/%lu/%lu\n",
+    (unsigned long)Percentile(before, 50), (unsigned long)p99Before, (unsigned long)*std::max_element(before.begin(), before.end()),
+    (unsigned long)Percentile(after, 50), (unsigned long)p99After, (unsigned long)*std::max_element(after.begin(), after.end()));
+  assert(Percentile(after, 50) == 20);
+  assert(p99After*4 < p99Before);
+
+  return 0;
+}
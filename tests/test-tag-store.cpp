@@ -0,0 +1,97 @@
+#include <cassert>
+#include <cstdlib>
+#include <memory>
+#include <unordered_map>
+
+#include "TagStore.h"
+
+using namespace i2p::garlic;
+
+struct Key
+{
+  int id;
+  bool expired;
+};
+
+int main() {
+  TagStore<uint64_t, Key> store;
+  auto k1 = std::make_shared<Key>(Key{1, false}), k2 = std::make_shared<Key>(Key{2, false});
+  int index = -1;
+
+  assert(!store.Take(1, index));
+  for (uint64_t t = 0; t < 100; t++)
+    store.Insert(t, (t & 1) ? k1 : k2, (int)t, 1000);
+  assert(store.GetSize() == 100);
+  assert(store.GetNumRecords() == 2); // key is shared by tags
+  assert(store.Take(7, index) == k1 && index == 7);
+  assert(!store.Take(7, index)); // used only once
+  store.Insert(8, k1, 80, 1000); // replace
+  assert(store.GetSize() == 99);
+  assert(store.Take(8, index) == k1 && index == 80);
+  for (uint64_t t = 0; t < 100; t += 2)
+    if (t != 8) assert(store.Take(t, index) == k2 && index == (int)t);
+  assert(store.GetNumRecords() == 1); // k2 released
+  assert(k2.use_count() == 1);
+
+  // compare with unordered_map under random inserts and removals
+  std::unordered_map<uint64_t, int> ref;
+  for (uint64_t t = 1; t < 100; t += 2)
+    if (t != 7) ref[t] = (int)t;
+  srand(1);
+  for (int i = 0; i < 200000; i++)
+  {
+    uint64_t tag = rand() % 5000;
+    if (rand() % 3)
+    {
+      store.Insert(tag, k1, i, 1000);
+      ref[tag] = i;
+    }
+    else
+    {
+      auto it = ref.find(tag);
+      auto r = store.Take(tag, index);
+      assert((it != ref.end()) == (r != nullptr));
+      if (it != ref.end())
+      {
+        assert(index == it->second);
+        ref.erase(it);
+      }
+    }
+  }
+  assert(store.GetSize() == ref.size());
+  size_t num = 0;
+  store.ForEach([&num, &ref](uint64_t tag, std::shared_ptr<Key>, uint32_t) { num++; assert(ref.count(tag)); });
+  assert(num == ref.size());
+
+  // expiration by buckets
+  TagStore<uint64_t, Key> store1;
+  for (uint64_t t = 0; t < 1000; t++)
+    store1.Insert(t, k1, 0, 10000 + t); // 1000 seconds
+  assert(store1.CleanupExpired(10000 + 100, 600) == 0);
+  size_t expired = store1.CleanupExpired(10000 + 1000, 600);
+  assert(expired >= 300 && expired <= 400 + TAG_STORE_BUCKET_DURATION);
+  assert(store1.Take(999, index));
+  store1.CleanupExpired(10000 + 2000, 600);
+  assert(store1.GetSize() == 0 && store1.GetNumRecords() == 0);
+
+  // invalidated record's tags are not found
+  store1.Insert(1, k1, 0, 20000);
+  store1.Insert(2, k2, 0, 20000);
+  k2->expired = true;
+  store1.InvalidateRecords([](const Key& k) { return k.expired; });
+  assert(!store1.Take(2, index));
+  assert(store1.Take(1, index) == k1);
+  assert(k2.use_count() == 1);
+
+  // long tags are kept in buckets by first 8 bytes, newer tag with the same ones doesn't expire
+  TagStore<i2p::data::Tag<32>, Key> store2;
+  uint8_t buf[32] = {0};
+  i2p::data::Tag<32> t1(buf);
+  buf[31] = 1;
+  i2p::data::Tag<32> t2(buf);
+  store2.Insert(t1, k1, 1, 30000);
+  store2.Insert(t2, k1, 2, 30000 + 600);
+  assert(store2.CleanupExpired(30000 + 600 + TAG_STORE_BUCKET_DURATION, 600) == 1);
+  assert(!store2.Take(t1, index));
+  assert(store2.Take(t2, index) == k1 && index == 2);
+}
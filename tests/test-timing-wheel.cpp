@@ -0,0 +1,78 @@
+#include <cassert>
+#include <cstdlib>
+#include <map>
+#include <vector>
+
+#include "util.h"
+
+using namespace i2p::util;
+
+template<typename Wheel>
+void Compare(Wheel& wheel, uint64_t start, uint64_t duration, uint64_t maxDelay, uint64_t maxStep)
+{
+  std::multimap<uint64_t, int> ref; // expiration -> item
+  std::vector<uint64_t> expirations;
+  uint64_t ts = start;
+  int id = 0;
+  srand(1);
+  while (ts < start + duration)
+  {
+    for (int i = rand() % 4; i > 0; i--)
+    {
+      uint64_t expiration = ts + rand() % maxDelay;
+      wheel.Add(id, expiration);
+      ref.insert({expiration, id});
+      expirations.push_back(expiration);
+      id++;
+    }
+    ts += 1 + rand() % maxStep;
+    std::vector<int> expired;
+    wheel.Advance(ts, [&expired, &expirations, ts](int item)
+      {
+        assert(expirations[item] <= ts); // never early
+        expired.push_back(item);
+      });
+    // everything due is expired, ticks are rounded up
+    size_t num = 0;
+    for (auto it = ref.begin(); it != ref.end() && it->first <= ts;)
+    {
+      if (it->first + 1000 <= ts) num++; // more than a tick ago
+      it = ref.erase(it);
+    }
+    assert(expired.size() >= num);
+    assert(wheel.GetSize() + expired.size() >= ref.size());
+    for (auto item: expired) assert(expirations[item] <= ts);
+  }
+  wheel.Advance(ts + maxDelay + 1000, [](int) {});
+  assert(wheel.GetSize() == 0);
+}
+
+int main() {
+  // exact ticks
+  TimingWheel<int> wheel;
+  int n = 0;
+  wheel.Add(1, 1000);
+  wheel.Add(2, 1070);
+  wheel.Add(3, 6000); // upper level
+  wheel.Advance(999, [&n](int) { n++; });
+  assert(n == 0 && wheel.GetSize() == 3); // first call, sorted out at once
+  wheel.Advance(1000, [&n](int item) { assert(item == 1); n++; });
+  assert(n == 1);
+  wheel.Advance(1069, [](int) { assert(false); });
+  wheel.Advance(1070, [&n](int item) { assert(item == 2); n++; });
+  wheel.Advance(5999, [](int) { assert(false); });
+  // added again from callback
+  wheel.Advance(6000, [&wheel, &n](int item) { assert(item == 3); n++; wheel.Add(4, 6000); });
+  wheel.Advance(6001, [&n](int item) { assert(item == 4); n++; });
+  assert(n == 4 && wheel.GetSize() == 0);
+
+  // random against multimap, milliseconds with seconds ticks
+  TimingWheel<int> wheel1(1000);
+  Compare(wheel1, 1600000000000ULL, 3600*1000, 700*1000, 5000);
+  // single level with entries beyond span
+  TimingWheel<int, 4, 1> wheel2(1000);
+  Compare(wheel2, 1600000000000ULL, 600*1000, 60*1000, 15000);
+  // cascading through all levels
+  TimingWheel<int, 2, 3> wheel3(1);
+  Compare(wheel3, 12345, 100000, 200, 3);
+}
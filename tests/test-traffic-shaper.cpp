@@ -0,0 +1,71 @@
+#include <cassert>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "TrafficShaper.h"
+
+using namespace i2p;
+using namespace i2p::transport;
+
+const uint64_t RATE = 1000000, TRANSIT_RATE = 500000; // bytes per second, bursts are a second of them
+
+int main() {
+  TrafficShaper shaper;
+  // local and NetDb borrow before first refill, exploratory a burst, transit nothing
+  assert(!shaper.Admit(eI2NPTrafficClassTransit, 1000));
+  assert(shaper.Admit(eI2NPTrafficClassExploratory, 1000));
+  assert(shaper.Admit(eI2NPTrafficClassLocal, 1000));
+  assert(shaper.Admit(eI2NPTrafficClassNetDb, 1000));
+
+  // first refill fills burst, transit within share
+  shaper.Refill(1000, RATE, TRANSIT_RATE);
+  int num = 0;
+  while (shaper.Admit(eI2NPTrafficClassTransit, 1000)) num++;
+  assert(num == 500);
+  // root has 997000 - 500000 left, local takes it in debt
+  assert(shaper.Admit(eI2NPTrafficClassLocal, 600000));
+
+  // 100 ms later 100000 and 50000 come, transit doesn't fit root and gives share tokens back
+  shaper.Refill(1100, RATE, TRANSIT_RATE);
+  shaper.Refill(1100, RATE, TRANSIT_RATE); // same time, nothing
+  shaper.Refill(1050, RATE, TRANSIT_RATE); // past, nothing
+  assert(!shaper.Admit(eI2NPTrafficClassTransit, 1000)); // root 100000 - 103000
+  assert(shaper.Admit(eI2NPTrafficClassLocal, 100));
+  shaper.Refill(1104, RATE, TRANSIT_RATE); // root 900, transit 52000
+  assert(!shaper.Admit(eI2NPTrafficClassTransit, 1000));
+  assert(shaper.Admit(eI2NPTrafficClassTransit, 900));
+  assert(!shaper.Admit(eI2NPTrafficClassTransit, 1));
+
+  // exploratory is dropped a burst in debt, debt is limited
+  assert(shaper.Admit(eI2NPTrafficClassExploratory, 1000001));
+  assert(!shaper.Admit(eI2NPTrafficClassExploratory, 1));
+  assert(shaper.Admit(eI2NPTrafficClassNetDb, 5000000)); // root -2000000 at most
+  shaper.Refill(2104, RATE, TRANSIT_RATE); // -1000000
+  assert(shaper.Admit(eI2NPTrafficClassExploratory, 1));
+  // long pause refills one burst only, and bucket is not deeper than burst
+  shaper.Refill(100000, RATE, TRANSIT_RATE);
+  shaper.Refill(200000, RATE, TRANSIT_RATE);
+  shaper.Refill(300000, RATE, TRANSIT_RATE);
+  assert(shaper.Admit(eI2NPTrafficClassLocal, 1000000));
+  assert(!shaper.Admit(eI2NPTrafficClassTransit, 1));
+
+  // lower rate makes burst smaller, but not below min
+  shaper.Refill(400000, RATE/5, TRANSIT_RATE/10);
+  assert(!shaper.Admit(eI2NPTrafficClassTransit, TRAFFIC_SHAPER_MIN_BURST + 1));
+  assert(shaper.Admit(eI2NPTrafficClassTransit, TRAFFIC_SHAPER_MIN_BURST));
+
+  // threads take tokens without lock, none is taken twice
+  shaper.Refill(500000, RATE, TRANSIT_RATE);
+  std::atomic<int> numAdmitted(0);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; i++)
+    threads.emplace_back([&shaper, &numAdmitted]()
+      {
+        while (shaper.Admit(eI2NPTrafficClassTransit, 100)) numAdmitted++;
+      });
+  for (auto& it: threads) it.join();
+  assert(numAdmitted == 5000);
+
+  return 0;
+}
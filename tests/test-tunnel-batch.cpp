@@ -0,0 +1,85 @@
+#include <cassert>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "TunnelBase.h"
+
+using namespace i2p;
+using namespace i2p::tunnel;
+
+struct FakeTunnel
+{
+  int buffered = 0, flushed = 0;
+  void FlushTunnelDataMsgs() { flushed += buffered; buffered = 0; }
+};
+
+std::map<uint32_t, std::shared_ptr<FakeTunnel> > tunnels;
+
+std::shared_ptr<I2NPMessage> CreateMsg(I2NPMessageType typeID, uint32_t tunnelID)
+{
+  auto msg = std::make_shared<I2NPMessageBuffer<I2NP_MAX_SHORT_MESSAGE_SIZE> >();
+  uint8_t payload[4];
+  htobe32buf(payload, tunnelID);
+  msg->Concat(payload, 4);
+  msg->SetTypeID(typeID);
+  return msg;
+}
+
+// buffered messages of other tunnels than current must be flushed
+void CheckFlushed(std::shared_ptr<FakeTunnel> current)
+{
+  for (auto& it: tunnels)
+    if (it.second != current)
+      assert(it.second->buffered == 0);
+}
+
+// returns number of messages of unknown tunnels and of other types
+std::pair<int, int> Run(const std::vector<std::shared_ptr<I2NPMessage> >& queue)
+{
+  size_t next = 1;
+  int numNotFound = 0, numOther = 0;
+  HandleTunnelMsgs<FakeTunnel>(queue[0],
+    [&queue, &next]() { return next < queue.size() ? queue[next++] : nullptr; },
+    [](uint32_t tunnelID)
+    {
+      auto it = tunnels.find(tunnelID);
+      return it != tunnels.end() ? it->second : nullptr;
+    },
+    [&numNotFound](uint32_t tunnelID, std::shared_ptr<FakeTunnel> tunnel, std::shared_ptr<I2NPMessage> msg)
+    {
+      assert(tunnelID == bufbe32toh(msg->GetPayload()));
+      CheckFlushed(tunnel);
+      if (tunnel)
+        tunnel->buffered++;
+      else
+        numNotFound++;
+    },
+    [&numOther](std::shared_ptr<I2NPMessage>)
+    {
+      CheckFlushed(nullptr);
+      numOther++;
+    });
+  CheckFlushed(nullptr);
+  return {numNotFound, numOther};
+}
+
+int main() {
+  auto t1 = std::make_shared<FakeTunnel>(), t2 = std::make_shared<FakeTunnel>();
+  tunnels[1] = t1; tunnels[2] = t2;
+
+  // build message between data messages of the same tunnel
+  auto res = Run({CreateMsg(eI2NPTunnelData, 1), CreateMsg(eI2NPTunnelGateway, 1), CreateMsg(eI2NPVariableTunnelBuild, 0),
+    CreateMsg(eI2NPTunnelData, 1), CreateMsg(eI2NPTunnelData, 2), CreateMsg(eI2NPTunnelData, 3), CreateMsg(eI2NPTunnelData, 2)});
+  assert(res.first == 1 && res.second == 1);
+  assert(t1->flushed == 3 && t2->flushed == 2);
+
+  // build message and unknown tunnel last
+  res = Run({CreateMsg(eI2NPTunnelData, 2), CreateMsg(eI2NPTunnelBuildReply, 0)});
+  assert(res.first == 0 && res.second == 1);
+  res = Run({CreateMsg(eI2NPTunnelData, 1), CreateMsg(eI2NPTunnelData, 3)});
+  assert(res.first == 1 && res.second == 0);
+  assert(t1->flushed == 4 && t2->flushed == 3);
+
+  return 0;
+}
@@ -0,0 +1,96 @@
+#include <cassert>
+#include <inttypes.h>
+#include <string.h>
+#include <stdio.h>
+#include <chrono>
+#include <vector>
+#include <openssl/rand.h>
+
+#include "Crypto.h"
+
+// compares batched tunnel layer encryption with per-message one and measures both
+
+const size_t NUM_TUNNELS = 16;
+const size_t NUM_MSGS = 4096;
+const int NUM_ROUNDS = 16;
+
+template<typename Layer, typename Single, typename Batch>
+static void Check (std::vector<Layer>& layers, Single single, Batch batch)
+{
+	std::vector<uint8_t> in(NUM_MSGS*1024), out1(NUM_MSGS*1024), out2(NUM_MSGS*1024);
+	RAND_bytes (in.data (), in.size ());
+	for (size_t num = 1; num < 20; num++)
+	{
+		std::vector<typename Layer::BatchItem> items;
+		for (size_t i = 0; i < num; i++)
+		{
+			single (layers[i % NUM_TUNNELS], in.data () + i*1024, out1.data () + i*1024);
+			items.push_back ({ &layers[i % NUM_TUNNELS], in.data () + i*1024, out2.data () + i*1024 });
+		}
+		batch (items.data (), items.size ());
+		assert (!memcmp (out1.data (), out2.data (), num*1024));
+		// in place
+		memcpy (out2.data (), in.data (), num*1024);
+		for (auto& it: items) it.in = it.out;
+		batch (items.data (), items.size ());
+		assert (!memcmp (out1.data (), out2.data (), num*1024));
+	}
+}
+
+template<typename Layer, typename Single, typename Batch>
+static void Benchmark (const char * name, std::vector<Layer>& layers, Single single, Batch batch)
+{
+	std::vector<uint8_t> buf(NUM_MSGS*1024);
+	RAND_bytes (buf.data (), buf.size ());
+	std::vector<typename Layer::BatchItem> items;
+	for (size_t i = 0; i < NUM_MSGS; i++)
+		items.push_back ({ &layers[i % NUM_TUNNELS], buf.data () + i*1024, buf.data () + i*1024 });
+
+	auto start = std::chrono::steady_clock::now ();
+	for (int r = 0; r < NUM_ROUNDS; r++)
+		for (auto& it: items)
+			single (*it.layer, it.in, it.out);
+	auto singleTime = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now () - start).count ();
+
+	start = std::chrono::steady_clock::now ();
+	for (int r = 0; r < NUM_ROUNDS; r++)
+		batch (items.data (), items.size ());
+	auto batchTime = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now () - start).count ();
+
+	double mbytes = (double)NUM_MSGS*1024*NUM_ROUNDS/1000000.0;
+	printf ("%s: per-message %.1f MB/s, batched %.1f MB/s, speedup %.2fx\n", name,
+		mbytes*1000000.0/singleTime, mbytes*1000000.0/batchTime, (double)singleTime/batchTime);
+}
+
+int main ()
+{
+	i2p::cpu::Detect ();
+	std::vector<i2p::crypto::TunnelEncryption> encryptions(NUM_TUNNELS);
+	std::vector<i2p::crypto::TunnelDecryption> decryptions(NUM_TUNNELS);
+	for (size_t i = 0; i < NUM_TUNNELS; i++)
+	{
+		uint8_t layerKey[32], ivKey[32];
+		RAND_bytes (layerKey, 32); RAND_bytes (ivKey, 32);
+		encryptions[i].SetKeys (layerKey, ivKey);
+		decryptions[i].SetKeys (layerKey, ivKey);
+	}
+
+	auto encrypt = [](i2p::crypto::TunnelEncryption& e, const uint8_t * in, uint8_t * out) { e.Encrypt (in, out); };
+	auto encryptBatch = [](const i2p::crypto::TunnelEncryption::BatchItem * items, size_t num) { i2p::crypto::TunnelEncryption::Encrypt (items, num); };
+	auto decrypt = [](i2p::crypto::TunnelDecryption& d, const uint8_t * in, uint8_t * out) { d.Decrypt (in, out); };
+	auto decryptBatch = [](const i2p::crypto::TunnelDecryption::BatchItem * items, size_t num) { i2p::crypto::TunnelDecryption::Decrypt (items, num); };
+
+	Check (encryptions, encrypt, encryptBatch);
+	Check (decryptions, decrypt, decryptBatch);
+
+	// decryption reverses encryption
+	uint8_t msg[1024], enc[1024], dec[1024];
+	RAND_bytes (msg, 1024);
+	encryptions[0].Encrypt (msg, enc);
+	i2p::crypto::TunnelDecryption::BatchItem item{ &decryptions[0], enc, dec };
+	i2p::crypto::TunnelDecryption::Decrypt (&item, 1);
+	assert (!memcmp (msg, dec, 1024));
+
+	Benchmark ("Tunnel encryption", encryptions, encrypt, encryptBatch);
+	Benchmark ("Tunnel decryption", decryptions, decrypt, decryptBatch);
+}